@@ -0,0 +1,51 @@
+// Throughput of the CRC32 backends on the host.
+//
+//   cmake --build build --target radiomesh_benchmarks && ./build/crc32-benchmark
+//
+// The packet CRC covers the frame counter and the payload, so the interesting sizes are a short
+// sensor reading and a full 217-byte payload.
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <common/utils/RadioMeshCrc32.h>
+
+static volatile uint32_t sink;
+
+template <typename Crc>
+static void run(const char* name, const std::vector<uint8_t>& data, size_t length)
+{
+    const size_t iterations = (64 * 1024 * 1024) / (length + 4);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        Crc crc;
+        crc.update(static_cast<uint32_t>(i));
+        crc.update(data.data(), length);
+        sink = crc.finalize();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double bytes = static_cast<double>(iterations) * (length + 4);
+
+    printf("  %-8s %8.1f MB/s %8.1f ns/packet\n", name, bytes / seconds / 1e6,
+           seconds * 1e9 / iterations);
+}
+
+int main()
+{
+    std::vector<uint8_t> data(256);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(i * 37 + 11);
+    }
+
+    for (size_t length : {16, 217}) {
+        printf("fcounter + %zu byte payload\n", length);
+        run<RadioMeshUtils::Crc32Bitwise>("bitwise", data, length);
+        run<RadioMeshUtils::Crc32Nibble>("nibble", data, length);
+        run<RadioMeshUtils::Crc32Table>("table", data, length);
+        run<RadioMeshUtils::Crc32Slice4>("slice4", data, length);
+        run<RadioMeshUtils::Crc32Slice8>("slice8", data, length);
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Lookup and insert cost of the packet tracker against the former std::list + std::unordered_map
+// LRU implementation.
+//
+//   cmake --build build --target radiomesh_benchmarks && ./build/packet-tracker-benchmark
+//
+// The workload mirrors the router: every received frame is looked up, and frames seen for the
+// first time are inserted. Each packet arrives a few times, once per relaying neighbour.
+
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <core/protocol/inc/routing/PacketTracker.h>
+
+// The tracker as it was before it moved to a fixed open-addressed table
+class LegacyPacketTracker
+{
+public:
+    explicit LegacyPacketTracker(uint32_t capacity) : capacity(capacity)
+    {
+    }
+
+    void addEntry(uint32_t key, uint32_t value)
+    {
+        if (map.find(key) != map.end()) {
+            moveToFront(key, value);
+        } else {
+            if (lruList.size() == capacity) {
+                auto last = lruList.back();
+                map.erase(last.first);
+                lruList.pop_back();
+            }
+            lruList.push_front({key, value});
+            map[key] = lruList.begin();
+        }
+    }
+
+    uint32_t findOrDefault(uint32_t key, uint32_t defaultValue)
+    {
+        auto it = map.find(key);
+        if (it != map.end()) {
+            moveToFront(key, it->second->second);
+            return it->second->second;
+        }
+        return defaultValue;
+    }
+
+private:
+    std::list<std::pair<uint32_t, uint32_t>> lruList;
+    std::unordered_map<uint32_t, std::list<std::pair<uint32_t, uint32_t>>::iterator> map;
+    uint32_t capacity;
+
+    void moveToFront(uint32_t key, uint32_t value)
+    {
+        lruList.erase(map[key]);
+        lruList.push_front({key, value});
+        map[key] = lruList.begin();
+    }
+};
+
+static volatile uint32_t sink;
+
+template <typename Tracker>
+static void run(const char* name, Tracker& tracker, const std::vector<uint32_t>& keys)
+{
+    const size_t rounds = 200;
+    uint32_t duplicates = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (uint32_t key : keys) {
+            uint32_t crc = key ^ 0x5A5A5A5A;
+            if (tracker.findOrDefault(key, 0U) == crc) {
+                duplicates++;
+            } else {
+                tracker.addEntry(key, crc);
+            }
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    sink = duplicates;
+
+    printf("  %-8s %8.1f ns/frame\n", name, seconds * 1e9 / (rounds * keys.size()));
+}
+
+int main()
+{
+    const uint32_t capacity = RM_PACKET_TRACKER_CAPACITY;
+
+    // Random packet IDs, each received 3 times spread over the following frames
+    std::vector<uint32_t> ids;
+    uint32_t seed = 1;
+    for (size_t i = 0; i < 20000; i++) {
+        seed = seed * 1664525 + 1013904223;
+        ids.push_back(seed);
+    }
+    std::vector<uint32_t> keys;
+    for (size_t i = 2; i < ids.size(); i++) {
+        keys.push_back(ids[i]);
+        keys.push_back(ids[i - 1]);
+        keys.push_back(ids[i - 2]);
+    }
+
+    printf("%u entries, %zu frames\n", capacity, keys.size());
+    LegacyPacketTracker legacy(capacity);
+    run("legacy", legacy, keys);
+    PacketTracker tracker;
+    run("fixed", tracker, keys);
+    return 0;
+}
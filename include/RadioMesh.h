@@ -16,7 +16,9 @@
 // Protocol includes
 #include <core/protocol/inc/packet/Callbacks.h>
 #include <core/protocol/inc/packet/Packet.h>
+#include <core/protocol/inc/packet/PacketView.h>
 #include <core/protocol/inc/packet/Topics.h>
+#include <core/protocol/inc/routing/TopologyGraph.h>
 
 // Framework interfaces
 #include <framework/interfaces/ICrypto.h>
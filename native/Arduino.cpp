@@ -0,0 +1,179 @@
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "Arduino.h"
+#include "NativeHost.h"
+
+HardwareSerial Serial;
+
+namespace
+{
+bool virtualClock = false;
+uint64_t virtualMicros = 0;
+const auto clockStart = std::chrono::steady_clock::now();
+std::mt19937 rng(0);
+} // namespace
+
+namespace NativeHost
+{
+
+void useVirtualClock(uint64_t startMicros)
+{
+    virtualClock = true;
+    virtualMicros = startMicros;
+}
+
+void useRealClock()
+{
+    virtualClock = false;
+}
+
+bool isVirtualClock()
+{
+    return virtualClock;
+}
+
+void setMicros(uint64_t now)
+{
+    virtualMicros = now;
+}
+
+void advanceMicros(uint64_t deltaMicros)
+{
+    virtualMicros += deltaMicros;
+}
+
+void seedRandom(uint32_t seed)
+{
+    rng.seed(seed);
+}
+
+uint64_t nowMicros()
+{
+    if (virtualClock) {
+        return virtualMicros;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - clockStart;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+} // namespace NativeHost
+
+unsigned long millis()
+{
+    return static_cast<unsigned long>(NativeHost::nowMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    return static_cast<unsigned long>(NativeHost::nowMicros());
+}
+
+void delay(unsigned long ms)
+{
+    if (virtualClock) {
+        virtualMicros += static_cast<uint64_t>(ms) * 1000;
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    if (virtualClock) {
+        virtualMicros += us;
+    } else if (us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+}
+
+long random(long max)
+{
+    if (max <= 0) {
+        return 0;
+    }
+    return static_cast<long>(rng() % static_cast<unsigned long>(max));
+}
+
+long random(long min, long max)
+{
+    if (min >= max) {
+        return min;
+    }
+    return min + random(max - min);
+}
+
+void randomSeed(unsigned long seed)
+{
+    if (seed != 0) {
+        rng.seed(static_cast<std::mt19937::result_type>(seed));
+    }
+}
+
+int analogRead(uint8_t pin)
+{
+    // Floating pin noise, drawn from the same deterministic generator as random()
+    return static_cast<int>(rng() & 0x3FF);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    return LOW;
+}
+
+void yield()
+{
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    return fwrite(buffer, 1, size, stdout);
+}
+
+size_t HardwareSerial::print(const char* str)
+{
+    return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+}
+
+size_t HardwareSerial::print(const std::string& str)
+{
+    return write(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+}
+
+size_t HardwareSerial::println(const char* str)
+{
+    return print(str) + print("\n");
+}
+
+size_t HardwareSerial::println(const std::string& str)
+{
+    return print(str) + print("\n");
+}
+
+size_t HardwareSerial::printf(const char* format, ...)
+{
+    va_list arg;
+    va_start(arg, format);
+    int len = vfprintf(stdout, format, arg);
+    va_end(arg);
+    return len < 0 ? 0 : static_cast<size_t>(len);
+}
+
+void HardwareSerial::flush()
+{
+    fflush(stdout);
+}
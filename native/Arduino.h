@@ -0,0 +1,87 @@
+#pragma once
+
+/**
+ * @file Arduino.h
+ * @brief Minimal Arduino core for the native (host) build.
+ *
+ * Only the subset of the Arduino API used by RadioMesh is provided. Time is taken from the
+ * host steady clock unless a virtual clock is installed with NativeHost::useVirtualClock(),
+ * in which case millis()/micros() return the virtual time and delay() advances it.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#define ARDUINO_NATIVE 1
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define A0 36
+#define GPIO0 0
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define memcpy_P memcpy
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+int analogRead(uint8_t pin);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+void yield();
+
+/**
+ * @class HardwareSerial
+ * @brief Serial port writing to the host stdout.
+ */
+class HardwareSerial
+{
+public:
+    void begin(unsigned long baud)
+    {
+    }
+
+    void end()
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return true;
+    }
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t print(const char* str);
+    size_t print(const std::string& str);
+    size_t println(const char* str = "");
+    size_t println(const std::string& str);
+    size_t printf(const char* format, ...);
+    void flush();
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,64 @@
+#include <algorithm>
+
+#include "EEPROM.h"
+#include "NativeHost.h"
+
+EEPROMClass EEPROM;
+
+bool EEPROMClass::begin(size_t size)
+{
+    if (size == 0 || size > state->flash.size()) {
+        return false;
+    }
+    state->ram.assign(state->flash.begin(), state->flash.begin() + size);
+    state->begun = true;
+    return true;
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+    if (!state->begun || address < 0 || static_cast<size_t>(address) >= state->ram.size()) {
+        return 0;
+    }
+    return state->ram[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+    if (!state->begun || address < 0 || static_cast<size_t>(address) >= state->ram.size()) {
+        return;
+    }
+    state->ram[address] = value;
+}
+
+bool EEPROMClass::commit()
+{
+    if (!state->begun) {
+        return false;
+    }
+    std::copy(state->ram.begin(), state->ram.end(), state->flash.begin());
+    return true;
+}
+
+void EEPROMClass::end()
+{
+    // The ESP32 core commits pending writes before releasing the RAM copy
+    commit();
+    state->ram.clear();
+    state->begun = false;
+}
+
+size_t EEPROMClass::length()
+{
+    return state->ram.size();
+}
+
+void EEPROMClass::setState(EEPROMState* newState)
+{
+    state = newState != nullptr ? newState : &defaultState;
+}
+
+void NativeHost::setEEPROMState(EEPROMState* state)
+{
+    EEPROM.setState(state);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/**
+ * @file EEPROM.h
+ * @brief ESP32-style emulated EEPROM for the native (host) build.
+ *
+ * Like the ESP32 core, begin() loads a RAM copy of the flash contents, read()/write() work on
+ * the RAM copy and commit() writes it back. The flash contents survive end()/begin() cycles.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Size of the emulated flash sector backing the EEPROM.
+const size_t NATIVE_EEPROM_FLASH_SIZE = 4096;
+
+/**
+ * @brief Emulated EEPROM state: persistent flash contents and the RAM copy in use.
+ */
+struct EEPROMState
+{
+    std::vector<uint8_t> flash = std::vector<uint8_t>(NATIVE_EEPROM_FLASH_SIZE, 0xFF);
+    std::vector<uint8_t> ram;
+    bool begun = false;
+};
+
+class EEPROMClass
+{
+public:
+    bool begin(size_t size);
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    bool commit();
+    void end();
+    size_t length();
+
+    /**
+     * @brief Select the state backing this EEPROM. Use NativeHost::setEEPROMState().
+     * @param newState The state to use, or nullptr for the built-in state.
+     */
+    void setState(EEPROMState* newState);
+
+private:
+    EEPROMState defaultState;
+    EEPROMState* state = &defaultState;
+};
+
+extern EEPROMClass EEPROM;
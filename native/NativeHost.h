@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @file NativeHost.h
+ * @brief Controls for the native (host) stand-ins of the Arduino core, EEPROM and radio.
+ *
+ * These hooks only exist in the native build. They let tests and the mesh simulator drive
+ * time deterministically and plug a simulated radio behind the SX1262 driver.
+ */
+
+class NativeRadioBackend;
+struct EEPROMState;
+
+namespace NativeHost
+{
+
+/**
+ * @brief Switch millis()/micros() to a virtual clock starting at the given time.
+ *
+ * While the virtual clock is active, delay() and delayMicroseconds() advance the virtual time
+ * instead of sleeping.
+ *
+ * @param startMicros Initial virtual time in microseconds.
+ */
+void useVirtualClock(uint64_t startMicros = 0);
+
+/**
+ * @brief Switch millis()/micros() back to the host steady clock.
+ */
+void useRealClock();
+
+/**
+ * @brief Check if the virtual clock is active.
+ * @returns true if the virtual clock is active, false otherwise.
+ */
+bool isVirtualClock();
+
+/**
+ * @brief Set the virtual time.
+ * @param nowMicros Virtual time in microseconds.
+ */
+void setMicros(uint64_t nowMicros);
+
+/**
+ * @brief Advance the virtual time.
+ * @param deltaMicros Number of microseconds to advance.
+ */
+void advanceMicros(uint64_t deltaMicros);
+
+/**
+ * @brief Get the current time in microseconds, with full 64-bit range.
+ * @returns The current (virtual or host) time in microseconds.
+ */
+uint64_t nowMicros();
+
+/**
+ * @brief Seed the generator behind random() and analogRead().
+ *
+ * Unlike randomSeed(), a seed of 0 is accepted, so every 32-bit seed selects a sequence.
+ *
+ * @param seed The seed.
+ */
+void seedRandom(uint32_t seed);
+
+/**
+ * @brief Install the radio backend used by SX1262 instances created afterwards.
+ *
+ * Passing nullptr restores the built-in backend, which accepts every command and completes
+ * transmissions immediately.
+ *
+ * @param backend The backend to use. Ownership is not transferred.
+ */
+void setRadioBackend(NativeRadioBackend* backend);
+
+/**
+ * @brief Get the radio backend used by newly created SX1262 instances.
+ * @returns The current radio backend, never nullptr.
+ */
+NativeRadioBackend* getRadioBackend();
+
+/**
+ * @brief Select the EEPROM state (flash contents and RAM copy) used by the global EEPROM.
+ *
+ * Passing nullptr restores the built-in state.
+ *
+ * @param state The EEPROM state to use. Ownership is not transferred.
+ */
+void setEEPROMState(EEPROMState* state);
+
+} // namespace NativeHost
@@ -0,0 +1,254 @@
+#include <cmath>
+#include <cstring>
+
+#include "NativeHost.h"
+#include "RadioLib.h"
+
+namespace
+{
+
+/**
+ * Built-in backend: every transmission completes immediately and nothing is received.
+ */
+class ImmediateRadioBackend : public NativeRadioBackend
+{
+public:
+    int16_t transmit(SX1262& radio, const uint8_t* data, size_t length) override
+    {
+        radio.transmitDone();
+        return RADIOLIB_ERR_NONE;
+    }
+};
+
+ImmediateRadioBackend immediateBackend;
+NativeRadioBackend* currentBackend = &immediateBackend;
+
+const float SX126X_BANDWIDTHS[] = {7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125.0, 250.0, 500.0};
+
+} // namespace
+
+void NativeHost::setRadioBackend(NativeRadioBackend* backend)
+{
+    currentBackend = backend != nullptr ? backend : &immediateBackend;
+}
+
+NativeRadioBackend* NativeHost::getRadioBackend()
+{
+    return currentBackend;
+}
+
+SX1262::SX1262(Module* mod) : module(mod), backend(currentBackend)
+{
+    backend->onAttach(*this, true);
+}
+
+SX1262::~SX1262()
+{
+    backend->onAttach(*this, false);
+}
+
+int16_t SX1262::begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord, int8_t power,
+                      uint16_t preambleLength, float tcxoVoltage, bool useRegulatorLDO)
+{
+    int16_t state = setFrequency(freq);
+    if (state == RADIOLIB_ERR_NONE) {
+        state = setBandwidth(bw);
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+        state = setSpreadingFactor(sf);
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+        state = setCodingRate(cr);
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+        state = setSyncWord(syncWord);
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+        state = setOutputPower(power);
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+        state = setPreambleLength(preambleLength);
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+        mode = Mode::STANDBY;
+        irqFlags = 0;
+    }
+    return state;
+}
+
+int16_t SX1262::setFrequency(float freq)
+{
+    if (freq < 150.0 || freq > 960.0) {
+        return RADIOLIB_ERR_INVALID_FREQUENCY;
+    }
+    frequency = freq;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::setBandwidth(float bw)
+{
+    for (float supported : SX126X_BANDWIDTHS) {
+        if (std::fabs(bw - supported) <= 0.001) {
+            bandwidth = supported;
+            return RADIOLIB_ERR_NONE;
+        }
+    }
+    return RADIOLIB_ERR_INVALID_BANDWIDTH;
+}
+
+int16_t SX1262::setSpreadingFactor(uint8_t sf)
+{
+    if (sf < 5 || sf > 12) {
+        return RADIOLIB_ERR_INVALID_SPREADING_FACTOR;
+    }
+    spreadingFactor = sf;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::setCodingRate(uint8_t cr)
+{
+    if (cr < 5 || cr > 8) {
+        return RADIOLIB_ERR_INVALID_CODING_RATE;
+    }
+    codingRate = cr;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::setOutputPower(int8_t power)
+{
+    if (power < -9 || power > 22) {
+        return RADIOLIB_ERR_INVALID_OUTPUT_POWER;
+    }
+    outputPower = power;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::setSyncWord(uint8_t word, uint8_t controlBits)
+{
+    syncWord = word;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::setPreambleLength(uint16_t length)
+{
+    preambleLength = length;
+    return RADIOLIB_ERR_NONE;
+}
+
+void SX1262::setDio1Action(void (*func)(void))
+{
+    dio1Action = func;
+}
+
+void SX1262::clearDio1Action()
+{
+    dio1Action = nullptr;
+}
+
+int16_t SX1262::startReceive()
+{
+    irqFlags = 0;
+    mode = Mode::RX;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::startTransmit(const uint8_t* data, size_t len, uint8_t addr)
+{
+    if (len > RADIOLIB_SX126X_MAX_PACKET_LENGTH) {
+        return RADIOLIB_ERR_PACKET_TOO_LONG;
+    }
+    irqFlags = 0;
+    mode = Mode::TX;
+    int16_t state = backend->transmit(*this, data, len);
+    if (state != RADIOLIB_ERR_NONE) {
+        mode = Mode::STANDBY;
+    }
+    return state;
+}
+
+int16_t SX1262::standby()
+{
+    mode = Mode::STANDBY;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::sleep(bool retainConfig)
+{
+    mode = Mode::SLEEP;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1262::scanChannel()
+{
+    irqFlags = 0;
+    mode = Mode::STANDBY;
+    return backend->isChannelActive(*this) ? RADIOLIB_LORA_DETECTED : RADIOLIB_CHANNEL_FREE;
+}
+
+size_t SX1262::getPacketLength(bool update)
+{
+    return rxBuffer.size();
+}
+
+int16_t SX1262::readData(uint8_t* data, size_t len)
+{
+    size_t length = len < rxBuffer.size() ? len : rxBuffer.size();
+    if (length > 0) {
+        memcpy(data, rxBuffer.data(), length);
+    }
+    irqFlags = 0;
+    return RADIOLIB_ERR_NONE;
+}
+
+float SX1262::getRSSI(bool packet)
+{
+    return lastRssi;
+}
+
+float SX1262::getSNR()
+{
+    return lastSnr;
+}
+
+uint32_t SX1262::getIrqFlags()
+{
+    return irqFlags;
+}
+
+RadioLibTime_t SX1262::getTimeOnAir(size_t len)
+{
+    const double symbolMicros = std::pow(2.0, spreadingFactor) / (bandwidth * 1000.0) * 1e6;
+    const int lowDataRate = symbolMicros > 16000.0 ? 1 : 0;
+    double numerator = 8.0 * len - 4.0 * spreadingFactor + 28.0 + 16.0;
+    double denominator = 4.0 * (spreadingFactor - 2.0 * lowDataRate);
+    double payloadSymbols = 8.0 + std::fmax(std::ceil(numerator / denominator) * codingRate, 0.0);
+    double preambleSymbols = preambleLength + 4.25;
+    return static_cast<RadioLibTime_t>(std::llround((preambleSymbols + payloadSymbols) *
+                                                    symbolMicros));
+}
+
+bool SX1262::receive(const uint8_t* data, size_t len, float rssi, float snr)
+{
+    if (mode != Mode::RX || len > RADIOLIB_SX126X_MAX_PACKET_LENGTH) {
+        return false;
+    }
+    rxBuffer.assign(data, data + len);
+    lastRssi = rssi;
+    lastSnr = snr;
+    raiseIrq(RADIOLIB_SX126X_IRQ_RX_DONE);
+    return true;
+}
+
+void SX1262::transmitDone()
+{
+    mode = Mode::STANDBY;
+    raiseIrq(RADIOLIB_SX126X_IRQ_TX_DONE);
+}
+
+void SX1262::raiseIrq(uint32_t flags)
+{
+    irqFlags |= flags;
+    if (dio1Action != nullptr) {
+        dio1Action();
+    }
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+/**
+ * @file RadioLib.h
+ * @brief SX1262 stand-in for the native (host) build.
+ *
+ * The SX1262 class emulates the chip side of the RadioLib driver used by LoraRadio: parameter
+ * validation, operating mode, IRQ flags, the DIO1 interrupt and the RX buffer. What happens on
+ * the air is delegated to a NativeRadioBackend, installed with NativeHost::setRadioBackend().
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define RADIOLIB_NC (0xFFFFFFFF)
+
+#define RADIOLIB_ERR_NONE (0)
+#define RADIOLIB_ERR_UNKNOWN (-1)
+#define RADIOLIB_ERR_CHIP_NOT_FOUND (-2)
+#define RADIOLIB_ERR_PACKET_TOO_LONG (-4)
+#define RADIOLIB_ERR_TX_TIMEOUT (-5)
+#define RADIOLIB_ERR_RX_TIMEOUT (-6)
+#define RADIOLIB_ERR_CRC_MISMATCH (-7)
+#define RADIOLIB_ERR_INVALID_BANDWIDTH (-8)
+#define RADIOLIB_ERR_INVALID_SPREADING_FACTOR (-9)
+#define RADIOLIB_ERR_INVALID_CODING_RATE (-10)
+#define RADIOLIB_ERR_INVALID_FREQUENCY (-12)
+#define RADIOLIB_ERR_INVALID_OUTPUT_POWER (-13)
+
+#define RADIOLIB_PREAMBLE_DETECTED (0)
+#define RADIOLIB_LORA_DETECTED (1)
+#define RADIOLIB_CHANNEL_FREE (-702)
+
+#define RADIOLIB_SX126X_IRQ_TX_DONE 0b0000000001
+#define RADIOLIB_SX126X_IRQ_RX_DONE 0b0000000010
+#define RADIOLIB_SX126X_IRQ_PREAMBLE_DETECTED 0b0000000100
+#define RADIOLIB_SX126X_IRQ_SYNC_WORD_VALID 0b0000001000
+#define RADIOLIB_SX126X_IRQ_HEADER_VALID 0b0000010000
+#define RADIOLIB_SX126X_IRQ_HEADER_ERR 0b0000100000
+#define RADIOLIB_SX126X_IRQ_CRC_ERR 0b0001000000
+#define RADIOLIB_SX126X_IRQ_CAD_DONE 0b0010000000
+#define RADIOLIB_SX126X_IRQ_CAD_DETECTED 0b0100000000
+#define RADIOLIB_SX126X_IRQ_TIMEOUT 0b1000000000
+
+#define RADIOLIB_SX126X_MAX_PACKET_LENGTH 255
+
+typedef unsigned long RadioLibTime_t;
+#define RADIOLIB_SX126X_SYNC_WORD_PRIVATE 0x12
+
+class SX1262;
+
+/**
+ * @class NativeRadioBackend
+ * @brief The medium behind emulated SX1262 radios.
+ *
+ * A backend decides what happens to a transmitted frame. It reports the end of a transmission
+ * with SX1262::transmitDone() and delivers frames to other radios with SX1262::receive().
+ */
+class NativeRadioBackend
+{
+public:
+    virtual ~NativeRadioBackend()
+    {
+    }
+
+    /**
+     * @brief Called when a radio starts transmitting a frame.
+     * @param radio The transmitting radio.
+     * @param data The frame bytes.
+     * @param length The frame length.
+     * @returns RADIOLIB_ERR_NONE if the transmission started, a RadioLib error code otherwise.
+     */
+    virtual int16_t transmit(SX1262& radio, const uint8_t* data, size_t length) = 0;
+
+    /**
+     * @brief Called when a radio runs channel activity detection.
+     * @param radio The scanning radio.
+     * @returns true if LoRa activity is heard on the radio's channel, false otherwise.
+     */
+    virtual bool isChannelActive(SX1262& radio)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Called when a radio is created or destroyed.
+     * @param radio The radio.
+     * @param attached true when the radio is created, false when it is destroyed.
+     */
+    virtual void onAttach(SX1262& radio, bool attached)
+    {
+    }
+};
+
+/**
+ * @class Module
+ * @brief Pin mapping of a radio module. Pins are only recorded.
+ */
+class Module
+{
+public:
+    Module(uint32_t cs, uint32_t irq, uint32_t rst, uint32_t gpio = RADIOLIB_NC)
+        : cs(cs), irq(irq), rst(rst), gpio(gpio)
+    {
+    }
+
+    uint32_t cs;
+    uint32_t irq;
+    uint32_t rst;
+    uint32_t gpio;
+};
+
+class SX1262
+{
+public:
+    /// @brief Chip operating mode.
+    enum class Mode
+    {
+        SLEEP,
+        STANDBY,
+        RX,
+        TX
+    };
+
+    explicit SX1262(Module* mod);
+    ~SX1262();
+
+    int16_t begin(float freq = 434.0, float bw = 125.0, uint8_t sf = 9, uint8_t cr = 7,
+                  uint8_t syncWord = RADIOLIB_SX126X_SYNC_WORD_PRIVATE, int8_t power = 10,
+                  uint16_t preambleLength = 8, float tcxoVoltage = 1.6,
+                  bool useRegulatorLDO = false);
+
+    int16_t setFrequency(float freq);
+    int16_t setBandwidth(float bw);
+    int16_t setSpreadingFactor(uint8_t sf);
+    int16_t setCodingRate(uint8_t cr);
+    int16_t setOutputPower(int8_t power);
+    int16_t setSyncWord(uint8_t syncWord, uint8_t controlBits = 0x44);
+    int16_t setPreambleLength(uint16_t preambleLength);
+
+    void setDio1Action(void (*func)(void));
+    void clearDio1Action();
+
+    int16_t startReceive();
+    int16_t startTransmit(const uint8_t* data, size_t len, uint8_t addr = 0);
+    int16_t standby();
+    int16_t sleep(bool retainConfig = true);
+    /// @brief Blocking channel activity detection, the radio is left in standby like the driver.
+    int16_t scanChannel();
+
+    size_t getPacketLength(bool update = true);
+    int16_t readData(uint8_t* data, size_t len);
+    float getRSSI(bool packet = true);
+    float getSNR();
+    uint32_t getIrqFlags();
+    /// @brief Time on air of a packet in microseconds, explicit header and CRC on like the driver.
+    RadioLibTime_t getTimeOnAir(size_t len);
+
+    // Native only: used by backends
+
+    /**
+     * @brief Deliver a frame to this radio, as if it was demodulated from the air.
+     *
+     * The frame is only accepted while the radio is in receive mode. On success the RX buffer is
+     * replaced, RX_DONE is raised and the DIO1 action is invoked.
+     *
+     * @returns true if the frame was accepted, false otherwise.
+     */
+    bool receive(const uint8_t* data, size_t len, float rssi, float snr);
+
+    /**
+     * @brief Complete the current transmission: raise TX_DONE and invoke the DIO1 action.
+     */
+    void transmitDone();
+
+    /**
+     * @brief Raise IRQ flags and invoke the DIO1 action.
+     * @param flags RADIOLIB_SX126X_IRQ_* flags to raise.
+     */
+    void raiseIrq(uint32_t flags);
+
+    Mode getMode() const
+    {
+        return mode;
+    }
+    float getFrequency() const
+    {
+        return frequency;
+    }
+    float getBandwidth() const
+    {
+        return bandwidth;
+    }
+    uint8_t getSpreadingFactor() const
+    {
+        return spreadingFactor;
+    }
+    uint8_t getCodingRate() const
+    {
+        return codingRate;
+    }
+    int8_t getOutputPower() const
+    {
+        return outputPower;
+    }
+    uint8_t getSyncWord() const
+    {
+        return syncWord;
+    }
+    uint16_t getPreambleLength() const
+    {
+        return preambleLength;
+    }
+    const Module* getModule() const
+    {
+        return module.get();
+    }
+
+    /// @brief Opaque pointer for the backend to associate its own state with this radio.
+    void* userData = nullptr;
+
+private:
+    std::unique_ptr<Module> module;
+    NativeRadioBackend* backend = nullptr;
+    void (*dio1Action)(void) = nullptr;
+
+    Mode mode = Mode::STANDBY;
+    uint32_t irqFlags = 0;
+
+    float frequency = 434.0;
+    float bandwidth = 125.0;
+    uint8_t spreadingFactor = 9;
+    uint8_t codingRate = 7;
+    int8_t outputPower = 10;
+    uint8_t syncWord = RADIOLIB_SX126X_SYNC_WORD_PRIVATE;
+    uint16_t preambleLength = 8;
+
+    std::vector<uint8_t> rxBuffer;
+    float lastRssi = 0;
+    float lastSnr = 0;
+};
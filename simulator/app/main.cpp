@@ -0,0 +1,185 @@
+// radiomesh-sim: run a randomly placed RadioMesh network on the virtual channel and print the
+// delivery, latency and airtime report. See docs/mesh-simulator.md.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <MeshSimulator.h>
+#include <common/utils/Utils.h>
+#include <core/protocol/inc/transport/ReliableTransfer.h>
+
+static void usage(const char* program)
+{
+    printf("Usage: %s [options]\n"
+           "  --nodes N        number of nodes, including the hub (default 10)\n"
+           "  --area M         side of the square area in meters (default 2000)\n"
+           "  --line           place the nodes evenly along a line of the area's side, hub first\n"
+           "  --seed S         random seed (default 1)\n"
+           "  --duration S     traffic duration in seconds (default 600)\n"
+           "  --period S       mean message period per node in seconds (default 60)\n"
+           "  --payload B      payload size in bytes (default 20)\n"
+           "  --sf SF          spreading factor (default 8)\n"
+           "  --loss P         random frame loss probability (default 0)\n"
+           "  --shadowing DB   log-normal shadowing sigma in dB (default 0)\n"
+           "  --broadcast      send to broadcast instead of the hub\n"
+           "  --peers          send to random other nodes instead of the hub\n"
+           "  --push           send from the hub to every node instead\n"
+           "  --reliable       send unicast messages reliably, acknowledged end to end\n"
+           "  --lbt            listen before talk before every transmission\n"
+           "  --relay-lbt      listen before talk before relayed frames\n"
+           "  --beacons        send neighbour discovery beacons\n"
+           "  --region R       airtime rules: eu868 (868.3 MHz, 1%% duty cycle) or us915\n"
+           "  --fail N:S       power node N off S seconds into the run, may be repeated\n"
+           "  --per-node       print per node counters\n",
+           program);
+}
+
+int main(int argc, char** argv)
+{
+    size_t nodeCount = 10;
+    double area = 2000.0;
+    uint32_t seed = 1;
+    uint64_t durationS = 600;
+    uint32_t periodS = 60;
+    size_t payload = 20;
+    int sf = 8;
+    bool broadcast = false;
+    bool peers = false;
+    bool push = false;
+    bool lbt = false;
+    bool relayLbt = false;
+    bool line = false;
+    bool perNode = false;
+    std::vector<std::pair<size_t, uint64_t>> failures;
+    SimConfig config;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (arg == "--broadcast") {
+            broadcast = true;
+            continue;
+        }
+        if (arg == "--peers") {
+            peers = true;
+            continue;
+        }
+        if (arg == "--push") {
+            push = true;
+            continue;
+        }
+        if (arg == "--reliable") {
+            config.reliable = true;
+            continue;
+        }
+        if (arg == "--beacons") {
+            config.beacons = true;
+            continue;
+        }
+        if (arg == "--lbt") {
+            lbt = true;
+            continue;
+        }
+        if (arg == "--relay-lbt") {
+            relayLbt = true;
+            continue;
+        }
+        if (arg == "--line") {
+            line = true;
+            continue;
+        }
+        if (arg == "--per-node") {
+            perNode = true;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h" || value == nullptr) {
+            usage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+        i++;
+        if (arg == "--nodes") {
+            nodeCount = strtoul(value, nullptr, 10);
+        } else if (arg == "--area") {
+            area = atof(value);
+        } else if (arg == "--seed") {
+            seed = strtoul(value, nullptr, 10);
+        } else if (arg == "--duration") {
+            durationS = strtoull(value, nullptr, 10);
+        } else if (arg == "--period") {
+            periodS = strtoul(value, nullptr, 10);
+        } else if (arg == "--payload") {
+            payload = strtoul(value, nullptr, 10);
+        } else if (arg == "--sf") {
+            sf = atoi(value);
+        } else if (arg == "--loss") {
+            config.channel.packetLossRate = atof(value);
+        } else if (arg == "--shadowing") {
+            config.channel.shadowingSigmaDb = atof(value);
+        } else if (arg == "--region" && strcmp(value, "eu868") == 0) {
+            config.radio.setBand(868.3).setAirtimeRegion(AirtimeRegion::EU868);
+        } else if (arg == "--region" && strcmp(value, "us915") == 0) {
+            config.radio.setAirtimeRegion(AirtimeRegion::US915);
+        } else if (arg == "--fail" && strchr(value, ':') != nullptr) {
+            failures.emplace_back(strtoul(value, nullptr, 10),
+                                  strtoull(strchr(value, ':') + 1, nullptr, 10));
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    size_t maxPayload = config.reliable ? ReliableTransfer::MAX_MESSAGE_LENGTH : MAX_DATA_LENGTH;
+    if (nodeCount < 2 || periodS == 0 || payload == 0 || payload > maxPayload) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    config.seed = seed;
+    config.radio.sf = sf;
+    config.radio.setListenBeforeTalk(lbt).setRelayListenBeforeTalk(relayLbt);
+    MeshSimulator sim(config);
+
+    // Hub in the center, other nodes uniformly placed. On a line, the hub at one end.
+    std::mt19937 placement(seed);
+    std::uniform_real_distribution<double> coordinate(0.0, area);
+    std::array<byte, RM_ID_LENGTH> hubId = RadioMeshUtils::uint32ToDeviceId(1);
+    for (size_t i = 0; i < nodeCount; i++) {
+        SimNodeConfig node;
+        node.id = RadioMeshUtils::uint32ToDeviceId(i + 1);
+        node.name = (i == 0) ? "hub" : "node" + std::to_string(i);
+        node.type = (i == 0) ? MeshDeviceType::HUB : MeshDeviceType::STANDARD;
+        if (line) {
+            node.x = area * i / (nodeCount - 1);
+        } else {
+            node.x = (i == 0) ? area / 2 : coordinate(placement);
+            node.y = (i == 0) ? area / 2 : coordinate(placement);
+        }
+        if (sim.addNode(node) < 0) {
+            fprintf(stderr, "Failed to create node %zu\n", i);
+            return 1;
+        }
+    }
+
+    if (peers) {
+        sim.schedulePeerTraffic(periodS * 1000, durationS * 1000, payload);
+    } else if (push) {
+        sim.schedulePushTraffic(periodS * 1000, durationS * 1000, payload);
+    } else {
+        sim.schedulePeriodicTraffic(periodS * 1000, durationS * 1000, payload,
+                                    broadcast ? BROADCAST_ADDR : hubId);
+    }
+    for (const auto& failure : failures) {
+        sim.scheduleNodeFailure(failure.first, failure.second * 1000000ULL);
+    }
+    // Leave time for the last messages to propagate
+    sim.runFor(durationS * 1000 + 10000);
+
+    SimReport report = sim.getReport();
+    printf("%s", report.toString(perNode).c_str());
+    return 0;
+}
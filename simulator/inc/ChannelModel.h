@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+/**
+ * @brief Parameters of the simulated LoRa channel.
+ *
+ * Path loss follows the log-distance model PL(d) = PL(d0) + 10 * n * log10(d / d0) with d0 = 1 m,
+ * plus optional log-normal shadowing. The defaults describe a suburban 915 MHz deployment.
+ */
+struct ChannelParams
+{
+    /// @brief Path loss at the 1 m reference distance, in dB (free space at 915 MHz)
+    double referenceLossDb = 31.7;
+    /// @brief Path loss exponent n (2.0 free space, 2.7 - 3.5 urban)
+    double pathLossExponent = 2.9;
+    /// @brief Standard deviation of the log-normal shadowing, in dB. 0 disables shadowing.
+    double shadowingSigmaDb = 0.0;
+    /// @brief Receiver noise figure, in dB
+    double noiseFigureDb = 6.0;
+    /// @brief Minimum power difference for the stronger of two overlapping frames to survive
+    double captureThresholdDb = 6.0;
+    /// @brief Probability that an otherwise valid frame is dropped (fading, interference)
+    double packetLossRate = 0.0;
+};
+
+/**
+ * @brief LoRa modulation settings needed to compute the time on air of a frame.
+ */
+struct LoraModulation
+{
+    uint8_t sf = 7;
+    float bw = 125.0;
+    /// @brief RadioLib coding rate denominator, 5 to 8 for 4/5 to 4/8
+    uint8_t cr = 7;
+    uint16_t preambleLength = 8;
+    bool explicitHeader = true;
+    bool crcOn = true;
+};
+
+/**
+ * @class ChannelModel
+ * @brief Link budget and time on air for the mesh simulator.
+ */
+class ChannelModel
+{
+public:
+    explicit ChannelModel(const ChannelParams& params = ChannelParams()) : params(params)
+    {
+    }
+
+    const ChannelParams& getParams() const
+    {
+        return params;
+    }
+
+    /**
+     * @brief Compute the time on air of a LoRa frame, as specified in the SX126x datasheet.
+     *
+     * Low data rate optimization is enabled when the symbol time exceeds 16 ms, which matches
+     * what RadioLib does automatically for the SX126x.
+     *
+     * @param modulation The modulation settings.
+     * @param payloadLength The frame length in bytes.
+     * @returns The time on air in microseconds.
+     */
+    static uint64_t timeOnAirMicros(const LoraModulation& modulation, size_t payloadLength);
+
+    /**
+     * @brief Get the demodulation SNR floor of a spreading factor.
+     * @param sf The spreading factor.
+     * @returns The minimum SNR in dB.
+     */
+    static double snrThresholdDb(uint8_t sf);
+
+    /**
+     * @brief Get the thermal noise floor of the receiver.
+     * @param bwKHz The bandwidth in kHz.
+     * @returns The noise floor in dBm.
+     */
+    double noiseFloorDbm(float bwKHz) const;
+
+    /**
+     * @brief Compute the path loss between two points.
+     * @param distanceMeters The distance in meters.
+     * @param rng The generator used for shadowing.
+     * @returns The path loss in dB.
+     */
+    double pathLossDb(double distanceMeters, std::mt19937_64& rng) const;
+
+private:
+    ChannelParams params;
+};
@@ -0,0 +1,481 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <EEPROM.h>
+#include <NativeHost.h>
+#include <RadioLib.h>
+
+#include <common/inc/Definitions.h>
+#include <common/inc/RadioConfigs.h>
+#include <core/protocol/inc/packet/Packet.h>
+
+#include <ChannelModel.h>
+
+class RadioMeshDevice;
+class LoraRadio;
+class PacketRouter;
+class RoutingTable;
+class EEPROMStorage;
+class AesCrypto;
+class EcdhKeyCache;
+
+/**
+ * @brief Description of a simulated node.
+ */
+struct SimNodeConfig
+{
+    std::string name;
+    std::array<byte, RM_ID_LENGTH> id = {0, 0, 0, 0};
+    MeshDeviceType type = MeshDeviceType::STANDARD;
+    /// @brief Position in meters
+    double x = 0.0;
+    double y = 0.0;
+    bool relayEnabled = true;
+};
+
+/**
+ * @brief Global simulation settings.
+ */
+struct SimConfig
+{
+    /// @brief Seed for every random draw of the run (channel, traffic, packet ids)
+    uint32_t seed = 1;
+    ChannelParams channel;
+    /// @brief Radio settings applied to every node. Pins are ignored.
+    LoraRadioParams radio = LoraRadioPresets::HELTEC_WIFI_LORA_32_V3;
+    /// @brief Network key provisioned in every node, so all nodes start included
+    std::vector<byte> networkKey = std::vector<byte>(32, 0x42);
+    /// @brief Interval at which every node's run() is called when idle. 0 only runs nodes on
+    /// radio events.
+    uint32_t pollIntervalMs = 0;
+    /// @brief Send unicast messages with sendReliableData(), acknowledged end to end
+    bool reliable = false;
+    /// @brief Every node sends neighbour discovery beacons
+    bool beacons = false;
+};
+
+/**
+ * @brief Per node counters.
+ */
+struct SimNodeStats
+{
+    uint64_t airtimeMicros = 0;
+    uint32_t framesSent = 0;
+    uint32_t framesReceived = 0;
+    /// @brief Frames sent on behalf of another node
+    uint32_t relays = 0;
+    /// @brief Frames of a message this node had already sent
+    uint32_t duplicateRebroadcasts = 0;
+    /// @brief Rebroadcasts cancelled because enough neighbours relayed the message first
+    uint32_t relaysSuppressed = 0;
+    /// @brief Rebroadcasts dropped to make room in a full relay table
+    uint32_t relaysDropped = 0;
+    /// @brief Frames lost at this node because they overlapped another frame
+    uint32_t collisions = 0;
+    /// @brief Frames lost at this node because it was transmitting
+    uint32_t missedWhileTransmitting = 0;
+    /// @brief Frames dropped at this node by the random loss model
+    uint32_t randomLosses = 0;
+    /// @brief Listen before talk detections that found the channel busy
+    uint32_t channelBusy = 0;
+    /// @brief Frames given up because the channel stayed busy
+    uint32_t channelBusyDrops = 0;
+    /// @brief Frames held back by the airtime budget
+    uint32_t airtimeDeferred = 0;
+    /// @brief Frames dropped by the airtime budget
+    uint32_t airtimeDropped = 0;
+    /// @brief Unicast frames acknowledged by their next hop
+    uint32_t hopAcked = 0;
+    /// @brief Unicast frames sent again because their ACK timed out
+    uint32_t hopRetransmissions = 0;
+    /// @brief Unicast frames given up without an ACK
+    uint32_t hopAckFailures = 0;
+    /// @brief Reliable messages acknowledged by their destination
+    uint32_t reliableAcknowledged = 0;
+    /// @brief Reliable messages given up without an acknowledgement
+    uint32_t reliableFailed = 0;
+    /// @brief Reliable messages sent again
+    uint32_t reliableRetransmissions = 0;
+    /// @brief Reliable messages refused because every slot waited for an acknowledgement
+    uint32_t reliableRefused = 0;
+    /// @brief Routes moved to an alternative next hop after a missed hop ACK
+    uint32_t routeFailovers = 0;
+    /// @brief Neighbour discovery beacons and answers sent
+    uint32_t beaconsSent = 0;
+    /// @brief Beacons skipped because enough neighbours beaconed
+    uint32_t beaconsSuppressed = 0;
+};
+
+/**
+ * @brief Summary of a simulation run.
+ */
+struct SimReport
+{
+    uint64_t simulatedMicros = 0;
+    uint32_t messagesSent = 0;
+    /// @brief Expected deliveries: 1 per unicast message, N - 1 per broadcast message
+    uint32_t deliveriesExpected = 0;
+    uint32_t deliveries = 0;
+    double deliveryRatio = 0.0;
+    double latencyAvgMs = 0.0;
+    double latencyP50Ms = 0.0;
+    double latencyP95Ms = 0.0;
+    double latencyMaxMs = 0.0;
+    uint32_t framesSent = 0;
+    uint32_t relays = 0;
+    uint32_t duplicateRebroadcasts = 0;
+    uint32_t relaysSuppressed = 0;
+    uint32_t relaysDropped = 0;
+    uint32_t collisions = 0;
+    uint32_t channelBusy = 0;
+    uint32_t channelBusyDrops = 0;
+    uint32_t airtimeDeferred = 0;
+    uint32_t airtimeDropped = 0;
+    uint32_t hopAcked = 0;
+    uint32_t hopRetransmissions = 0;
+    uint32_t hopAckFailures = 0;
+    uint32_t reliableAcknowledged = 0;
+    uint32_t reliableFailed = 0;
+    uint32_t reliableRetransmissions = 0;
+    uint32_t reliableRefused = 0;
+    uint32_t routeFailovers = 0;
+    uint32_t beaconsSent = 0;
+    uint32_t beaconsSuppressed = 0;
+    /// @brief Devices and links in the topology graphs of the hubs
+    uint32_t topologyDevices = 0;
+    uint32_t topologyLinks = 0;
+    /// @brief Link changes the hubs observed, and shortest paths they computed again for them
+    uint32_t topologyLinkChanges = 0;
+    uint32_t topologyPathUpdates = 0;
+    uint64_t airtimeMicros = 0;
+    std::vector<SimNodeStats> nodes;
+
+    /**
+     * @brief Format the report as human readable text.
+     * @param perNode Include one line per node.
+     * @returns The formatted report.
+     */
+    std::string toString(bool perNode = false) const;
+};
+
+/**
+ * @class MeshSimulator
+ * @brief Discrete-event simulator running RadioMeshDevice instances over a virtual LoRa channel.
+ *
+ * Every node is a real RadioMeshDevice built with DeviceBuilder, with its own LoraRadio,
+ * PacketRouter, RoutingTable, EEPROMStorage and emulated EEPROM. The library singletons are
+ * swapped in before a node runs, so nodes share nothing but the channel.
+ *
+ * Time is virtual: the simulator installs the NativeHost virtual clock and jumps from one event
+ * to the next. A transmission occupies the channel for its exact time on air. At every receiver
+ * in range it overlaps other frames (capture effect, otherwise both are lost), is lost if the
+ * receiver transmits meanwhile, and is subject to random loss. Channel activity detection reports
+ * the channel busy while a frame the node can demodulate is on air. All random draws derive from
+ * SimConfig::seed, so a run is reproducible.
+ *
+ * Only one simulator may exist at a time.
+ */
+class MeshSimulator : public NativeRadioBackend
+{
+public:
+    explicit MeshSimulator(const SimConfig& config = SimConfig());
+    virtual ~MeshSimulator();
+
+    MeshSimulator(const MeshSimulator&) = delete;
+    void operator=(const MeshSimulator&) = delete;
+
+    /**
+     * @brief Create a node, provisioned as included in the network.
+     * @param nodeConfig The node description.
+     * @returns The node index, or -1 if the device could not be built.
+     */
+    int addNode(const SimNodeConfig& nodeConfig);
+
+    /**
+     * @brief Get the number of nodes.
+     * @returns The number of nodes.
+     */
+    size_t getNodeCount() const
+    {
+        return nodes.size();
+    }
+
+    /**
+     * @brief Get the device of a node.
+     * @param index The node index.
+     * @returns The device, or nullptr if the index is invalid.
+     */
+    RadioMeshDevice* getDevice(size_t index);
+
+    /**
+     * @brief Run a function in the context of a node (its singletons installed).
+     * @param index The node index.
+     * @param fn The function to run.
+     */
+    template <typename Fn>
+    void withNode(size_t index, Fn fn)
+    {
+        if (index < nodes.size()) {
+            activate(*nodes[index]);
+            fn();
+        }
+    }
+
+    /**
+     * @brief Schedule an application message.
+     * @param from The sending node index.
+     * @param atMicros The virtual time of the send, in microseconds.
+     * @param topic The application topic.
+     * @param data The payload.
+     * @param target The destination, broadcast by default.
+     */
+    void scheduleSend(size_t from, uint64_t atMicros, uint8_t topic, const std::vector<byte>& data,
+                      std::array<byte, RM_ID_LENGTH> target = BROADCAST_ADDR);
+
+    /**
+     * @brief Power a node off: from then on it neither runs, transmits nor receives.
+     *
+     * A transmission in progress is cut short, and the node's scheduled messages are not sent.
+     *
+     * @param index The node index.
+     * @param atMicros The virtual time of the failure, in microseconds.
+     */
+    void scheduleNodeFailure(size_t index, uint64_t atMicros);
+
+    /**
+     * @brief Power cycle a node: it loses everything but its storage and boots again.
+     *
+     * A node that is down is powered on again. The counters its device keeps, such as hop
+     * ACKs and relays, start over.
+     *
+     * @param index The node index.
+     * @param atMicros The virtual time of the restart, in microseconds.
+     */
+    void scheduleNodeRestart(size_t index, uint64_t atMicros);
+
+    /**
+     * @brief Schedule periodic messages from every standard node to a destination.
+     *
+     * Send times follow a Poisson process of the given mean period, drawn from the seed.
+     *
+     * @param meanPeriodMs Mean time between two messages of a node.
+     * @param durationMs Length of the traffic window, starting now.
+     * @param payloadSize Payload length in bytes.
+     * @param target The destination.
+     * @param topic The application topic.
+     */
+    void schedulePeriodicTraffic(uint32_t meanPeriodMs, uint64_t durationMs, size_t payloadSize,
+                                 std::array<byte, RM_ID_LENGTH> target, uint8_t topic = 0x10);
+
+    /**
+     * @brief Schedule periodic messages from every standard node to other standard nodes.
+     *
+     * Like schedulePeriodicTraffic(), each message going to another standard node drawn at
+     * random, so unicast routes form between the nodes.
+     *
+     * @param meanPeriodMs Mean time between two messages of a node.
+     * @param durationMs Length of the traffic window, starting now.
+     * @param payloadSize Payload length in bytes.
+     * @param topic The application topic.
+     */
+    void schedulePeerTraffic(uint32_t meanPeriodMs, uint64_t durationMs, size_t payloadSize,
+                             uint8_t topic = 0x10);
+
+    /**
+     * @brief Schedule periodic messages from the hub to every standard node.
+     *
+     * Like schedulePeriodicTraffic() in the other direction, each node receiving its own stream
+     * of messages, as when the hub pushes configuration.
+     *
+     * @param meanPeriodMs Mean time between two messages to a node.
+     * @param durationMs Length of the traffic window, starting now.
+     * @param payloadSize Payload length in bytes.
+     * @param topic The application topic.
+     */
+    void schedulePushTraffic(uint32_t meanPeriodMs, uint64_t durationMs, size_t payloadSize,
+                             uint8_t topic = 0x10);
+
+    /**
+     * @brief Process events until the virtual clock reaches the given time.
+     * @param untilMicros The virtual time to stop at.
+     */
+    void runUntil(uint64_t untilMicros);
+
+    /**
+     * @brief Process events for a duration.
+     * @param durationMs The duration in milliseconds.
+     */
+    void runFor(uint64_t durationMs)
+    {
+        runUntil(nowMicros + durationMs * 1000);
+    }
+
+    /**
+     * @brief Get the current virtual time.
+     * @returns The virtual time in microseconds.
+     */
+    uint64_t getNowMicros() const
+    {
+        return nowMicros;
+    }
+
+    /**
+     * @brief Build the report for everything simulated so far.
+     * @returns The report.
+     */
+    SimReport getReport() const;
+
+    /**
+     * @brief Get the channel model.
+     * @returns The channel model.
+     */
+    const ChannelModel& getChannel() const
+    {
+        return channel;
+    }
+
+    // NativeRadioBackend interface
+    int16_t transmit(SX1262& radio, const uint8_t* data, size_t length) override;
+    void onAttach(SX1262& radio, bool attached) override;
+    bool isChannelActive(SX1262& radio) override;
+
+private:
+    struct Reception
+    {
+        uint64_t txId;
+        uint64_t endMicros;
+        float rssi;
+        float snr;
+        bool lost;
+    };
+
+    struct MessageRecord
+    {
+        uint64_t sentMicros;
+        uint8_t topic;
+        bool broadcast;
+        size_t source;
+        std::array<byte, RM_ID_LENGTH> target;
+        std::map<size_t, uint64_t> deliveredMicros;
+    };
+
+    struct Node
+    {
+        SimNodeConfig config;
+        EEPROMState eeprom;
+        LoraRadio* radio = nullptr;
+        PacketRouter* router = nullptr;
+        RoutingTable* routingTable = nullptr;
+        EEPROMStorage* storage = nullptr;
+        AesCrypto* crypto = nullptr;
+        EcdhKeyCache* ecdhKeys = nullptr;
+        RadioMeshDevice* device = nullptr;
+        SX1262* sx = nullptr;
+        size_t index = 0;
+
+        uint64_t currentTxId = 0;
+        // Earliest WAKEUP event scheduled for the node, 0 if none
+        uint64_t wakeupMicros = 0;
+        std::vector<Reception> receptions;
+        std::set<uint64_t> sentMessages;
+        // Application messages handed to the device, waiting in its transmit queue
+        std::deque<MessageRecord> queuedMessages;
+        SimNodeStats stats;
+        // Powered off by scheduleNodeFailure(), until scheduleNodeRestart()
+        bool down = false;
+    };
+
+    struct Transmission
+    {
+        size_t sender;
+        uint64_t startMicros;
+        uint64_t endMicros;
+        std::vector<uint8_t> frame;
+        std::vector<size_t> receivers;
+        // Nodes close enough to demodulate the frame, whatever their radio was doing
+        std::vector<size_t> inRange;
+        bool aborted;
+    };
+
+    enum class EventType
+    {
+        TX_END,
+        APP_SEND,
+        POLL,
+        WAKEUP,
+        NODE_DOWN,
+        NODE_RESTART
+    };
+
+    struct Event
+    {
+        uint64_t atMicros;
+        uint64_t sequence;
+        EventType type;
+        size_t node;
+        uint64_t ref;
+
+        bool operator>(const Event& other) const
+        {
+            if (atMicros != other.atMicros) {
+                return atMicros > other.atMicros;
+            }
+            return sequence > other.sequence;
+        }
+    };
+
+    struct PendingSend
+    {
+        uint8_t topic;
+        std::vector<byte> data;
+        std::array<byte, RM_ID_LENGTH> target;
+    };
+
+    SimConfig config;
+    ChannelModel channel;
+    std::mt19937_64 rng;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    std::map<uint64_t, Transmission> transmissions;
+    std::map<uint64_t, PendingSend> pendingSends;
+    std::map<uint64_t, MessageRecord> messages;
+    // Messages sent with sendReliableData(), in send order. Their deliveries carry the frame
+    // counter of whichever copy arrived, they are matched by source, target and topic instead.
+    std::vector<MessageRecord> reliableMessages;
+    uint64_t nowMicros = 0;
+    uint64_t nextSequence = 0;
+    uint64_t nextRef = 1;
+    Node* current = nullptr;
+
+    static MeshSimulator* active;
+
+    void schedule(uint64_t atMicros, EventType type, size_t node, uint64_t ref = 0);
+    void activate(Node& node);
+    int bootNode(Node& node, bool provision);
+    void releaseNode(Node& node);
+    void runNode(Node& node);
+    void scheduleWakeup(Node& node, uint32_t dueMillis);
+    void handleTxEnd(uint64_t txId);
+    void handleAppSend(size_t node, uint64_t ref);
+    void handleNodeDown(Node& node);
+    void handleNodeRestart(Node& node);
+    void abortTransmission(Node& node);
+    void onDelivery(Node& node, const RadioMeshPacket* packet, int err);
+    void onReliableDelivery(Node& node, const RadioMeshPacket* packet);
+    void onSendFailed(Node& node, const RadioMeshPacket* packet);
+    LoraModulation getModulation(const SX1262& radio) const;
+
+    static uint64_t messageKey(const std::array<byte, RM_ID_LENGTH>& source, uint32_t fcounter);
+    static void onPacketReceived(const RadioMeshPacket* packet, int err);
+    static void onPacketSent(const RadioMeshPacket* packet, int err);
+};
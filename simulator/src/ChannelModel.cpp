@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cmath>
+
+#include <ChannelModel.h>
+
+uint64_t ChannelModel::timeOnAirMicros(const LoraModulation& modulation, size_t payloadLength)
+{
+    const double sf = modulation.sf;
+    const double bwHz = modulation.bw * 1000.0;
+    const double symbolMicros = std::pow(2.0, sf) / bwHz * 1e6;
+
+    const int lowDataRate = symbolMicros > 16000.0 ? 1 : 0;
+    const int header = modulation.explicitHeader ? 0 : 1;
+    const int crc = modulation.crcOn ? 1 : 0;
+    const int codingRate = modulation.cr - 4;
+
+    double numerator = 8.0 * payloadLength - 4.0 * sf + 28.0 + 16.0 * crc - 20.0 * header;
+    double denominator = 4.0 * (sf - 2.0 * lowDataRate);
+    double payloadSymbols =
+        8.0 + std::max(std::ceil(numerator / denominator) * (codingRate + 4), 0.0);
+    double preambleSymbols = modulation.preambleLength + 4.25;
+
+    return static_cast<uint64_t>(std::llround((preambleSymbols + payloadSymbols) * symbolMicros));
+}
+
+double ChannelModel::snrThresholdDb(uint8_t sf)
+{
+    switch (sf) {
+    case 5:
+        return -2.5;
+    case 6:
+        return -5.0;
+    case 7:
+        return -7.5;
+    case 8:
+        return -10.0;
+    case 9:
+        return -12.5;
+    case 10:
+        return -15.0;
+    case 11:
+        return -17.5;
+    default:
+        return -20.0;
+    }
+}
+
+double ChannelModel::noiseFloorDbm(float bwKHz) const
+{
+    return -174.0 + 10.0 * std::log10(bwKHz * 1000.0) + params.noiseFigureDb;
+}
+
+double ChannelModel::pathLossDb(double distanceMeters, std::mt19937_64& rng) const
+{
+    double distance = std::max(distanceMeters, 1.0);
+    double loss = params.referenceLossDb + 10.0 * params.pathLossExponent * std::log10(distance);
+    if (params.shadowingSigmaDb > 0.0) {
+        std::normal_distribution<double> shadowing(0.0, params.shadowingSigmaDb);
+        loss += shadowing(rng);
+    }
+    return loss;
+}
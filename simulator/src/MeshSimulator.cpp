@@ -0,0 +1,883 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <common/utils/Utils.h>
+#include <core/protocol/inc/crypto/EcdhKeyCache.h>
+#include <core/protocol/inc/crypto/aes/AesCrypto.h>
+#include <core/protocol/inc/routing/PacketRouter.h>
+#include <core/protocol/inc/routing/RoutingTable.h>
+#include <framework/builder/inc/DeviceBuilder.h>
+#include <framework/device/inc/Device.h>
+#include <framework/device/inc/DeviceStorage.h>
+#include <hardware/inc/radio/LoraRadio.h>
+#include <hardware/inc/storage/eeprom/EEPROMStorage.h>
+
+#include <MeshSimulator.h>
+
+MeshSimulator* MeshSimulator::active = nullptr;
+
+MeshSimulator::MeshSimulator(const SimConfig& config)
+    : config(config), channel(config.channel), rng(config.seed)
+{
+    if (active != nullptr) {
+        logerr_ln("ERROR only one MeshSimulator may exist at a time");
+    }
+    active = this;
+
+    NativeHost::useVirtualClock(0);
+    NativeHost::seedRandom(config.seed);
+    NativeHost::setRadioBackend(this);
+}
+
+MeshSimulator::~MeshSimulator()
+{
+    for (auto& node : nodes) {
+        activate(*node);
+        releaseNode(*node);
+    }
+    nodes.clear();
+    current = nullptr;
+
+    LoraRadio::setInstance(nullptr);
+    PacketRouter::setInstance(nullptr);
+    RoutingTable::setInstance(nullptr);
+    EEPROMStorage::setInstance(nullptr);
+    AesCrypto::setInstance(nullptr);
+    EcdhKeyCache::setInstance(nullptr);
+    NativeHost::setEEPROMState(nullptr);
+    NativeHost::setRadioBackend(nullptr);
+    NativeHost::useRealClock();
+
+    if (active == this) {
+        active = nullptr;
+    }
+}
+
+int MeshSimulator::addNode(const SimNodeConfig& nodeConfig)
+{
+    auto node = std::make_unique<Node>();
+    node->config = nodeConfig;
+    node->index = nodes.size();
+    if (bootNode(*node, true) != RM_E_NONE) {
+        return -1;
+    }
+
+    nodes.push_back(std::move(node));
+    size_t index = nodes.size() - 1;
+    if (config.pollIntervalMs > 0) {
+        schedule(nowMicros + config.pollIntervalMs * 1000ULL, EventType::POLL, index);
+    }
+    uint32_t dueMillis;
+    if (nodes[index]->device->getBeaconService().getNextDue(&dueMillis)) {
+        scheduleWakeup(*nodes[index], dueMillis);
+    }
+    return static_cast<int>(index);
+}
+
+int MeshSimulator::bootNode(Node& node, bool provision)
+{
+    // Fresh singletons: getInstance() creates them for this node
+    LoraRadio::setInstance(nullptr);
+    PacketRouter::setInstance(nullptr);
+    RoutingTable::setInstance(nullptr);
+    EEPROMStorage::setInstance(nullptr);
+    AesCrypto::setInstance(nullptr);
+    EcdhKeyCache::setInstance(nullptr);
+    NativeHost::setEEPROMState(&node.eeprom);
+    current = &node;
+
+    node.radio = LoraRadio::getInstance();
+    node.router = PacketRouter::getInstance();
+    node.routingTable = RoutingTable::getInstance();
+    node.storage = EEPROMStorage::getInstance();
+    node.crypto = AesCrypto::getInstance();
+    node.ecdhKeys = EcdhKeyCache::getInstance();
+
+    // Provision the node as already included, with the shared network key
+    ByteStorageParams storageParams(EEPROM_STORAGE_MAX_SIZE);
+    node.storage->setParams(storageParams);
+    if (provision && node.storage->begin() == RM_E_NONE) {
+        DeviceStorage deviceStorage(node.storage);
+        deviceStorage.persistState(DeviceInclusionState::INCLUDED);
+        deviceStorage.persistNetworkKey(config.networkKey);
+        node.storage->end();
+    }
+
+    SecurityParams security;
+    security.method = SecurityMethod::AES;
+    security.key = config.networkKey;
+    security.iv = std::vector<byte>(AesCrypto::AES_IV_SIZE, 0);
+
+    DeviceBuilder builder;
+    IDevice* device = builder.start()
+                          .withLoraRadio(config.radio)
+                          .withRelayEnabled(node.config.relayEnabled)
+                          .withBeacons(config.beacons)
+                          .withRxPacketCallback(&MeshSimulator::onPacketReceived)
+                          .withTxPacketCallback(&MeshSimulator::onPacketSent)
+                          .withSecureMessaging(security)
+                          .build(node.config.name, node.config.id, node.config.type);
+    int rc = device != nullptr ? device->getRadio()->setup() : RM_E_DEVICE_INITIALIZATION_FAILED;
+    node.device = static_cast<RadioMeshDevice*>(device);
+    if (rc != RM_E_NONE) {
+        logerr_ln("ERROR failed to create simulated node %s, rc = %d", node.config.name.c_str(),
+                  rc);
+        releaseNode(node);
+        current = nullptr;
+    }
+    return rc;
+}
+
+void MeshSimulator::releaseNode(Node& node)
+{
+    delete node.device;
+    delete node.radio;
+    delete node.router;
+    delete node.routingTable;
+    delete node.storage;
+    delete node.crypto;
+    delete node.ecdhKeys;
+    node.device = nullptr;
+    node.radio = nullptr;
+    node.router = nullptr;
+    node.routingTable = nullptr;
+    node.storage = nullptr;
+    node.crypto = nullptr;
+    node.ecdhKeys = nullptr;
+}
+
+RadioMeshDevice* MeshSimulator::getDevice(size_t index)
+{
+    if (index >= nodes.size()) {
+        return nullptr;
+    }
+    return nodes[index]->device;
+}
+
+void MeshSimulator::scheduleSend(size_t from, uint64_t atMicros, uint8_t topic,
+                                 const std::vector<byte>& data,
+                                 std::array<byte, RM_ID_LENGTH> target)
+{
+    uint64_t ref = nextRef++;
+    pendingSends[ref] = PendingSend{topic, data, target};
+    schedule(atMicros, EventType::APP_SEND, from, ref);
+}
+
+void MeshSimulator::scheduleNodeFailure(size_t index, uint64_t atMicros)
+{
+    if (index < nodes.size()) {
+        schedule(atMicros, EventType::NODE_DOWN, index);
+    }
+}
+
+void MeshSimulator::scheduleNodeRestart(size_t index, uint64_t atMicros)
+{
+    if (index < nodes.size()) {
+        schedule(atMicros, EventType::NODE_RESTART, index);
+    }
+}
+
+void MeshSimulator::schedulePeriodicTraffic(uint32_t meanPeriodMs, uint64_t durationMs,
+                                            size_t payloadSize,
+                                            std::array<byte, RM_ID_LENGTH> target, uint8_t topic)
+{
+    std::exponential_distribution<double> interval(1.0 / (meanPeriodMs * 1000.0));
+    std::uniform_int_distribution<int> payloadByte(0, 255);
+    uint64_t end = nowMicros + durationMs * 1000;
+
+    for (auto& node : nodes) {
+        if (node->config.type != MeshDeviceType::STANDARD || node->config.id == target) {
+            continue;
+        }
+        uint64_t at = nowMicros + static_cast<uint64_t>(interval(rng));
+        while (at < end) {
+            std::vector<byte> data(payloadSize);
+            for (auto& b : data) {
+                b = static_cast<byte>(payloadByte(rng));
+            }
+            scheduleSend(node->index, at, topic, data, target);
+            at += static_cast<uint64_t>(interval(rng)) + 1;
+        }
+    }
+}
+
+void MeshSimulator::schedulePeerTraffic(uint32_t meanPeriodMs, uint64_t durationMs,
+                                        size_t payloadSize, uint8_t topic)
+{
+    std::vector<size_t> peers;
+    for (auto& node : nodes) {
+        if (node->config.type == MeshDeviceType::STANDARD) {
+            peers.push_back(node->index);
+        }
+    }
+    if (peers.size() < 2) {
+        return;
+    }
+
+    std::exponential_distribution<double> interval(1.0 / (meanPeriodMs * 1000.0));
+    std::uniform_int_distribution<int> payloadByte(0, 255);
+    std::uniform_int_distribution<size_t> otherPeer(0, peers.size() - 2);
+    uint64_t end = nowMicros + durationMs * 1000;
+
+    for (size_t i = 0; i < peers.size(); i++) {
+        uint64_t at = nowMicros + static_cast<uint64_t>(interval(rng));
+        while (at < end) {
+            std::vector<byte> data(payloadSize);
+            for (auto& b : data) {
+                b = static_cast<byte>(payloadByte(rng));
+            }
+            // Any peer but the sender
+            size_t peer = otherPeer(rng);
+            if (peer >= i) {
+                peer++;
+            }
+            scheduleSend(peers[i], at, topic, data, nodes[peers[peer]]->config.id);
+            at += static_cast<uint64_t>(interval(rng)) + 1;
+        }
+    }
+}
+
+void MeshSimulator::schedulePushTraffic(uint32_t meanPeriodMs, uint64_t durationMs,
+                                        size_t payloadSize, uint8_t topic)
+{
+    auto hub = std::find_if(nodes.begin(), nodes.end(), [](const std::unique_ptr<Node>& node) {
+        return node->config.type == MeshDeviceType::HUB;
+    });
+    if (hub == nodes.end()) {
+        return;
+    }
+
+    std::exponential_distribution<double> interval(1.0 / (meanPeriodMs * 1000.0));
+    std::uniform_int_distribution<int> payloadByte(0, 255);
+    uint64_t end = nowMicros + durationMs * 1000;
+
+    for (auto& node : nodes) {
+        if (node->config.type != MeshDeviceType::STANDARD) {
+            continue;
+        }
+        uint64_t at = nowMicros + static_cast<uint64_t>(interval(rng));
+        while (at < end) {
+            std::vector<byte> data(payloadSize);
+            for (auto& b : data) {
+                b = static_cast<byte>(payloadByte(rng));
+            }
+            scheduleSend((*hub)->index, at, topic, data, node->config.id);
+            at += static_cast<uint64_t>(interval(rng)) + 1;
+        }
+    }
+}
+
+void MeshSimulator::runUntil(uint64_t untilMicros)
+{
+    while (!events.empty() && events.top().atMicros <= untilMicros) {
+        Event event = events.top();
+        events.pop();
+        nowMicros = event.atMicros;
+        NativeHost::setMicros(nowMicros);
+
+        switch (event.type) {
+        case EventType::TX_END:
+            handleTxEnd(event.ref);
+            break;
+        case EventType::APP_SEND:
+            handleAppSend(event.node, event.ref);
+            break;
+        case EventType::POLL:
+            // Polling goes on while a node is down, in case it restarts
+            if (!nodes[event.node]->down) {
+                runNode(*nodes[event.node]);
+            }
+            schedule(nowMicros + config.pollIntervalMs * 1000ULL, EventType::POLL, event.node);
+            break;
+        case EventType::WAKEUP:
+            if (nodes[event.node]->wakeupMicros == nowMicros) {
+                nodes[event.node]->wakeupMicros = 0;
+            }
+            if (!nodes[event.node]->down) {
+                runNode(*nodes[event.node]);
+            }
+            break;
+        case EventType::NODE_DOWN:
+            handleNodeDown(*nodes[event.node]);
+            break;
+        case EventType::NODE_RESTART:
+            handleNodeRestart(*nodes[event.node]);
+            break;
+        }
+    }
+    nowMicros = std::max(nowMicros, untilMicros);
+    NativeHost::setMicros(nowMicros);
+}
+
+int16_t MeshSimulator::transmit(SX1262& radio, const uint8_t* data, size_t length)
+{
+    Node* sender = static_cast<Node*>(radio.userData);
+    if (sender == nullptr) {
+        // Radio created outside of a simulated node
+        radio.transmitDone();
+        return RADIOLIB_ERR_NONE;
+    }
+
+    if (sender->currentTxId != 0) {
+        // Like the SX1262, a new transmission replaces the one in progress
+        abortTransmission(*sender);
+    }
+
+    // Half duplex: whatever the sender was receiving is lost
+    for (auto& reception : sender->receptions) {
+        if (!reception.lost && reception.endMicros > nowMicros) {
+            reception.lost = true;
+            sender->stats.missedWhileTransmitting++;
+        }
+    }
+
+    LoraModulation modulation = getModulation(radio);
+    uint64_t toa = ChannelModel::timeOnAirMicros(modulation, length);
+    uint64_t txId = nextRef++;
+
+    Transmission tx;
+    tx.sender = sender->index;
+    tx.startMicros = nowMicros;
+    tx.endMicros = nowMicros + toa;
+    tx.frame.assign(data, data + length);
+    tx.aborted = false;
+
+    sender->stats.framesSent++;
+    sender->stats.airtimeMicros += toa;
+
+    if (length >= HEADER_LENGTH) {
+        std::array<byte, RM_ID_LENGTH> source;
+        std::copy_n(data + SDEV_ID_POS, RM_ID_LENGTH, source.begin());
+        uint64_t key = messageKey(source, RadioMeshUtils::toUint32(data + FCOUNTER_POS));
+        if (source != sender->config.id) {
+            sender->stats.relays++;
+        }
+        bool firstTransmission = sender->sentMessages.insert(key).second;
+        if (!firstTransmission) {
+            sender->stats.duplicateRebroadcasts++;
+        }
+        if (firstTransmission && source == sender->config.id && !sender->queuedMessages.empty() &&
+            sender->queuedMessages.front().topic == data[TOPIC_POS]) {
+            // Application messages of a node leave its transmit queue in the order they were sent
+            messages[key] = std::move(sender->queuedMessages.front());
+            sender->queuedMessages.pop_front();
+        }
+    }
+
+    float txPower = radio.getOutputPower();
+    double noiseFloor = channel.noiseFloorDbm(modulation.bw);
+    double snrThreshold = ChannelModel::snrThresholdDb(modulation.sf);
+
+    for (auto& receiver : nodes) {
+        if (receiver.get() == sender || receiver->sx == nullptr || receiver->down) {
+            continue;
+        }
+        const SX1262& rx = *receiver->sx;
+        if (rx.getFrequency() != radio.getFrequency() || rx.getBandwidth() != radio.getBandwidth() ||
+            rx.getSpreadingFactor() != radio.getSpreadingFactor() ||
+            rx.getSyncWord() != radio.getSyncWord()) {
+            continue;
+        }
+
+        double distance = std::hypot(receiver->config.x - sender->config.x,
+                                     receiver->config.y - sender->config.y);
+        double rssi = txPower - channel.pathLossDb(distance, rng);
+        double snr = rssi - noiseFloor;
+        if (snr < snrThreshold) {
+            continue;
+        }
+        tx.inRange.push_back(receiver->index);
+
+        if (rx.getMode() == SX1262::Mode::TX) {
+            receiver->stats.missedWhileTransmitting++;
+            continue;
+        }
+        if (rx.getMode() != SX1262::Mode::RX) {
+            continue;
+        }
+
+        Reception reception{txId, tx.endMicros, static_cast<float>(rssi), static_cast<float>(snr),
+                            false};
+        for (auto& other : receiver->receptions) {
+            if (other.endMicros <= nowMicros) {
+                continue;
+            }
+            double margin = rssi - other.rssi;
+            if (margin < channel.getParams().captureThresholdDb && !reception.lost) {
+                reception.lost = true;
+                receiver->stats.collisions++;
+            }
+            if (-margin < channel.getParams().captureThresholdDb && !other.lost) {
+                other.lost = true;
+                receiver->stats.collisions++;
+            }
+        }
+        receiver->receptions.push_back(reception);
+        tx.receivers.push_back(receiver->index);
+    }
+
+    transmissions[txId] = std::move(tx);
+    sender->currentTxId = txId;
+    schedule(nowMicros + toa, EventType::TX_END, sender->index, txId);
+    return RADIOLIB_ERR_NONE;
+}
+
+void MeshSimulator::onAttach(SX1262& radio, bool attached)
+{
+    if (attached) {
+        if (current != nullptr) {
+            radio.userData = current;
+            current->sx = &radio;
+        }
+        return;
+    }
+    for (auto& node : nodes) {
+        if (node->sx == &radio) {
+            node->sx = nullptr;
+        }
+    }
+    if (current != nullptr && current->sx == &radio) {
+        current->sx = nullptr;
+    }
+}
+
+bool MeshSimulator::isChannelActive(SX1262& radio)
+{
+    Node* node = static_cast<Node*>(radio.userData);
+    if (node == nullptr) {
+        return false;
+    }
+    for (const auto& entry : transmissions) {
+        const Transmission& tx = entry.second;
+        if (tx.aborted || tx.endMicros <= nowMicros) {
+            continue;
+        }
+        if (std::find(tx.inRange.begin(), tx.inRange.end(), node->index) != tx.inRange.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshSimulator::schedule(uint64_t atMicros, EventType type, size_t node, uint64_t ref)
+{
+    events.push(Event{atMicros, nextSequence++, type, node, ref});
+}
+
+void MeshSimulator::activate(Node& node)
+{
+    LoraRadio::setInstance(node.radio);
+    PacketRouter::setInstance(node.router);
+    RoutingTable::setInstance(node.routingTable);
+    EEPROMStorage::setInstance(node.storage);
+    AesCrypto::setInstance(node.crypto);
+    EcdhKeyCache::setInstance(node.ecdhKeys);
+    NativeHost::setEEPROMState(&node.eeprom);
+    current = &node;
+}
+
+void MeshSimulator::runNode(Node& node)
+{
+    activate(node);
+    node.device->run();
+
+    // Run the node again when its next delayed rebroadcast, listen before talk retry, hop ACK
+    // timeout, reliable message deadline or beacon is due. One still due could not be queued, it
+    // is retried a millisecond later.
+    uint32_t dueMillis;
+    if (node.device->getRelayScheduler().getNextDue(&dueMillis)) {
+        scheduleWakeup(node, dueMillis);
+    }
+    if (node.router->getNextHopAckDue(&dueMillis)) {
+        scheduleWakeup(node, dueMillis);
+    }
+    if (node.device->getReliableTransfer().getNextDue(&dueMillis)) {
+        scheduleWakeup(node, dueMillis);
+    }
+    if (node.radio->getTxRetryDue(&dueMillis)) {
+        scheduleWakeup(node, dueMillis);
+    }
+    if (node.device->getBeaconService().getNextDue(&dueMillis)) {
+        scheduleWakeup(node, dueMillis);
+    }
+}
+
+void MeshSimulator::scheduleWakeup(Node& node, uint32_t dueMillis)
+{
+    uint64_t dueMicros = std::max<uint64_t>(dueMillis * 1000ULL, nowMicros + 1000);
+    if (node.wakeupMicros == 0 || dueMicros < node.wakeupMicros) {
+        node.wakeupMicros = dueMicros;
+        schedule(dueMicros, EventType::WAKEUP, node.index);
+    }
+}
+
+void MeshSimulator::handleTxEnd(uint64_t txId)
+{
+    auto it = transmissions.find(txId);
+    if (it == transmissions.end()) {
+        return;
+    }
+    Transmission tx = std::move(it->second);
+    transmissions.erase(it);
+    if (tx.aborted) {
+        return;
+    }
+
+    // The sender returns to receive mode first, so it can hear immediate replies
+    Node& sender = *nodes[tx.sender];
+    sender.currentTxId = 0;
+    if (sender.sx != nullptr) {
+        activate(sender);
+        sender.sx->transmitDone();
+        runNode(sender);
+    }
+
+    std::uniform_real_distribution<double> loss(0.0, 1.0);
+    for (size_t index : tx.receivers) {
+        Node& receiver = *nodes[index];
+        auto rec = std::find_if(receiver.receptions.begin(), receiver.receptions.end(),
+                                [txId](const Reception& r) { return r.txId == txId; });
+        if (rec == receiver.receptions.end()) {
+            continue;
+        }
+        Reception reception = *rec;
+        receiver.receptions.erase(rec);
+
+        if (reception.lost) {
+            continue;
+        }
+        if (channel.getParams().packetLossRate > 0.0 &&
+            loss(rng) < channel.getParams().packetLossRate) {
+            receiver.stats.randomLosses++;
+            continue;
+        }
+        if (receiver.sx == nullptr) {
+            continue;
+        }
+
+        activate(receiver);
+        if (receiver.sx->receive(tx.frame.data(), tx.frame.size(), reception.rssi,
+                                 reception.snr)) {
+            receiver.stats.framesReceived++;
+            runNode(receiver);
+        } else {
+            receiver.stats.missedWhileTransmitting++;
+        }
+    }
+}
+
+void MeshSimulator::handleAppSend(size_t index, uint64_t ref)
+{
+    auto it = pendingSends.find(ref);
+    if (it == pendingSends.end() || index >= nodes.size()) {
+        return;
+    }
+    PendingSend send = std::move(it->second);
+    pendingSends.erase(it);
+
+    Node& node = *nodes[index];
+    if (node.down) {
+        return;
+    }
+    MessageRecord record;
+    record.sentMicros = nowMicros;
+    record.topic = send.topic;
+    record.broadcast = RadioMeshUtils::isBroadcastAddress(send.target);
+    record.source = index;
+    record.target = send.target;
+
+    activate(node);
+    if (config.reliable && !record.broadcast) {
+        int rc = node.device->sendReliableData(send.topic, send.data, send.target);
+        if (rc == RM_E_NONE) {
+            reliableMessages.push_back(record);
+        } else if (rc == RM_E_QUEUE_FULL) {
+            node.stats.reliableRefused++;
+        }
+    } else {
+        // Queued until transmit() sees the frame and learns its frame counter
+        node.queuedMessages.push_back(record);
+        if (node.device->sendData(send.topic, send.data, send.target) != RM_E_NONE) {
+            node.queuedMessages.pop_back();
+        }
+    }
+    // Like the application loop would, so a frame held back or failed at once is handled
+    runNode(node);
+}
+
+void MeshSimulator::handleNodeDown(Node& node)
+{
+    node.down = true;
+    if (node.currentTxId != 0) {
+        abortTransmission(node);
+    }
+    // Frames on their way to it are lost with the radio
+    node.receptions.clear();
+    node.queuedMessages.clear();
+}
+
+void MeshSimulator::handleNodeRestart(Node& node)
+{
+    if (!node.down) {
+        handleNodeDown(node);
+    }
+    // Only the node's storage survives, everything else starts over like after a power cycle
+    activate(node);
+    releaseNode(node);
+    if (bootNode(node, false) != RM_E_NONE) {
+        return;
+    }
+    node.down = false;
+    uint32_t dueMillis;
+    if (node.device->getBeaconService().getNextDue(&dueMillis)) {
+        scheduleWakeup(node, dueMillis);
+    }
+}
+
+void MeshSimulator::abortTransmission(Node& node)
+{
+    auto it = transmissions.find(node.currentTxId);
+    node.currentTxId = 0;
+    if (it == transmissions.end()) {
+        return;
+    }
+    Transmission& tx = it->second;
+    tx.aborted = true;
+    node.stats.airtimeMicros -= tx.endMicros - nowMicros;
+    for (size_t index : tx.receivers) {
+        auto& receptions = nodes[index]->receptions;
+        receptions.erase(std::remove_if(receptions.begin(), receptions.end(),
+                                        [&it](const Reception& r) { return r.txId == it->first; }),
+                         receptions.end());
+    }
+}
+
+void MeshSimulator::onDelivery(Node& node, const RadioMeshPacket* packet, int err)
+{
+    if (packet == nullptr || err != RM_E_NONE || packet->topic <= MessageTopic::MAX_RESERVED) {
+        return;
+    }
+    auto it = messages.find(messageKey(packet->sourceDevId, packet->fcounter));
+    if (it == messages.end()) {
+        onReliableDelivery(node, packet);
+        return;
+    }
+    if (it->second.source == node.index) {
+        return;
+    }
+    MessageRecord& record = it->second;
+    if (!record.broadcast && record.target != node.config.id) {
+        return;
+    }
+    record.deliveredMicros.emplace(node.index, nowMicros);
+}
+
+void MeshSimulator::onReliableDelivery(Node& node, const RadioMeshPacket* packet)
+{
+    // Each message is delivered once, the oldest one still undelivered is the one that arrived
+    for (MessageRecord& record : reliableMessages) {
+        if (record.deliveredMicros.empty() && record.target == node.config.id &&
+            record.topic == packet->topic &&
+            nodes[record.source]->config.id == packet->sourceDevId) {
+            record.deliveredMicros.emplace(node.index, nowMicros);
+            return;
+        }
+    }
+}
+
+void MeshSimulator::onSendFailed(Node& node, const RadioMeshPacket* packet)
+{
+    // A message that never made it on air still counts as sent, and undelivered
+    if (packet == nullptr || packet->sourceDevId != node.config.id ||
+        node.queuedMessages.empty() || node.queuedMessages.front().topic != packet->topic) {
+        return;
+    }
+    uint64_t key = messageKey(packet->sourceDevId, packet->fcounter);
+    if (node.sentMessages.insert(key).second) {
+        messages[key] = std::move(node.queuedMessages.front());
+        node.queuedMessages.pop_front();
+    }
+}
+
+LoraModulation MeshSimulator::getModulation(const SX1262& radio) const
+{
+    LoraModulation modulation;
+    modulation.sf = radio.getSpreadingFactor();
+    modulation.bw = radio.getBandwidth();
+    modulation.cr = radio.getCodingRate();
+    modulation.preambleLength = radio.getPreambleLength();
+    return modulation;
+}
+
+uint64_t MeshSimulator::messageKey(const std::array<byte, RM_ID_LENGTH>& source, uint32_t fcounter)
+{
+    return (static_cast<uint64_t>(RadioMeshUtils::deviceIdToUint32(source)) << 32) | fcounter;
+}
+
+void MeshSimulator::onPacketReceived(const RadioMeshPacket* packet, int err)
+{
+    if (active != nullptr && active->current != nullptr) {
+        active->onDelivery(*active->current, packet, err);
+    }
+}
+
+void MeshSimulator::onPacketSent(const RadioMeshPacket* packet, int err)
+{
+    if (err != RM_E_NONE && active != nullptr && active->current != nullptr) {
+        active->onSendFailed(*active->current, packet);
+    }
+}
+
+SimReport MeshSimulator::getReport() const
+{
+    SimReport report;
+    report.simulatedMicros = nowMicros;
+
+    std::vector<double> latencies;
+    auto count = [&](const MessageRecord& record) {
+        report.messagesSent++;
+        report.deliveriesExpected += record.broadcast ? nodes.size() - 1 : 1;
+        for (const auto& delivery : record.deliveredMicros) {
+            report.deliveries++;
+            latencies.push_back((delivery.second - record.sentMicros) / 1000.0);
+        }
+    };
+    for (const auto& entry : messages) {
+        count(entry.second);
+    }
+    for (const auto& record : reliableMessages) {
+        count(record);
+    }
+    if (report.deliveriesExpected > 0) {
+        report.deliveryRatio = static_cast<double>(report.deliveries) / report.deliveriesExpected;
+    }
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0;
+        for (double latency : latencies) {
+            sum += latency;
+        }
+        report.latencyAvgMs = sum / latencies.size();
+        report.latencyP50Ms = latencies[(latencies.size() - 1) / 2];
+        report.latencyP95Ms = latencies[(latencies.size() - 1) * 95 / 100];
+        report.latencyMaxMs = latencies.back();
+    }
+
+    for (const auto& node : nodes) {
+        SimNodeStats stats = node->stats;
+        stats.relaysSuppressed = node->device->getRelayScheduler().getSuppressedCount();
+        stats.relaysDropped = node->device->getRelayScheduler().getDroppedCount();
+        ChannelAccessStats channelStats = node->radio->getChannelAccessStats();
+        stats.channelBusy = channelStats.busy;
+        stats.channelBusyDrops = channelStats.dropped;
+        AirtimeBudget budget = node->radio->getAirtimeBudget();
+        stats.airtimeDeferred = budget.deferred;
+        stats.airtimeDropped = budget.dropped;
+        HopAckStats hopAckStats = node->router->getHopAckStats();
+        stats.hopAcked = hopAckStats.acked;
+        stats.hopRetransmissions = hopAckStats.retransmissions;
+        stats.hopAckFailures = hopAckStats.failures;
+        const ReliableStats& reliableStats = node->device->getReliableTransfer().getStats();
+        stats.reliableAcknowledged = reliableStats.acknowledged;
+        stats.reliableFailed = reliableStats.failed;
+        stats.reliableRetransmissions = reliableStats.retransmissions;
+        stats.routeFailovers = node->routingTable->getFailovers();
+        const BeaconStats& beaconStats = node->device->getBeaconService().getStats();
+        stats.beaconsSent = beaconStats.sent;
+        stats.beaconsSuppressed = beaconStats.suppressed;
+        report.framesSent += stats.framesSent;
+        report.relays += stats.relays;
+        report.duplicateRebroadcasts += stats.duplicateRebroadcasts;
+        report.relaysSuppressed += stats.relaysSuppressed;
+        report.relaysDropped += stats.relaysDropped;
+        report.collisions += stats.collisions;
+        report.channelBusy += stats.channelBusy;
+        report.channelBusyDrops += stats.channelBusyDrops;
+        report.airtimeDeferred += stats.airtimeDeferred;
+        report.airtimeDropped += stats.airtimeDropped;
+        report.hopAcked += stats.hopAcked;
+        report.hopRetransmissions += stats.hopRetransmissions;
+        report.hopAckFailures += stats.hopAckFailures;
+        report.reliableAcknowledged += stats.reliableAcknowledged;
+        report.reliableFailed += stats.reliableFailed;
+        report.reliableRetransmissions += stats.reliableRetransmissions;
+        report.reliableRefused += stats.reliableRefused;
+        report.routeFailovers += stats.routeFailovers;
+        report.beaconsSent += stats.beaconsSent;
+        report.beaconsSuppressed += stats.beaconsSuppressed;
+        const TopologyGraph* topology = node->device->getTopology();
+        if (topology != nullptr) {
+            report.topologyDevices += topology->getNodeCount();
+            report.topologyLinks += topology->getLinkCount();
+            report.topologyLinkChanges += topology->getStats().linkChanges;
+            report.topologyPathUpdates += topology->getStats().nodesSettled;
+        }
+        report.airtimeMicros += stats.airtimeMicros;
+        report.nodes.push_back(stats);
+    }
+    return report;
+}
+
+std::string SimReport::toString(bool perNode) const
+{
+    char line[160];
+    std::string out;
+
+    snprintf(line, sizeof(line), "Simulated time      : %.3f s\n", simulatedMicros / 1e6);
+    out += line;
+    snprintf(line, sizeof(line), "Messages sent       : %u\n", messagesSent);
+    out += line;
+    snprintf(line, sizeof(line), "Delivery ratio      : %.4f (%u/%u)\n", deliveryRatio, deliveries,
+             deliveriesExpected);
+    out += line;
+    snprintf(line, sizeof(line), "Latency avg/p50/p95/max: %.1f/%.1f/%.1f/%.1f ms\n", latencyAvgMs,
+             latencyP50Ms, latencyP95Ms, latencyMaxMs);
+    out += line;
+    snprintf(line, sizeof(line), "Frames sent         : %u (relays %u, duplicate rebroadcasts %u)\n",
+             framesSent, relays, duplicateRebroadcasts);
+    out += line;
+    snprintf(line, sizeof(line), "Relays suppressed   : %u (dropped %u)\n", relaysSuppressed,
+             relaysDropped);
+    out += line;
+    snprintf(line, sizeof(line), "Collisions          : %u\n", collisions);
+    out += line;
+    snprintf(line, sizeof(line), "Channel busy        : %u (frames dropped %u)\n", channelBusy,
+             channelBusyDrops);
+    out += line;
+    snprintf(line, sizeof(line), "Airtime limited     : %u deferred, %u dropped\n", airtimeDeferred,
+             airtimeDropped);
+    out += line;
+    snprintf(line, sizeof(line), "Hop ACKs            : %u acked, %u retransmissions, %u failed\n",
+             hopAcked, hopRetransmissions, hopAckFailures);
+    out += line;
+    snprintf(line, sizeof(line),
+             "Reliable messages   : %u acknowledged, %u failed, %u retransmissions, %u refused\n",
+             reliableAcknowledged, reliableFailed, reliableRetransmissions, reliableRefused);
+    out += line;
+    snprintf(line, sizeof(line), "Route failovers     : %u\n", routeFailovers);
+    out += line;
+    snprintf(line, sizeof(line), "Beacons             : %u sent, %u suppressed\n", beaconsSent,
+             beaconsSuppressed);
+    out += line;
+    snprintf(line, sizeof(line),
+             "Hub topology        : %u devices, %u links, %u link changes, %u paths updated\n",
+             topologyDevices, topologyLinks, topologyLinkChanges, topologyPathUpdates);
+    out += line;
+    snprintf(line, sizeof(line), "Total airtime       : %.3f s\n", airtimeMicros / 1e6);
+    out += line;
+
+    if (perNode) {
+        out += "node  airtime_ms  sent  recv  relays  dup_rebroadcasts  collisions  missed_tx  "
+               "lost\n";
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const SimNodeStats& n = nodes[i];
+            snprintf(line, sizeof(line), "%4zu  %10.1f  %4u  %4u  %6u  %16u  %10u  %9u  %4u\n", i,
+                     n.airtimeMicros / 1000.0, n.framesSent, n.framesReceived, n.relays,
+                     n.duplicateRebroadcasts, n.collisions, n.missedWhileTransmitting,
+                     n.randomLosses);
+            out += line;
+        }
+    }
+    return out;
+}
@@ -95,6 +95,8 @@ enum MessageTopic : uint8_t
     INCLUDE_OPEN = 0x08,
     INCLUDE_CONFIRM = 0x09,
     INCLUDE_SUCCESS = 0x0A,
+    RELIABLE_DATA = 0x0B,
+    RELIABLE_ACK = 0x0C,
     MAX_RESERVED = 0x0F
 };
 
@@ -288,6 +290,16 @@ inline bool isInclusionTopic(uint8_t topic)
            isIncludeConfirm(topic);
 }
 
+/**
+ * @brief Check if a topic belongs to the reliable message service
+ * @param topic Topic value
+ * @return true if the topic is a RELIABLE_DATA or a RELIABLE_ACK, false otherwise
+ */
+inline bool isReliableTransfer(uint8_t topic)
+{
+    return topic == MessageTopic::RELIABLE_DATA || topic == MessageTopic::RELIABLE_ACK;
+}
+
 /**
  * @brief Convert topic value to string representation
  * @param topic Topic value
@@ -316,6 +328,10 @@ inline std::string topicToString(uint8_t topic)
         return "INCLUDE_CONFIRM";
     case MessageTopic::INCLUDE_SUCCESS:
         return "INCLUDE_SUCCESS";
+    case MessageTopic::RELIABLE_DATA:
+        return "RELIABLE_DATA";
+    case MessageTopic::RELIABLE_ACK:
+        return "RELIABLE_ACK";
     default:
         return "0x" + std::to_string(topic);
     }
@@ -458,6 +474,34 @@ enum class DeviceInclusionState
     INCLUDED = 0x03
 };
 
+/**
+ * @brief Reasons for dropping a received frame, in the order the receive path checks them.
+ *
+ * The header checks come first and only read fixed header offsets, so frames that can be
+ * rejected from the header cost no CRC, MIC or decryption work.
+ */
+enum class RxDropReason : uint8_t
+{
+    /// Frame shorter than a header or longer than a packet
+    INVALID_LENGTH = 0,
+    /// Protocol version this device does not handle
+    UNSUPPORTED_VERSION,
+    /// Our own packet, relayed back to us
+    OWN_ECHO,
+    /// Hop count over the limit, or at the limit for a packet we would only relay
+    HOP_LIMIT,
+    /// Unicast relay hop addressed to another device
+    NOT_NEXT_HOP,
+    /// Packet already received or sent
+    DUPLICATE,
+    /// Packet CRC mismatch
+    CRC_MISMATCH,
+    /// MIC verification failed
+    MIC_FAILURE,
+    /// Number of reasons, not a reason
+    COUNT
+};
+
 // Inclusion mode
 enum class HubMode
 {
@@ -74,6 +74,24 @@
  */
 #define RM_E_DEVICE_INITIALIZATION_FAILED (-10)
 
+/**
+ * @brief The transmit queue is full.
+ *        The frame was not sent, try again once queued frames went out.
+ */
+#define RM_E_QUEUE_FULL (-11)
+
+/**
+ * @brief The next hop did not acknowledge the frame.
+ *        The frame was sent, retransmitted and then flooded if possible, it may still arrive.
+ */
+#define RM_E_HOP_ACK_TIMEOUT (-12)
+
+/**
+ * @brief The destination did not acknowledge the reliable message.
+ *        The message was sent and retransmitted until its retries were used up.
+ */
+#define RM_E_DELIVERY_TIMEOUT (-13)
+
 /**
  * @brief The radio setup failed.
  */
@@ -130,6 +148,16 @@
  */
 #define RM_E_RADIO_HEADER_CRC_MISMATCH (-111)
 
+/**
+ * @brief The channel stayed busy for every listen before talk attempt.
+ */
+#define RM_E_RADIO_CHANNEL_BUSY (-112)
+
+/**
+ * @brief The frame does not fit in the regulatory airtime limits.
+ */
+#define RM_E_RADIO_AIRTIME_LIMIT (-113)
+
 /**
  * @brief The display setup failed.
  */
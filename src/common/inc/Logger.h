@@ -33,7 +33,7 @@
 #define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 #endif
 
-#if defined(ARDUINO)
+#if defined(ARDUINO) || defined(RM_NATIVE)
 #define OUTPUT_PORT Serial
 #else
 #define PORT std::cout
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Radio and hop acknowledgement metrics reported through IDevice, and the transmit priority
+// classes the queue metrics are counted by
+
+/**
+ * @enum TxPriority
+ * @brief Transmit priority classes, most urgent first.
+ */
+enum class TxPriority : uint8_t
+{
+    INCLUSION = 0,
+    ACK,
+    APPLICATION,
+    RELAY,
+    COUNT
+};
+
+/**
+ * @struct TxQueueStats
+ * @brief Transmit queue metrics.
+ */
+struct TxQueueStats
+{
+    // Frames waiting or being sent
+    uint8_t depth = 0;
+    uint8_t depthByPriority[static_cast<size_t>(TxPriority::COUNT)] = {};
+    // Deepest the queue has been
+    uint8_t highWater = 0;
+    uint32_t sent = 0;
+    uint32_t failed = 0;
+    // Frames refused because every slot was taken
+    uint32_t rejected = 0;
+};
+
+/**
+ * @struct ChannelAccessStats
+ * @brief Listen before talk metrics.
+ */
+struct ChannelAccessStats
+{
+    // Channel activity detections run before a transmission
+    uint32_t scans = 0;
+    // Detections that found the channel busy, each one followed by a backoff
+    uint32_t busy = 0;
+    // Frames given up because the channel stayed busy for every attempt
+    uint32_t dropped = 0;
+};
+
+/**
+ * @struct AirtimeBudget
+ * @brief Airtime budget of the sub-band the radio transmits in.
+ */
+struct AirtimeBudget
+{
+    // Duty cycle of the sub-band in tenths of a percent, 1000 when unrestricted
+    uint16_t dutyCyclePermille = 1000;
+    // Longest time on air of a single frame, 0 when unrestricted
+    uint32_t maxDwellMs = 0;
+    uint32_t capacityMs = 0;
+    uint32_t remainingMs = 0;
+    // Frames held back until the budget refilled
+    uint32_t deferred = 0;
+    // Frames given up, relays thinned out and frames that can never fit
+    uint32_t dropped = 0;
+};
+
+/**
+ * @struct HopAckStats
+ * @brief Hop-by-hop acknowledgement metrics.
+ */
+struct HopAckStats
+{
+    // Frames acknowledged by their next hop
+    uint32_t acked = 0;
+    uint32_t retransmissions = 0;
+    // Frames given up without an ACK
+    uint32_t failures = 0;
+    // Smoothed delay from the end of a transmission to its ACK, 0 until one was measured
+    uint32_t smoothedRttMs = 0;
+};
@@ -4,6 +4,10 @@
 // Arduino build
 #include "Arduino.h"
 #define RM_ARDUINO_BUILD
+#elif defined(RM_NATIVE)
+// native (host) build, the Arduino API is provided by the shims in native/
+#include "Arduino.h"
+#define RM_NATIVE_BUILD
 #else
 // generic build
 #include <stdio.h>
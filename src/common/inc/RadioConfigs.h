@@ -44,6 +44,20 @@ public:
     int di1;
 };
 
+/**
+ * @enum AirtimeRegion
+ * @brief Regulatory airtime rules the radio enforces.
+ */
+enum class AirtimeRegion : uint8_t
+{
+    /// @brief No limit
+    UNRESTRICTED = 0,
+    /// @brief ETSI EN 300 220 sub-band duty cycles, 863 - 870 MHz
+    EU868,
+    /// @brief FCC 400 ms dwell time per frame, 902 - 928 MHz
+    US915
+};
+
 /**
  * @class LoraRadioParams
  *
@@ -59,6 +73,7 @@ public:
     constexpr static uint8_t DEFAULT_SF = 7;
     constexpr static uint8_t DEFAULT_GAIN = 0;
     constexpr static bool DEFAULT_PRIVATE_NETWORK = true;
+    constexpr static uint8_t DEFAULT_LBT_MAX_ATTEMPTS = 5;
 
     LoraRadioParams(PinConfig pinConfig = PinConfig(), float band = DEFAULT_BAND,
                     int8_t txPower = DEFAULT_TX_POWER, float bw = DEFAULT_BW,
@@ -104,6 +119,23 @@ public:
         this->privateNetwork = privateNetwork;
         return *this;
     }
+    LoraRadioParams& setAirtimeRegion(AirtimeRegion airtimeRegion)
+    {
+        this->airtimeRegion = airtimeRegion;
+        return *this;
+    }
+    LoraRadioParams& setListenBeforeTalk(bool enabled,
+                                         uint8_t maxAttempts = DEFAULT_LBT_MAX_ATTEMPTS)
+    {
+        this->listenBeforeTalk = enabled;
+        this->lbtMaxAttempts = maxAttempts;
+        return *this;
+    }
+    LoraRadioParams& setRelayListenBeforeTalk(bool enabled)
+    {
+        this->relayListenBeforeTalk = enabled;
+        return *this;
+    }
 
     inline bool validate() const
     {
@@ -125,6 +157,10 @@ public:
             sf = other.sf;
             gain = other.gain;
             privateNetwork = other.privateNetwork;
+            listenBeforeTalk = other.listenBeforeTalk;
+            lbtMaxAttempts = other.lbtMaxAttempts;
+            relayListenBeforeTalk = other.relayListenBeforeTalk;
+            airtimeRegion = other.airtimeRegion;
         }
         return *this;
     }
@@ -143,7 +179,11 @@ public:
                std::string(", txPower=") + std::to_string(txPower) + std::string(", bw=") +
                std::to_string(bw_hz) + std::string(", sf=") + std::to_string(sf) +
                std::string(", gain=") + std::to_string(gain) + std::string(", privateNetwork=") +
-               std::to_string(privateNetwork) + std::string(")");
+               std::to_string(privateNetwork) + std::string(", listenBeforeTalk=") +
+               std::to_string(listenBeforeTalk) + std::string(", lbtMaxAttempts=") +
+               std::to_string(lbtMaxAttempts) + std::string(", relayListenBeforeTalk=") +
+               std::to_string(relayListenBeforeTalk) + std::string(", airtimeRegion=") +
+               std::to_string(static_cast<int>(airtimeRegion)) + std::string(")");
     }
 
     inline bool isInitialized() const
@@ -169,6 +209,17 @@ public:
     uint8_t gain;
     /// @brief private network flag
     bool privateNetwork;
+    /// @brief run channel activity detection before every transmission, backing off while the
+    /// channel is busy
+    bool listenBeforeTalk = false;
+    /// @brief channel activity detections before a frame is given up, when listening before talk
+    uint8_t lbtMaxAttempts = DEFAULT_LBT_MAX_ATTEMPTS;
+    /// @brief listen before talk for relayed frames only, when listenBeforeTalk is off. Relays are
+    /// rebroadcast by several neighbours at once and collide more than frames sent first hand, so
+    /// dense meshes gain the most from it.
+    bool relayListenBeforeTalk = false;
+    /// @brief regulatory airtime rules applied to the band
+    AirtimeRegion airtimeRegion = AirtimeRegion::UNRESTRICTED;
 };
 
 // Preset configurations for different boards
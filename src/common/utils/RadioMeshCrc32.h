@@ -1,89 +1,232 @@
 #pragma once
 
 #include <Arduino.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// CRC32 backends. Select one with -DRM_CRC32_BACKEND=<backend>, the default is RM_CRC32_TABLE.
+// All of them compute the same wire CRC, they only trade speed for table size.
+#define RM_CRC32_BITWISE 0 // no table, 8 shift steps per byte
+#define RM_CRC32_NIBBLE 1  // 64-byte table, 2 lookups per byte
+#define RM_CRC32_TABLE 2   // 1 KiB table, 1 lookup per byte
+#define RM_CRC32_SLICE4 3  // 4 KiB table, 4 bytes per step
+#define RM_CRC32_SLICE8 4  // 8 KiB table, 8 bytes per step
+
+#ifndef RM_CRC32_BACKEND
+#define RM_CRC32_BACKEND RM_CRC32_TABLE
+#endif
 
 namespace RadioMeshUtils
 {
-class CRC32
+/**
+ * @brief CRC32 engines.
+ *
+ * The RadioMesh packet CRC is CRC-32/BZIP2: polynomial 0x04C11DB7 processed MSB first, no input
+ * or output reflection, initial value and final XOR 0xFFFFFFFF. The original implementation
+ * reflected every byte into a reflected-polynomial loop and reflected the result back, which is
+ * the same CRC computed the slow way.
+ *
+ * Each engine has a single static update() that advances a raw CRC register over a buffer. The
+ * lookup tables are generated at compile time and are constant, so they end up in flash.
+ */
+namespace crc32
+{
+constexpr uint32_t POLYNOMIAL = 0x04C11DB7;
+
+constexpr uint32_t shift(uint32_t crc, int bits)
+{
+    for (int i = 0; i < bits; i++) {
+        crc = (crc & 0x80000000U) ? (crc << 1) ^ POLYNOMIAL : (crc << 1);
+    }
+    return crc;
+}
+
+template <size_t Slices>
+constexpr std::array<std::array<uint32_t, 256>, Slices> makeTables()
+{
+    std::array<std::array<uint32_t, 256>, Slices> tables{};
+    for (uint32_t i = 0; i < 256; i++) {
+        tables[0][i] = shift(i << 24, 8);
+    }
+    // Table k advances the CRC over a byte followed by k zero bytes
+    for (size_t k = 1; k < Slices; k++) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t previous = tables[k - 1][i];
+            tables[k][i] = (previous << 8) ^ tables[0][previous >> 24];
+        }
+    }
+    return tables;
+}
+
+constexpr std::array<uint32_t, 16> makeNibbleTable()
+{
+    std::array<uint32_t, 16> table{};
+    for (uint32_t i = 0; i < 16; i++) {
+        table[i] = shift(i << 28, 4);
+    }
+    return table;
+}
+
+inline uint32_t loadBigEndian(const uint8_t* data)
+{
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+struct BitwiseEngine
+{
+    static uint32_t update(uint32_t crc, const uint8_t* data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++) {
+            crc = shift(crc ^ (static_cast<uint32_t>(data[i]) << 24), 8);
+        }
+        return crc;
+    }
+};
+
+struct NibbleEngine
+{
+    static constexpr std::array<uint32_t, 16> table = makeNibbleTable();
+
+    static uint32_t update(uint32_t crc, const uint8_t* data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++) {
+            crc = (crc << 4) ^ table[(crc >> 28) ^ (data[i] >> 4)];
+            crc = (crc << 4) ^ table[(crc >> 28) ^ (data[i] & 0x0F)];
+        }
+        return crc;
+    }
+};
+
+struct TableEngine
+{
+    static constexpr std::array<std::array<uint32_t, 256>, 1> tables = makeTables<1>();
+
+    static uint32_t update(uint32_t crc, const uint8_t* data, size_t length)
+    {
+        const std::array<uint32_t, 256>& table = tables[0];
+        for (size_t i = 0; i < length; i++) {
+            crc = (crc << 8) ^ table[(crc >> 24) ^ data[i]];
+        }
+        return crc;
+    }
+};
+
+struct Slice4Engine
+{
+    static constexpr std::array<std::array<uint32_t, 256>, 4> tables = makeTables<4>();
+
+    static uint32_t update(uint32_t crc, const uint8_t* data, size_t length)
+    {
+        for (; length >= 4; data += 4, length -= 4) {
+            uint32_t x = crc ^ loadBigEndian(data);
+            crc = tables[3][x >> 24] ^ tables[2][(x >> 16) & 0xFF] ^ tables[1][(x >> 8) & 0xFF] ^
+                  tables[0][x & 0xFF];
+        }
+        return TableEngine::update(crc, data, length);
+    }
+};
+
+struct Slice8Engine
+{
+    static constexpr std::array<std::array<uint32_t, 256>, 8> tables = makeTables<8>();
+
+    static uint32_t update(uint32_t crc, const uint8_t* data, size_t length)
+    {
+        for (; length >= 8; data += 8, length -= 8) {
+            uint32_t x = crc ^ loadBigEndian(data);
+            uint32_t y = loadBigEndian(data + 4);
+            crc = tables[7][x >> 24] ^ tables[6][(x >> 16) & 0xFF] ^ tables[5][(x >> 8) & 0xFF] ^
+                  tables[4][x & 0xFF] ^ tables[3][y >> 24] ^ tables[2][(y >> 16) & 0xFF] ^
+                  tables[1][(y >> 8) & 0xFF] ^ tables[0][y & 0xFF];
+        }
+        return Slice4Engine::update(crc, data, length);
+    }
+};
+} // namespace crc32
+
+/**
+ * @class Crc32
+ * @brief Incremental CRC32 over one of the crc32 engines.
+ */
+template <typename Engine>
+class Crc32
 {
 public:
-    CRC32()
+    Crc32()
     {
         reset();
     }
 
     inline void reset()
     {
-        crc = ~0L;
+        crc = 0xFFFFFFFFU;
     }
 
-    // Process a single byte with reflection
     inline void update(uint8_t value)
     {
-        value = reflectByte(value);
-        crc ^= static_cast<uint32_t>(value);
-        for (int i = 0; i < 8; i++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ polynomial;
-            } else {
-                crc >>= 1;
-            }
-        }
+        crc = Engine::update(crc, &value, 1);
     }
 
-    // Update with uint16 and uint32 values as before
+    // Multi-byte values are processed least significant byte first
     inline void update(uint16_t value)
     {
-        update(static_cast<uint8_t>(value & 0xFF));
-        update(static_cast<uint8_t>((value >> 8) & 0xFF));
+        uint8_t bytes[2] = {static_cast<uint8_t>(value & 0xFF),
+                            static_cast<uint8_t>((value >> 8) & 0xFF)};
+        crc = Engine::update(crc, bytes, sizeof(bytes));
     }
 
     inline void update(uint32_t value)
     {
-        update(static_cast<uint16_t>(value & 0xFFFF));
-        update(static_cast<uint16_t>((value >> 16) & 0xFFFF));
+        uint8_t bytes[4] = {
+            static_cast<uint8_t>(value & 0xFF), static_cast<uint8_t>((value >> 8) & 0xFF),
+            static_cast<uint8_t>((value >> 16) & 0xFF), static_cast<uint8_t>((value >> 24) & 0xFF)};
+        crc = Engine::update(crc, bytes, sizeof(bytes));
     }
 
-    // Update with a byte array
     inline void update(const uint8_t* data, size_t length)
     {
-        for (size_t i = 0; i < length; i++) {
-            update(data[i]);
-        }
+        crc = Engine::update(crc, data, length);
     }
 
-    // Finalize and return the reflected CRC
     inline uint32_t finalize()
     {
-        return reflect(crc) ^ ~0L;
+        return crc ^ 0xFFFFFFFFU;
     }
 
-private:
-    uint32_t crc;
-    static constexpr uint32_t polynomial = 0xEDB88320;
-
-    // Reflects a byte, flipping the bit order
-    inline uint8_t reflectByte(uint8_t b)
+    /**
+     * @brief Compute the CRC of a buffer in one call
+     * @param data Data to checksum
+     * @param length Data length in bytes
+     * @return The CRC
+     */
+    static uint32_t compute(const uint8_t* data, size_t length)
     {
-        uint8_t reflection = 0;
-        for (uint32_t i = 0; i < 8; i++) {
-            if (b & (1U << i)) {
-                reflection |= (1 << (7 - i));
-            }
-        }
-        return reflection;
+        return Engine::update(0xFFFFFFFFU, data, length) ^ 0xFFFFFFFFU;
     }
 
-    // Reflects a 32-bit value, flipping the bit order
-    inline uint32_t reflect(uint32_t data)
-    {
-        uint32_t reflection = 0;
-        for (uint32_t i = 0; i < 32; i++) {
-            if (data & (1U << i)) {
-                reflection |= (1U << (31 - i));
-            }
-        }
-        return reflection;
-    }
+private:
+    uint32_t crc;
 };
+
+using Crc32Bitwise = Crc32<crc32::BitwiseEngine>;
+using Crc32Nibble = Crc32<crc32::NibbleEngine>;
+using Crc32Table = Crc32<crc32::TableEngine>;
+using Crc32Slice4 = Crc32<crc32::Slice4Engine>;
+using Crc32Slice8 = Crc32<crc32::Slice8Engine>;
+
+#if RM_CRC32_BACKEND == RM_CRC32_BITWISE
+using CRC32 = Crc32Bitwise;
+#elif RM_CRC32_BACKEND == RM_CRC32_NIBBLE
+using CRC32 = Crc32Nibble;
+#elif RM_CRC32_BACKEND == RM_CRC32_TABLE
+using CRC32 = Crc32Table;
+#elif RM_CRC32_BACKEND == RM_CRC32_SLICE4
+using CRC32 = Crc32Slice4;
+#elif RM_CRC32_BACKEND == RM_CRC32_SLICE8
+using CRC32 = Crc32Slice8;
+#else
+#error "Unknown RM_CRC32_BACKEND"
+#endif
 } // namespace RadioMeshUtils
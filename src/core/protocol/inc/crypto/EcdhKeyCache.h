@@ -0,0 +1,81 @@
+#pragma once
+
+#include <common/inc/Definitions.h>
+
+// Number of peers whose derived key is kept. A hub including several devices at once needs one
+// per device, a standard device only the hub's.
+#ifndef RM_ECDH_CACHE_SLOTS
+#define RM_ECDH_CACHE_SLOTS 4
+#endif
+
+/**
+ * @class EcdhKeyCache
+ * @brief Cache of Curve25519 ECDH derived keys, one per peer public key
+ *
+ * Deriving the inclusion key costs a Curve25519 scalar multiplication and a SHA256, and one
+ * inclusion step needs it for encryption, decryption and the ECIES MIC on each side. The cache
+ * keeps SHA256(shared secret) per peer public key so each handshake does one scalar
+ * multiplication per peer. The derived key is the ECIES k_enc and k_mac of the protocol.
+ *
+ * All entries belong to one private key: deriving with another private key wipes the cache.
+ * Evicted entries and the whole cache on clear() are wiped.
+ */
+class EcdhKeyCache
+{
+public:
+    static const uint8_t KEY_SIZE = 32;
+    static const uint8_t SLOTS = RM_ECDH_CACHE_SLOTS;
+
+    static EcdhKeyCache* getInstance();
+
+#ifdef RM_NATIVE
+    // Native build only: lets the mesh simulator keep one instance per simulated node.
+    static EcdhKeyCache* setInstance(EcdhKeyCache* newInstance);
+#endif
+
+    /**
+     * @brief Get the key derived from our private key and a peer public key
+     * @param privateKey Our Curve25519 private key, KEY_SIZE bytes
+     * @param peerPublicKey Peer Curve25519 public key, KEY_SIZE bytes
+     * @param key Output derived key, KEY_SIZE bytes
+     * @return true if the key was derived, false if ECDH failed
+     */
+    bool deriveKey(const byte* privateKey, const byte* peerPublicKey, byte* key);
+
+    /**
+     * @brief Wipe all derived keys, e.g. on factory reset
+     */
+    void clear();
+
+    /**
+     * @brief Get the number of scalar multiplications done, for tests
+     * @return Number of ECDH evaluations
+     */
+    uint32_t getDerivations() const
+    {
+        return derivations;
+    }
+
+private:
+    EcdhKeyCache() = default;
+    EcdhKeyCache(const EcdhKeyCache&) = delete;
+    void operator=(const EcdhKeyCache&) = delete;
+
+    static EcdhKeyCache* instance;
+
+    struct Entry
+    {
+        byte peerPublicKey[KEY_SIZE] = {0};
+        byte key[KEY_SIZE] = {0};
+        uint32_t lastUse = 0;
+        bool used = false;
+    };
+
+    byte privateKey[KEY_SIZE] = {0};
+    bool hasPrivateKey = false;
+    Entry entries[SLOTS];
+    uint32_t useCounter = 0;
+    uint32_t derivations = 0;
+
+    void wipe(Entry& entry);
+};
@@ -1,10 +1,10 @@
 #pragma once
 
 #include <common/inc/Definitions.h>
+#include <core/protocol/inc/crypto/aes/AesCtrCipherCache.h>
 #include <memory>
 #include <vector>
 
-class AesCrypto;
 class KeyManager;
 
 /**
@@ -27,10 +27,54 @@ public:
      * @param topic The message topic
      * @param deviceType The type of device performing encryption
      * @param inclusionState The current inclusion state of the device
+     * @param iv Initial AES-CTR counter block (see PacketNonce), nullptr for all zeros
      * @return Encrypted data (or original data if no encryption needed)
      */
     std::vector<byte> encrypt(const std::vector<byte>& data, uint8_t topic,
-                              MeshDeviceType deviceType, DeviceInclusionState inclusionState);
+                              MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                              const byte* iv = nullptr);
+
+    /**
+     * @brief Encrypt packet data in place based on context
+     *
+     * All methods are AES-CTR based, so the cipher text has the length of the clear text and
+     * can overwrite it inside the frame buffer.
+     *
+     * @param data The data to encrypt, replaced by the cipher text
+     * @param length The length of the data
+     * @param topic The message topic
+     * @param deviceType The type of device performing encryption
+     * @param inclusionState The current inclusion state of the device
+     * @param iv Initial AES-CTR counter block (see PacketNonce), nullptr for all zeros
+     */
+    void encryptInPlace(byte* data, size_t length, uint8_t topic, MeshDeviceType deviceType,
+                        DeviceInclusionState inclusionState, const byte* iv = nullptr);
+
+    /**
+     * @brief Generate the key stream of the next outgoing packet ahead of time
+     *
+     * Meant to be called while the radio is busy sending. When the next encryptInPlace() call
+     * has the same key and IV it only XORs the payload with the precomputed key stream.
+     * Only network key (AES) messages are supported.
+     *
+     * @param topic The message topic of the next packet
+     * @param deviceType The type of device performing encryption
+     * @param inclusionState The current inclusion state of the device
+     * @param iv Initial AES-CTR counter block of the next packet
+     * @param length Number of payload bytes to cover
+     * @return true if the key stream was generated, false otherwise
+     */
+    bool precomputeKeystream(uint8_t topic, MeshDeviceType deviceType,
+                             DeviceInclusionState inclusionState, const byte* iv, size_t length);
+
+    /**
+     * @brief Get the number of packets encrypted with a precomputed key stream
+     * @return Number of packets
+     */
+    uint32_t getPrecomputedKeystreamUses() const
+    {
+        return ctrCache.getKeystreamUses();
+    }
 
     /**
      * @brief Decrypt packet data based on context
@@ -38,10 +82,12 @@ public:
      * @param topic The message topic
      * @param deviceType The type of device performing decryption
      * @param inclusionState The current inclusion state of the device
+     * @param iv Initial AES-CTR counter block (see PacketNonce), nullptr for all zeros
      * @return Decrypted data (or original data if no decryption needed)
      */
     std::vector<byte> decrypt(const std::vector<byte>& data, uint8_t topic,
-                              MeshDeviceType deviceType, DeviceInclusionState inclusionState);
+                              MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                              const byte* iv = nullptr);
 
     /**
      * @brief Set the shared network key for AES encryption
@@ -72,19 +118,23 @@ public:
      * @brief Decrypt data using direct ECC (public for manual decryption)
      * @param data Encrypted data
      * @param privateKey Private key for decryption
+     * @param iv Initial AES-CTR counter block, nullptr for all zeros
      * @return Decrypted data
      */
     std::vector<byte> decryptDirectECC(const std::vector<byte>& data,
-                                       const std::vector<byte>& privateKey);
+                                       const std::vector<byte>& privateKey,
+                                       const byte* iv = nullptr);
 
     /**
      * @brief Encrypt data using direct ECC (public for manual encryption)
      * @param data Data to encrypt
      * @param publicKey Public key for encryption
+     * @param iv Initial AES-CTR counter block, nullptr for all zeros
      * @return Encrypted data
      */
     std::vector<byte> encryptDirectECC(const std::vector<byte>& data,
-                                       const std::vector<byte>& publicKey);
+                                       const std::vector<byte>& publicKey,
+                                       const byte* iv = nullptr);
 
     /**
      * @brief Get network key for MIC computation
@@ -124,8 +174,14 @@ private:
                                        MeshDeviceType deviceType) const;
     std::vector<byte> getDecryptionKey(EncryptionMethod method, uint8_t topic,
                                        MeshDeviceType deviceType) const;
-    std::vector<byte> encryptAES(const std::vector<byte>& data, const std::vector<byte>& key);
-    std::vector<byte> decryptAES(const std::vector<byte>& data, const std::vector<byte>& key);
+    std::vector<byte> encryptAES(const std::vector<byte>& data, const std::vector<byte>& key,
+                                 const byte* iv);
+    void encryptAESInPlace(byte* data, size_t length, const std::vector<byte>& key,
+                           const byte* iv);
+    bool deriveDirectECCKey(const std::vector<byte>& privateKey, const std::vector<byte>& publicKey,
+                            std::vector<byte>& key);
+    std::vector<byte> decryptAES(const std::vector<byte>& data, const std::vector<byte>& key,
+                                 const byte* iv);
 
     // Key storage
     std::vector<byte> networkKey;
@@ -134,6 +190,6 @@ private:
     std::vector<byte> hubPublicKey;
     std::vector<byte> tempDevicePublicKey;
 
-    // Crypto instances
-    AesCrypto* aesCrypto = nullptr;
+    // AES-CTR ciphers with their key schedules, keyed by network key or ECDH derived key
+    AesCtrCipherCache ctrCache;
 };
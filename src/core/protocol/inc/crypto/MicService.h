@@ -2,6 +2,8 @@
 
 #include <common/inc/Definitions.h>
 #include <core/protocol/inc/crypto/cmac/AesCmac.h>
+#include <core/protocol/inc/crypto/cmac/AesCmacContext.h>
+#include <core/protocol/inc/packet/PacketView.h>
 #include <vector>
 
 class EncryptionService;
@@ -41,6 +43,20 @@ public:
                                       MeshDeviceType deviceType,
                                       DeviceInclusionState inclusionState);
 
+    /**
+     * @brief Compute the MIC of a frame being built, without copying it
+     * @param data Header followed by the encrypted payload, contiguous
+     * @param length Length of header and payload
+     * @param topic Message topic for key selection
+     * @param deviceType Device type (hub vs standard)
+     * @param inclusionState Current inclusion state
+     * @param mic Output buffer of MIC_SIZE bytes
+     * @return true if the MIC was computed, false if no key is available
+     */
+    bool computePacketMIC(const byte* data, size_t length, uint8_t topic,
+                          MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                          byte* mic);
+
     /**
      * @brief Verify packet MIC
      * @param header Complete packet header (35 bytes)
@@ -58,6 +74,55 @@ public:
                         MeshDeviceType deviceType,
                         DeviceInclusionState inclusionState);
 
+    /**
+     * @brief Verify the MIC of a received frame in place
+     *
+     * Header and payload are authenticated straight from the frame; no copy is made.
+     *
+     * @param packet View over the received frame
+     * @param deviceType Device type (hub vs standard)
+     * @param inclusionState Current inclusion state
+     * @return true if MIC is valid or not required for the topic, false otherwise
+     */
+    bool verifyPacketMIC(const RadioMeshPacketView& packet,
+                         MeshDeviceType deviceType,
+                         DeviceInclusionState inclusionState);
+
+    /**
+     * @brief Start an incremental MIC computation
+     *
+     * Selects the MIC key for the context and keys the CMAC. Feed the authenticated bytes with
+     * updateMIC(), in as many pieces as needed, then call finalizeMIC() or verifyMIC(). This lets
+     * a header and a payload that are not contiguous be authenticated without copying them.
+     *
+     * @param topic Message topic for key selection
+     * @param deviceType Device type (hub vs standard)
+     * @param inclusionState Current inclusion state
+     * @return true if a MIC key is available, false otherwise
+     */
+    bool beginMIC(uint8_t topic, MeshDeviceType deviceType, DeviceInclusionState inclusionState);
+
+    /**
+     * @brief Add authenticated bytes to the MIC started with beginMIC()
+     * @param data Header or payload bytes, in wire order
+     * @param length Number of bytes
+     */
+    void updateMIC(const byte* data, size_t length);
+
+    /**
+     * @brief Finish the MIC started with beginMIC()
+     * @param mic Output buffer of MIC_SIZE bytes
+     * @return true if the MIC was computed, false otherwise
+     */
+    bool finalizeMIC(byte* mic);
+
+    /**
+     * @brief Finish the MIC started with beginMIC() and compare it with a received one
+     * @param receivedMic Received MIC, MIC_SIZE bytes
+     * @return true if the MIC matches, false otherwise
+     */
+    bool verifyMIC(const byte* receivedMic);
+
     /**
      * @brief Extract MIC from payload
      * @param payloadWithMic Complete payload including MIC
@@ -94,9 +159,9 @@ private:
      * @param topic Message topic
      * @param deviceType Device type
      * @param inclusionState Inclusion state
-     * @return Key for MIC computation or empty if no MIC needed
+     * @return Key for MIC computation or empty if no MIC needed. Valid until the next call.
      */
-    std::vector<byte> getMICKey(uint8_t topic,
+    const std::vector<byte>& getMICKey(uint8_t topic,
                                MeshDeviceType deviceType,
                                DeviceInclusionState inclusionState);
 
@@ -109,4 +174,9 @@ private:
     std::vector<byte> getECIESMacKey(uint8_t topic, MeshDeviceType deviceType);
 
     EncryptionService* encryptionService;
+    // Last ECIES k_mac derived by getMICKey, network key MICs use the key in place
+    std::vector<byte> eciesMacKey;
+    const std::vector<byte> noKey;
+    // Keyed CMAC, re-expanded only when the MIC key changes
+    AesCmacContext cmacContext;
 };
\ No newline at end of file
@@ -25,6 +25,16 @@ public:
         return instance;
     }
 
+#ifdef RM_NATIVE
+    // Native build only: lets the mesh simulator keep one instance per simulated node.
+    static AesCrypto* setInstance(AesCrypto* newInstance)
+    {
+        AesCrypto* previous = instance;
+        instance = newInstance;
+        return previous;
+    }
+#endif
+
     virtual ~AesCrypto() = default;
 
     // IAesCrypto interface
@@ -34,6 +44,13 @@ public:
 
     int setParams(const SecurityParams& params);
 
+    /**
+     * @brief Encrypt data in place with the current key and IV
+     * @param data the data to encrypt, replaced by the cipher text
+     * @param length the length of the data
+     */
+    void encryptInPlace(byte* data, size_t length);
+
 private:
     AesCrypto()
     {
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <AES.h>
+#include <CTR.h>
+#include <common/inc/Definitions.h>
+
+// Number of AES-256 key schedules kept resident: the network key plus the ECDH derived keys of
+// inclusions in progress. Each slot costs about 300 bytes of RAM.
+#ifndef RM_AES_CTR_CACHE_SLOTS
+#define RM_AES_CTR_CACHE_SLOTS 3
+#endif
+
+/**
+ * @class AesCtrCipherCache
+ * @brief AES-256-CTR ciphers keyed once and reused across packets
+ *
+ * Each slot keeps a CTR cipher with its expanded key schedule, identified by the key bytes. A
+ * packet with a cached key only loads its counter block before generating the key stream, so the
+ * key expansion runs once per key instead of once per packet. When all slots are in use the least
+ * recently used one is re-keyed.
+ *
+ * The key stream of one upcoming message can be generated ahead of time with precompute(), e.g.
+ * while the radio is busy sending the previous frame. The matching crypt() call then only XORs.
+ */
+class AesCtrCipherCache
+{
+public:
+    static const uint8_t KEY_SIZE = 32;
+    static const uint8_t IV_SIZE = 16;
+    static const uint8_t COUNTER_SIZE = 4;
+    static const uint8_t SLOTS = RM_AES_CTR_CACHE_SLOTS;
+    // Largest payload (MAX_DATA_LENGTH) rounded up to whole AES blocks
+    static const size_t KEYSTREAM_SIZE = 224;
+
+    AesCtrCipherCache() = default;
+    ~AesCtrCipherCache();
+
+    AesCtrCipherCache(const AesCtrCipherCache&) = delete;
+    AesCtrCipherCache& operator=(const AesCtrCipherCache&) = delete;
+
+    /**
+     * @brief Encrypt or decrypt with AES-256-CTR
+     * @param key AES-256 key
+     * @param keyLength Key length, must be KEY_SIZE
+     * @param iv Initial counter block, IV_SIZE bytes
+     * @param input Input data
+     * @param output Output buffer, may be the same as input
+     * @param length Data length
+     * @return true on success, false if the key length is invalid
+     */
+    bool crypt(const byte* key, size_t keyLength, const byte* iv, const byte* input, byte* output,
+               size_t length);
+
+    /**
+     * @brief Generate the key stream of an upcoming message
+     * @param key AES-256 key
+     * @param keyLength Key length, must be KEY_SIZE
+     * @param iv Initial counter block of the upcoming message, IV_SIZE bytes
+     * @param length Number of key stream bytes, at most KEYSTREAM_SIZE
+     * @return true if the key stream was generated, false otherwise
+     */
+    bool precompute(const byte* key, size_t keyLength, const byte* iv, size_t length);
+
+    /**
+     * @brief Wipe all cached keys, key schedules and any precomputed key stream
+     */
+    void clear();
+
+    /**
+     * @brief Get the number of key expansions done since construction, for tests and benchmarks
+     * @return Number of key expansions
+     */
+    uint32_t getKeyExpansions() const
+    {
+        return keyExpansions;
+    }
+
+    /**
+     * @brief Get the number of messages served by a precomputed key stream, for tests
+     * @return Number of messages
+     */
+    uint32_t getKeystreamUses() const
+    {
+        return keystreamUses;
+    }
+
+private:
+    struct Slot
+    {
+        CTR<AES256> cipher;
+        byte key[KEY_SIZE] = {0};
+        uint32_t lastUse = 0;
+        bool used = false;
+    };
+
+    Slot slots[SLOTS];
+    uint32_t useCounter = 0;
+    uint32_t keyExpansions = 0;
+    uint32_t keystreamUses = 0;
+
+    // Precomputed key stream, used once by the crypt() call with the same cipher and IV
+    byte keystream[KEYSTREAM_SIZE] = {0};
+    byte keystreamIv[IV_SIZE] = {0};
+    size_t keystreamLength = 0;
+    Slot* keystreamSlot = nullptr;
+
+    Slot* getCipher(const byte* key);
+    void clearKeystream();
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstring>
+
+#include <core/protocol/inc/packet/Packet.h>
+
+/**
+ * @class PacketNonce
+ * @brief Initial AES-CTR counter block of a packet payload
+ *
+ * From protocol version 5 the counter block is built from header fields that identify the packet
+ * and that relays never change:
+ *
+ *   | source ID (4) | packet ID (4) | frame counter (4) | block counter (4) |
+ *
+ * The block counter starts at zero and covers the 14 blocks of the largest payload. Sender,
+ * relays and receivers all derive the same block from the header. Version 4 frames use an
+ * all-zero block.
+ */
+class PacketNonce
+{
+public:
+    static const uint8_t SIZE = 16;
+
+    /**
+     * @brief Check if frames of a protocol version use a per-packet counter block
+     * @param protocolVersion Version byte of the frame
+     * @return true for version 5 and later, false for the all-zero block of version 4
+     */
+    static bool isPerPacket(uint8_t protocolVersion)
+    {
+        return protocolVersion >= RM_PROTOCOL_VERSION_PACKET_NONCE;
+    }
+
+    /**
+     * @brief Build the counter block from a serialized header
+     * @param header Frame header, HEADER_LENGTH bytes
+     * @param nonce Output counter block, SIZE bytes
+     */
+    static void fromHeader(const byte* header, byte* nonce)
+    {
+        build(header[VERSION_POS], header + SDEV_ID_POS, header + PKT_ID_POS,
+              header + FCOUNTER_POS, nonce);
+    }
+
+    /**
+     * @brief Build the counter block of a packet
+     * @param packet The packet
+     * @param nonce Output counter block, SIZE bytes
+     */
+    static void fromPacket(const RadioMeshPacket& packet, byte* nonce)
+    {
+        byte fcounter[FCOUNTER_LENGTH];
+        RadioMeshPacket::writeUint32(fcounter, packet.fcounter);
+        build(packet.protocolVersion, packet.sourceDevId.data(), packet.packetId.data(), fcounter,
+              nonce);
+    }
+
+    /**
+     * @brief Build the counter block from its fields
+     * @param protocolVersion Protocol version of the frame
+     * @param sourceDevId Source device ID, DEV_ID_LENGTH bytes
+     * @param packetId Packet ID, MSG_ID_LENGTH bytes
+     * @param fcounter Frame counter, big-endian as in the header
+     * @param nonce Output counter block, SIZE bytes
+     */
+    static void build(uint8_t protocolVersion, const byte* sourceDevId, const byte* packetId,
+                      const byte* fcounter, byte* nonce)
+    {
+        memset(nonce, 0, SIZE);
+        if (!isPerPacket(protocolVersion)) {
+            return;
+        }
+        memcpy(nonce, sourceDevId, DEV_ID_LENGTH);
+        memcpy(nonce + DEV_ID_LENGTH, packetId, MSG_ID_LENGTH);
+        memcpy(nonce + DEV_ID_LENGTH + MSG_ID_LENGTH, fcounter, FCOUNTER_LENGTH);
+    }
+};
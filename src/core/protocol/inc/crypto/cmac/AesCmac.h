@@ -9,6 +9,9 @@
  *
  * Provides Message Authentication Code (MAC) computation using AES in CMAC mode.
  * Supports 128-bit output with optional truncation to 32 bits for RadioMesh MIC.
+ *
+ * These one-shot functions expand the key on every call. Use AesCmacContext to authenticate
+ * many messages with the same key.
  */
 class AesCmac
 {
@@ -46,47 +49,37 @@ public:
                          const std::vector<byte>& data,
                          const std::vector<byte>& receivedMic);
 
-private:
-    /**
-     * @brief Generate subkeys K1 and K2 for CMAC
-     * @param key AES encryption key
-     * @param k1 Output subkey K1
-     * @param k2 Output subkey K2
-     */
-    static void generateSubkeys(const std::vector<byte>& key, 
-                               std::vector<byte>& k1, 
-                               std::vector<byte>& k2);
-
-    /**
-     * @brief Left shift operation for subkey generation
-     * @param input Input block
-     * @return Left-shifted block
-     */
-    static std::vector<byte> leftShift(const std::vector<byte>& input);
-
     /**
-     * @brief XOR two byte vectors
-     * @param a First vector
-     * @param b Second vector
-     * @return XOR result
+     * @brief Compute truncated MIC without allocating
+     * @param key AES key (16 or 32 bytes)
+     * @param data Input data to authenticate
+     * @param length Length of the input data
+     * @param mic Output buffer of CMAC_MIC_SIZE bytes
+     * @return true if the MIC was computed, false if the key is invalid
      */
-    static std::vector<byte> xorVectors(const std::vector<byte>& a, 
-                                       const std::vector<byte>& b);
+    static bool computeMIC(const std::vector<byte>& key, const byte* data, size_t length,
+                           byte* mic);
 
     /**
-     * @brief Apply PKCS#7 padding to data
-     * @param data Input data
-     * @param blockSize Target block size
-     * @return Padded data
+     * @brief Verify MIC without allocating
+     * @param key AES key used for computation
+     * @param data Original data
+     * @param length Length of the original data
+     * @param receivedMic MIC to verify, CMAC_MIC_SIZE bytes
+     * @return true if MIC is valid, false otherwise
      */
-    static std::vector<byte> padData(const std::vector<byte>& data, size_t blockSize);
+    static bool verifyMIC(const std::vector<byte>& key, const byte* data, size_t length,
+                          const byte* receivedMic);
 
+private:
     /**
-     * @brief Encrypt single AES block
-     * @param key AES key
-     * @param block 16-byte block to encrypt
-     * @return Encrypted block
+     * @brief Compute the full CMAC with a one-shot context
+     * @param key AES key (16 or 32 bytes)
+     * @param data Input data to authenticate
+     * @param length Length of the input data
+     * @param cmac Output buffer of CMAC_OUTPUT_SIZE bytes
+     * @return true if the CMAC was computed, false if the key is invalid
      */
-    static std::vector<byte> aesEncryptBlock(const std::vector<byte>& key, 
-                                            const std::vector<byte>& block);
-};
\ No newline at end of file
+    static bool computeCMAC(const std::vector<byte>& key, const byte* data, size_t length,
+                            byte* cmac);
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <AES.h>
+#include <common/inc/Definitions.h>
+
+/**
+ * @class AesCmacContext
+ * @brief Keyed, incremental AES-CMAC (RFC 4493)
+ *
+ * The AES key schedule and the K1/K2 subkeys are computed once in setKey() and reused for every
+ * message until the key changes, so authenticating a packet costs only its AES blocks. Input is
+ * fed with update() in any number of pieces and is processed in a fixed 16-byte stack block, so
+ * non-contiguous header and payload can be authenticated without concatenating them.
+ *
+ * Typical use:
+ * @code
+ * context.setKey(key, 32); // no expansion when the key did not change
+ * context.begin();
+ * context.update(header, headerLength);
+ * context.update(payload, payloadLength);
+ * context.finalize(mic, 4); // truncated MIC
+ * @endcode
+ */
+class AesCmacContext
+{
+public:
+    static const uint8_t BLOCK_SIZE = 16;
+    static const uint8_t MAX_KEY_SIZE = 32;
+
+    AesCmacContext() = default;
+    ~AesCmacContext();
+
+    AesCmacContext(const AesCmacContext&) = delete;
+    AesCmacContext& operator=(const AesCmacContext&) = delete;
+
+    /**
+     * @brief Key the context and start a message. Does nothing if the context already holds the key
+     * @param key AES key
+     * @param length Key length, 16 or 32 bytes
+     * @return true if the context is keyed, false if the key length is invalid
+     */
+    bool setKey(const byte* key, size_t length);
+
+    /**
+     * @brief Check if the context holds a key
+     * @return true if setKey() succeeded and the context was not cleared since
+     */
+    bool hasKey() const
+    {
+        return aes != nullptr;
+    }
+
+    /**
+     * @brief Start a new message with the current key
+     */
+    void begin();
+
+    /**
+     * @brief Add message bytes
+     * @param data Input data
+     * @param length Input length, may be zero
+     */
+    void update(const byte* data, size_t length);
+
+    /**
+     * @brief Finish the message and get the CMAC. The context is ready for the next message
+     * @param mac Output buffer
+     * @param length Number of leading CMAC bytes to output, at most BLOCK_SIZE
+     * @return true if the CMAC was computed, false if the context has no key
+     */
+    bool finalize(byte* mac, size_t length = BLOCK_SIZE);
+
+    /**
+     * @brief Finish the message and compare its CMAC with an expected one, in constant time
+     * @param expected Expected leading CMAC bytes
+     * @param length Number of bytes to compare, at most BLOCK_SIZE
+     * @return true if they match, false otherwise or if the context has no key
+     */
+    bool verify(const byte* expected, size_t length);
+
+    /**
+     * @brief Wipe the key schedule, subkeys and message state
+     */
+    void clear();
+
+private:
+    AES128 aes128;
+    AES256 aes256;
+    BlockCipher* aes = nullptr;
+
+    byte key[MAX_KEY_SIZE] = {0};
+    size_t keyLength = 0;
+
+    byte k1[BLOCK_SIZE] = {0};
+    byte k2[BLOCK_SIZE] = {0};
+
+    // Chaining value and the last, possibly partial, block. The last block is held back until
+    // more data arrives because it is masked with K1 or K2 only at finalize().
+    byte chain[BLOCK_SIZE] = {0};
+    byte pending[BLOCK_SIZE] = {0};
+    size_t pendingLength = 0;
+
+    void processBlock(const byte* block);
+    static void deriveSubkey(byte* block);
+};
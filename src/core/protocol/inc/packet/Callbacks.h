@@ -17,3 +17,14 @@ typedef void (*PacketReceivedCallback)(const RadioMeshPacket*, int);
  * @param int The error code of the transmission.
  */
 typedef void (*PacketSentCallback)(const RadioMeshPacket*, int);
+
+/**
+ * @typedef ReliableSendCallback
+ * @brief A callback function for the outcome of a reliable message.
+ * @param target Device the message was sent to.
+ * @param sequence Sequence number the message was given when sent.
+ * @param err RM_E_NONE once the target acknowledged the message, an error code otherwise.
+ * @param context The context given with the message.
+ */
+typedef void (*ReliableSendCallback)(const std::array<byte, RM_ID_LENGTH>& target,
+                                     uint16_t sequence, int err, void* context);
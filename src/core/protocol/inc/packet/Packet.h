@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <string>
@@ -9,8 +10,19 @@
 #include <common/inc/Logger.h>
 #include <common/utils/Utils.h>
 
-// Protocol version
-#define RM_PROTOCOL_VERSION 4
+// Protocol versions
+// 4: payload encrypted with AES-CTR from an all-zero counter block
+// 5: AES-CTR counter block derived from the header (source ID, packet ID, frame counter)
+// Receivers handle both, build with -DRM_PROTOCOL_VERSION=4 to keep sending version 4 frames
+// while a network still has version 4 only devices.
+#define RM_PROTOCOL_VERSION_ZERO_IV 4
+#define RM_PROTOCOL_VERSION_PACKET_NONCE 5
+#ifndef RM_PROTOCOL_VERSION
+#define RM_PROTOCOL_VERSION RM_PROTOCOL_VERSION_PACKET_NONCE
+#endif
+// Oldest and newest versions received
+#define RM_PROTOCOL_VERSION_MIN RM_PROTOCOL_VERSION_ZERO_IV
+#define RM_PROTOCOL_VERSION_MAX RM_PROTOCOL_VERSION_PACKET_NONCE
 #define PROTOCOL_VERSION_LENGTH 1
 
 // Packet size constants
@@ -149,38 +161,63 @@ public:
      */
     std::vector<byte> toByteBuffer() const
     {
-        std::vector<byte> buffer;
-        buffer.reserve(HEADER_LENGTH + packetData.size());
-
-        // Add header fields
-        buffer.push_back(protocolVersion);
-        buffer.insert(buffer.end(), sourceDevId.begin(), sourceDevId.end());
-        buffer.insert(buffer.end(), destDevId.begin(), destDevId.end());
-        buffer.insert(buffer.end(), packetId.begin(), packetId.end());
-        buffer.push_back(topic);
-        buffer.push_back(deviceType);
-        buffer.push_back(hopCount);
-
-        buffer.push_back((packetCrc >> 24) & 0xFF);
-        buffer.push_back((packetCrc >> 16) & 0xFF);
-        buffer.push_back((packetCrc >> 8) & 0xFF);
-        buffer.push_back(packetCrc & 0xFF);
-
-        buffer.push_back((fcounter >> 24) & 0xFF);
-        buffer.push_back((fcounter >> 16) & 0xFF);
-        buffer.push_back((fcounter >> 8) & 0xFF);
-        buffer.push_back(fcounter & 0xFF);
-
-        buffer.insert(buffer.end(), lastHopId.begin(), lastHopId.end());
-        buffer.insert(buffer.end(), nextHopId.begin(), nextHopId.end());
-        buffer.insert(buffer.end(), reserved.begin(), reserved.end());
-
-        // Add data section
-        buffer.insert(buffer.end(), packetData.begin(), packetData.end());
-
+        std::vector<byte> buffer(HEADER_LENGTH + packetData.size());
+        serialize(buffer.data(), buffer.size());
         return buffer;
     }
 
+    /**
+     * @brief Serialize the packet into a caller owned buffer, without allocating
+     * @param buffer Destination buffer
+     * @param capacity Size of the destination buffer
+     * @return Number of bytes written, 0 if the packet does not fit
+     */
+    size_t serialize(byte* buffer, size_t capacity) const
+    {
+        size_t length = HEADER_LENGTH + packetData.size();
+        if (length > capacity) {
+            return 0;
+        }
+        writeHeader(buffer);
+        if (!packetData.empty()) {
+            memcpy(buffer + DATA_POS, packetData.data(), packetData.size());
+        }
+        return length;
+    }
+
+    /**
+     * @brief Write the header fields at their wire positions
+     * @param buffer Destination, at least HEADER_LENGTH bytes
+     */
+    void writeHeader(byte* buffer) const
+    {
+        buffer[VERSION_POS] = protocolVersion;
+        std::copy_n(sourceDevId.begin(), DEV_ID_LENGTH, buffer + SDEV_ID_POS);
+        std::copy_n(destDevId.begin(), DEV_ID_LENGTH, buffer + DDEV_ID_POS);
+        std::copy_n(packetId.begin(), MSG_ID_LENGTH, buffer + PKT_ID_POS);
+        buffer[TOPIC_POS] = topic;
+        buffer[DEVICE_TYPE_POS] = deviceType;
+        buffer[HOP_COUNT_POS] = hopCount;
+        writeUint32(buffer + DATA_CRC_POS, packetCrc);
+        writeUint32(buffer + FCOUNTER_POS, fcounter);
+        std::copy_n(lastHopId.begin(), DEV_ID_LENGTH, buffer + LAST_HOP_ID_POS);
+        std::copy_n(nextHopId.begin(), DEV_ID_LENGTH, buffer + NEXT_HOP_POS);
+        std::copy_n(reserved.begin(), RESERVED_LENGTH, buffer + RESERVED_POS);
+    }
+
+    /**
+     * @brief Write a 32-bit header field, big-endian
+     * @param buffer Destination, at least 4 bytes
+     * @param value Value to write
+     */
+    static void writeUint32(byte* buffer, uint32_t value)
+    {
+        buffer[0] = (value >> 24) & 0xFF;
+        buffer[1] = (value >> 16) & 0xFF;
+        buffer[2] = (value >> 8) & 0xFF;
+        buffer[3] = value & 0xFF;
+    }
+
     /**
      * @brief Reset packet to initial state
      */
@@ -308,31 +345,8 @@ public:
      */
     std::vector<byte> getHeaderBytes() const
     {
-        std::vector<byte> header;
-        header.reserve(HEADER_LENGTH);
-
-        header.push_back(protocolVersion);
-        header.insert(header.end(), sourceDevId.begin(), sourceDevId.end());
-        header.insert(header.end(), destDevId.begin(), destDevId.end());
-        header.insert(header.end(), packetId.begin(), packetId.end());
-        header.push_back(topic);
-        header.push_back(deviceType);
-        header.push_back(hopCount);
-
-        header.push_back((packetCrc >> 24) & 0xFF);
-        header.push_back((packetCrc >> 16) & 0xFF);
-        header.push_back((packetCrc >> 8) & 0xFF);
-        header.push_back(packetCrc & 0xFF);
-
-        header.push_back((fcounter >> 24) & 0xFF);
-        header.push_back((fcounter >> 16) & 0xFF);
-        header.push_back((fcounter >> 8) & 0xFF);
-        header.push_back(fcounter & 0xFF);
-
-        header.insert(header.end(), lastHopId.begin(), lastHopId.end());
-        header.insert(header.end(), nextHopId.begin(), nextHopId.end());
-        header.insert(header.end(), reserved.begin(), reserved.end());
-
+        std::vector<byte> header(HEADER_LENGTH);
+        writeHeader(header.data());
         return header;
     }
     /**
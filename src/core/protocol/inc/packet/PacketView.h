@@ -0,0 +1,278 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <core/protocol/inc/packet/Packet.h>
+
+/**
+ * @struct ByteSpan
+ * @brief Non-owning view over a contiguous range of bytes.
+ */
+struct ByteSpan
+{
+    const byte* data = nullptr;
+    size_t size = 0;
+
+    ByteSpan() = default;
+    ByteSpan(const byte* data, size_t size) : data(data), size(size)
+    {
+    }
+
+    bool empty() const
+    {
+        return size == 0;
+    }
+
+    const byte* begin() const
+    {
+        return data;
+    }
+
+    const byte* end() const
+    {
+        return data + size;
+    }
+
+    const byte& operator[](size_t index) const
+    {
+        return data[index];
+    }
+};
+
+/**
+ * @class RadioMeshPacketView
+ * @brief Non-owning, read-only view of a raw RadioMesh frame.
+ *
+ * Header fields are decoded on access straight from the frame, and header, payload and MIC are
+ * exposed as spans into it, so a received frame can be checked for duplicates, CRC and MIC
+ * without copying it. The frame must outlive the view.
+ *
+ * Use toPacket() to get an owning RadioMeshPacket once the frame has been accepted.
+ */
+class RadioMeshPacketView
+{
+public:
+    RadioMeshPacketView() = default;
+
+    /**
+     * @brief Create a view over a raw frame
+     * @param frame Frame bytes, header first
+     * @param length Frame length in bytes
+     */
+    RadioMeshPacketView(const byte* frame, size_t length) : frame(frame), length(length)
+    {
+    }
+
+    /**
+     * @brief Check that the frame is long enough for a header and at most PACKET_LENGTH bytes
+     * @return true if the fields can be read, false otherwise
+     */
+    bool isValid() const
+    {
+        return frame != nullptr && length >= MIN_PACKET_LENGTH && length <= PACKET_LENGTH;
+    }
+
+    uint8_t getProtocolVersion() const
+    {
+        return frame[VERSION_POS];
+    }
+
+    /**
+     * @brief Check that the frame uses a protocol version this device can decrypt
+     * @return true if the version is between RM_PROTOCOL_VERSION_MIN and RM_PROTOCOL_VERSION_MAX
+     */
+    bool hasSupportedVersion() const
+    {
+        return frame[VERSION_POS] >= RM_PROTOCOL_VERSION_MIN &&
+               frame[VERSION_POS] <= RM_PROTOCOL_VERSION_MAX;
+    }
+
+    std::array<byte, DEV_ID_LENGTH> getSourceDevId() const
+    {
+        return getId(SDEV_ID_POS);
+    }
+
+    /**
+     * @brief Get the source device ID as the 32-bit key used by the duplicate filter
+     * @return Source device ID, big-endian decoded
+     */
+    uint32_t getSourceIdKey() const
+    {
+        return readUint32(SDEV_ID_POS);
+    }
+
+    std::array<byte, DEV_ID_LENGTH> getDestDevId() const
+    {
+        return getId(DDEV_ID_POS);
+    }
+
+    std::array<byte, MSG_ID_LENGTH> getPacketId() const
+    {
+        return getId(PKT_ID_POS);
+    }
+
+    /**
+     * @brief Get the packet ID as the 32-bit key used by the packet tracker
+     * @return Packet ID, big-endian decoded
+     */
+    uint32_t getPacketIdKey() const
+    {
+        return readUint32(PKT_ID_POS);
+    }
+
+    uint8_t getTopic() const
+    {
+        return frame[TOPIC_POS];
+    }
+
+    uint8_t getDeviceType() const
+    {
+        return frame[DEVICE_TYPE_POS];
+    }
+
+    uint8_t getHopCount() const
+    {
+        return frame[HOP_COUNT_POS];
+    }
+
+    uint32_t getPacketCrc() const
+    {
+        return readUint32(DATA_CRC_POS);
+    }
+
+    uint32_t getFcounter() const
+    {
+        return readUint32(FCOUNTER_POS);
+    }
+
+    std::array<byte, DEV_ID_LENGTH> getLastHopId() const
+    {
+        return getId(LAST_HOP_ID_POS);
+    }
+
+    std::array<byte, DEV_ID_LENGTH> getNextHopId() const
+    {
+        return getId(NEXT_HOP_POS);
+    }
+
+    /**
+     * @brief Check if the frame names the relay that should forward it
+     * @return false if any relay may forward it: the next hop is the broadcast address, or all
+     * zeros when the sender had no route
+     */
+    bool hasUnicastNextHop() const
+    {
+        std::array<byte, DEV_ID_LENGTH> nextHop = getNextHopId();
+        return nextHop != BROADCAST_ADDR && nextHop != std::array<byte, DEV_ID_LENGTH>{};
+    }
+
+    /**
+     * @brief Get the whole frame
+     * @return Span over header, payload and MIC
+     */
+    ByteSpan getFrame() const
+    {
+        return ByteSpan(frame, length);
+    }
+
+    /**
+     * @brief Get the header bytes, as covered by the MIC
+     * @return Span over the 35-byte header
+     */
+    ByteSpan getHeader() const
+    {
+        return ByteSpan(frame, HEADER_LENGTH);
+    }
+
+    /**
+     * @brief Get the data section, including the MIC if any
+     * @return Span over everything after the header
+     */
+    ByteSpan getData() const
+    {
+        return ByteSpan(frame + DATA_POS, length - DATA_POS);
+    }
+
+    /**
+     * @brief Check if the data section ends with a MIC, same rule as RadioMeshPacket::hasMIC()
+     * @return true if the last MIC_SIZE bytes are a MIC, false otherwise
+     */
+    bool hasMIC() const
+    {
+        return getTopic() != MessageTopic::INCLUDE_OPEN &&
+               getTopic() != MessageTopic::INCLUDE_REQUEST && getData().size >= MIC_SIZE;
+    }
+
+    /**
+     * @brief Get the payload without the MIC
+     * @return Span over the (encrypted) payload
+     */
+    ByteSpan getPayload() const
+    {
+        ByteSpan data = getData();
+        return hasMIC() ? ByteSpan(data.data, data.size - MIC_SIZE) : data;
+    }
+
+    /**
+     * @brief Get the MIC
+     * @return Span over the MIC, empty if the packet has none
+     */
+    ByteSpan getMIC() const
+    {
+        return hasMIC() ? ByteSpan(frame + length - MIC_SIZE, MIC_SIZE) : ByteSpan();
+    }
+
+    /**
+     * @brief Get the bytes covered by the MIC: header followed by payload, contiguous in the frame
+     * @return Span over header and payload
+     */
+    ByteSpan getAuthenticatedData() const
+    {
+        return ByteSpan(frame, HEADER_LENGTH + getPayload().size);
+    }
+
+    /**
+     * @brief Copy the frame into an owning packet
+     * @param stripMIC Leave the MIC out of packetData
+     * @return The packet
+     */
+    RadioMeshPacket toPacket(bool stripMIC = true) const
+    {
+        RadioMeshPacket packet;
+        packet.protocolVersion = getProtocolVersion();
+        packet.sourceDevId = getSourceDevId();
+        packet.destDevId = getDestDevId();
+        packet.packetId = getPacketId();
+        packet.topic = getTopic();
+        packet.deviceType = getDeviceType();
+        packet.hopCount = getHopCount();
+        packet.packetCrc = getPacketCrc();
+        packet.fcounter = getFcounter();
+        packet.lastHopId = getLastHopId();
+        packet.nextHopId = getNextHopId();
+        std::copy_n(frame + RESERVED_POS, RESERVED_LENGTH, packet.reserved.begin());
+
+        ByteSpan data = stripMIC ? getPayload() : getData();
+        packet.packetData.assign(data.begin(), data.end());
+        return packet;
+    }
+
+private:
+    const byte* frame = nullptr;
+    size_t length = 0;
+
+    std::array<byte, DEV_ID_LENGTH> getId(size_t pos) const
+    {
+        std::array<byte, DEV_ID_LENGTH> id;
+        std::copy_n(frame + pos, DEV_ID_LENGTH, id.begin());
+        return id;
+    }
+
+    uint32_t readUint32(size_t pos) const
+    {
+        return (static_cast<uint32_t>(frame[pos]) << 24) |
+               (static_cast<uint32_t>(frame[pos + 1]) << 16) |
+               (static_cast<uint32_t>(frame[pos + 2]) << 8) | frame[pos + 3];
+    }
+};
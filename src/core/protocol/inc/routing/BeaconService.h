@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vector>
+
+#include <common/inc/Definitions.h>
+#include <core/protocol/inc/routing/NeighborTable.h>
+
+// Shortest time between two beacons, used while the neighbourhood changes
+#ifndef RM_BEACON_MIN_INTERVAL_MS
+#define RM_BEACON_MIN_INTERVAL_MS 15000
+#endif
+
+// Times the interval doubles while the neighbourhood stays the same. The longest interval, 4
+// minutes by default, should stay below ROUTE_TIMEOUT so the routes beacons keep do not expire.
+#ifndef RM_BEACON_DOUBLINGS
+#define RM_BEACON_DOUBLINGS 4
+#endif
+
+// A beacon is skipped once this many neighbours already listing this device beaconed during the
+// interval
+#ifndef RM_BEACON_REDUNDANCY
+#define RM_BEACON_REDUNDANCY 3
+#endif
+
+// Neighbours listed in a beacon, best links first. Each one costs 4 bytes of payload.
+#ifndef RM_BEACON_NEIGHBORS
+#define RM_BEACON_NEIGHBORS 8
+#endif
+
+// Longest random delay before answering the beacon of a device that knows no neighbour yet
+#ifndef RM_BEACON_ANSWER_JITTER_MS
+#define RM_BEACON_ANSWER_JITTER_MS 3000
+#endif
+
+/**
+ * @struct BeaconStats
+ * @brief Beacon service metrics.
+ */
+struct BeaconStats
+{
+    // Beacons and answers sent
+    uint32_t sent = 0;
+    // Beacons skipped because enough neighbours already listing this device beaconed
+    uint32_t suppressed = 0;
+    uint32_t received = 0;
+    // Times the interval went back to the shortest one
+    uint32_t resets = 0;
+};
+
+/**
+ * @class BeaconService
+ * @brief Neighbour discovery beacons, paced by a Trickle timer (RFC 6206).
+ *
+ * Each beacon is a PING broadcast to the neighbours only, never relayed, listing the neighbours
+ * this device hears over a good link. A device hearing it learns a route to its sender, and to
+ * every device listed through the sender, so devices two hops away are reachable by unicast before
+ * they ever sent anything.
+ *
+ * Beacons go out once per interval, at a random time in its second half. The interval starts at
+ * RM_BEACON_MIN_INTERVAL_MS and doubles after each one, up to RM_BEACON_DOUBLINGS times, so a
+ * stable neighbourhood costs a beacon every few minutes. Whenever the list of neighbours to
+ * announce changes, the interval goes back to the shortest one. A beacon is skipped if
+ * RM_BEACON_REDUNDANCY neighbours that already list this device beaconed during the interval.
+ *
+ * A device that just started lists nobody. Neighbours answer its beacon with a PONG, their own
+ * beacon, within RM_BEACON_ANSWER_JITTER_MS instead of waiting for their interval, and the PONG
+ * counts as their beacon for the interval.
+ *
+ * The service only keeps state, the device sends the packets. Times are in milliseconds. It is not
+ * synchronized, it is used from the device loop.
+ */
+class BeaconService
+{
+public:
+    static const uint32_t MIN_INTERVAL_MS = RM_BEACON_MIN_INTERVAL_MS;
+    static const uint32_t MAX_INTERVAL_MS = MIN_INTERVAL_MS << RM_BEACON_DOUBLINGS;
+    static const uint8_t MAX_NEIGHBORS = RM_BEACON_NEIGHBORS;
+    // Links to neighbours listed need fewer than 2.5 transmissions per frame
+    static const uint16_t MAX_LISTED_LINK_COST = 250;
+
+    static_assert(MIN_INTERVAL_MS > 0, "RM_BEACON_MIN_INTERVAL_MS must not be 0");
+    static_assert(MAX_INTERVAL_MS / MIN_INTERVAL_MS == (1U << RM_BEACON_DOUBLINGS),
+                  "RM_BEACON_DOUBLINGS is too large for RM_BEACON_MIN_INTERVAL_MS");
+    static_assert(MAX_NEIGHBORS * DEV_ID_LENGTH <= MAX_DATA_LENGTH,
+                  "RM_BEACON_NEIGHBORS does not fit in a packet");
+
+    BeaconService();
+
+    /**
+     * @brief Start beaconing at the shortest interval
+     * @param now Current time
+     */
+    void start(uint32_t now);
+
+    /**
+     * @brief Stop beaconing
+     */
+    void stop();
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    /**
+     * @brief Go back to the shortest interval if the neighbours to list changed
+     * @param neighbors The neighbour table
+     * @param now Current time
+     */
+    void checkNeighbors(const NeighborTable& neighbors, uint32_t now);
+
+    /**
+     * @brief Check whether a beacon is due, moving on to the next interval once one ends
+     * @param now Current time
+     * @param topic set to the topic of the beacon, PING or PONG
+     * @return true if a beacon is due until onSent() is called, false otherwise
+     */
+    bool isDue(uint32_t now, uint8_t* topic);
+
+    /**
+     * @brief Record that the due beacon was sent
+     */
+    void onSent();
+
+    /**
+     * @brief Build the payload of a beacon: the IDs of the neighbours heard over a good link
+     * recently, best links first
+     * @param neighbors The neighbour table
+     * @param now Current time
+     * @return The payload, up to RM_BEACON_NEIGHBORS device IDs
+     */
+    std::vector<byte> buildPayload(const NeighborTable& neighbors, uint32_t now) const;
+
+    /**
+     * @brief Record a beacon heard from a neighbour
+     * @param topic Topic of the beacon, PING or PONG
+     * @param listed Number of devices the beacon lists
+     * @param listsUs true if the beacon lists this device
+     * @param now Current time
+     */
+    void onBeacon(uint8_t topic, size_t listed, bool listsUs, uint32_t now);
+
+    /**
+     * @brief Get when the next beacon is due, or the current interval ends
+     * @param dueAt set to the deadline
+     * @return true if beaconing, false otherwise
+     */
+    bool getNextDue(uint32_t* dueAt) const;
+
+    /**
+     * @brief Get the length of the current interval
+     * @return Interval in milliseconds
+     */
+    uint32_t getInterval() const
+    {
+        return interval;
+    }
+
+    /**
+     * @brief Get the metrics
+     * @return The metrics
+     */
+    const BeaconStats& getStats() const
+    {
+        return stats;
+    }
+
+private:
+    bool enabled = false;
+    uint32_t interval = MIN_INTERVAL_MS;
+    uint32_t intervalStart = 0;
+    // Time the beacon of the interval is due
+    uint32_t fireAt = 0;
+    // Neighbours listing us heard beaconing during the interval
+    uint8_t heard = 0;
+    bool fired = false;
+    bool answerPending = false;
+    uint32_t answerAt = 0;
+    // Neighbour set version and list announced, to notice changes
+    uint16_t neighborVersion = 0;
+    uint32_t listDigest = 0;
+    BeaconStats stats;
+
+    void startInterval(uint32_t now);
+    void reset(uint32_t now);
+    static uint32_t digest(const std::vector<byte>& list);
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <common/inc/Definitions.h>
+
+// Number of source devices whose recent frame counters are remembered. Each source costs 24 bytes.
+#ifndef RM_DEDUP_MAX_SOURCES
+#define RM_DEDUP_MAX_SOURCES 32
+#endif
+
+// A source that sent nothing for this long is forgotten, which also lets a device whose frame
+// counter started over, its storage lost, be heard again.
+#ifndef RM_DEDUP_SOURCE_TIMEOUT_MS
+#define RM_DEDUP_SOURCE_TIMEOUT_MS (10 * 60 * 1000UL)
+#endif
+
+/**
+ * @class DuplicateFilter
+ * @brief Per-source frame counter window used to reject duplicate packets.
+ *
+ * Each source device stamps its packets with an increasing frame counter. For every source the
+ * filter keeps the highest counter accepted and a 64-bit bitmap of the counters just below it,
+ * like an IPsec anti-replay window. A packet is a duplicate if its counter is in the window and
+ * its bit is set, or if it is older than the window. Rejection is exact within the window and
+ * memory grows with the number of active sources instead of the number of recent packets.
+ *
+ * Only frames whose header is authenticated by a MIC should be recorded, otherwise a forged
+ * frame with a large counter would silence its claimed source.
+ */
+class DuplicateFilter
+{
+public:
+    static const uint8_t WINDOW_SIZE = 64;
+    static const uint8_t MAX_SOURCES = RM_DEDUP_MAX_SOURCES;
+    static const uint32_t SOURCE_TIMEOUT_MS = RM_DEDUP_SOURCE_TIMEOUT_MS;
+
+    DuplicateFilter();
+
+    /**
+     * @brief Check if a packet was already accepted
+     * @param sourceId Source device ID
+     * @param fcounter Frame counter of the packet
+     * @param now Current time in milliseconds
+     * @return true if the packet is a duplicate or is too old to tell, false otherwise
+     */
+    bool isDuplicate(uint32_t sourceId, uint32_t fcounter, uint32_t now) const;
+
+    /**
+     * @brief Record an accepted packet
+     *
+     * When all the sources are in use, the one heard from least recently is forgotten.
+     *
+     * @param sourceId Source device ID
+     * @param fcounter Frame counter of the packet
+     * @param now Current time in milliseconds
+     */
+    void markSeen(uint32_t sourceId, uint32_t fcounter, uint32_t now);
+
+    /**
+     * @brief Forget all the sources
+     */
+    void clear();
+
+    /**
+     * @brief Get the number of sources tracked, expired ones included until they are reused
+     * @return Number of sources
+     */
+    size_t size() const;
+
+private:
+    struct SourceWindow
+    {
+        uint32_t sourceId;
+        // Highest frame counter accepted, bit i of the bitmap is set if highest - i was accepted
+        uint32_t highest;
+        uint64_t bitmap;
+        uint32_t lastSeen;
+        bool used;
+    };
+
+    SourceWindow sources[MAX_SOURCES];
+
+    int findSource(uint32_t sourceId) const;
+    int claimSource(uint32_t now);
+    static bool isExpired(const SourceWindow& source, uint32_t now);
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+
+#include <common/inc/Definitions.h>
+#include <common/inc/Metrics.h>
+#include <core/protocol/inc/packet/Packet.h>
+#include <hardware/inc/radio/TxQueue.h>
+
+// Number of unicast frames waiting for the ACK of their next hop. Each slot costs about 290 bytes.
+// Frames sent while every slot is taken go out without hop acknowledgement.
+#ifndef RM_HOP_ACK_SLOTS
+#define RM_HOP_ACK_SLOTS 4
+#endif
+
+// Retransmissions of a frame its next hop did not acknowledge, before giving up on the hop
+#ifndef RM_HOP_ACK_RETRIES
+#define RM_HOP_ACK_RETRIES 3
+#endif
+
+// Allowance on top of the times on air for the next hop to handle the frame and start its ACK
+#ifndef RM_HOP_ACK_GUARD_MS
+#define RM_HOP_ACK_GUARD_MS 50
+#endif
+
+// Longest ACK timeout, retransmission backoff included
+#ifndef RM_HOP_ACK_MAX_TIMEOUT_MS
+#define RM_HOP_ACK_MAX_TIMEOUT_MS 10000
+#endif
+
+/**
+ * @class HopAckTracker
+ * @brief Keeps unicast frames until their next hop acknowledges them.
+ *
+ * A copy of each tracked frame waits in a fixed slot. Once the frame is on air, the next hop has
+ * a timeout to acknowledge it, after which it is sent again, up to RM_HOP_ACK_RETRIES times, with
+ * the timeout doubled each time. Up to half a timeout of random wait is added, so that two nodes
+ * retransmitting while the other transmits do not keep missing each other. The timeout starts
+ * from the times on air of the frame and its ACK, and follows the measured ACK delays once there
+ * are some, smoothed the way TCP does (RFC 6298). Delays of retransmitted frames are not
+ * measured, the ACK may answer either copy.
+ *
+ * Times are in milliseconds. The tracker is not synchronized, it is used from the device loop.
+ */
+class HopAckTracker
+{
+public:
+    static const uint8_t SLOTS = RM_HOP_ACK_SLOTS;
+
+    enum class State : uint8_t
+    {
+        FREE,
+        // Queued or on air
+        SENDING,
+        // On air, waiting for the ACK
+        WAITING
+    };
+
+    /**
+     * @struct PendingAck
+     * @brief A frame waiting for the ACK of its next hop.
+     */
+    struct PendingAck
+    {
+        // The frame as sent, MIC included. onComplete and context are the sender's.
+        TxFrame frame;
+        uint32_t packetKey;
+        std::array<byte, DEV_ID_LENGTH> nextHopId;
+        // Keys the frame was authenticated with, to authenticate it again if rerouted
+        MeshDeviceType deviceType;
+        DeviceInclusionState inclusionState;
+        // Timeout before any ACK delay was measured, and lowest timeout once measured
+        uint32_t initialTimeoutMs;
+        uint32_t minTimeoutMs;
+        uint32_t sentAt;
+        uint32_t deadline;
+        uint8_t transmissions;
+        bool acked;
+        State state;
+    };
+
+    HopAckTracker();
+
+    /**
+     * @brief Track a frame about to be queued
+     * @param frame The frame, with its length, priority and the sender's completion callback
+     * @param packetKey Packet ID key of the frame
+     * @param deviceType Device type the frame was authenticated for
+     * @param inclusionState Inclusion state the frame was authenticated for
+     * @param frameAirtimeMs Time on air of the frame
+     * @param ackAirtimeMs Time on air of its ACK
+     * @return The tracked copy, nullptr if no slot is free
+     */
+    PendingAck* add(const TxFrame& frame, uint32_t packetKey, MeshDeviceType deviceType,
+                    DeviceInclusionState inclusionState, uint32_t frameAirtimeMs,
+                    uint32_t ackAirtimeMs);
+
+    /**
+     * @brief Record that a tracked frame went on air, and start waiting for its ACK
+     * @param pending The frame
+     * @param now Current time
+     * @return true if the ACK already came in, for an earlier copy, false otherwise
+     */
+    bool onSent(PendingAck* pending, uint32_t now);
+
+    /**
+     * @brief Match an ACK with the frame it acknowledges
+     * @param packetKey Packet ID key of the acknowledged frame
+     * @param fromId Device ID of the ACK's sender
+     * @param now Current time
+     * @return The frame, nullptr if none matches. It is done with once WAITING, a copy still
+     * SENDING completes when onSent() returns true.
+     */
+    PendingAck* onAck(uint32_t packetKey, const byte* fromId, uint32_t now);
+
+    /**
+     * @brief Get a frame whose ACK timeout expired
+     * @param now Current time
+     * @return The frame, nullptr if none expired
+     */
+    PendingAck* getExpired(uint32_t now);
+
+    /**
+     * @brief Check if a frame may be sent again
+     * @param pending The frame
+     * @return true if its retransmissions are not used up, false otherwise
+     */
+    bool canRetry(const PendingAck& pending) const
+    {
+        return pending.transmissions <= RM_HOP_ACK_RETRIES;
+    }
+
+    /**
+     * @brief Record that a frame was queued again
+     * @param pending The frame
+     */
+    void onRetransmit(PendingAck* pending);
+
+    /**
+     * @brief Get when the next ACK timeout expires
+     * @param dueAt set to the earliest ACK deadline
+     * @return true if a frame waits for its ACK, false otherwise
+     */
+    bool getNextDue(uint32_t* dueAt) const;
+
+    /**
+     * @brief Get the ACK timeout of the frame's latest transmission
+     * @param pending The frame
+     * @return Timeout in milliseconds
+     */
+    uint32_t getTimeout(const PendingAck& pending) const;
+
+    /**
+     * @brief Stop tracking a frame. A frame released unacknowledged counts as a failure.
+     * @param pending The frame
+     */
+    void release(PendingAck* pending);
+
+    /**
+     * @brief Get the number of frames tracked
+     * @return Number of frames
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the metrics
+     * @return The metrics
+     */
+    HopAckStats getStats() const;
+
+private:
+    PendingAck pending[SLOTS];
+    // Smoothed ACK delay and its mean deviation
+    uint32_t srttMs = 0;
+    uint32_t rttvarMs = 0;
+    bool hasRtt = false;
+    HopAckStats stats;
+
+    void sampleRtt(uint32_t rttMs);
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+
+#include <common/inc/Definitions.h>
+#include <core/protocol/inc/packet/Packet.h>
+
+// Neighbours whose link quality is tracked. Each one costs 20 bytes. Once the table is full, a new
+// neighbour takes the place of one not heard for ROUTE_TIMEOUT, or else of the worst link if its
+// own is better, so that neighbours heard over poor links do not push out the good ones.
+#ifndef RM_MAX_NEIGHBORS
+#define RM_MAX_NEIGHBORS 16
+#endif
+
+/**
+ * @class NeighborTable
+ * @brief Quality of the links to the devices heard directly.
+ *
+ * Every frame received from a neighbour updates its smoothed RSSI and SNR, and every frame sent to
+ * it updates the smoothed ratio of transmissions it acknowledged. Both are exponentially weighted
+ * moving averages with a weight of 1/8 for the new sample, so a single lucky or unlucky frame
+ * hardly moves them. The link cost is the expected number of transmissions of a frame and its
+ * ACK (ETX), the inverse of the delivery ratio. Until a neighbour acknowledged or missed a frame,
+ * the delivery ratio is estimated from the margin of its SNR over the demodulation floor of the
+ * spreading factor, for the frame and for its ACK.
+ *
+ * Signal levels are kept in quarter dB, delivery ratios in thousandths and costs in hundredths of
+ * a transmission, so nothing needs floating point.
+ */
+class NeighborTable
+{
+public:
+    static const uint8_t CAPACITY = RM_MAX_NEIGHBORS;
+    // Cost of a link that never failed
+    static const uint16_t MIN_LINK_COST = 100;
+    // Cost of a link that keeps failing
+    static const uint16_t MAX_LINK_COST = 2000;
+    // Cost of a link to a device not heard directly, or forgotten since
+    static const uint16_t UNKNOWN_LINK_COST = 300;
+
+    struct Neighbor
+    {
+        std::array<byte, DEV_ID_LENGTH> id;
+        uint32_t lastHeard;
+        // Smoothed RSSI and SNR, in quarter dB
+        int16_t rssi;
+        int16_t snr;
+        // Smoothed ratio of transmissions acknowledged, in thousandths, once ackSamples > 0
+        uint16_t delivery;
+        // Transmissions acknowledged or missed, up to 0xFFFF
+        uint16_t ackSamples;
+        uint16_t frames;
+        bool used;
+    };
+
+    NeighborTable();
+
+    /**
+     * @brief Set the spreading factor of the radio, which sets the SNR a frame needs to be received
+     * @param spreadingFactor LoRa spreading factor, 5 to 12
+     */
+    void setSpreadingFactor(uint8_t spreadingFactor);
+
+    /**
+     * @brief Record a frame received directly from a neighbour
+     * @param id Device ID of the neighbour, the frame's last hop
+     * @param rssi RSSI of the frame in dBm
+     * @param snr SNR of the frame in dB
+     * @param now Current time in milliseconds
+     */
+    void onReceived(const byte* id, int rssi, float snr, uint32_t now);
+
+    /**
+     * @brief Record whether a neighbour acknowledged a transmission
+     * @param id Device ID of the neighbour
+     * @param acked true if it acknowledged the transmission, false if the ACK timed out
+     */
+    void onAckResult(const byte* id, bool acked);
+
+    /**
+     * @brief Get the expected number of transmissions to get a frame through to a neighbour
+     * @param id Device ID of the neighbour
+     * @return Cost in hundredths of a transmission, from MIN_LINK_COST to MAX_LINK_COST
+     */
+    uint16_t getLinkCost(const byte* id) const;
+
+    /**
+     * @brief Get the estimated ratio of transmissions a neighbour acknowledges
+     * @param neighbor The neighbour
+     * @return Delivery ratio in thousandths
+     */
+    uint16_t getDelivery(const Neighbor& neighbor) const;
+
+    /**
+     * @brief Find a neighbour
+     * @param id Device ID of the neighbour
+     * @return The neighbour, nullptr if it is not tracked
+     */
+    const Neighbor* find(const byte* id) const;
+
+    /**
+     * @brief Get a table entry
+     * @param index Entry index, below CAPACITY
+     * @return The neighbour in the entry, nullptr if the entry is free
+     */
+    const Neighbor* get(uint8_t index) const;
+
+    /**
+     * @brief Get the number of neighbours tracked
+     * @return Number of neighbours
+     */
+    uint8_t size() const;
+
+    /**
+     * @brief Get the number of neighbours heard within ROUTE_TIMEOUT
+     * @param now Current time in milliseconds
+     * @return Number of neighbours
+     */
+    uint8_t countHeard(uint32_t now) const;
+
+    /**
+     * @brief Get a number that changes whenever a neighbour is added or forgotten
+     * @return Version of the set of neighbours
+     */
+    uint16_t getVersion() const
+    {
+        return version;
+    }
+
+    /**
+     * @brief Forget every neighbour
+     */
+    void clear();
+
+private:
+    Neighbor neighbors[CAPACITY];
+    // Demodulation floor of the spreading factor, in quarter dB
+    int16_t snrFloor;
+    uint16_t version = 0;
+
+    Neighbor* findEntry(const byte* id);
+    uint16_t getSnrDelivery(int16_t snr) const;
+    static uint16_t toLinkCost(uint32_t delivery);
+};
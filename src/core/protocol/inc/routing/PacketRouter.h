@@ -9,11 +9,16 @@
 #include <vector>
 
 #include <core/protocol/inc/crypto/aes/AesCrypto.h>
+#include <core/protocol/inc/crypto/aes/PacketNonce.h>
 #include <core/protocol/inc/crypto/EncryptionService.h>
 #include <core/protocol/inc/crypto/MicService.h>
 #include <core/protocol/inc/packet/Packet.h>
+#include <core/protocol/inc/packet/PacketView.h>
+#include <core/protocol/inc/routing/DuplicateFilter.h>
+#include <core/protocol/inc/routing/HopAckTracker.h>
 #include <core/protocol/inc/routing/PacketTracker.h>
 #include <core/protocol/inc/routing/RoutingTable.h>
+#include <hardware/inc/radio/TxQueue.h>
 
 /**
  * @class PacketRouter
@@ -37,26 +42,154 @@ public:
         return instance;
     }
 
+#ifdef RM_NATIVE
+    /**
+     * @brief Replace the instance returned by getInstance(). Native build only, used by the
+     * mesh simulator to give each simulated node its own router and packet tracker.
+     * @param newInstance The instance to install, nullptr to create a new one on next use.
+     * @return The previously installed instance.
+     */
+    static PacketRouter* setInstance(PacketRouter* newInstance)
+    {
+        PacketRouter* previous = instance;
+        instance = newInstance;
+        return previous;
+    }
+#endif
+
     virtual ~PacketRouter()
     {
     }
     /**
      * @brief Route a packet to the next hop in the mesh network.
-     * @param packet RadioMeshPacket to route
+     *
+     * The packet is serialized straight into a slot of the radio's transmit queue, then
+     * encrypted and authenticated in place. The packet itself is not modified.
+     *
+     * @param packet RadioMeshPacket to route, with a clear text payload
+     * @param ourDeviceId Our device ID
+     * @param deviceType Type of device (Hub or Standard)
+     * @param inclusionState Current inclusion state
+     * @param priority Transmit priority class of the packet
+     * @param onComplete Called once the frame is sent or failed, may be nullptr
+     * @param context Passed to onComplete
+     * @return RM_E_NONE if the packet was successfully routed, RM_E_QUEUE_FULL if the transmit
+     * queue is full, an error code otherwise.
+     */
+    int routePacket(const RadioMeshPacket& packet, const byte* ourDeviceId,
+                    MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                    TxPriority priority = TxPriority::APPLICATION,
+                    TxCompleteCallback onComplete = nullptr, void* context = nullptr);
+
+    /**
+     * @brief Relay a received frame to the next hop in the mesh network.
+     *
+     * The frame is copied once into a slot of the radio's transmit queue, where the routing
+     * header fields, CRC and MIC are patched. The payload is forwarded encrypted, as received, so
+     * relaying does not allocate. Relayed frames have the lowest transmit priority. A frame
+     * received as a unicast hop is forwarded to the next hop of our route and acknowledged hop by
+     * hop, a flooded one is flooded on and not acknowledged.
+     *
+     * @param frame View over the received frame, with a verified MIC
      * @param ourDeviceId Our device ID
      * @param deviceType Type of device (Hub or Standard)
      * @param inclusionState Current inclusion state
-     * @return RM_E_NONE if the packet was successfully routed, an error code otherwise.
+     * @param onComplete Called once the frame is sent or failed, may be nullptr
+     * @param context Passed to onComplete
+     * @return RM_E_NONE if the frame was successfully relayed, RM_E_QUEUE_FULL if the transmit
+     * queue is full, an error code otherwise.
      */
-    int routePacket(RadioMeshPacket packet, const byte* ourDeviceId, 
-                   MeshDeviceType deviceType, DeviceInclusionState inclusionState);
+    int relayFrame(const RadioMeshPacketView& frame, const byte* ourDeviceId,
+                   MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                   TxCompleteCallback onComplete = nullptr, void* context = nullptr);
 
     /**
      * @brief Check if a packet has already been tracked.
      * @param packet RadioMeshPacket to check
      * @return true if the packet has already been tracked, false otherwise.
      */
-    bool isPacketFoundInTracker(RadioMeshPacket packet);
+    bool isPacketFoundInTracker(const RadioMeshPacket& packet);
+
+    /**
+     * @brief Check if a received frame has already been tracked, without copying it.
+     *
+     * Frames authenticated by a MIC are checked against the frame counter window of their source,
+     * the others against the packet ID tracker.
+     *
+     * @param packet View over the received frame
+     * @return true if the packet has already been tracked, false otherwise.
+     */
+    bool isPacketFoundInTracker(const RadioMeshPacketView& packet);
+
+    /**
+     * @brief Record a received frame as seen, so that later copies are rejected as duplicates.
+     *
+     * Call it only once the frame's MIC is verified: the frame counter window of the source moves
+     * forward with the counter of the frame. Frames without a MIC are not recorded.
+     *
+     * @param packet View over the received frame
+     */
+    void markPacketSeen(const RadioMeshPacketView& packet);
+
+    /**
+     * @brief Track a received frame waiting to be relayed.
+     *
+     * Frames are tracked once relayed. A delayed relay is tracked as soon as it is scheduled, so
+     * the copies heard meanwhile are recognized as duplicates, whether or not the frame has a MIC.
+     *
+     * @param packet View over the received frame
+     */
+    void trackPendingRelay(const RadioMeshPacketView& packet);
+
+    /**
+     * @brief Check if a frame is to be acknowledged by its next hop.
+     *
+     * Application frames and reliable messages sent to a unicast next hop are acknowledged hop by
+     * hop. Inclusion frames have their own protocol timeouts, floods and ACKs are not acknowledged.
+     *
+     * @param frame View over the frame
+     * @return true if the next hop acknowledges the frame, false otherwise.
+     */
+    static bool requiresHopAck(const RadioMeshPacketView& frame);
+
+    /**
+     * @brief Handle a hop ACK addressed to us.
+     *
+     * Completes the frame it acknowledges, whose sender is reported RM_E_NONE.
+     *
+     * @param packetKey Packet ID key of the acknowledged frame
+     * @param fromId Device ID of the ACK's sender, the frame's next hop
+     */
+    void onHopAck(uint32_t packetKey, const byte* fromId);
+
+    /**
+     * @brief Retransmit the frames whose ACK timed out, call it from the device loop.
+     *
+     * A frame is sent again up to RM_HOP_ACK_RETRIES times. After that the routes through its
+     * next hop may be dropped, and the frame is flooded once to reach its destination another
+     * way. The sender is reported the outcome of the flood, or RM_E_HOP_ACK_TIMEOUT if it could
+     * not be sent.
+     */
+    void serviceHopAcks();
+
+    /**
+     * @brief Get when the next ACK timeout expires
+     * @param dueAt set to the earliest ACK deadline, in milliseconds
+     * @return true if a frame waits for its ACK, false otherwise
+     */
+    bool getNextHopAckDue(uint32_t* dueAt) const
+    {
+        return hopAcks.getNextDue(dueAt);
+    }
+
+    /**
+     * @brief Get the hop-by-hop acknowledgement metrics
+     * @return HopAckStats
+     */
+    HopAckStats getHopAckStats() const
+    {
+        return hopAcks.getStats();
+    }
 
     /**
      * @brief Set the encryption service to use for encrypting and decrypting packets.
@@ -94,20 +227,41 @@ private:
     PacketRouter(const PacketRouter&) = delete;
     void operator=(const PacketRouter&) = delete;
 
-    PacketTracker packetTracker = PacketTracker(50);
+    // A hop ACK carries the ID of the packet it acknowledges
+    static const size_t HOP_ACK_LENGTH = HEADER_LENGTH + MSG_ID_LENGTH + MIC_SIZE;
+
+    PacketTracker packetTracker;
+    DuplicateFilter duplicateFilter;
+    HopAckTracker hopAcks;
     AesCrypto* crypto = nullptr;
     EncryptionService* encryptionService = nullptr;
     MicService* micService = nullptr;
 
     static PacketRouter* instance;
 
-    bool checkMaxHops(RadioMeshPacket& packetCopy);
-    void updateLastHopId(RadioMeshPacket& packetCopy, const byte* ourDeviceId);
-    void routeToNextHop(RadioMeshPacket& packetCopy);
-    void encryptPacketData(RadioMeshPacket& packetCopy, MeshDeviceType deviceType, DeviceInclusionState inclusionState);
-    int computeAndAppendMIC(RadioMeshPacket& packetCopy, MeshDeviceType deviceType, DeviceInclusionState inclusionState);
-    void calculatePacketCrc(RadioMeshPacket& packetCopy, RadioMeshUtils::CRC32& crc32,
-                            uint32_t key);
-    int sendPacket(RadioMeshPacket& packetCopy);
-    void trackPacket(RadioMeshPacket& packetCopy, uint32_t key);
+    // Frame helpers: frame is a transmit queue slot, length excludes the MIC
+    bool checkMaxHops(uint8_t hopCount, uint32_t key);
+    void updateLastHopId(byte* frame, const byte* ourDeviceId);
+    void routeToNextHop(byte* frame);
+    void encryptPacketData(byte* frame, size_t length, MeshDeviceType deviceType,
+                           DeviceInclusionState inclusionState);
+    uint32_t calculatePacketCrc(byte* frame, size_t length, uint32_t key);
+    int computeAndAppendMIC(byte* frame, size_t& length, MeshDeviceType deviceType,
+                            DeviceInclusionState inclusionState);
+    int sendFrame(TxFrame* frame, size_t length, uint32_t key, MeshDeviceType deviceType,
+                  DeviceInclusionState inclusionState, TxPriority priority,
+                  TxCompleteCallback onComplete, void* context);
+    void trackPacket(const byte* frame, size_t length, uint32_t key, uint32_t packetCrc);
+    HopAckTracker::PendingAck* trackHopAck(TxFrame* slot, size_t length, uint32_t key,
+                                           MeshDeviceType deviceType,
+                                           DeviceInclusionState inclusionState,
+                                           TxPriority priority, TxCompleteCallback onComplete,
+                                           void* context);
+    bool retransmitHopFrame(HopAckTracker::PendingAck* pending);
+    void rerouteHopFrame(HopAckTracker::PendingAck* pending);
+    int floodHopFrame(const HopAckTracker::PendingAck* pending);
+    void completeHopAck(HopAckTracker::PendingAck* pending, int err);
+    static void onHopFrameSent(const TxFrame& frame, int err, void* context);
+    bool isPacketFoundInTracker(uint8_t topic, uint32_t sourceId, uint32_t fcounter, uint32_t key,
+                                uint32_t packetCrc);
 };
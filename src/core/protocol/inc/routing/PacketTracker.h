@@ -1,54 +1,146 @@
 #pragma once
 
 #include <common/inc/Definitions.h>
-#include <list>
-#include <unordered_map>
+
+// Number of packets remembered for duplicate detection, a power of two. Each entry costs 12 bytes
+// plus 4 bytes of hash index.
+#ifndef RM_PACKET_TRACKER_CAPACITY
+#define RM_PACKET_TRACKER_CAPACITY 64
+#endif
 
 /**
- * @class PacketTracker
+ * @class FixedPacketTracker
  * @brief This class is a packet tracker.
  *
  * It defines a simple packet tracker that stores a map of key-value pairs.
  * And it is used by the PacketRouter class to track packets that have already been processed.
- * The tracker is implemented as a least recently used (LRU) cache.
+ *
+ * Entries live in a fixed array sized by the Capacity template parameter and are found through an
+ * open-addressed, linear probing hash index twice that size, so nothing is allocated after
+ * construction and a lookup is a couple of adjacent array reads. When the tracker is full, a CLOCK
+ * hand sweeps the entries and evicts the first one not looked up since the hand last passed it,
+ * which approximates least recently used eviction without reordering anything on a hit.
+ *
+ * @tparam Capacity maximum number of entries, a power of two
  */
-class PacketTracker
+template <uint16_t Capacity>
+class FixedPacketTracker
 {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Packet tracker capacity must be a power of two");
+    static_assert(Capacity <= 16384, "Packet tracker capacity is too large");
+
 private:
-    // Doubly linked list to store keys in order of usage
-    std::list<std::pair<uint32_t, uint32_t>> lruList;
-    // Map to store key and corresponding iterator to the list
-    std::unordered_map<uint32_t, std::list<std::pair<uint32_t, uint32_t>>::iterator> map;
-    const uint32_t MAX_CAPACITY = 50;
+    struct Entry
+    {
+        uint32_t key;
+        uint32_t value;
+        bool used;
+        bool referenced;
+    };
+
+    // Index slots hold entry index + 1, 0 marks an empty slot
+    static const uint32_t INDEX_SIZE = Capacity * 2;
+    static const uint32_t INDEX_MASK = INDEX_SIZE - 1;
+
+    static constexpr uint32_t log2(uint32_t value)
+    {
+        return value > 1 ? 1 + log2(value / 2) : 0;
+    }
+    static const uint32_t INDEX_SHIFT = 32 - log2(INDEX_SIZE);
+
+    Entry entries[Capacity] = {};
+    uint16_t index[INDEX_SIZE] = {};
+
+    uint16_t capacity_ = Capacity;
+    uint16_t count = 0;
+    // Entries below this one have been used since the last clear, so filling up is O(1)
+    uint16_t highWater = 0;
+    uint16_t hand = 0;
+
+    static uint32_t hashSlot(uint32_t key)
+    {
+        // Fibonacci hashing: the top bits of the product depend on every bit of the key
+        return (key * 2654435769U) >> INDEX_SHIFT;
+    }
+
+    int32_t findSlot(uint32_t key) const
+    {
+        for (uint32_t slot = hashSlot(key);; slot = (slot + 1) & INDEX_MASK) {
+            uint16_t entry = index[slot];
+            if (entry == 0) {
+                return -1;
+            }
+            if (entries[entry - 1].key == key) {
+                return slot;
+            }
+        }
+    }
+
+    void eraseSlot(uint32_t slot)
+    {
+        entries[index[slot] - 1].used = false;
+        index[slot] = 0;
+        count--;
 
-    uint32_t capacity_ = MAX_CAPACITY;
+        // Backward shift deletion: pull later entries of the probe run into the hole so that
+        // lookups can stop at the first empty slot without tombstones
+        uint32_t hole = slot;
+        for (uint32_t next = (slot + 1) & INDEX_MASK; index[next] != 0;
+             next = (next + 1) & INDEX_MASK) {
+            uint32_t home = hashSlot(entries[index[next] - 1].key);
+            if (((next - home) & INDEX_MASK) >= ((next - hole) & INDEX_MASK)) {
+                index[hole] = index[next];
+                index[next] = 0;
+                hole = next;
+            }
+        }
+    }
 
-    void moveToFront(uint32_t key, uint32_t value)
+    uint16_t allocateEntry()
     {
-        lruList.erase(map[key]);
-        lruList.push_front({key, value});
-        map[key] = lruList.begin();
+        if (highWater < capacity_) {
+            return highWater++;
+        }
+        if (count < capacity_) {
+            // Reuse an entry freed by removeEntry()
+            for (uint16_t i = 0; i < capacity_; i++) {
+                if (!entries[i].used) {
+                    return i;
+                }
+            }
+        }
+
+        // CLOCK: give referenced entries a second chance, evict the first unreferenced one
+        while (entries[hand].referenced) {
+            entries[hand].referenced = false;
+            hand = (hand + 1) % capacity_;
+        }
+        uint16_t victim = hand;
+        hand = (hand + 1) % capacity_;
+        eraseSlot(findSlot(entries[victim].key));
+        return victim;
     }
 
 public:
     /**
      * @brief Construct a new Packet Tracker object
      *
-     * @return PacketTracker
+     * @return FixedPacketTracker
      */
-    PacketTracker()
+    FixedPacketTracker()
     {
     }
 
     /**
      * @brief Construct a new Packet Tracker object
      *
-     * @param capacity the maximum number of entries to store in the tracker
-     * @return PacketTracker
+     * @param capacity the maximum number of entries to store in the tracker, at most Capacity
+     * @return FixedPacketTracker
      */
-    PacketTracker(uint32_t capacity)
+    FixedPacketTracker(uint32_t capacity)
     {
-        capacity_ = capacity;
+        capacity_ = (capacity > 0 && capacity < Capacity) ? capacity : Capacity;
     }
 
     /**
@@ -58,7 +150,7 @@ public:
      */
     inline uint32_t size()
     {
-        return map.size();
+        return count;
     }
 
     /**
@@ -69,17 +161,22 @@ public:
      */
     inline void addEntry(uint32_t key, uint32_t value)
     {
-        if (map.find(key) != map.end()) {
-            moveToFront(key, value);
-        } else {
-            if (lruList.size() == capacity_) {
-                auto last = lruList.back();
-                map.erase(last.first);
-                lruList.pop_back();
-            }
-            lruList.push_front({key, value});
-            map[key] = lruList.begin();
+        int32_t slot = findSlot(key);
+        if (slot >= 0) {
+            Entry& entry = entries[index[slot] - 1];
+            entry.value = value;
+            entry.referenced = true;
+            return;
         }
+
+        uint16_t position = allocateEntry();
+        entries[position] = {key, value, true, false};
+        uint32_t free = hashSlot(key);
+        while (index[free] != 0) {
+            free = (free + 1) & INDEX_MASK;
+        }
+        index[free] = position + 1;
+        count++;
     }
 
     /**
@@ -89,9 +186,9 @@ public:
      */
     inline void removeEntry(uint32_t key)
     {
-        if (map.find(key) != map.end()) {
-            lruList.erase(map[key]);
-            map.erase(key);
+        int32_t slot = findSlot(key);
+        if (slot >= 0) {
+            eraseSlot(slot);
         }
     }
 
@@ -100,8 +197,15 @@ public:
      */
     inline void clearMap()
     {
-        lruList.clear();
-        map.clear();
+        for (uint16_t i = 0; i < Capacity; i++) {
+            entries[i] = {};
+        }
+        for (uint32_t i = 0; i < INDEX_SIZE; i++) {
+            index[i] = 0;
+        }
+        count = 0;
+        highWater = 0;
+        hand = 0;
     }
 
     /**
@@ -112,7 +216,7 @@ public:
      */
     inline bool keyExists(uint32_t key)
     {
-        return map.find(key) != map.end();
+        return findSlot(key) >= 0;
     }
 
     /**
@@ -125,12 +229,17 @@ public:
     template <typename K, typename V>
     inline V findOrDefault(const K& key, const V& defaultValue)
     {
-        auto it = map.find(key);
-        if (it != map.end()) {
-            moveToFront(key, it->second->second);
-            return it->second->second;
-        } else {
+        int32_t slot = findSlot(key);
+        if (slot < 0) {
             return defaultValue;
         }
+        Entry& entry = entries[index[slot] - 1];
+        entry.referenced = true;
+        return entry.value;
     }
 };
+
+/**
+ * @brief The packet tracker used by the router, sized with RM_PACKET_TRACKER_CAPACITY
+ */
+using PacketTracker = FixedPacketTracker<RM_PACKET_TRACKER_CAPACITY>;
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <common/inc/Definitions.h>
+#include <core/protocol/inc/packet/PacketView.h>
+
+// Backoffs are counted in slots, the time on air of the frame to relay, so that relays waiting
+// different numbers of slots do not overlap on air. Every slot waited adds to the latency of each
+// hop, and a frame waiting long runs into the traffic that follows it.
+
+// Longest signal based backoff, given to the strongest received signals. Weaker signals come from
+// farther away, where a rebroadcast covers more new ground, so they wait less. Kept above
+// RM_RELAY_JITTER_SLOTS so that the signal, not chance, decides which relay goes first.
+#ifndef RM_RELAY_BACKOFF_SLOTS
+#define RM_RELAY_BACKOFF_SLOTS 3
+#endif
+
+// Width of the random window the rebroadcast falls in, starting at the signal based backoff, so
+// relays hearing the same packet at about the same strength still spread out.
+#ifndef RM_RELAY_JITTER_SLOTS
+#define RM_RELAY_JITTER_SLOTS 2
+#endif
+
+// Number of received frames waiting for their rebroadcast. Each slot costs about 270 bytes. A
+// frame arrives at most every slot, so with at least as many as the slots of the longest backoff
+// the table only fills when the channel is busy past it.
+#ifndef RM_RELAY_SLOTS
+#define RM_RELAY_SLOTS 8
+#endif
+
+// A pending rebroadcast is cancelled once this many neighbours were heard relaying the packet. On
+// sparse, line shaped meshes a single relay rarely reaches every next hop.
+#ifndef RM_RELAY_SUPPRESS_COPIES
+#define RM_RELAY_SUPPRESS_COPIES 2
+#endif
+
+// From this many neighbours heard, a single copy cancels the rebroadcast: the relays around are
+// close enough together that any one of them covers nearly what the others would.
+#ifndef RM_RELAY_DENSE_NEIGHBORS
+#define RM_RELAY_DENSE_NEIGHBORS 6
+#endif
+
+/**
+ * @class RelayScheduler
+ * @brief Delays rebroadcasts and cancels the ones neighbours already made redundant.
+ *
+ * Relays hearing a broadcast all at once would rebroadcast it together and collide. Instead each
+ * received frame to relay waits for a backoff: the received signal quality picks the start of a
+ * window, later the stronger the signal, and the rebroadcast falls at random within it. Windows
+ * are narrower than the range of starts, so the farthest receivers rebroadcast first. Both are
+ * counted in frame times on air. While it waits, every copy of the packet heard from other relays
+ * is counted, and the rebroadcast is dropped once enough neighbours relayed it (counter-based
+ * suppression): one in a dense neighbourhood, RM_RELAY_SUPPRESS_COPIES otherwise. The radio then
+ * senses the channel before the rebroadcast if LoraRadioParams::relayListenBeforeTalk is on.
+ * When every slot is taken, the longest waiting rebroadcast is dropped for the new one.
+ */
+class RelayScheduler
+{
+public:
+    static const uint8_t SLOTS = RM_RELAY_SLOTS;
+
+    /**
+     * @struct PendingRelay
+     * @brief A received frame waiting for its rebroadcast.
+     */
+    struct PendingRelay
+    {
+        byte data[PACKET_LENGTH];
+        size_t length;
+        uint32_t packetKey;
+        uint32_t scheduledAt;
+        uint32_t dueAt;
+        uint8_t copiesHeard;
+        // Copies that cancel the rebroadcast
+        uint8_t copiesToSuppress;
+        bool used;
+
+        RadioMeshPacketView getFrame() const
+        {
+            return RadioMeshPacketView(data, length);
+        }
+    };
+
+    RelayScheduler();
+
+    /**
+     * @brief Schedule the rebroadcast of a received frame
+     * @param frame The received frame, copied into the scheduler
+     * @param rssi RSSI the frame was received at, in dBm
+     * @param snr SNR the frame was received at, in dB
+     * @param airtimeMs Time on air of the frame, in milliseconds
+     * @param neighbors Number of neighbours heard, which sets the copies that cancel the
+     * rebroadcast
+     * @param now Current time in milliseconds
+     * @return true if the frame was scheduled, false if it does not fit in a slot
+     *
+     * When every slot is taken, the rebroadcast waiting the longest is dropped to make room: its
+     * neighbours had the most time to relay it already.
+     */
+    bool schedule(const RadioMeshPacketView& frame, float rssi, float snr, uint32_t airtimeMs,
+                  uint8_t neighbors, uint32_t now);
+
+    /**
+     * @brief Count a copy of a packet heard from another relay
+     *
+     * Cancels the pending rebroadcast of the packet once enough copies were heard, one with
+     * RM_RELAY_DENSE_NEIGHBORS neighbours or more, RM_RELAY_SUPPRESS_COPIES otherwise.
+     *
+     * @param packetKey Packet ID key of the copy
+     */
+    void onCopyHeard(uint32_t packetKey);
+
+    /**
+     * @brief Get a rebroadcast whose backoff expired
+     * @param now Current time in milliseconds
+     * @return The rebroadcast, which stays pending until release(), nullptr if none is due
+     */
+    const PendingRelay* getDue(uint32_t now) const;
+
+    /**
+     * @brief Get when the next rebroadcast is due
+     * @param dueAt set to the time the earliest pending rebroadcast is due, in milliseconds
+     * @return true if a rebroadcast is pending, false otherwise
+     */
+    bool getNextDue(uint32_t* dueAt) const;
+
+    /**
+     * @brief Forget a rebroadcast returned by getDue()
+     * @param relay The rebroadcast
+     */
+    void release(const PendingRelay* relay);
+
+    /**
+     * @brief Forget all the pending rebroadcasts
+     */
+    void clear();
+
+    /**
+     * @brief Get the number of pending rebroadcasts
+     * @return Number of rebroadcasts
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the number of rebroadcasts cancelled because neighbours relayed the packet
+     * @return Number of rebroadcasts
+     */
+    uint32_t getSuppressedCount() const
+    {
+        return suppressed;
+    }
+
+    /**
+     * @brief Get the number of rebroadcasts dropped to make room for newer ones
+     * @return Number of rebroadcasts
+     */
+    uint32_t getDroppedCount() const
+    {
+        return dropped;
+    }
+
+    /**
+     * @brief Get the start of the backoff window picked by the signal quality
+     * @param rssi RSSI in dBm
+     * @param snr SNR in dB
+     * @param airtimeMs Time on air of the frame, in milliseconds
+     * @return Backoff in milliseconds, between 0 and RM_RELAY_BACKOFF_SLOTS times airtimeMs
+     */
+    static uint32_t getSignalBackoff(float rssi, float snr, uint32_t airtimeMs);
+
+private:
+    PendingRelay relays[SLOTS];
+    uint32_t suppressed = 0;
+    uint32_t dropped = 0;
+};
@@ -1,42 +1,156 @@
 #pragma once
 
+#include "NeighborTable.h"
 #include "RoutingTypes.h"
 #include <common/inc/Logger.h>
 #include <core/protocol/inc/packet/Packet.h>
+#include <core/protocol/inc/packet/PacketView.h>
 
+// Smallest power of two holding at least the given number of index slots
+constexpr uint32_t routingIndexSize(uint32_t slots, uint32_t size = 1)
+{
+    return size >= slots ? size : routingIndexSize(slots, size * 2);
+}
+
+constexpr uint32_t routingIndexBits(uint32_t size)
+{
+    return size > 1 ? 1 + routingIndexBits(size / 2) : 0;
+}
+
+/**
+ * @class RoutingTable
+ * @brief Next hop towards each destination heard from, learned from received packets.
+ *
+ * Routes live in a fixed array of RM_MAX_ROUTES entries and are found through an open-addressed,
+ * linear probing hash index on the destination ID, at least twice that size, so a lookup is a
+ * couple of adjacent array reads whatever the number of routes. The entries are chained in least
+ * recently used order, a route moving to the front whenever it is used or its destination is
+ * heard from. Once the table is full, the route at the back makes room for the new destination.
+ * Expired routes and routes whose next hop stopped acknowledging are removed.
+ *
+ * Paths are compared by cost: the expected transmissions over the link to the next hop, from the
+ * neighbour table, plus ROUTE_HOP_COST for each hop past it. The cost of a stored path follows
+ * the current quality of its link, and a route only moves to another next hop if that path is
+ * ROUTE_SWITCH_MARGIN_PCT cheaper, so routes do not flap between similar paths.
+ *
+ * Each route keeps up to RM_ROUTE_PATHS next hops: the one in use and alternatives ranked by
+ * cost, learned from every copy of the destination's packets, duplicates included, as long as
+ * they come from a neighbour closer to the destination than we are, which can't route through
+ * us. When the next hop in use misses ROUTE_FAILOVER_MISSES ACKs of a frame, failover() moves the
+ * route to the best alternative at once, so the next retransmission already takes it. Paths
+ * expire on their own, a route once it has none left.
+ */
 class RoutingTable
 {
 public:
-    /*
-        Typical LoRa RSSI ranges:
-
-        Excellent: -90 dBm or higher
-        Good: -100 to -90 dBm
-        Fair: -110 to -100 dBm
-        Poor: -120 to -110 dBm
-        Very Poor: Below -120 dBm
-    */
-    //  RSSI typically changes in steps of about 6dB for meaningful signal strength changes
-    static const int8_t RSSI_UPPER_THRESHOLD = 12; // Clear improvement needed to switch
-    static const int8_t RSSI_LOWER_THRESHOLD = 6;  // More tolerant of existing route degradation
+    static const uint16_t CAPACITY = RM_MAX_ROUTES;
+
+    static_assert(CAPACITY > 0 && CAPACITY <= 16384, "RM_MAX_ROUTES must be between 1 and 16384");
 
     static RoutingTable* getInstance();
 
-    // Update or add route based on received packet
-    void updateRoute(const RadioMeshPacket& packet, int8_t rssi);
+#ifdef RM_NATIVE
+    // Native build only: the mesh simulator swaps in one table per simulated node.
+    // Returns the previously installed instance. nullptr creates a new one on next use.
+    static RoutingTable* setInstance(RoutingTable* newInstance);
+#endif
+
+    // Update or add route based on received packet, and the quality of the link it came over
+    void updateRoute(const RadioMeshPacket& packet, int8_t rssi, float snr);
+
+    // Same, from a copy of a packet already received, which may have come over another path.
+    // Copies longer than the path in use only update the neighbour table.
+    void updateRoute(const RadioMeshPacketView& frame, int8_t rssi, float snr);
+
+    // Whether a copy of a packet already received would teach something: a path through its last
+    // hop that is not stored, or not refreshed for ROUTE_PATH_REFRESH_MS, or else a neighbour not
+    // heard for ROUTE_TIMEOUT. It only reads the tables, so the copy's MIC need not be verified
+    // when it returns false.
+    bool canLearnFrom(const RadioMeshPacketView& frame, uint32_t now) const;
+
+    // Add a route to a device a neighbour hears directly, listed in its beacon, if there is none
+    void updateTwoHopRoute(const byte* destId, const byte* neighbor, int8_t rssi);
 
     // Find next hop for destination
     bool findNextHop(const byte* destId, byte* nextHop);
 
+    // Report a frame its next hop never acknowledged. The routes through that hop are dropped
+    // after ROUTE_MAX_ACK_FAILURES frames in a row.
+    void reportAckFailure(const byte* nextHop);
+
+    // Report a frame acknowledged by its next hop
+    void reportAckSuccess(const byte* nextHop);
+
+    // Report a transmission whose ACK timed out, the frame may still be sent again
+    void reportAckMissed(const byte* nextHop);
+
+    // Move the route to a destination off a next hop that missed an ACK, to its best alternative.
+    // Returns true with the next hop now in use if it differs from failedHop, false if the
+    // destination has no other path.
+    bool failover(const byte* destId, const byte* failedHop, byte* nextHop);
+
+    // Number of paths kept to a destination, expired ones included until it is looked up
+    uint8_t getPathCount(const byte* destId);
+
+    // Number of times a route moved to an alternative path after a missed ACK
+    uint32_t getFailovers() const
+    {
+        return failovers;
+    }
+
+    // Cost of the route to a destination in hundredths of a transmission, 0 if there is none
+    uint16_t getRouteCost(const byte* destId);
+
+    NeighborTable& getNeighbors()
+    {
+        return neighbors;
+    }
+
+    // Number of routes stored, expired ones included until they are looked up
+    uint16_t size() const
+    {
+        return count;
+    }
+
     // Debug function to print current routes
     void printRoutes();
 
 private:
+    static const uint16_t NONE = 0xFFFF;
+
+    // Index slots hold entry index + 1, 0 marks an empty slot
+    static const uint32_t INDEX_SIZE = routingIndexSize(2 * CAPACITY);
+    static const uint32_t INDEX_MASK = INDEX_SIZE - 1;
+    static const uint32_t INDEX_SHIFT = 32 - routingIndexBits(INDEX_SIZE);
+
     RoutingTable();
     static RoutingTable* instance;
-    RouteEntry routes[MAX_ROUTES];
+    RouteEntry routes[CAPACITY];
+    // Least recently used order, most recent first. Free entries are chained through next.
+    uint16_t next[CAPACITY];
+    uint16_t previous[CAPACITY];
+    uint16_t head = NONE;
+    uint16_t tail = NONE;
+    uint16_t freeHead = NONE;
+    uint16_t count = 0;
+    uint16_t index[INDEX_SIZE] = {};
+    NeighborTable neighbors;
+    uint32_t failovers = 0;
 
-    int findRoute(const byte* destId);
-    int findEmptySlot();
-    bool isBetterRoute(const RouteEntry& newRoute, const RouteEntry& existingRoute);
+    static uint32_t hashSlot(const byte* destId);
+    int32_t findSlot(const byte* destId) const;
+    int findRoute(const byte* destId) const;
+    int addRoute(const byte* destId);
+    void removeRoute(int route);
+    void touch(int route);
+    void linkFront(int route);
+    void unlink(int route);
+    bool isFeasible(const byte* destId, uint8_t hops) const;
+    void updatePath(const byte* destId, const byte* lastHop, uint8_t hopCount, int8_t rssi);
+    int findPath(const RouteEntry& route, const byte* nextHop) const;
+    void removePath(RouteEntry& route, uint8_t path);
+    void removeExpiredPaths(RouteEntry& route, uint32_t now);
+    void rankPaths(RouteEntry& route);
+    uint16_t getPathCost(const RoutePath& path) const;
+    bool isBetterPath(const RoutePath& newPath, const RoutePath& existingPath) const;
 };
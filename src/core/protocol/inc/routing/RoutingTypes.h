@@ -4,19 +4,44 @@
 #include <common/inc/Definitions.h>
 #include <core/protocol/inc/packet/Packet.h>
 
-// Maximum number of routes to store
-#define MAX_ROUTES 10
+// Maximum number of routes to store. Each route costs 12 bytes per path plus 12 bytes, and 4 to
+// 8 bytes of hash index. The least recently used route is forgotten when a new destination needs
+// one.
+#ifndef RM_MAX_ROUTES
+#define RM_MAX_ROUTES 64
+#endif
+// Next hops kept per destination, the route in use and its ranked alternatives
+#ifndef RM_ROUTE_PATHS
+#define RM_ROUTE_PATHS 3
+#endif
 // Route timeout in milliseconds
 #define ROUTE_TIMEOUT 300000 // 5 minutes
+// A stored path is only learned again from duplicate copies once it is this old, in milliseconds
+#define ROUTE_PATH_REFRESH_MS 60000
+// Frames in a row a next hop may leave unacknowledged before the routes through it are dropped
+#define ROUTE_MAX_ACK_FAILURES 2
+// ACKs a next hop may miss in a row for one frame before its retransmission takes another path
+#define ROUTE_FAILOVER_MISSES 2
+// Cost of each hop past the next one, whose links are not known here, in hundredths of a
+// transmission
+#define ROUTE_HOP_COST 150
+// A route is only replaced by one at least this much cheaper, in percent
+#define ROUTE_SWITCH_MARGIN_PCT 15
 
 // Return value for not found
 #define NOT_FOUND -1
-struct RouteEntry
+struct RoutePath
 {
-    std::array<byte, DEV_ID_LENGTH> destId;    // 8 bytes for device ID
-    std::array<byte, DEV_ID_LENGTH> nextHopId; // 8 bytes for next hop
-    uint8_t hops;                              // 1 byte for hop count
-    int8_t rssi;                               // 1 byte for RSSI
+    std::array<byte, DEV_ID_LENGTH> nextHopId; // 4 bytes for next hop
     uint32_t lastSeen;                         // 4 bytes for timestamp
-    bool active;                               // 1 byte for active flag
+    uint8_t hops;                              // 1 byte for hops past the next hop
+    int8_t rssi;                               // 1 byte for RSSI
+    uint8_t ackFailures;                       // 1 byte for unacknowledged frames in a row
+};
+
+struct RouteEntry
+{
+    std::array<byte, DEV_ID_LENGTH> destId; // 4 bytes for device ID
+    RoutePath paths[RM_ROUTE_PATHS];        // paths[0] is in use, the others by rising cost
+    uint8_t pathCount;                      // 1 byte for the number of paths
 };
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <common/inc/Definitions.h>
+#include <core/protocol/inc/routing/RoutingTable.h>
+
+// Devices kept in the topology graph of a hub, the hub included. Each one costs 24 bytes plus 4 to
+// 8 bytes of hash index. The one heard from least recently is forgotten when a new device is heard.
+#ifndef RM_TOPOLOGY_NODES
+#define RM_TOPOLOGY_NODES 256
+#endif
+// Links kept in the topology graph of a hub. Each one costs 16 bytes. The one observed least
+// recently is forgotten when a new link is observed.
+#ifndef RM_TOPOLOGY_LINKS
+#define RM_TOPOLOGY_LINKS 1024
+#endif
+// A link is only updated in the shortest paths once its cost changed by this much, in percent
+#define TOPOLOGY_COST_CHANGE_PCT 20
+// Time between two scans for links not observed for ROUTE_TIMEOUT, in milliseconds
+#define TOPOLOGY_EXPIRY_SCAN_MS 10000
+
+/**
+ * @struct TopologyStats
+ * @brief Topology graph metrics.
+ */
+struct TopologyStats
+{
+    // Link observations that changed the graph: a link added, removed or whose cost changed
+    uint32_t linkChanges = 0;
+    // Devices whose shortest path was computed again, over all the changes
+    uint32_t nodesSettled = 0;
+    uint32_t nodesEvicted = 0;
+    uint32_t linksEvicted = 0;
+};
+
+/**
+ * @class TopologyGraph
+ * @brief Graph of the links a hub observed, with the shortest path from the hub to every device.
+ *
+ * Every frame a hub receives shows a link from its last hop to the hub, whose cost is measured by
+ * the neighbour table. A frame relayed once also shows the link from its source to the relay, and
+ * a frame relayed more times shows that its source is hopCount - 1 hops away from its last hop.
+ * Such a path is kept as a single link standing for that many hops, so devices out of reach of
+ * the neighbours of the hub are in the graph too, and the paths through them are loose: the
+ * devices between are left to their own routing tables. Beacons heard from neighbours add the
+ * links to the devices they list. Links the hub did not measure cost ROUTE_HOP_COST per hop.
+ *
+ * The shortest paths form a tree rooted at the hub, updated as links change instead of computed
+ * again from scratch. A link added or cheaper only moves the devices it brings closer, found by
+ * Dijkstra's algorithm starting from its ends. A link removed or more expensive only matters if it
+ * is in the tree: the devices below it lose their paths and get the best one through their
+ * neighbours still reached, then Dijkstra's algorithm spreads from them. Small changes of a link
+ * cost, under TOPOLOGY_COST_CHANGE_PCT, are ignored. Links not observed for ROUTE_TIMEOUT expire,
+ * and so do the devices left without a link.
+ *
+ * It is not synchronized, it is used from the device loop. Times are in milliseconds.
+ */
+class TopologyGraph
+{
+public:
+    static const uint16_t MAX_NODES = RM_TOPOLOGY_NODES;
+    static const uint16_t MAX_LINKS = RM_TOPOLOGY_LINKS;
+    // Cost of the path to a device with none
+    static const uint32_t UNREACHABLE = 0xFFFFFFFF;
+
+    static_assert(MAX_NODES >= 2 && MAX_NODES < 0xFFFF, "RM_TOPOLOGY_NODES must be 2 to 65534");
+    static_assert(MAX_LINKS >= 1 && MAX_LINKS < 0xFFFF, "RM_TOPOLOGY_LINKS must be 1 to 65534");
+
+    /**
+     * @brief Create the graph of a hub, holding only the hub
+     * @param hubId ID of the hub, the root of the shortest paths
+     */
+    explicit TopologyGraph(const byte* hubId);
+
+    /**
+     * @brief Record the links a received frame shows
+     * @param sourceId Source of the frame
+     * @param lastHopId Device the hub heard sending the frame
+     * @param hopCount Hop count of the frame, 1 if heard from its source
+     * @param lastHopCost Cost of the link from the last hop to the hub, in hundredths of a
+     * transmission
+     * @param now Current time
+     */
+    void onPacket(const byte* sourceId, const byte* lastHopId, uint8_t hopCount,
+                  uint16_t lastHopCost, uint32_t now);
+
+    /**
+     * @brief Record a device listed in the beacon of a neighbour, which hears it over a good link
+     * @param senderId Neighbour that sent the beacon
+     * @param listedId Device listed in the beacon
+     * @param now Current time
+     */
+    void onBeacon(const byte* senderId, const byte* listedId, uint32_t now);
+
+    /**
+     * @brief Add a link or refresh it, updating the shortest paths if its cost changed
+     * @param a One end of the link
+     * @param b The other end
+     * @param cost Cost of the link, in hundredths of a transmission
+     * @param hops Hops the link stands for, 1 for a link between neighbours
+     * @param now Current time
+     */
+    void updateLink(const byte* a, const byte* b, uint16_t cost, uint8_t hops, uint32_t now);
+
+    /**
+     * @brief Remove a link, updating the shortest paths through it
+     * @param a One end of the link
+     * @param b The other end
+     * @return true if the link was in the graph, false otherwise
+     */
+    bool removeLink(const byte* a, const byte* b);
+
+    /**
+     * @brief Remove the links not observed for ROUTE_TIMEOUT and the devices left without a link.
+     * Scans at most once every TOPOLOGY_EXPIRY_SCAN_MS, so it may be called from every loop.
+     * @param now Current time
+     */
+    void removeExpired(uint32_t now);
+
+    /**
+     * @brief Get the shortest path from the hub to a device
+     * @param destId The device
+     * @param path set to the devices on the path, from the first hop to the device
+     * @return true if the device is reached, false otherwise
+     */
+    bool getPath(const byte* destId, std::vector<std::array<byte, DEV_ID_LENGTH>>* path) const;
+
+    /**
+     * @brief Get the cost of the shortest path from the hub to a device
+     * @param destId The device
+     * @return Cost in hundredths of a transmission, UNREACHABLE if the device is not reached
+     */
+    uint32_t getCost(const byte* destId) const;
+
+    /**
+     * @brief Get the number of hops of the shortest path from the hub to a device
+     * @param destId The device
+     * @return Hops, 0 if the device is not reached
+     */
+    uint8_t getHops(const byte* destId) const;
+
+    // Number of devices in the graph, the hub included
+    uint16_t getNodeCount() const
+    {
+        return nodeCount;
+    }
+
+    // Number of links in the graph
+    uint16_t getLinkCount() const
+    {
+        return linkCount;
+    }
+
+    /**
+     * @brief Get the metrics
+     * @return The metrics
+     */
+    const TopologyStats& getStats() const
+    {
+        return stats;
+    }
+
+    /**
+     * @brief Describe the graph in JSON: the devices with the cost, hops and previous device of
+     * their shortest path, and the links with their cost and hops
+     * @return The JSON text
+     */
+    std::string toJson() const;
+
+private:
+    static const uint16_t NONE = 0xFFFF;
+    static const uint16_t ROOT = 0;
+
+    // Index slots hold node index + 1, 0 marks an empty slot
+    static const uint32_t INDEX_SIZE = routingIndexSize(2 * MAX_NODES);
+    static const uint32_t INDEX_MASK = INDEX_SIZE - 1;
+    static const uint32_t INDEX_SHIFT = 32 - routingIndexBits(INDEX_SIZE);
+
+    struct Node
+    {
+        std::array<byte, DEV_ID_LENGTH> id;
+        uint32_t lastSeen;
+        // Cost of the shortest path from the hub, UNREACHABLE if there is none
+        uint32_t cost;
+        // Previous device on that path, NONE for the hub and the devices not reached
+        uint16_t parent;
+        uint16_t firstLink;
+        // Position in the heap, NONE if not in it
+        uint16_t heapPosition;
+        uint8_t hops;
+        bool used;
+    };
+
+    struct Link
+    {
+        uint16_t ends[2];
+        // Next link of each end, or next free link through next[0]
+        uint16_t next[2];
+        uint32_t lastSeen;
+        uint16_t cost;
+        uint8_t hops;
+        bool used;
+    };
+
+    Node nodes[MAX_NODES];
+    Link links[MAX_LINKS];
+    uint16_t index[INDEX_SIZE] = {};
+    uint16_t freeLink = NONE;
+    uint16_t nodeCount = 0;
+    uint16_t linkCount = 0;
+    uint32_t lastExpiryScan = 0;
+    // Binary min-heap of the devices whose path is being computed, by path cost
+    uint16_t heap[MAX_NODES];
+    uint16_t heapSize = 0;
+    // Devices that lost their path, waiting for a new one
+    uint16_t detached[MAX_NODES];
+    uint16_t detachedCount = 0;
+    TopologyStats stats;
+
+    static uint32_t hashSlot(const byte* id);
+    int32_t findSlot(const byte* id) const;
+    uint16_t findNode(const byte* id) const;
+    uint16_t addNode(const byte* id, uint32_t now, uint16_t keep);
+    void removeNode(uint16_t node);
+    uint16_t findLink(uint16_t a, uint16_t b) const;
+    uint16_t addLink(uint16_t a, uint16_t b, uint32_t now);
+    void unlinkFrom(uint16_t node, uint16_t link);
+    void freeLinkEntry(uint16_t link);
+    void detachLink(uint16_t link);
+    uint16_t other(const Link& link, uint16_t node) const;
+    uint16_t nextOf(const Link& link, uint16_t node) const;
+    void relax(uint16_t from, uint16_t to, const Link& link);
+    void detachSubtree(uint16_t top);
+    void repair();
+    void propagate();
+    void heapPush(uint16_t node);
+    uint16_t heapPop();
+    void siftUp(uint16_t position);
+    void siftDown(uint16_t position);
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <common/inc/Definitions.h>
+#include <core/protocol/inc/packet/Callbacks.h>
+#include <core/protocol/inc/packet/Packet.h>
+
+// Reliable messages kept until their destination acknowledges them, all destinations together.
+// Each slot costs about 240 bytes. Once all are taken, sending more fails with RM_E_QUEUE_FULL. The
+// limit also keeps a hub pushing to many devices from sending more than the channel carries.
+#ifndef RM_RELIABLE_SLOTS
+#define RM_RELIABLE_SLOTS 8
+#endif
+
+// Messages to one destination sent and not acknowledged at once. Further messages wait in their
+// slot until the oldest ones are acknowledged or given up.
+#ifndef RM_RELIABLE_WINDOW
+#define RM_RELIABLE_WINDOW 4
+#endif
+
+// Devices whose sequence numbers are kept, as destinations and as sources. The least recently used
+// one without messages in flight is forgotten when a new device needs an entry.
+#ifndef RM_RELIABLE_PEERS
+#define RM_RELIABLE_PEERS 16
+#endif
+
+// Retransmissions of a message before it is reported undelivered
+#ifndef RM_RELIABLE_RETRIES
+#define RM_RELIABLE_RETRIES 4
+#endif
+
+// Acknowledgement timeout of a destination whose round trip was not measured yet. A message may
+// wait in the transmit queues of several hops, each retransmitting it to the next one.
+#ifndef RM_RELIABLE_INITIAL_TIMEOUT_MS
+#define RM_RELIABLE_INITIAL_TIMEOUT_MS 8000
+#endif
+
+// Bounds of the acknowledgement timeout, retransmission backoff included
+#ifndef RM_RELIABLE_MIN_TIMEOUT_MS
+#define RM_RELIABLE_MIN_TIMEOUT_MS 3000
+#endif
+#ifndef RM_RELIABLE_MAX_TIMEOUT_MS
+#define RM_RELIABLE_MAX_TIMEOUT_MS 60000
+#endif
+
+// Time a destination waits for more messages from the same source before acknowledging, so that
+// a window of messages costs a single acknowledgement
+#ifndef RM_RELIABLE_ACK_DELAY_MS
+#define RM_RELIABLE_ACK_DELAY_MS 500
+#endif
+
+/**
+ * @struct ReliableStats
+ * @brief Reliable message service metrics.
+ */
+struct ReliableStats
+{
+    // Messages accepted for sending
+    uint32_t sent = 0;
+    // Messages acknowledged by their destination
+    uint32_t acknowledged = 0;
+    // Messages given up without an acknowledgement
+    uint32_t failed = 0;
+    uint32_t retransmissions = 0;
+    // Messages handed to the application, each one once
+    uint32_t received = 0;
+    // Copies of messages already received
+    uint32_t duplicates = 0;
+    uint32_t acksSent = 0;
+};
+
+/**
+ * @class ReliableTransfer
+ * @brief End-to-end acknowledged delivery of application messages.
+ *
+ * Messages to a destination are numbered in sequence and carried in RELIABLE_DATA packets. Up to
+ * RM_RELIABLE_WINDOW of them are sent before the oldest is acknowledged (sliding window). The
+ * destination answers with a RELIABLE_ACK holding the next sequence number it expects and a
+ * bitmap of the 32 following ones it already has (selective acknowledgement), so a single ACK
+ * covers a whole window and tells exactly which messages to send again. A message missing below
+ * an acknowledged one is sent again at once; any other is sent again when its timeout expires,
+ * up to RM_RELIABLE_RETRIES times. The timeout follows the measured round trips to the
+ * destination (RFC 6298) and doubles on every retransmission. Up to half a timeout of random wait
+ * is added, so that messages sent together are not sent again together.
+ *
+ * The destination hands each message to the application once: copies of a message it already has
+ * are acknowledged again and dropped. A sender that gives up on a message moves on, and the
+ * destination stops waiting for it once newer messages fall past its bitmap. Sequence numbers
+ * count from 0 in a session the sender draws at random for each destination. A destination that
+ * sees a new session starts over, so a rebooted sender is not taken for a duplicate.
+ *
+ * The service only keeps state, the device sends the packets. Completion callbacks are called
+ * from onAck() and getDue(). Times are in milliseconds. It is not synchronized, it is used from
+ * the device loop.
+ */
+class ReliableTransfer
+{
+public:
+    static const uint8_t SLOTS = RM_RELIABLE_SLOTS;
+    static const uint8_t WINDOW = RM_RELIABLE_WINDOW;
+    static const uint8_t PEERS = RM_RELIABLE_PEERS;
+    // Sequence numbers past the next expected one an ACK reports
+    static const uint8_t SACK_BITS = 32;
+    // RELIABLE_DATA payload: application topic, session, sequence number, application data
+    static const size_t DATA_HEADER_LENGTH = 4;
+    // RELIABLE_ACK payload: session, next expected sequence number, SACK bitmap
+    static const size_t ACK_LENGTH = 7;
+    static const size_t MAX_MESSAGE_LENGTH = MAX_DATA_LENGTH - DATA_HEADER_LENGTH;
+
+    static_assert(WINDOW > 0 && WINDOW <= SACK_BITS, "Reliable window must be between 1 and 32");
+
+    enum class State : uint8_t
+    {
+        FREE,
+        // Waiting for room in the window or for its first transmission
+        QUEUED,
+        // Sent, waiting for the ACK
+        SENT
+    };
+
+    /**
+     * @enum Receipt
+     * @brief What became of a received message.
+     */
+    enum class Receipt : uint8_t
+    {
+        // First copy, for the application
+        NEW,
+        // Already received, acknowledged again
+        DUPLICATE,
+        // No room to track the source, neither delivered nor acknowledged
+        DROPPED
+    };
+
+    /**
+     * @struct Message
+     * @brief A message waiting for the acknowledgement of its destination.
+     */
+    struct Message
+    {
+        std::array<byte, RM_ID_LENGTH> target;
+        uint8_t topic;
+        uint8_t session;
+        uint16_t sequence;
+        byte data[MAX_MESSAGE_LENGTH];
+        size_t length;
+        ReliableSendCallback onComplete;
+        void* context;
+        // Order the messages were accepted in, the oldest goes first
+        uint32_t order;
+        uint32_t sentAt;
+        uint32_t deadline;
+        uint8_t transmissions;
+        // Sent again because a newer message was acknowledged, only once per transmission
+        bool fastRetransmitted;
+        State state;
+
+        /**
+         * @brief Get the RELIABLE_DATA payload carrying the message
+         * @return The payload
+         */
+        std::vector<byte> getPayload() const;
+    };
+
+    /**
+     * @struct Ack
+     * @brief An acknowledgement due to a source.
+     */
+    struct Ack
+    {
+        std::array<byte, RM_ID_LENGTH> target;
+        uint8_t session;
+        uint16_t nextExpected;
+        uint32_t received;
+
+        /**
+         * @brief Get the RELIABLE_ACK payload carrying the acknowledgement
+         * @return The payload
+         */
+        std::vector<byte> getPayload() const;
+    };
+
+    ReliableTransfer();
+
+    /**
+     * @brief Accept a message for sending
+     * @param target Destination of the message, a single device
+     * @param topic Application topic of the message
+     * @param data Application data
+     * @param onComplete Called with the outcome of the message, may be nullptr
+     * @param context Passed to onComplete
+     * @param sequence set to the sequence number of the message, may be nullptr
+     * @return RM_E_NONE if the message was accepted, RM_E_PACKET_TOO_LONG if the data does not
+     * fit, RM_E_QUEUE_FULL if no slot or no device entry is free
+     */
+    int send(const std::array<byte, RM_ID_LENGTH>& target, uint8_t topic,
+             const std::vector<byte>& data, ReliableSendCallback onComplete, void* context,
+             uint16_t* sequence);
+
+    /**
+     * @brief Get a message to send, oldest first
+     *
+     * Messages whose retries are used up are reported with RM_E_DELIVERY_TIMEOUT on the way.
+     *
+     * @param now Current time
+     * @return A message due for its first transmission or a retransmission, nullptr if none is
+     * due. It stays due until onSent() is called with it.
+     */
+    Message* getDue(uint32_t now);
+
+    /**
+     * @brief Record that a message was handed to the radio, and start its ACK timeout
+     * @param message The message
+     * @param now Current time
+     */
+    void onSent(Message* message, uint32_t now);
+
+    /**
+     * @brief Handle an acknowledgement, completing the messages it covers
+     * @param from Device ID of the ACK's sender
+     * @param payload RELIABLE_ACK payload
+     * @param now Current time
+     * @return true if the payload is a valid ACK, false otherwise
+     */
+    bool onAck(const byte* from, const std::vector<byte>& payload, uint32_t now);
+
+    /**
+     * @brief Handle a received message and schedule its acknowledgement
+     * @param from Device ID of the message's source
+     * @param payload RELIABLE_DATA payload
+     * @param now Current time
+     * @param topic set to the application topic of the message
+     * @param data set to the application data of a NEW message
+     * @return What became of the message, DROPPED if the payload is not a valid message
+     */
+    Receipt onData(const byte* from, const std::vector<byte>& payload, uint32_t now,
+                   uint8_t* topic, std::vector<byte>* data);
+
+    /**
+     * @brief Get an acknowledgement whose delay expired
+     * @param now Current time
+     * @param ack set to the acknowledgement, which is no longer due once returned
+     * @return true if an acknowledgement is due, false otherwise
+     */
+    bool getAckDue(uint32_t now, Ack* ack);
+
+    /**
+     * @brief Get when the next retransmission or acknowledgement is due
+     * @param dueAt set to the earliest deadline
+     * @return true if a message waits for its ACK or an ACK is pending, false otherwise
+     */
+    bool getNextDue(uint32_t* dueAt) const;
+
+    /**
+     * @brief Drop every message, unreported, and forget every device
+     */
+    void clear();
+
+    /**
+     * @brief Get the number of messages not completed yet
+     * @return Number of messages
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the metrics
+     * @return The metrics
+     */
+    const ReliableStats& getStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Peer
+    {
+        std::array<byte, RM_ID_LENGTH> id;
+        uint32_t lastUsed;
+        bool used;
+        // As a destination: session and sequence number of the next message, measured round trip
+        bool sending;
+        uint8_t txSession;
+        uint16_t nextSequence;
+        uint32_t srttMs;
+        uint32_t rttvarMs;
+        bool hasRtt;
+        // As a source: next sequence number expected, and which of the 32 following ones arrived
+        bool receiving;
+        uint8_t rxSession;
+        uint16_t nextExpected;
+        uint32_t received;
+        bool ackPending;
+        uint32_t ackDueAt;
+    };
+
+    Message messages[SLOTS];
+    Peer peers[PEERS];
+    uint32_t nextOrder = 0;
+    ReliableStats stats;
+
+    Peer* findPeer(const byte* id);
+    Peer* addPeer(const byte* id, uint32_t now);
+    bool hasMessages(const Peer& peer) const;
+    bool isInWindow(const Message& message) const;
+    uint32_t getTimeout(const Peer& peer, uint8_t transmissions) const;
+    void sampleRtt(Peer& peer, uint32_t rttMs);
+    void complete(Message* message, int err);
+    static void advance(Peer& peer);
+};
@@ -0,0 +1,95 @@
+#include <Crypto.h>
+#include <Curve25519.h>
+#include <SHA256.h>
+#include <cstring>
+
+#include <common/inc/Logger.h>
+#include <core/protocol/inc/crypto/EcdhKeyCache.h>
+
+const uint8_t EcdhKeyCache::KEY_SIZE;
+const uint8_t EcdhKeyCache::SLOTS;
+
+EcdhKeyCache* EcdhKeyCache::instance = nullptr;
+
+EcdhKeyCache* EcdhKeyCache::getInstance()
+{
+    if (!instance) {
+        instance = new EcdhKeyCache();
+    }
+    return instance;
+}
+
+#ifdef RM_NATIVE
+EcdhKeyCache* EcdhKeyCache::setInstance(EcdhKeyCache* newInstance)
+{
+    EcdhKeyCache* previous = instance;
+    instance = newInstance;
+    return previous;
+}
+#endif
+
+bool EcdhKeyCache::deriveKey(const byte* ourPrivateKey, const byte* peerPublicKey, byte* key)
+{
+    if (!hasPrivateKey || memcmp(privateKey, ourPrivateKey, KEY_SIZE) != 0) {
+        // Keys derived from another private key must not be handed out
+        clear();
+        memcpy(privateKey, ourPrivateKey, KEY_SIZE);
+        hasPrivateKey = true;
+    }
+
+    useCounter++;
+
+    Entry* victim = &entries[0];
+    for (Entry& entry : entries) {
+        if (entry.used && memcmp(entry.peerPublicKey, peerPublicKey, KEY_SIZE) == 0) {
+            entry.lastUse = useCounter;
+            memcpy(key, entry.key, KEY_SIZE);
+            return true;
+        }
+        if (!entry.used || (victim->used && entry.lastUse < victim->lastUse)) {
+            victim = &entry;
+        }
+    }
+
+    // Perform ECDH using Curve25519
+    uint8_t sharedSecret[KEY_SIZE];
+    bool ok = Curve25519::eval(sharedSecret, privateKey, peerPublicKey);
+    derivations++;
+    if (!ok) {
+        logerr_ln("Failed to compute Curve25519 shared secret");
+        clean(sharedSecret);
+        return false;
+    }
+
+    // Use SHA256 to derive the key from the shared secret
+    wipe(*victim);
+    SHA256 sha256;
+    sha256.reset();
+    sha256.update(sharedSecret, KEY_SIZE);
+    sha256.finalize(victim->key, KEY_SIZE);
+    clean(sharedSecret);
+
+    memcpy(victim->peerPublicKey, peerPublicKey, KEY_SIZE);
+    victim->lastUse = useCounter;
+    victim->used = true;
+    memcpy(key, victim->key, KEY_SIZE);
+    return true;
+}
+
+void EcdhKeyCache::clear()
+{
+    for (Entry& entry : entries) {
+        wipe(entry);
+    }
+    clean(privateKey);
+    hasPrivateKey = false;
+    useCounter = 0;
+}
+
+void EcdhKeyCache::wipe(Entry& entry)
+{
+    clean(entry.peerPublicKey);
+    clean(entry.key);
+    entry.lastUse = 0;
+    entry.used = false;
+}
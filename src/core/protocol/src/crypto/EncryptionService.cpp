@@ -1,16 +1,16 @@
 #include <common/inc/Logger.h>
 #include <common/utils/Utils.h>
+#include <core/protocol/inc/crypto/EcdhKeyCache.h>
 #include <core/protocol/inc/crypto/EncryptionService.h>
-#include <core/protocol/inc/crypto/aes/AesCrypto.h>
 #include <Arduino.h>
 #include <Crypto.h>
-#include <Curve25519.h>
-#include <SHA256.h>
 
+// Initial counter block when the caller has no per-packet nonce (protocol version 4)
+static const byte ZERO_IV[AesCtrCipherCache::IV_SIZE] = {0};
 
 std::vector<byte> EncryptionService::encrypt(const std::vector<byte>& data, uint8_t topic,
                                              MeshDeviceType deviceType,
-                                             DeviceInclusionState inclusionState)
+                                             DeviceInclusionState inclusionState, const byte* iv)
 {
     EncryptionMethod method = determineCryptoMethod(topic, deviceType, inclusionState);
 
@@ -32,7 +32,7 @@ std::vector<byte> EncryptionService::encrypt(const std::vector<byte>& data, uint
             return data;
         }
         logdbg_ln("Encrypting with direct ECC for topic 0x%02X, key size=%d", topic, key.size());
-        return encryptDirectECC(data, key);
+        return encryptDirectECC(data, key, iv);
     }
 
     case EncryptionMethod::AES: {
@@ -41,7 +41,7 @@ std::vector<byte> EncryptionService::encrypt(const std::vector<byte>& data, uint
             logerr_ln("No AES key available for topic 0x%02X", topic);
             return data;
         }
-        return encryptAES(data, key);
+        return encryptAES(data, key, iv);
     }
 
     default:
@@ -50,9 +50,62 @@ std::vector<byte> EncryptionService::encrypt(const std::vector<byte>& data, uint
     }
 }
 
+void EncryptionService::encryptInPlace(byte* data, size_t length, uint8_t topic,
+                                       MeshDeviceType deviceType,
+                                       DeviceInclusionState inclusionState, const byte* iv)
+{
+    if (length == 0) {
+        return;
+    }
+
+    EncryptionMethod method = determineCryptoMethod(topic, deviceType, inclusionState);
+
+    switch (method) {
+    case EncryptionMethod::NONE:
+        logdbg_ln("No encryption for topic 0x%02X", topic);
+        return;
+
+    case EncryptionMethod::DIRECT_ECC: {
+        std::vector<byte> key;
+        if (!deriveDirectECCKey(devicePrivateKey, getEncryptionKey(method, topic, deviceType),
+                                key)) {
+            logerr_ln("No direct ECC key available for topic 0x%02X, deviceType=%d", topic,
+                      (int)deviceType);
+            return;
+        }
+        encryptAESInPlace(data, length, key, iv);
+        return;
+    }
+
+    case EncryptionMethod::AES:
+        if (networkKey.empty()) {
+            logerr_ln("No AES key available for topic 0x%02X", topic);
+            return;
+        }
+        encryptAESInPlace(data, length, networkKey, iv);
+        return;
+
+    default:
+        logerr_ln("Unknown encryption method for topic 0x%02X", topic);
+        return;
+    }
+}
+
+bool EncryptionService::precomputeKeystream(uint8_t topic, MeshDeviceType deviceType,
+                                            DeviceInclusionState inclusionState, const byte* iv,
+                                            size_t length)
+{
+    // Only the network key is known ahead of time
+    if (determineCryptoMethod(topic, deviceType, inclusionState) != EncryptionMethod::AES ||
+        networkKey.empty()) {
+        return false;
+    }
+    return ctrCache.precompute(networkKey.data(), networkKey.size(), iv, length);
+}
+
 std::vector<byte> EncryptionService::decrypt(const std::vector<byte>& data, uint8_t topic,
                                              MeshDeviceType deviceType,
-                                             DeviceInclusionState inclusionState)
+                                             DeviceInclusionState inclusionState, const byte* iv)
 {
     if (data.empty()) {
         return data;
@@ -71,7 +124,7 @@ std::vector<byte> EncryptionService::decrypt(const std::vector<byte>& data, uint
             logerr_ln("No direct ECC key available for topic 0x%02X", topic);
             return data;
         }
-        return decryptDirectECC(data, key);
+        return decryptDirectECC(data, key, iv);
     }
 
     case EncryptionMethod::AES: {
@@ -80,7 +133,7 @@ std::vector<byte> EncryptionService::decrypt(const std::vector<byte>& data, uint
             logerr_ln("No AES key available for topic 0x%02X", topic);
             return data;
         }
-        return decryptAES(data, key);
+        return decryptAES(data, key, iv);
     }
 
     default:
@@ -91,6 +144,10 @@ std::vector<byte> EncryptionService::decrypt(const std::vector<byte>& data, uint
 
 void EncryptionService::setNetworkKey(const std::vector<byte>& key)
 {
+    if (key != networkKey) {
+        // Don't keep the schedule of a replaced key around
+        ctrCache.clear();
+    }
     networkKey = key;
     logdbg_ln("Network key set for EncryptionService");
 }
@@ -244,39 +301,16 @@ std::vector<byte> EncryptionService::getDecryptionKey(EncryptionMethod method, u
 }
 
 std::vector<byte> EncryptionService::encryptDirectECC(const std::vector<byte>& data,
-                                                      const std::vector<byte>& publicKey)
+                                                      const std::vector<byte>& publicKey,
+                                                      const byte* iv)
 {
-    if (publicKey.size() != 32) {
-        logerr_ln("Invalid public key size for Curve25519: %d (expected 32)", publicKey.size());
+    std::vector<byte> keyVector;
+    if (!deriveDirectECCKey(devicePrivateKey, publicKey, keyVector)) {
         return data;
     }
 
-    if (devicePrivateKey.size() != 32) {
-        logerr_ln("Device private key not set for direct ECC encryption");
-        return data;
-    }
-
-
-    // Perform ECDH using Curve25519
-    uint8_t sharedSecret[32];
-    if (!Curve25519::eval(sharedSecret, devicePrivateKey.data(), publicKey.data())) {
-        logerr_ln("Failed to compute Curve25519 shared secret for direct ECC");
-        return data;
-    }
-
-
-    // Use SHA256 to derive encryption key from shared secret
-    SHA256 sha256;
-    sha256.reset();
-    sha256.update(sharedSecret, 32);
-    uint8_t encryptionKey[32];
-    sha256.finalize(encryptionKey, 32);
-
-    // Convert to vector for AES encryption
-    std::vector<byte> keyVector(encryptionKey, encryptionKey + 32);
-
     // Encrypt data with AES using derived key - ZERO OVERHEAD!
-    std::vector<byte> encryptedData = encryptAES(data, keyVector);
+    std::vector<byte> encryptedData = encryptAES(data, keyVector, iv);
     if (encryptedData.empty()) {
         logerr_ln("Failed to encrypt data with Curve25519 ECC");
         return data;
@@ -289,8 +323,33 @@ std::vector<byte> EncryptionService::encryptDirectECC(const std::vector<byte>& d
     return encryptedData;
 }
 
+bool EncryptionService::deriveDirectECCKey(const std::vector<byte>& privateKey,
+                                           const std::vector<byte>& publicKey,
+                                           std::vector<byte>& key)
+{
+    if (publicKey.size() != 32) {
+        logerr_ln("Invalid public key size for Curve25519: %d (expected 32)", publicKey.size());
+        return false;
+    }
+
+    if (privateKey.size() != 32) {
+        logerr_ln("Device private key not set for direct ECC encryption");
+        return false;
+    }
+
+    // ECDH and SHA256 run once per peer, later calls hit the cache
+    key.resize(EcdhKeyCache::KEY_SIZE);
+    if (!EcdhKeyCache::getInstance()->deriveKey(privateKey.data(), publicKey.data(), key.data())) {
+        logerr_ln("Failed to compute Curve25519 shared secret for direct ECC");
+        key.clear();
+        return false;
+    }
+    return true;
+}
+
 std::vector<byte> EncryptionService::decryptDirectECC(const std::vector<byte>& data,
-                                                      const std::vector<byte>& privateKey)
+                                                      const std::vector<byte>& privateKey,
+                                                      const byte* iv)
 {
     if (data.empty()) {
         logerr_ln("Empty data for direct ECC decryption");
@@ -316,66 +375,42 @@ std::vector<byte> EncryptionService::decryptDirectECC(const std::vector<byte>& d
         return data;
     }
 
-    if (senderPublicKey.size() != 32) {
-        logerr_ln("Invalid sender public key size for Curve25519: %d (expected 32)", senderPublicKey.size());
-        return data;
-    }
-
-
-    // Perform ECDH using Curve25519
-    uint8_t sharedSecret[32];
-    if (!Curve25519::eval(sharedSecret, privateKey.data(), senderPublicKey.data())) {
-        logerr_ln("Failed to compute Curve25519 shared secret for direct ECC decryption");
+    std::vector<byte> keyVector;
+    if (!deriveDirectECCKey(privateKey, senderPublicKey, keyVector)) {
         return data;
     }
 
-
-    // Use SHA256 to derive encryption key from shared secret
-    SHA256 sha256;
-    sha256.reset();
-    sha256.update(sharedSecret, 32);
-    uint8_t encryptionKey[32];
-    sha256.finalize(encryptionKey, 32);
-
-    // Convert to vector for AES decryption
-    std::vector<byte> keyVector(encryptionKey, encryptionKey + 32);
-
     logdbg_ln("Curve25519 ECC decryption: input=%d bytes", data.size());
 
     // Decrypt data with AES using derived key - input data is pure encrypted content
-    return decryptAES(data, keyVector);
+    return decryptAES(data, keyVector, iv);
 }
 
 std::vector<byte> EncryptionService::encryptAES(const std::vector<byte>& data,
-                                                const std::vector<byte>& key)
+                                                const std::vector<byte>& key, const byte* iv)
 {
-    if (!aesCrypto) {
-        aesCrypto = AesCrypto::getInstance();
+    // CTR mode - no padding needed, output size = input size
+    std::vector<byte> encryptedData(data.size());
+    if (!ctrCache.crypt(key.data(), key.size(), iv ? iv : ZERO_IV, data.data(),
+                        encryptedData.data(), data.size())) {
+        return std::vector<byte>();
     }
+    return encryptedData;
+}
 
-    SecurityParams params;
-    params.method = SecurityMethod::AES;
-    params.key = key; // typically the network key
-    params.iv = std::vector<byte>(16, 0);
-
-    aesCrypto->setParams(params);
-
-    // CTR mode - no padding needed, output size = input size
-    return aesCrypto->encrypt(data);
+void EncryptionService::encryptAESInPlace(byte* data, size_t length,
+                                          const std::vector<byte>& key, const byte* iv)
+{
+    ctrCache.crypt(key.data(), key.size(), iv ? iv : ZERO_IV, data, data, length);
 }
 
 std::vector<byte> EncryptionService::decryptAES(const std::vector<byte>& data,
-                                                const std::vector<byte>& key)
+                                                const std::vector<byte>& key, const byte* iv)
 {
-    if (!aesCrypto) {
-        aesCrypto = AesCrypto::getInstance();
+    std::vector<byte> decryptedData(data.size());
+    if (!ctrCache.crypt(key.data(), key.size(), iv ? iv : ZERO_IV, data.data(),
+                        decryptedData.data(), data.size())) {
+        return std::vector<byte>();
     }
-
-    SecurityParams params;
-    params.method = SecurityMethod::AES;
-    params.key = key;
-    params.iv = std::vector<byte>(16, 0);
-
-    aesCrypto->setParams(params);
-    return aesCrypto->decrypt(data);
+    return decryptedData;
 }
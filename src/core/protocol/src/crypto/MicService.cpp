@@ -1,9 +1,8 @@
 #include <core/protocol/inc/crypto/MicService.h>
 #include <core/protocol/inc/crypto/EncryptionService.h>
 #include <core/protocol/inc/packet/Topics.h>
+#include <core/protocol/inc/crypto/EcdhKeyCache.h>
 #include <common/inc/Logger.h>
-#include <Curve25519.h>
-#include <SHA256.h>
 
 MicService::MicService(EncryptionService* encryptionService)
     : encryptionService(encryptionService)
@@ -21,28 +20,40 @@ std::vector<byte> MicService::computePacketMIC(const std::vector<byte>& header,
         return std::vector<byte>();
     }
 
-    std::vector<byte> micKey = getMICKey(topic, deviceType, inclusionState);
-    if (micKey.empty()) {
-        logerr_ln("No MIC key available for topic 0x%02X", topic);
+    if (!beginMIC(topic, deviceType, inclusionState)) {
         return std::vector<byte>();
     }
+    updateMIC(header.data(), header.size());
+    updateMIC(encryptedPayload.data(), encryptedPayload.size());
 
-    // Combine header and encrypted payload for MIC computation
-    std::vector<byte> dataToAuthenticate;
-    dataToAuthenticate.reserve(header.size() + encryptedPayload.size());
-    dataToAuthenticate.insert(dataToAuthenticate.end(), header.begin(), header.end());
-    dataToAuthenticate.insert(dataToAuthenticate.end(), encryptedPayload.begin(), encryptedPayload.end());
-
-    std::vector<byte> mic = AesCmac::computeMIC(micKey, dataToAuthenticate);
-    if (mic.size() != 4) {
+    std::vector<byte> mic(MIC_SIZE);
+    if (!finalizeMIC(mic.data())) {
         logerr_ln("Failed to compute MIC for topic 0x%02X", topic);
         return std::vector<byte>();
     }
 
-    logdbg_ln("Computed MIC for topic 0x%02X, data size=%d", topic, dataToAuthenticate.size());
+    logdbg_ln("Computed MIC for topic 0x%02X, data size=%d", topic,
+              header.size() + encryptedPayload.size());
     return mic;
 }
 
+bool MicService::computePacketMIC(const byte* data, size_t length, uint8_t topic,
+                                  MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                                  byte* mic)
+{
+    if (!beginMIC(topic, deviceType, inclusionState)) {
+        return false;
+    }
+    updateMIC(data, length);
+    if (!finalizeMIC(mic)) {
+        logerr_ln("Failed to compute MIC for topic 0x%02X", topic);
+        return false;
+    }
+
+    logdbg_ln("Computed MIC for topic 0x%02X, data size=%d", topic, length);
+    return true;
+}
+
 bool MicService::verifyPacketMIC(const std::vector<byte>& header,
                                 const std::vector<byte>& encryptedPayload,
                                 const std::vector<byte>& receivedMic,
@@ -60,20 +71,13 @@ bool MicService::verifyPacketMIC(const std::vector<byte>& header,
         return false;
     }
 
-    std::vector<byte> micKey = getMICKey(topic, deviceType, inclusionState);
-    if (micKey.empty()) {
-        logerr_ln("No MIC key available for topic 0x%02X verification", topic);
+    if (!beginMIC(topic, deviceType, inclusionState)) {
         return false;
     }
+    updateMIC(header.data(), header.size());
+    updateMIC(encryptedPayload.data(), encryptedPayload.size());
+    bool isValid = verifyMIC(receivedMic.data());
 
-    // Combine header and encrypted payload for MIC verification
-    std::vector<byte> dataToAuthenticate;
-    dataToAuthenticate.reserve(header.size() + encryptedPayload.size());
-    dataToAuthenticate.insert(dataToAuthenticate.end(), header.begin(), header.end());
-    dataToAuthenticate.insert(dataToAuthenticate.end(), encryptedPayload.begin(), encryptedPayload.end());
-
-    bool isValid = AesCmac::verifyMIC(micKey, dataToAuthenticate, receivedMic);
-    
     if (isValid) {
         logdbg_ln("MIC verification passed for topic 0x%02X", topic);
     } else {
@@ -83,6 +87,68 @@ bool MicService::verifyPacketMIC(const std::vector<byte>& header,
     return isValid;
 }
 
+bool MicService::verifyPacketMIC(const RadioMeshPacketView& packet,
+                                 MeshDeviceType deviceType,
+                                 DeviceInclusionState inclusionState)
+{
+    uint8_t topic = packet.getTopic();
+    if (!requiresMIC(topic)) {
+        logdbg_ln("Topic 0x%02X does not require MIC verification", topic);
+        return true;
+    }
+
+    if (!packet.hasMIC()) {
+        logerr_ln("Packet missing MIC for topic 0x%02X", topic);
+        return false;
+    }
+
+    if (!beginMIC(topic, deviceType, inclusionState)) {
+        return false;
+    }
+
+    // Header and payload are authenticated where they are in the frame
+    ByteSpan header = packet.getHeader();
+    ByteSpan payload = packet.getPayload();
+    updateMIC(header.data, header.size);
+    updateMIC(payload.data, payload.size);
+    bool isValid = verifyMIC(packet.getMIC().data);
+
+    if (isValid) {
+        logdbg_ln("MIC verification passed for topic 0x%02X", topic);
+    } else {
+        logerr_ln("MIC verification FAILED for topic 0x%02X", topic);
+    }
+    return isValid;
+}
+
+bool MicService::beginMIC(uint8_t topic, MeshDeviceType deviceType,
+                          DeviceInclusionState inclusionState)
+{
+    const std::vector<byte>& micKey = getMICKey(topic, deviceType, inclusionState);
+    if (micKey.empty()) {
+        logerr_ln("No MIC key available for topic 0x%02X", topic);
+        return false;
+    }
+
+    // The context keeps the expanded key and subkeys while the key stays the same
+    return cmacContext.setKey(micKey.data(), micKey.size());
+}
+
+void MicService::updateMIC(const byte* data, size_t length)
+{
+    cmacContext.update(data, length);
+}
+
+bool MicService::finalizeMIC(byte* mic)
+{
+    return cmacContext.finalize(mic, MIC_SIZE);
+}
+
+bool MicService::verifyMIC(const byte* receivedMic)
+{
+    return cmacContext.verify(receivedMic, MIC_SIZE);
+}
+
 std::vector<byte> MicService::extractMIC(const std::vector<byte>& payloadWithMic)
 {
     if (payloadWithMic.size() < 4) {
@@ -128,24 +194,25 @@ bool MicService::requiresMIC(uint8_t topic)
             topic != MessageTopic::INCLUDE_REQUEST);
 }
 
-std::vector<byte> MicService::getMICKey(uint8_t topic,
-                                       MeshDeviceType deviceType,
-                                       DeviceInclusionState inclusionState)
+const std::vector<byte>& MicService::getMICKey(uint8_t topic,
+                                              MeshDeviceType deviceType,
+                                              DeviceInclusionState inclusionState)
 {
     if (!encryptionService) {
         logerr_ln("EncryptionService not available for MIC key");
-        return std::vector<byte>();
+        return noKey;
     }
 
     switch (topic) {
     case MessageTopic::INCLUDE_OPEN:
     case MessageTopic::INCLUDE_REQUEST:
         // No MIC for cleartext public key exchange messages
-        return std::vector<byte>();
+        return noKey;
 
     case MessageTopic::INCLUDE_RESPONSE:
         // Use ECIES k_mac from ECDH
-        return getECIESMacKey(topic, deviceType);
+        eciesMacKey = getECIESMacKey(topic, deviceType);
+        return eciesMacKey;
 
     case MessageTopic::INCLUDE_CONFIRM:
     case MessageTopic::INCLUDE_SUCCESS:
@@ -160,7 +227,7 @@ std::vector<byte> MicService::getMICKey(uint8_t topic,
         }
         
         logerr_ln("Device not included, cannot get network key for MIC");
-        return std::vector<byte>();
+        return noKey;
     }
 }
 
@@ -204,20 +271,14 @@ std::vector<byte> MicService::getECIESMacKey(uint8_t topic, MeshDeviceType devic
         return std::vector<byte>();
     }
 
-    // Perform ECDH to get shared secret
-    uint8_t sharedSecret[32];
-    if (!Curve25519::eval(sharedSecret, privateKey.data(), publicKey.data())) {
+    // k_mac is SHA256 of the ECDH shared secret, same as EncryptionService, and is shared with
+    // it through the ECDH cache
+    std::vector<byte> kmac(EcdhKeyCache::KEY_SIZE);
+    if (!EcdhKeyCache::getInstance()->deriveKey(privateKey.data(), publicKey.data(), kmac.data())) {
         logerr_ln("Failed to compute ECDH shared secret for MIC key");
         return std::vector<byte>();
     }
 
-    // Derive k_mac using SHA256 (same as EncryptionService)
-    SHA256 sha256;
-    sha256.reset();
-    sha256.update(sharedSecret, 32);
-    uint8_t kmac[32];
-    sha256.finalize(kmac, 32);
-
     logdbg_ln("Derived ECIES k_mac for topic 0x%02X", topic);
-    return std::vector<byte>(kmac, kmac + 32);
+    return kmac;
 }
\ No newline at end of file
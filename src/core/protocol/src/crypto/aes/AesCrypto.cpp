@@ -61,6 +61,17 @@ std::vector<byte> AesCrypto::encrypt(const std::vector<byte>& clearData)
     return encryptedData;
 }
 
+void AesCrypto::encryptInPlace(byte* data, size_t length)
+{
+    ctraes256.clear();
+    ctraes256.setKey(this->securityParams.key.data(), AES_KEY_SIZE);
+    ctraes256.setIV(this->securityParams.iv.data(), AES_IV_SIZE);
+    ctraes256.setCounterSize(AES_COUNTER_SIZE);
+
+    // CTR XORs the key stream into the data, so input and output may be the same buffer
+    ctraes256.encrypt(data, data, length);
+}
+
 std::vector<byte> AesCrypto::decrypt(const std::vector<byte>& encryptedData)
 {
     size_t size = encryptedData.size();
@@ -0,0 +1,112 @@
+#include <Crypto.h>
+#include <cstring>
+
+#include <common/inc/Logger.h>
+#include <core/protocol/inc/crypto/aes/AesCtrCipherCache.h>
+
+const uint8_t AesCtrCipherCache::KEY_SIZE;
+const uint8_t AesCtrCipherCache::IV_SIZE;
+const uint8_t AesCtrCipherCache::COUNTER_SIZE;
+const uint8_t AesCtrCipherCache::SLOTS;
+const size_t AesCtrCipherCache::KEYSTREAM_SIZE;
+
+AesCtrCipherCache::~AesCtrCipherCache()
+{
+    clear();
+}
+
+bool AesCtrCipherCache::crypt(const byte* key, size_t keyLength, const byte* iv,
+                              const byte* input, byte* output, size_t length)
+{
+    if (keyLength != KEY_SIZE) {
+        logerr_ln("ERROR: Invalid key size %d", keyLength);
+        return false;
+    }
+
+    Slot* slot = getCipher(key);
+
+    // A precomputed key stream serves the one message it was generated for
+    if (keystreamSlot == slot && length <= keystreamLength &&
+        memcmp(keystreamIv, iv, IV_SIZE) == 0) {
+        for (size_t i = 0; i < length; i++) {
+            output[i] = input[i] ^ keystream[i];
+        }
+        clearKeystream();
+        keystreamUses++;
+        return true;
+    }
+
+    // Only the counter block changes from one packet to the next
+    slot->cipher.setIV(iv, IV_SIZE);
+    slot->cipher.setCounterSize(COUNTER_SIZE);
+    slot->cipher.encrypt(output, input, length);
+    return true;
+}
+
+bool AesCtrCipherCache::precompute(const byte* key, size_t keyLength, const byte* iv,
+                                   size_t length)
+{
+    if (keyLength != KEY_SIZE || length > KEYSTREAM_SIZE) {
+        logerr_ln("ERROR: Invalid key stream request, key size %d, length %d", keyLength, length);
+        return false;
+    }
+
+    Slot* slot = getCipher(key);
+
+    // Encrypting zeros gives the key stream
+    memset(keystream, 0, length);
+    slot->cipher.setIV(iv, IV_SIZE);
+    slot->cipher.setCounterSize(COUNTER_SIZE);
+    slot->cipher.encrypt(keystream, keystream, length);
+    memcpy(keystreamIv, iv, IV_SIZE);
+    keystreamLength = length;
+    keystreamSlot = slot;
+    return true;
+}
+
+void AesCtrCipherCache::clear()
+{
+    clearKeystream();
+    for (Slot& slot : slots) {
+        slot.cipher.clear();
+        clean(slot.key, sizeof(slot.key));
+        slot.lastUse = 0;
+        slot.used = false;
+    }
+    useCounter = 0;
+}
+
+AesCtrCipherCache::Slot* AesCtrCipherCache::getCipher(const byte* key)
+{
+    useCounter++;
+
+    Slot* victim = &slots[0];
+    for (Slot& slot : slots) {
+        if (slot.used && memcmp(slot.key, key, KEY_SIZE) == 0) {
+            slot.lastUse = useCounter;
+            return &slot;
+        }
+        if (!slot.used || (victim->used && slot.lastUse < victim->lastUse)) {
+            victim = &slot;
+        }
+    }
+
+    if (keystreamSlot == victim) {
+        clearKeystream();
+    }
+    victim->cipher.clear();
+    victim->cipher.setKey(key, KEY_SIZE);
+    memcpy(victim->key, key, KEY_SIZE);
+    victim->lastUse = useCounter;
+    victim->used = true;
+    keyExpansions++;
+    return victim;
+}
+
+void AesCtrCipherCache::clearKeystream()
+{
+    clean(keystream, sizeof(keystream));
+    clean(keystreamIv, sizeof(keystreamIv));
+    keystreamLength = 0;
+    keystreamSlot = nullptr;
+}
@@ -0,0 +1,164 @@
+#include <core/protocol/inc/crypto/cmac/AesCmacContext.h>
+#include <common/inc/Logger.h>
+#include <Crypto.h>
+#include <cstring>
+
+const uint8_t AesCmacContext::BLOCK_SIZE;
+const uint8_t AesCmacContext::MAX_KEY_SIZE;
+
+AesCmacContext::~AesCmacContext()
+{
+    clear();
+}
+
+bool AesCmacContext::setKey(const byte* newKey, size_t length)
+{
+    if (aes != nullptr && length == keyLength && memcmp(key, newKey, length) == 0) {
+        begin();
+        return true;
+    }
+
+    clear();
+    if (length == 16) {
+        aes = &aes128;
+    } else if (length == 32) {
+        aes = &aes256;
+    } else {
+        logerr_ln("Invalid AES key size for CMAC: %d", length);
+        return false;
+    }
+    aes->setKey(newKey, length);
+    memcpy(key, newKey, length);
+    keyLength = length;
+
+    // Subkeys: L = AES(K, 0), K1 = L << 1, K2 = K1 << 1 (RFC 4493 section 2.3)
+    aes->encryptBlock(k1, k1);
+    deriveSubkey(k1);
+    memcpy(k2, k1, BLOCK_SIZE);
+    deriveSubkey(k2);
+
+    begin();
+    return true;
+}
+
+void AesCmacContext::begin()
+{
+    memset(chain, 0, BLOCK_SIZE);
+    pendingLength = 0;
+}
+
+void AesCmacContext::update(const byte* data, size_t length)
+{
+    if (length == 0) {
+        return;
+    }
+
+    // Top up the held back block. It is only chained once we know it is not the last one.
+    if (pendingLength > 0 || length <= BLOCK_SIZE) {
+        size_t count = BLOCK_SIZE - pendingLength;
+        if (count > length) {
+            count = length;
+        }
+        memcpy(pending + pendingLength, data, count);
+        pendingLength += count;
+        data += count;
+        length -= count;
+        if (length == 0) {
+            return;
+        }
+        processBlock(pending);
+        pendingLength = 0;
+    }
+
+    // Chain full blocks straight from the input, keeping the last one (full or partial) back
+    while (length > BLOCK_SIZE) {
+        processBlock(data);
+        data += BLOCK_SIZE;
+        length -= BLOCK_SIZE;
+    }
+    memcpy(pending, data, length);
+    pendingLength = length;
+}
+
+bool AesCmacContext::finalize(byte* mac, size_t length)
+{
+    if (aes == nullptr) {
+        logerr_ln("CMAC context has no key");
+        return false;
+    }
+    if (length > BLOCK_SIZE) {
+        logerr_ln("Invalid CMAC output length: %d", length);
+        return false;
+    }
+
+    // The last block is the final complete block (XOR K1), or the padded remainder (XOR K2).
+    // Empty data is one padded block.
+    const byte* subkey = k1;
+    if (pendingLength < BLOCK_SIZE) {
+        pending[pendingLength] = 0x80;
+        memset(pending + pendingLength + 1, 0, BLOCK_SIZE - pendingLength - 1);
+        subkey = k2;
+    }
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        chain[i] ^= pending[i] ^ subkey[i];
+    }
+    aes->encryptBlock(chain, chain);
+    memcpy(mac, chain, length);
+
+    begin();
+    clean(pending, BLOCK_SIZE);
+    return true;
+}
+
+bool AesCmacContext::verify(const byte* expected, size_t length)
+{
+    byte computed[BLOCK_SIZE];
+    if (!finalize(computed, length)) {
+        return false;
+    }
+
+    // Constant-time comparison to prevent timing attacks
+    byte diff = 0;
+    for (size_t i = 0; i < length; i++) {
+        diff |= computed[i] ^ expected[i];
+    }
+    clean(computed, sizeof(computed));
+    return diff == 0;
+}
+
+void AesCmacContext::clear()
+{
+    aes128.clear();
+    aes256.clear();
+    aes = nullptr;
+    clean(key, sizeof(key));
+    keyLength = 0;
+    clean(k1, sizeof(k1));
+    clean(k2, sizeof(k2));
+    clean(chain, sizeof(chain));
+    clean(pending, sizeof(pending));
+    pendingLength = 0;
+}
+
+void AesCmacContext::processBlock(const byte* block)
+{
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        chain[i] ^= block[i];
+    }
+    aes->encryptBlock(chain, chain);
+}
+
+void AesCmacContext::deriveSubkey(byte* block)
+{
+    bool msb = (block[0] & 0x80) != 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        block[i] = (block[i] << 1);
+        if (i + 1 < BLOCK_SIZE && (block[i + 1] & 0x80)) {
+            block[i] |= 0x01;
+        }
+    }
+    if (msb) {
+        // MSB was 1, XOR with Rb
+        block[BLOCK_SIZE - 1] ^= 0x87;
+    }
+}
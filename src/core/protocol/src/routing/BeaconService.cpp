@@ -0,0 +1,174 @@
+#include <Arduino.h>
+#include <algorithm>
+
+#include <common/utils/Utils.h>
+#include <core/protocol/inc/routing/BeaconService.h>
+#include <core/protocol/inc/routing/RoutingTypes.h>
+
+const uint32_t BeaconService::MIN_INTERVAL_MS;
+const uint32_t BeaconService::MAX_INTERVAL_MS;
+const uint8_t BeaconService::MAX_NEIGHBORS;
+const uint16_t BeaconService::MAX_LISTED_LINK_COST;
+
+BeaconService::BeaconService()
+{
+}
+
+void BeaconService::start(uint32_t now)
+{
+    enabled = true;
+    answerPending = false;
+    interval = MIN_INTERVAL_MS;
+    startInterval(now);
+}
+
+void BeaconService::stop()
+{
+    enabled = false;
+    answerPending = false;
+}
+
+void BeaconService::checkNeighbors(const NeighborTable& neighbors, uint32_t now)
+{
+    // Only a neighbour added or forgotten changes the list much, the links of the others are
+    // looked at again then
+    if (!enabled || neighbors.getVersion() == neighborVersion) {
+        return;
+    }
+    neighborVersion = neighbors.getVersion();
+    uint32_t listed = digest(buildPayload(neighbors, now));
+    if (listed != listDigest) {
+        listDigest = listed;
+        reset(now);
+    }
+}
+
+bool BeaconService::isDue(uint32_t now, uint8_t* topic)
+{
+    if (!enabled) {
+        return false;
+    }
+    while (static_cast<int32_t>(now - (intervalStart + interval)) >= 0) {
+        // Nothing changed during the interval, the next one is twice as long
+        uint32_t end = intervalStart + interval;
+        interval = std::min(interval * 2, MAX_INTERVAL_MS);
+        startInterval(end);
+    }
+    if (answerPending && static_cast<int32_t>(now - answerAt) >= 0) {
+        *topic = MessageTopic::PONG;
+        return true;
+    }
+    if (fired || static_cast<int32_t>(now - fireAt) < 0) {
+        return false;
+    }
+    if (heard >= RM_BEACON_REDUNDANCY) {
+        fired = true;
+        stats.suppressed++;
+        return false;
+    }
+    *topic = MessageTopic::PING;
+    return true;
+}
+
+void BeaconService::onSent()
+{
+    // An answer stands for the beacon of the interval, and a beacon for the answer
+    answerPending = false;
+    fired = true;
+    stats.sent++;
+}
+
+std::vector<byte> BeaconService::buildPayload(const NeighborTable& neighbors, uint32_t now) const
+{
+    struct Candidate
+    {
+        const NeighborTable::Neighbor* neighbor;
+        uint16_t cost;
+    };
+    Candidate candidates[NeighborTable::CAPACITY];
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < NeighborTable::CAPACITY; i++) {
+        const NeighborTable::Neighbor* neighbor = neighbors.get(i);
+        if (neighbor == nullptr || now - neighbor->lastHeard >= ROUTE_TIMEOUT) {
+            continue;
+        }
+        uint16_t cost = neighbors.getLinkCost(neighbor->id.data());
+        if (cost <= MAX_LISTED_LINK_COST) {
+            candidates[count++] = {neighbor, cost};
+        }
+    }
+    std::sort(candidates, candidates + count, [](const Candidate& a, const Candidate& b) {
+        return a.cost != b.cost ? a.cost < b.cost : a.neighbor->id < b.neighbor->id;
+    });
+
+    std::vector<byte> payload;
+    uint8_t listed = std::min(count, MAX_NEIGHBORS);
+    payload.reserve(listed * DEV_ID_LENGTH);
+    for (uint8_t i = 0; i < listed; i++) {
+        const auto& id = candidates[i].neighbor->id;
+        payload.insert(payload.end(), id.begin(), id.end());
+    }
+    return payload;
+}
+
+void BeaconService::onBeacon(uint8_t topic, size_t listed, bool listsUs, uint32_t now)
+{
+    stats.received++;
+    if (!enabled) {
+        return;
+    }
+    if (listsUs && heard < 0xFF) {
+        heard++;
+    }
+    // A device listing nobody just started, it learns its neighbours from the answers
+    if (topic == MessageTopic::PING && listed == 0 && !answerPending) {
+        answerPending = true;
+        answerAt = now + random(RM_BEACON_ANSWER_JITTER_MS + 1);
+    }
+}
+
+bool BeaconService::getNextDue(uint32_t* dueAt) const
+{
+    if (!enabled) {
+        return false;
+    }
+    uint32_t due = intervalStart + interval;
+    if (!fired) {
+        due = fireAt;
+    }
+    if (answerPending && static_cast<int32_t>(answerAt - due) < 0) {
+        due = answerAt;
+    }
+    *dueAt = due;
+    return true;
+}
+
+void BeaconService::startInterval(uint32_t now)
+{
+    // The beacon goes out in the second half, after the neighbours beaconing early were heard
+    intervalStart = now;
+    fireAt = now + interval / 2 + random(interval / 2);
+    heard = 0;
+    fired = false;
+}
+
+void BeaconService::reset(uint32_t now)
+{
+    // At the shortest interval already, the next beacon comes soon anyway
+    if (interval == MIN_INTERVAL_MS) {
+        return;
+    }
+    interval = MIN_INTERVAL_MS;
+    stats.resets++;
+    startInterval(now);
+}
+
+uint32_t BeaconService::digest(const std::vector<byte>& list)
+{
+    // Order independent, a neighbour moving up the list is no change
+    uint32_t sum = 0;
+    for (size_t i = 0; i + DEV_ID_LENGTH <= list.size(); i += DEV_ID_LENGTH) {
+        sum += RadioMeshUtils::toUint32(&list[i]) * 2654435769U;
+    }
+    return sum;
+}
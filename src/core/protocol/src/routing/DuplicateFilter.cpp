@@ -0,0 +1,105 @@
+#include <core/protocol/inc/routing/DuplicateFilter.h>
+
+const uint8_t DuplicateFilter::WINDOW_SIZE;
+const uint8_t DuplicateFilter::MAX_SOURCES;
+const uint32_t DuplicateFilter::SOURCE_TIMEOUT_MS;
+
+DuplicateFilter::DuplicateFilter()
+{
+    clear();
+}
+
+bool DuplicateFilter::isDuplicate(uint32_t sourceId, uint32_t fcounter, uint32_t now) const
+{
+    int index = findSource(sourceId);
+    if (index < 0 || isExpired(sources[index], now)) {
+        return false;
+    }
+
+    const SourceWindow& source = sources[index];
+    if (fcounter > source.highest) {
+        return false;
+    }
+    uint32_t age = source.highest - fcounter;
+    if (age >= WINDOW_SIZE) {
+        // Too old to tell, a device never counts from the start again
+        return true;
+    }
+    return (source.bitmap >> age) & 1;
+}
+
+void DuplicateFilter::markSeen(uint32_t sourceId, uint32_t fcounter, uint32_t now)
+{
+    int index = findSource(sourceId);
+    if (index < 0 || isExpired(sources[index], now)) {
+        if (index < 0) {
+            index = claimSource(now);
+        }
+        sources[index].sourceId = sourceId;
+        sources[index].highest = fcounter;
+        sources[index].bitmap = 1;
+        sources[index].used = true;
+    }
+
+    SourceWindow& source = sources[index];
+    source.lastSeen = now;
+    if (fcounter > source.highest) {
+        uint32_t shift = fcounter - source.highest;
+        source.bitmap = shift < WINDOW_SIZE ? (source.bitmap << shift) | 1 : 1;
+        source.highest = fcounter;
+        return;
+    }
+
+    uint32_t age = source.highest - fcounter;
+    if (age < WINDOW_SIZE) {
+        source.bitmap |= 1ULL << age;
+    }
+}
+
+void DuplicateFilter::clear()
+{
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        sources[i] = {};
+    }
+}
+
+size_t DuplicateFilter::size() const
+{
+    size_t count = 0;
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        if (sources[i].used) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int DuplicateFilter::findSource(uint32_t sourceId) const
+{
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        if (sources[i].used && sources[i].sourceId == sourceId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int DuplicateFilter::claimSource(uint32_t now)
+{
+    // An unused slot, or the source heard from least recently
+    int oldest = 0;
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        if (!sources[i].used) {
+            return i;
+        }
+        if (now - sources[i].lastSeen > now - sources[oldest].lastSeen) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+bool DuplicateFilter::isExpired(const SourceWindow& source, uint32_t now)
+{
+    return now - source.lastSeen >= SOURCE_TIMEOUT_MS;
+}
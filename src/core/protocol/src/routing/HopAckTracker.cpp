@@ -0,0 +1,168 @@
+#include <Arduino.h>
+#include <algorithm>
+#include <cstring>
+
+#include <core/protocol/inc/routing/HopAckTracker.h>
+
+const uint8_t HopAckTracker::SLOTS;
+
+HopAckTracker::HopAckTracker()
+{
+    for (int i = 0; i < SLOTS; i++) {
+        pending[i].state = State::FREE;
+    }
+}
+
+HopAckTracker::PendingAck* HopAckTracker::add(const TxFrame& frame, uint32_t packetKey,
+                                              MeshDeviceType deviceType,
+                                              DeviceInclusionState inclusionState,
+                                              uint32_t frameAirtimeMs, uint32_t ackAirtimeMs)
+{
+    if (frame.length > TxFrame::MAX_LENGTH) {
+        return nullptr;
+    }
+    for (int i = 0; i < SLOTS; i++) {
+        PendingAck& entry = pending[i];
+        if (entry.state != State::FREE) {
+            continue;
+        }
+        memcpy(entry.frame.data, frame.data, frame.length);
+        entry.frame.length = frame.length;
+        entry.frame.priority = frame.priority;
+        entry.frame.onComplete = frame.onComplete;
+        entry.frame.context = frame.context;
+        entry.packetKey = packetKey;
+        std::copy_n(frame.data + NEXT_HOP_POS, DEV_ID_LENGTH, entry.nextHopId.begin());
+        entry.deviceType = deviceType;
+        entry.inclusionState = inclusionState;
+        // The next hop may be sending a frame as long as ours before its ACK can go out
+        entry.initialTimeoutMs = frameAirtimeMs + 2 * ackAirtimeMs + RM_HOP_ACK_GUARD_MS;
+        entry.minTimeoutMs = ackAirtimeMs + RM_HOP_ACK_GUARD_MS;
+        entry.sentAt = 0;
+        entry.deadline = 0;
+        entry.transmissions = 1;
+        entry.acked = false;
+        entry.state = State::SENDING;
+        return &entry;
+    }
+    return nullptr;
+}
+
+bool HopAckTracker::onSent(PendingAck* entry, uint32_t now)
+{
+    if (entry->acked) {
+        return true;
+    }
+    entry->sentAt = now;
+    // Random extra wait, so that neighbours retransmitting into each other fall out of step
+    uint32_t timeout = getTimeout(*entry);
+    entry->deadline = now + timeout + random(timeout / 2 + 1);
+    entry->state = State::WAITING;
+    return false;
+}
+
+HopAckTracker::PendingAck* HopAckTracker::onAck(uint32_t packetKey, const byte* fromId,
+                                                uint32_t now)
+{
+    for (int i = 0; i < SLOTS; i++) {
+        PendingAck& entry = pending[i];
+        if (entry.state == State::FREE || entry.acked || entry.packetKey != packetKey ||
+            !std::equal(entry.nextHopId.begin(), entry.nextHopId.end(), fromId)) {
+            continue;
+        }
+        if (entry.state == State::WAITING && entry.transmissions == 1) {
+            sampleRtt(now - entry.sentAt);
+        }
+        entry.acked = true;
+        stats.acked++;
+        return &entry;
+    }
+    return nullptr;
+}
+
+HopAckTracker::PendingAck* HopAckTracker::getExpired(uint32_t now)
+{
+    for (int i = 0; i < SLOTS; i++) {
+        PendingAck& entry = pending[i];
+        if (entry.state == State::WAITING && static_cast<int32_t>(now - entry.deadline) >= 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void HopAckTracker::onRetransmit(PendingAck* entry)
+{
+    entry->transmissions++;
+    entry->state = State::SENDING;
+    stats.retransmissions++;
+}
+
+bool HopAckTracker::getNextDue(uint32_t* dueAt) const
+{
+    const PendingAck* next = nullptr;
+    for (int i = 0; i < SLOTS; i++) {
+        const PendingAck& entry = pending[i];
+        if (entry.state == State::WAITING &&
+            (next == nullptr || static_cast<int32_t>(entry.deadline - next->deadline) < 0)) {
+            next = &entry;
+        }
+    }
+    if (next == nullptr) {
+        return false;
+    }
+    *dueAt = next->deadline;
+    return true;
+}
+
+uint32_t HopAckTracker::getTimeout(const PendingAck& entry) const
+{
+    uint32_t timeout = entry.initialTimeoutMs;
+    if (hasRtt) {
+        timeout = std::max(entry.minTimeoutMs, srttMs + 4 * rttvarMs);
+    }
+    // Back off on every retransmission, the hop may be busy rather than gone
+    for (uint8_t i = 1; i < entry.transmissions && timeout < RM_HOP_ACK_MAX_TIMEOUT_MS; i++) {
+        timeout *= 2;
+    }
+    return std::min<uint32_t>(timeout, RM_HOP_ACK_MAX_TIMEOUT_MS);
+}
+
+void HopAckTracker::release(PendingAck* entry)
+{
+    if (!entry->acked) {
+        stats.failures++;
+    }
+    entry->state = State::FREE;
+}
+
+size_t HopAckTracker::size() const
+{
+    size_t count = 0;
+    for (int i = 0; i < SLOTS; i++) {
+        if (pending[i].state != State::FREE) {
+            count++;
+        }
+    }
+    return count;
+}
+
+HopAckStats HopAckTracker::getStats() const
+{
+    HopAckStats current = stats;
+    current.smoothedRttMs = srttMs;
+    return current;
+}
+
+void HopAckTracker::sampleRtt(uint32_t rttMs)
+{
+    if (!hasRtt) {
+        srttMs = rttMs;
+        rttvarMs = rttMs / 2;
+        hasRtt = true;
+        return;
+    }
+    uint32_t deviation = srttMs > rttMs ? srttMs - rttMs : rttMs - srttMs;
+    rttvarMs = (3 * rttvarMs + deviation) / 4;
+    srttMs = (7 * srttMs + rttMs) / 8;
+}
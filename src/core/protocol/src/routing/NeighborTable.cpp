@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+
+#include <core/protocol/inc/routing/NeighborTable.h>
+#include <core/protocol/inc/routing/RoutingTypes.h>
+
+const uint8_t NeighborTable::CAPACITY;
+const uint16_t NeighborTable::MIN_LINK_COST;
+const uint16_t NeighborTable::MAX_LINK_COST;
+const uint16_t NeighborTable::UNKNOWN_LINK_COST;
+
+namespace
+{
+// Delivery ratio of a frame received with these SNR margins over the floor, in quarter dB
+const int16_t LOW_MARGIN = -8;
+const int16_t HIGH_MARGIN = 24;
+const uint16_t LOW_MARGIN_DELIVERY = 50;
+const uint16_t HIGH_MARGIN_DELIVERY = 980;
+
+// Spreading factor of the radio presets
+const uint8_t DEFAULT_SPREADING_FACTOR = 8;
+
+int16_t toQuarterDb(float value)
+{
+    float quarters = std::round(value * 4);
+    return static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, quarters)));
+}
+
+// Exponentially weighted moving average, the new sample weighing 1/8
+int16_t smooth(int16_t average, int16_t sample)
+{
+    return static_cast<int16_t>(average + (sample - average) / 8);
+}
+} // namespace
+
+NeighborTable::NeighborTable()
+{
+    setSpreadingFactor(DEFAULT_SPREADING_FACTOR);
+    clear();
+}
+
+void NeighborTable::setSpreadingFactor(uint8_t spreadingFactor)
+{
+    // Each step of spreading factor lowers the floor by 2.5 dB, from -7.5 dB at SF7
+    snrFloor = -10 * (static_cast<int16_t>(spreadingFactor) - 4);
+}
+
+void NeighborTable::onReceived(const byte* id, int rssi, float snr, uint32_t now)
+{
+    int16_t rssiSample = toQuarterDb(rssi);
+    int16_t snrSample = toQuarterDb(snr);
+    Neighbor* neighbor = findEntry(id);
+    if (neighbor != nullptr) {
+        neighbor->rssi = smooth(neighbor->rssi, rssiSample);
+        neighbor->snr = smooth(neighbor->snr, snrSample);
+        neighbor->lastHeard = now;
+        if (neighbor->frames < 0xFFFF) {
+            neighbor->frames++;
+        }
+        return;
+    }
+
+    // A free entry, or else one gone quiet, or else the worst link if the new one is better
+    neighbor = nullptr;
+    uint16_t worstCost = 0;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        Neighbor& entry = neighbors[i];
+        if (!entry.used || now - entry.lastHeard >= ROUTE_TIMEOUT) {
+            neighbor = &entry;
+            worstCost = MAX_LINK_COST + 1;
+            break;
+        }
+        uint16_t cost = toLinkCost(getDelivery(entry));
+        if (neighbor == nullptr || cost > worstCost) {
+            neighbor = &entry;
+            worstCost = cost;
+        }
+    }
+    if (worstCost <= toLinkCost(getSnrDelivery(snrSample))) {
+        return;
+    }
+    std::copy_n(id, DEV_ID_LENGTH, neighbor->id.begin());
+    neighbor->lastHeard = now;
+    neighbor->rssi = rssiSample;
+    neighbor->snr = snrSample;
+    neighbor->delivery = 0;
+    neighbor->ackSamples = 0;
+    neighbor->frames = 1;
+    neighbor->used = true;
+    version++;
+}
+
+void NeighborTable::onAckResult(const byte* id, bool acked)
+{
+    Neighbor* neighbor = findEntry(id);
+    if (neighbor == nullptr) {
+        return;
+    }
+    if (neighbor->ackSamples == 0) {
+        // The signal based estimate is where the measured one starts from
+        neighbor->delivery = getSnrDelivery(neighbor->snr);
+    }
+    int32_t sample = acked ? 1000 : 0;
+    neighbor->delivery =
+        static_cast<uint16_t>(neighbor->delivery + (sample - neighbor->delivery) / 8);
+    if (neighbor->ackSamples < 0xFFFF) {
+        neighbor->ackSamples++;
+    }
+}
+
+uint16_t NeighborTable::getLinkCost(const byte* id) const
+{
+    const Neighbor* neighbor = find(id);
+    if (neighbor == nullptr) {
+        return UNKNOWN_LINK_COST;
+    }
+    return toLinkCost(getDelivery(*neighbor));
+}
+
+uint16_t NeighborTable::getDelivery(const Neighbor& neighbor) const
+{
+    return neighbor.ackSamples > 0 ? neighbor.delivery : getSnrDelivery(neighbor.snr);
+}
+
+const NeighborTable::Neighbor* NeighborTable::find(const byte* id) const
+{
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (neighbors[i].used &&
+            std::equal(neighbors[i].id.begin(), neighbors[i].id.end(), id)) {
+            return &neighbors[i];
+        }
+    }
+    return nullptr;
+}
+
+const NeighborTable::Neighbor* NeighborTable::get(uint8_t index) const
+{
+    return index < CAPACITY && neighbors[index].used ? &neighbors[index] : nullptr;
+}
+
+uint8_t NeighborTable::size() const
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (neighbors[i].used) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint8_t NeighborTable::countHeard(uint32_t now) const
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (neighbors[i].used && now - neighbors[i].lastHeard < ROUTE_TIMEOUT) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void NeighborTable::clear()
+{
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        neighbors[i].used = false;
+    }
+    version++;
+}
+
+NeighborTable::Neighbor* NeighborTable::findEntry(const byte* id)
+{
+    return const_cast<Neighbor*>(find(id));
+}
+
+uint16_t NeighborTable::toLinkCost(uint32_t delivery)
+{
+    if (delivery * MAX_LINK_COST <= 100000) {
+        return MAX_LINK_COST;
+    }
+    return std::max<uint16_t>(MIN_LINK_COST, static_cast<uint16_t>(100000 / delivery));
+}
+
+uint16_t NeighborTable::getSnrDelivery(int16_t snr) const
+{
+    // Linear between the two margins, squared as the ACK comes back over the same link
+    int32_t margin = std::max<int32_t>(LOW_MARGIN, std::min<int32_t>(HIGH_MARGIN, snr - snrFloor));
+    uint32_t frame = LOW_MARGIN_DELIVERY + (margin - LOW_MARGIN) *
+                                               (HIGH_MARGIN_DELIVERY - LOW_MARGIN_DELIVERY) /
+                                               (HIGH_MARGIN - LOW_MARGIN);
+    return static_cast<uint16_t>(frame * frame / 1000);
+}
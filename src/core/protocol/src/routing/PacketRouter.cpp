@@ -1,3 +1,4 @@
+#include <Arduino.h>
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -7,88 +8,123 @@
 
 PacketRouter* PacketRouter::instance = nullptr;
 
-int PacketRouter::routePacket(RadioMeshPacket packet, const byte* ourDeviceId,
-                              MeshDeviceType deviceType, DeviceInclusionState inclusionState)
+int PacketRouter::routePacket(const RadioMeshPacket& packet, const byte* ourDeviceId,
+                              MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                              TxPriority priority, TxCompleteCallback onComplete, void* context)
 {
-    RadioMeshUtils::CRC32 crc32;
-    RadioMeshPacket packetCopy = packet;
-    uint32_t key = RadioMeshUtils::toUint32(packetCopy.packetId.data());
+    uint32_t key = RadioMeshUtils::toUint32(packet.packetId.data());
 
     loginfo_ln("Routing packet with ID: 0x%X", key);
 
-    if (checkMaxHops(packetCopy)) {
+    if (checkMaxHops(packet.hopCount, key)) {
         return RM_E_MAX_HOPS;
     }
 
-    updateLastHopId(packetCopy, ourDeviceId);
-    loginfo_ln("Routing packet with ID: 0x%X, hop count: %d", key, packetCopy.hopCount);
-
-    routeToNextHop(packetCopy);
+    // Serialize straight into a transmit queue slot, leaving room for the MIC
+    TxFrame* slot = LoraRadio::getInstance()->acquireTxFrame();
+    if (slot == nullptr) {
+        return RM_E_QUEUE_FULL;
+    }
+    byte* frame = slot->data;
+    size_t length = packet.serialize(frame, LoraRadio::TX_FRAME_SIZE - MIC_SIZE);
+    if (length == 0) {
+        logerr_ln("Packet too long to route: %d data bytes", packet.packetData.size());
+        LoraRadio::getInstance()->releaseTxFrame(slot);
+        return RM_E_PACKET_TOO_LONG;
+    }
 
-    packetCopy.reserved.fill(0);
+    updateLastHopId(frame, ourDeviceId);
+    loginfo_ln("Routing packet with ID: 0x%X, hop count: %d", key, frame[HOP_COUNT_POS]);
 
+    routeToNextHop(frame);
 
-    if (packetCopy.topic != MessageTopic::INCLUDE_OPEN) {
-        encryptPacketData(packetCopy, deviceType, inclusionState);
+    if (packet.topic != MessageTopic::INCLUDE_OPEN) {
+        encryptPacketData(frame, length, deviceType, inclusionState);
     }
 
-    // CRC must be computed before MIC: the MIC authenticates the header bytes that are actually
-    // transmitted, and the header includes packetCrc. CRC covers payload-without-MIC; the MIC
-    // provides its own cryptographic integrity over header + encrypted payload.
-    calculatePacketCrc(packetCopy, crc32, key);
+    return sendFrame(slot, length, key, deviceType, inclusionState, priority, onComplete, context);
+}
+
+int PacketRouter::relayFrame(const RadioMeshPacketView& received, const byte* ourDeviceId,
+                             MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                             TxCompleteCallback onComplete, void* context)
+{
+    uint32_t key = received.getPacketIdKey();
+
+    loginfo_ln("Relaying packet with ID: 0x%X", key);
 
-    int micResult = computeAndAppendMIC(packetCopy, deviceType, inclusionState);
-    if (micResult != RM_E_NONE) {
-        return micResult;
+    if (checkMaxHops(received.getHopCount(), key)) {
+        return RM_E_MAX_HOPS;
     }
 
-    int rc = sendPacket(packetCopy);
-    if (rc != RM_E_NONE) {
-        return rc;
+    // Header and encrypted payload, the MIC is recomputed over the patched header
+    ByteSpan data = received.getAuthenticatedData();
+    if (data.size > LoraRadio::TX_FRAME_SIZE - MIC_SIZE) {
+        logerr_ln("Packet too long to relay: %d bytes", data.size);
+        return RM_E_PACKET_TOO_LONG;
+    }
+    TxFrame* slot = LoraRadio::getInstance()->acquireTxFrame();
+    if (slot == nullptr) {
+        return RM_E_QUEUE_FULL;
     }
+    byte* frame = slot->data;
+    memcpy(frame, data.data, data.size);
 
-    trackPacket(packetCopy, key);
+    updateLastHopId(frame, ourDeviceId);
+    loginfo_ln("Relaying packet with ID: 0x%X, hop count: %d", key, frame[HOP_COUNT_POS]);
 
-    return RM_E_NONE;
+    // A hop of a unicast route continues hop by hop and is acknowledged by the next hop. A flood
+    // copy stays a flood: it reaches the destination through many relays at once, tracking an
+    // ACK for each would only add traffic.
+    if (received.hasUnicastNextHop()) {
+        routeToNextHop(frame);
+    }
+
+    return sendFrame(slot, data.size, key, deviceType, inclusionState, TxPriority::RELAY,
+                     onComplete, context);
 }
 
-bool PacketRouter::checkMaxHops(RadioMeshPacket& packetCopy)
+bool PacketRouter::checkMaxHops(uint8_t hopCount, uint32_t key)
 {
-    if (packetCopy.hopCount >= MAX_HOPS) {
-        loginfo_ln("Max hops reached, dropping packet ID: %s",
-                   RadioMeshUtils::convertToHex(packetCopy.packetId.data(), MSG_ID_LENGTH).c_str());
+    if (hopCount >= MAX_HOPS) {
+        loginfo_ln("Max hops reached, dropping packet ID: 0x%X", key);
         return true;
     }
     return false;
 }
 
-void PacketRouter::updateLastHopId(RadioMeshPacket& packetCopy, const byte* ourDeviceId)
+void PacketRouter::updateLastHopId(byte* frame, const byte* ourDeviceId)
 {
-    std::copy_n(ourDeviceId, DEV_ID_LENGTH, packetCopy.lastHopId.begin());
-    packetCopy.hopCount++;
+    std::copy_n(ourDeviceId, DEV_ID_LENGTH, frame + LAST_HOP_ID_POS);
+    frame[HOP_COUNT_POS]++;
+    memset(frame + RESERVED_POS, 0, RESERVED_LENGTH);
 }
 
-void PacketRouter::routeToNextHop(RadioMeshPacket& packetCopy)
+void PacketRouter::routeToNextHop(byte* frame)
 {
-    if (!RadioMeshUtils::isBroadcastAddress(packetCopy.destDevId)) {
-        byte nextHop[DEV_ID_LENGTH];
-        if (RoutingTable::getInstance()->findNextHop(packetCopy.destDevId.data(), nextHop)) {
-            loginfo_ln(
-                "Found route to %s via %s",
-                RadioMeshUtils::convertToHex(packetCopy.destDevId.data(), DEV_ID_LENGTH).c_str(),
-                RadioMeshUtils::convertToHex(nextHop, DEV_ID_LENGTH).c_str());
-            memcpy(packetCopy.nextHopId.data(), nextHop, DEV_ID_LENGTH);
+    std::array<byte, DEV_ID_LENGTH> destDevId;
+    std::copy_n(frame + DDEV_ID_POS, DEV_ID_LENGTH, destDevId.begin());
+
+    if (!RadioMeshUtils::isBroadcastAddress(destDevId)) {
+        byte* nextHop = frame + NEXT_HOP_POS;
+        if (TopicUtils::isAck(frame[TOPIC_POS])) {
+            // Hop ACKs answer the neighbour the frame came from
+            std::copy(destDevId.begin(), destDevId.end(), nextHop);
+        } else if (RoutingTable::getInstance()->findNextHop(destDevId.data(), nextHop)) {
+            loginfo_ln("Found route to %s via %s",
+                       RadioMeshUtils::convertToHex(destDevId.data(), DEV_ID_LENGTH).c_str(),
+                       RadioMeshUtils::convertToHex(nextHop, DEV_ID_LENGTH).c_str());
         } else {
             loginfo_ln("No route found, broadcasting");
-            memset(packetCopy.nextHopId.data(), 0, DEV_ID_LENGTH);
+            memset(nextHop, 0, DEV_ID_LENGTH);
         }
     }
 }
 
-void PacketRouter::encryptPacketData(RadioMeshPacket& packetCopy, MeshDeviceType deviceType,
+void PacketRouter::encryptPacketData(byte* frame, size_t length, MeshDeviceType deviceType,
                                      DeviceInclusionState inclusionState)
 {
-    if (packetCopy.packetData.size() == 0) {
+    if (length <= DATA_POS) {
         return;
     }
 
@@ -96,83 +132,318 @@ void PacketRouter::encryptPacketData(RadioMeshPacket& packetCopy, MeshDeviceType
         logerr_ln("Encryption service not set, cannot encrypt packet data");
         return;
     }
-    packetCopy.packetData = encryptionService->encrypt(packetCopy.packetData, packetCopy.topic,
-                                                       deviceType, inclusionState);
+    // The counter block comes from header fields relays leave untouched
+    byte nonce[PacketNonce::SIZE];
+    PacketNonce::fromHeader(frame, nonce);
+    encryptionService->encryptInPlace(frame + DATA_POS, length - DATA_POS, frame[TOPIC_POS],
+                                      deviceType, inclusionState, nonce);
 }
 
-void PacketRouter::calculatePacketCrc(RadioMeshPacket& packetCopy, RadioMeshUtils::CRC32& crc32,
-                                      uint32_t key)
+uint32_t PacketRouter::calculatePacketCrc(byte* frame, size_t length, uint32_t key)
 {
+    RadioMeshUtils::CRC32 crc32;
+    uint32_t fcounter = RadioMeshUtils::toUint32(frame + FCOUNTER_POS);
+
     loginfo_ln("Calculating packet crc for packet ID: 0x%X", key);
-    loginfo_ln("  Frame Counter: %d", packetCopy.fcounter);
-    loginfo_ln("  Data: %s", RadioMeshUtils::convertToHex(packetCopy.packetData.data(),
-                                                          packetCopy.packetData.size())
-                                 .c_str());
-    crc32.update(packetCopy.fcounter);
-    if (packetCopy.packetData.size() > 0) {
-        crc32.update(packetCopy.packetData.data(), packetCopy.packetData.size());
+    loginfo_ln("  Frame Counter: %d", fcounter);
+    crc32.update(fcounter);
+    if (length > DATA_POS) {
+        crc32.update(frame + DATA_POS, length - DATA_POS);
     }
-    packetCopy.packetCrc = crc32.finalize();
-    std::string pktId =
-        RadioMeshUtils::convertToHex(packetCopy.packetId.data(), packetCopy.packetId.size());
-    loginfo_ln("Routing packet with id: %s crc: 0x%4X", pktId.c_str(), packetCopy.packetCrc);
-    packetCopy.log();
+    uint32_t packetCrc = crc32.finalize();
+    RadioMeshPacket::writeUint32(frame + DATA_CRC_POS, packetCrc);
+    loginfo_ln("Routing packet with id: 0x%X crc: 0x%4X", key, packetCrc);
+    return packetCrc;
 }
 
-int PacketRouter::sendPacket(RadioMeshPacket& packetCopy)
+int PacketRouter::computeAndAppendMIC(byte* frame, size_t& length, MeshDeviceType deviceType,
+                                      DeviceInclusionState inclusionState)
 {
-    std::vector<byte> buffer = packetCopy.toByteBuffer();
-    int rc = LoraRadio::getInstance()->sendPacket(buffer);
+    uint8_t topic = frame[TOPIC_POS];
+
+    if (topic == MessageTopic::INCLUDE_OPEN || topic == MessageTopic::INCLUDE_REQUEST) {
+        return RM_E_NONE;
+    }
+
+    if (!micService) {
+        logerr_ln("CRITICAL: MIC service not available");
+        return RM_E_DEVICE_INITIALIZATION_FAILED;
+    }
+
+    // The MIC covers header and encrypted payload as they sit in the frame
+    if (!micService->computePacketMIC(frame, length, topic, deviceType, inclusionState,
+                                      frame + length)) {
+        logerr_ln("Failed to compute MIC for topic 0x%02X", topic);
+        return RM_E_AUTH_FAILED;
+    }
+
+    length += MIC_SIZE;
+    return RM_E_NONE;
+}
+
+int PacketRouter::sendFrame(TxFrame* slot, size_t length, uint32_t key,
+                            MeshDeviceType deviceType, DeviceInclusionState inclusionState,
+                            TxPriority priority, TxCompleteCallback onComplete, void* context)
+{
+    byte* frame = slot->data;
+
+    // CRC must be computed before MIC: the MIC authenticates the header bytes that are actually
+    // transmitted, and the header includes packetCrc. CRC covers payload-without-MIC; the MIC
+    // provides its own cryptographic integrity over header + encrypted payload.
+    uint32_t packetCrc = calculatePacketCrc(frame, length, key);
+
+    int rc = computeAndAppendMIC(frame, length, deviceType, inclusionState);
+    if (rc != RM_E_NONE) {
+        LoraRadio::getInstance()->releaseTxFrame(slot);
+        return rc;
+    }
+
+    // A unicast hop is kept until the next hop acknowledges it, the sender hears about it then
+    HopAckTracker::PendingAck* pending = nullptr;
+    if (requiresHopAck(RadioMeshPacketView(frame, length))) {
+        pending = trackHopAck(slot, length, key, deviceType, inclusionState, priority, onComplete,
+                              context);
+    }
+    if (pending != nullptr) {
+        onComplete = &PacketRouter::onHopFrameSent;
+        context = pending;
+        slot->replyWindowMs = pending->minTimeoutMs;
+    }
+
+    rc = LoraRadio::getInstance()->queueTxFrame(slot, length, priority, onComplete, context);
     if (rc != RM_E_NONE) {
         logerr_ln("Failed to send packet");
+        if (pending != nullptr) {
+            hopAcks.release(pending);
+        }
+        return rc;
     }
-    return rc;
+
+    trackPacket(frame, length, key, packetCrc);
+
+    return RM_E_NONE;
 }
 
-void PacketRouter::trackPacket(RadioMeshPacket& packetCopy, uint32_t key)
+void PacketRouter::trackPacket(const byte* frame, size_t length, uint32_t key,
+                               uint32_t packetCrc)
 {
-    loginfo_ln("Tracking packet with ID: 0x%X, data crc: 0x%X", key, packetCopy.packetCrc);
-    packetTracker.addEntry(key, packetCopy.packetCrc);
+    loginfo_ln("Tracking packet with ID: 0x%X, data crc: 0x%X", key, packetCrc);
+    packetTracker.addEntry(key, packetCrc);
+
+    // Our own packets coming back from relays are duplicates too
+    markPacketSeen(RadioMeshPacketView(frame, length));
 }
 
-int PacketRouter::computeAndAppendMIC(RadioMeshPacket& packetCopy, MeshDeviceType deviceType,
-                                      DeviceInclusionState inclusionState)
+bool PacketRouter::requiresHopAck(const RadioMeshPacketView& frame)
 {
-    if (!micService) {
-        logerr_ln("CRITICAL: MIC service not available");
-        return RM_E_DEVICE_INITIALIZATION_FAILED;
+    uint8_t topic = frame.getTopic();
+    return (topic > MessageTopic::MAX_RESERVED || topic == MessageTopic::RELIABLE_DATA) &&
+           frame.hasUnicastNextHop();
+}
+
+HopAckTracker::PendingAck* PacketRouter::trackHopAck(TxFrame* slot, size_t length, uint32_t key,
+                                                     MeshDeviceType deviceType,
+                                                     DeviceInclusionState inclusionState,
+                                                     TxPriority priority,
+                                                     TxCompleteCallback onComplete, void* context)
+{
+    LoraRadio* radio = LoraRadio::getInstance();
+    slot->length = length;
+    slot->priority = priority;
+    slot->onComplete = onComplete;
+    slot->context = context;
+    HopAckTracker::PendingAck* pending =
+        hopAcks.add(*slot, key, deviceType, inclusionState, radio->getTimeOnAirMs(length),
+                    radio->getTimeOnAirMs(HOP_ACK_LENGTH));
+    if (pending == nullptr) {
+        logwarn_ln("No room to wait for the ACK of packet 0x%X, sending it unacknowledged", key);
     }
+    return pending;
+}
 
-    if (packetCopy.topic == MessageTopic::INCLUDE_OPEN || 
-        packetCopy.topic == MessageTopic::INCLUDE_REQUEST) {
-        return RM_E_NONE;
+void PacketRouter::onHopFrameSent(const TxFrame& frame, int err, void* context)
+{
+    // Completions are dispatched from the device loop, with this device's router installed
+    PacketRouter* router = getInstance();
+    HopAckTracker::PendingAck* pending = static_cast<HopAckTracker::PendingAck*>(context);
+    if (err == RM_E_RADIO_CHANNEL_BUSY && router->hopAcks.canRetry(*pending)) {
+        // Tried again like a frame that went unacknowledged, once the neighbours quieted down
+        router->hopAcks.onSent(pending, millis());
+        return;
+    }
+    if (err != RM_E_NONE) {
+        // Never made it on air, there is nothing to acknowledge
+        router->completeHopAck(pending, err);
+        return;
+    }
+    if (router->hopAcks.onSent(pending, millis())) {
+        router->completeHopAck(pending, RM_E_NONE);
     }
+}
 
-    std::vector<byte> header = packetCopy.getHeaderBytes();
-    std::vector<byte> encryptedPayload = packetCopy.packetData;
+void PacketRouter::onHopAck(uint32_t packetKey, const byte* fromId)
+{
+    HopAckTracker::PendingAck* pending = hopAcks.onAck(packetKey, fromId, millis());
+    if (pending == nullptr) {
+        logdbg_ln("Unexpected ACK for packet 0x%X", packetKey);
+        return;
+    }
+    loginfo_ln("Packet 0x%X acknowledged by its next hop", packetKey);
+    // Frames queued behind it may go now
+    LoraRadio::getInstance()->endReplyWindow();
+    RoutingTable::getInstance()->reportAckSuccess(fromId);
+    // A retransmission still queued completes once sent
+    if (pending->state == HopAckTracker::State::WAITING) {
+        completeHopAck(pending, RM_E_NONE);
+    }
+}
 
-    std::vector<byte> mic = micService->computePacketMIC(header, encryptedPayload, 
-                                                        packetCopy.topic, deviceType, inclusionState);
-    
-    if (mic.empty()) {
-        logerr_ln("Failed to compute MIC for topic 0x%02X", packetCopy.topic);
-        return RM_E_AUTH_FAILED;
+void PacketRouter::serviceHopAcks()
+{
+    HopAckTracker::PendingAck* pending;
+    while ((pending = hopAcks.getExpired(millis())) != nullptr) {
+        if (hopAcks.canRetry(*pending)) {
+            if (!retransmitHopFrame(pending)) {
+                // Retried on the next run, once queued frames went out
+                return;
+            }
+            RoutingTable::getInstance()->reportAckMissed(pending->nextHopId.data());
+            continue;
+        }
+
+        logwarn_ln("No ACK from %s for packet 0x%X, flooding it",
+                   RadioMeshUtils::convertToHex(pending->nextHopId.data(), DEV_ID_LENGTH).c_str(),
+                   pending->packetKey);
+        RoutingTable::getInstance()->reportAckMissed(pending->nextHopId.data());
+        RoutingTable::getInstance()->reportAckFailure(pending->nextHopId.data());
+        if (floodHopFrame(pending) == RM_E_NONE) {
+            // The flood reports to the sender
+            hopAcks.release(pending);
+        } else {
+            completeHopAck(pending, RM_E_HOP_ACK_TIMEOUT);
+        }
     }
+}
 
-    packetCopy.appendMIC(mic);
-    return RM_E_NONE;
+bool PacketRouter::retransmitHopFrame(HopAckTracker::PendingAck* pending)
+{
+    LoraRadio* radio = LoraRadio::getInstance();
+    TxFrame* slot = radio->acquireTxFrame();
+    if (slot == nullptr) {
+        return false;
+    }
+    rerouteHopFrame(pending);
+    loginfo_ln("Retransmitting packet 0x%X, attempt %d", pending->packetKey,
+               pending->transmissions + 1);
+    memcpy(slot->data, pending->frame.data, pending->frame.length);
+    slot->replyWindowMs = pending->minTimeoutMs;
+    hopAcks.onRetransmit(pending);
+    int rc = radio->queueTxFrame(slot, pending->frame.length, pending->frame.priority,
+                                 &PacketRouter::onHopFrameSent, pending);
+    if (rc != RM_E_NONE) {
+        completeHopAck(pending, rc);
+    }
+    return true;
 }
 
-bool PacketRouter::isPacketFoundInTracker(RadioMeshPacket packet)
+void PacketRouter::rerouteHopFrame(HopAckTracker::PendingAck* pending)
 {
-    uint32_t key = RadioMeshUtils::toUint32(packet.packetId.data());
-    uint32_t value = packet.packetCrc;
+    // After ROUTE_FAILOVER_MISSES missed ACKs the next hop may be gone rather than unlucky, the
+    // retransmission takes the destination's best other path
+    if (pending->transmissions < ROUTE_FAILOVER_MISSES) {
+        return;
+    }
+    byte* frame = pending->frame.data;
+    byte nextHop[DEV_ID_LENGTH];
+    if (!RoutingTable::getInstance()->failover(frame + DDEV_ID_POS, pending->nextHopId.data(),
+                                               nextHop)) {
+        return;
+    }
+    // The header changes, so the frame is authenticated again
+    size_t length = pending->frame.length - MIC_SIZE;
+    std::copy_n(nextHop, DEV_ID_LENGTH, frame + NEXT_HOP_POS);
+    if (computeAndAppendMIC(frame, length, pending->deviceType, pending->inclusionState) !=
+        RM_E_NONE) {
+        // Sent again unchanged
+        std::copy(pending->nextHopId.begin(), pending->nextHopId.end(), frame + NEXT_HOP_POS);
+        computeAndAppendMIC(frame, length, pending->deviceType, pending->inclusionState);
+        return;
+    }
+    loginfo_ln("Packet 0x%X rerouted via %s", pending->packetKey,
+               RadioMeshUtils::convertToHex(nextHop, DEV_ID_LENGTH).c_str());
+    std::copy_n(nextHop, DEV_ID_LENGTH, pending->nextHopId.begin());
+}
 
-    // find the packet ID key in our tracker and compare the data crc.
+int PacketRouter::floodHopFrame(const HopAckTracker::PendingAck* pending)
+{
+    LoraRadio* radio = LoraRadio::getInstance();
+    TxFrame* slot = radio->acquireTxFrame();
+    if (slot == nullptr) {
+        return RM_E_QUEUE_FULL;
+    }
+    // The header changes, so the frame is authenticated again. Its CRC does not cover the header.
+    size_t length = pending->frame.length - MIC_SIZE;
+    memcpy(slot->data, pending->frame.data, length);
+    memset(slot->data + NEXT_HOP_POS, 0, DEV_ID_LENGTH);
+    int rc = computeAndAppendMIC(slot->data, length, pending->deviceType,
+                                 pending->inclusionState);
+    if (rc != RM_E_NONE) {
+        radio->releaseTxFrame(slot);
+        return rc;
+    }
+    return radio->queueTxFrame(slot, length, pending->frame.priority, pending->frame.onComplete,
+                               pending->frame.context);
+}
+
+void PacketRouter::completeHopAck(HopAckTracker::PendingAck* pending, int err)
+{
+    if (pending->frame.onComplete != nullptr) {
+        pending->frame.onComplete(pending->frame, err, pending->frame.context);
+    }
+    hopAcks.release(pending);
+}
+
+bool PacketRouter::isPacketFoundInTracker(const RadioMeshPacket& packet)
+{
+    return isPacketFoundInTracker(packet.topic, RadioMeshUtils::toUint32(packet.sourceDevId.data()),
+                                  packet.fcounter,
+                                  RadioMeshUtils::toUint32(packet.packetId.data()),
+                                  packet.packetCrc);
+}
 
+bool PacketRouter::isPacketFoundInTracker(const RadioMeshPacketView& packet)
+{
+    return isPacketFoundInTracker(packet.getTopic(), packet.getSourceIdKey(),
+                                  packet.getFcounter(), packet.getPacketIdKey(),
+                                  packet.getPacketCrc());
+}
+
+void PacketRouter::markPacketSeen(const RadioMeshPacketView& packet)
+{
+    if (MicService::requiresMIC(packet.getTopic())) {
+        duplicateFilter.markSeen(packet.getSourceIdKey(), packet.getFcounter(), millis());
+    }
+}
+
+void PacketRouter::trackPendingRelay(const RadioMeshPacketView& packet)
+{
+    packetTracker.addEntry(packet.getPacketIdKey(), packet.getPacketCrc());
+}
+
+bool PacketRouter::isPacketFoundInTracker(uint8_t topic, uint32_t sourceId, uint32_t fcounter,
+                                          uint32_t key, uint32_t packetCrc)
+{
+    // Authenticated frames: exact check in the frame counter window of the source
+    if (MicService::requiresMIC(topic) &&
+        duplicateFilter.isDuplicate(sourceId, fcounter, millis())) {
+        loginfo_ln("Packet from [0x%X] with frame counter %u already seen.", sourceId, fcounter);
+        return true;
+    }
+
+    // find the packet ID key in our tracker and compare the data crc.
     uint32_t foundValue = packetTracker.findOrDefault(key, 0);
-    if (foundValue == value) {
-        loginfo_ln("Packet with ID [%s] already seen.", std::to_string(key).c_str());
+    if (foundValue == packetCrc) {
+        loginfo_ln("Packet with ID [0x%X] already seen.", key);
         return true;
     }
     return false;
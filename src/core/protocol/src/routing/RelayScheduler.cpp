@@ -0,0 +1,146 @@
+#include <Arduino.h>
+#include <algorithm>
+#include <cstring>
+
+#include <core/protocol/inc/routing/RelayScheduler.h>
+
+const uint8_t RelayScheduler::SLOTS;
+
+namespace
+{
+// Signal range mapped onto the backoff: LoRa demodulates down to about -20 dB SNR, and SNR stops
+// growing around +10 dB, past which RSSI still tells near from far.
+const float SNR_MIN = -20.0f;
+const float SNR_MAX = 10.0f;
+const float RSSI_MIN = -125.0f;
+const float RSSI_MAX = -50.0f;
+
+float normalize(float value, float min, float max)
+{
+    return std::min(1.0f, std::max(0.0f, (value - min) / (max - min)));
+}
+} // namespace
+
+RelayScheduler::RelayScheduler()
+{
+    clear();
+}
+
+uint32_t RelayScheduler::getSignalBackoff(float rssi, float snr, uint32_t airtimeMs)
+{
+    float quality = (normalize(snr, SNR_MIN, SNR_MAX) + normalize(rssi, RSSI_MIN, RSSI_MAX)) / 2;
+    return static_cast<uint32_t>(quality * RM_RELAY_BACKOFF_SLOTS * airtimeMs);
+}
+
+bool RelayScheduler::schedule(const RadioMeshPacketView& frame, float rssi, float snr,
+                              uint32_t airtimeMs, uint8_t neighbors, uint32_t now)
+{
+    ByteSpan bytes = frame.getFrame();
+    if (bytes.size > PACKET_LENGTH) {
+        return false;
+    }
+    uint32_t packetKey = frame.getPacketIdKey();
+    int free = -1;
+    for (int i = 0; i < SLOTS; i++) {
+        if (relays[i].used && relays[i].packetKey == packetKey) {
+            // Already waiting, a later copy only counts towards suppression
+            return true;
+        }
+        if (!relays[i].used && free < 0) {
+            free = i;
+        }
+    }
+    if (free < 0) {
+        // Full: the longest waiting rebroadcast gives up its slot rather than the new frame going
+        // out without a backoff
+        free = 0;
+        for (int i = 1; i < SLOTS; i++) {
+            if (static_cast<int32_t>(relays[i].scheduledAt - relays[free].scheduledAt) < 0) {
+                free = i;
+            }
+        }
+        dropped++;
+    }
+
+    PendingRelay& relay = relays[free];
+    memcpy(relay.data, bytes.data, bytes.size);
+    relay.length = bytes.size;
+    relay.packetKey = packetKey;
+    relay.scheduledAt = now;
+    // Somewhere in the window the signal picked
+    relay.dueAt = now + getSignalBackoff(rssi, snr, airtimeMs) +
+                  random(RM_RELAY_JITTER_SLOTS * airtimeMs + 1);
+    relay.copiesHeard = 0;
+    relay.copiesToSuppress = neighbors >= RM_RELAY_DENSE_NEIGHBORS ? 1 : RM_RELAY_SUPPRESS_COPIES;
+    relay.used = true;
+    return true;
+}
+
+void RelayScheduler::onCopyHeard(uint32_t packetKey)
+{
+    for (int i = 0; i < SLOTS; i++) {
+        PendingRelay& relay = relays[i];
+        if (!relay.used || relay.packetKey != packetKey) {
+            continue;
+        }
+        if (++relay.copiesHeard >= relay.copiesToSuppress) {
+            relay.used = false;
+            suppressed++;
+        }
+        return;
+    }
+}
+
+const RelayScheduler::PendingRelay* RelayScheduler::getDue(uint32_t now) const
+{
+    const PendingRelay* due = nullptr;
+    for (int i = 0; i < SLOTS; i++) {
+        const PendingRelay& relay = relays[i];
+        if (!relay.used || static_cast<int32_t>(now - relay.dueAt) < 0) {
+            continue;
+        }
+        if (due == nullptr || static_cast<int32_t>(relay.dueAt - due->dueAt) < 0) {
+            due = &relay;
+        }
+    }
+    return due;
+}
+
+bool RelayScheduler::getNextDue(uint32_t* dueAt) const
+{
+    const PendingRelay* next = nullptr;
+    for (int i = 0; i < SLOTS; i++) {
+        const PendingRelay& relay = relays[i];
+        if (relay.used && (next == nullptr || static_cast<int32_t>(relay.dueAt - next->dueAt) < 0)) {
+            next = &relay;
+        }
+    }
+    if (next == nullptr) {
+        return false;
+    }
+    *dueAt = next->dueAt;
+    return true;
+}
+
+void RelayScheduler::release(const PendingRelay* relay)
+{
+    relays[relay - relays].used = false;
+}
+
+void RelayScheduler::clear()
+{
+    for (int i = 0; i < SLOTS; i++) {
+        relays[i].used = false;
+    }
+}
+
+size_t RelayScheduler::size() const
+{
+    size_t count = 0;
+    for (int i = 0; i < SLOTS; i++) {
+        if (relays[i].used) {
+            count++;
+        }
+    }
+    return count;
+}
@@ -1,9 +1,11 @@
-
 #include <Arduino.h>
+#include <common/utils/Utils.h>
 #include <core/protocol/inc/routing/RoutingTable.h>
 
 RoutingTable* RoutingTable::instance = nullptr;
 
+const uint16_t RoutingTable::CAPACITY;
+
 RoutingTable* RoutingTable::getInstance()
 {
     if (!instance) {
@@ -12,125 +14,418 @@ RoutingTable* RoutingTable::getInstance()
     return instance;
 }
 
+#ifdef RM_NATIVE
+RoutingTable* RoutingTable::setInstance(RoutingTable* newInstance)
+{
+    RoutingTable* previous = instance;
+    instance = newInstance;
+    return previous;
+}
+#endif
+
 RoutingTable::RoutingTable()
 {
-    for (int i = 0; i < MAX_ROUTES; i++) {
-        routes[i].active = false;
+    for (uint16_t i = 0; i < CAPACITY; i++) {
+        next[i] = i + 1 < CAPACITY ? i + 1 : NONE;
+        previous[i] = NONE;
+    }
+    freeHead = 0;
+}
+
+void RoutingTable::updateRoute(const RadioMeshPacket& packet, int8_t rssi, float snr)
+{
+    // The frame came directly from its last hop, whatever its source
+    neighbors.onReceived(packet.lastHopId.data(), rssi, snr, millis());
+    updatePath(packet.sourceDevId.data(), packet.lastHopId.data(), packet.hopCount, rssi);
+}
+
+void RoutingTable::updateRoute(const RadioMeshPacketView& frame, int8_t rssi, float snr)
+{
+    neighbors.onReceived(frame.getLastHopId().data(), rssi, snr, millis());
+    if (isFeasible(frame.getSourceDevId().data(), frame.getHopCount())) {
+        updatePath(frame.getSourceDevId().data(), frame.getLastHopId().data(),
+                   frame.getHopCount(), rssi);
+    }
+}
+
+void RoutingTable::updateTwoHopRoute(const byte* destId, const byte* neighbor, int8_t rssi)
+{
+    // The neighbour hears the destination directly, as if it relayed a frame sent by it. Only a
+    // missing route is filled in, the paths learned from the destination's own packets are
+    // better known and a flood finds one as soon as it sends.
+    if (findRoute(destId) == NOT_FOUND) {
+        updatePath(destId, neighbor, 2, rssi);
     }
 }
 
-void RoutingTable::updateRoute(const RadioMeshPacket& packet, int8_t rssi)
+bool RoutingTable::canLearnFrom(const RadioMeshPacketView& frame, uint32_t now) const
 {
+    std::array<byte, DEV_ID_LENGTH> sourceId = frame.getSourceDevId();
+    std::array<byte, DEV_ID_LENGTH> lastHopId = frame.getLastHopId();
+    if (frame.getHopCount() >= MAX_HOPS - 1) {
+        return false;
+    }
+    if (!isFeasible(sourceId.data(), frame.getHopCount())) {
+        // No path through it, but the copy still tells of a neighbour not known yet
+        const NeighborTable::Neighbor* neighbor = neighbors.find(lastHopId.data());
+        return neighbor == nullptr || now - neighbor->lastHeard >= ROUTE_TIMEOUT;
+    }
+    int route = findRoute(sourceId.data());
+    if (route == NOT_FOUND) {
+        return true;
+    }
+    int path = findPath(routes[route], lastHopId.data());
+    return path == NOT_FOUND || now - routes[route].paths[path].lastSeen >= ROUTE_PATH_REFRESH_MS;
+}
+
+bool RoutingTable::isFeasible(const byte* destId, uint8_t hops) const
+{
+    // Only a neighbour closer to the destination than we are can't be routing through us. A copy
+    // as long as the path in use may be our own rebroadcast relayed back, or come from a
+    // neighbour as far away that would pick us as its alternative in turn.
+    int route = findRoute(destId);
+    if (route == NOT_FOUND || routes[route].pathCount == 0) {
+        return true;
+    }
+    return hops <= routes[route].paths[0].hops;
+}
+
+void RoutingTable::updatePath(const byte* destId, const byte* lastHop, uint8_t hopCount,
+                              int8_t rssi)
+{
+    uint32_t now = millis();
+
     // Don't store routes for packets that are near hop limit
-    if (packet.hopCount >= (MAX_HOPS - 1)) {
+    if (hopCount >= (MAX_HOPS - 1)) {
         loginfo_ln("Not storing route for packet near hop limit");
         return;
     }
 
-    RouteEntry newRoute;
-    std::copy(packet.sourceDevId.begin(), packet.sourceDevId.end(), newRoute.destId.begin());
-    std::copy(packet.lastHopId.begin(), packet.lastHopId.end(), newRoute.nextHopId.begin());
-    newRoute.hops = packet.hopCount;
-    newRoute.rssi = rssi;
-    newRoute.lastSeen = millis();
-    newRoute.active = true;
-
-    int index = findRoute(packet.sourceDevId.data());
-    if (index != NOT_FOUND) {
-        // Update existing route if new route is better
-        if (isBetterRoute(newRoute, routes[index])) {
-            routes[index] = newRoute;
-            loginfo_ln("Updated route via better relay: RSSI=%d, hops=%d", rssi, packet.hopCount);
-        }
+    RoutePath newPath;
+    std::copy_n(lastHop, DEV_ID_LENGTH, newPath.nextHopId.begin());
+    newPath.hops = hopCount;
+    newPath.rssi = rssi;
+    newPath.lastSeen = now;
+    newPath.ackFailures = 0;
+
+    int route = findRoute(destId);
+    if (route == NOT_FOUND) {
+        // Add new route, in place of the least recently used one if the table is full
+        route = addRoute(destId);
+        routes[route].paths[0] = newPath;
+        routes[route].pathCount = 1;
+        loginfo_ln("Added new route via relay: RSSI=%d, hops=%d", rssi, hopCount);
+        return;
+    }
+
+    RouteEntry& entry = routes[route];
+    touch(route);
+    removeExpiredPaths(entry, now);
+    int path = findPath(entry, lastHop);
+    if (path != NOT_FOUND) {
+        // Still usable through the same next hop
+        entry.paths[path].hops = newPath.hops;
+        entry.paths[path].rssi = newPath.rssi;
+        entry.paths[path].lastSeen = newPath.lastSeen;
+    } else if (entry.pathCount == 0) {
+        // An expired route is replaced by any new one
+        entry.paths[0] = newPath;
+        entry.pathCount = 1;
+        loginfo_ln("Restored route via relay: RSSI=%d, hops=%d", rssi, hopCount);
+        return;
+    } else if (entry.pathCount < RM_ROUTE_PATHS) {
+        entry.paths[entry.pathCount++] = newPath;
     } else {
-        // Add new route
-        index = findEmptySlot();
-        if (index != NOT_FOUND) {
-            routes[index] = newRoute;
-            loginfo_ln("Added new route via relay: RSSI=%d, hops=%d", rssi, packet.hopCount);
-        } else {
-            // This should not happen since findEmptySlot() checks for oldest route as last resort
-            // but we log it just in case
-            logwarn_ln("No empty slots for new route");
+        // The paths are ranked, the last one is the worst alternative, or the one in use
+        RoutePath& worst = entry.paths[entry.pathCount - 1];
+        if (entry.pathCount == 1 ? isBetterPath(newPath, worst)
+                                 : getPathCost(newPath) < getPathCost(worst)) {
+            worst = newPath;
         }
     }
+    rankPaths(entry);
 }
 
 bool RoutingTable::findNextHop(const byte* destId, byte* nextHop)
 {
-    int index = findRoute(destId);
-    if (index != NOT_FOUND && routes[index].active) {
-        if (millis() - routes[index].lastSeen < ROUTE_TIMEOUT) {
-            std::copy(routes[index].nextHopId.begin(), routes[index].nextHopId.end(), nextHop);
-            return true;
-        } else {
-            routes[index].active = false;
-            loginfo_ln(
-                "Route to %s expired",
-                RadioMeshUtils::convertToHex(routes[index].destId.data(), DEV_ID_LENGTH).c_str());
+    int route = findRoute(destId);
+    if (route == NOT_FOUND) {
+        return false;
+    }
+    RouteEntry& entry = routes[route];
+    removeExpiredPaths(entry, millis());
+    if (entry.pathCount == 0) {
+        loginfo_ln("Route to %s expired",
+                   RadioMeshUtils::convertToHex(entry.destId.data(), DEV_ID_LENGTH).c_str());
+        removeRoute(route);
+        return false;
+    }
+    touch(route);
+    std::copy(entry.paths[0].nextHopId.begin(), entry.paths[0].nextHopId.end(), nextHop);
+    return true;
+}
+
+void RoutingTable::reportAckFailure(const byte* nextHop)
+{
+    for (uint16_t i = head; i != NONE;) {
+        RouteEntry& entry = routes[i];
+        uint16_t following = next[i];
+        int path = findPath(entry, nextHop);
+        if (path != NOT_FOUND && ++entry.paths[path].ackFailures >= ROUTE_MAX_ACK_FAILURES) {
+            loginfo_ln("Route to %s via %s dropped, next hop stopped acknowledging",
+                       RadioMeshUtils::convertToHex(entry.destId.data(), DEV_ID_LENGTH).c_str(),
+                       RadioMeshUtils::convertToHex(nextHop, DEV_ID_LENGTH).c_str());
+            removePath(entry, path);
+            if (entry.pathCount == 0) {
+                removeRoute(i);
+            }
+        }
+        i = following;
+    }
+}
+
+void RoutingTable::reportAckSuccess(const byte* nextHop)
+{
+    neighbors.onAckResult(nextHop, true);
+    for (uint16_t i = head; i != NONE; i = next[i]) {
+        int path = findPath(routes[i], nextHop);
+        if (path != NOT_FOUND) {
+            routes[i].paths[path].ackFailures = 0;
+        }
+    }
+}
+
+void RoutingTable::reportAckMissed(const byte* nextHop)
+{
+    neighbors.onAckResult(nextHop, false);
+}
+
+bool RoutingTable::failover(const byte* destId, const byte* failedHop, byte* nextHop)
+{
+    int route = findRoute(destId);
+    if (route == NOT_FOUND) {
+        return false;
+    }
+    RouteEntry& entry = routes[route];
+    removeExpiredPaths(entry, millis());
+    if (entry.pathCount == 0 || (entry.pathCount == 1 && findPath(entry, failedHop) == 0)) {
+        return false;
+    }
+    if (findPath(entry, failedHop) == 0) {
+        // The failed path becomes the last resort, the best alternative takes over
+        RoutePath failed = entry.paths[0];
+        for (uint8_t i = 1; i < entry.pathCount; i++) {
+            entry.paths[i - 1] = entry.paths[i];
         }
+        entry.paths[entry.pathCount - 1] = failed;
+        failovers++;
+        loginfo_ln("Route to %s failed over from %s to %s",
+                   RadioMeshUtils::convertToHex(destId, DEV_ID_LENGTH).c_str(),
+                   RadioMeshUtils::convertToHex(failedHop, DEV_ID_LENGTH).c_str(),
+                   RadioMeshUtils::convertToHex(entry.paths[0].nextHopId.data(), DEV_ID_LENGTH)
+                       .c_str());
+    }
+    std::copy(entry.paths[0].nextHopId.begin(), entry.paths[0].nextHopId.end(), nextHop);
+    return true;
+}
+
+uint8_t RoutingTable::getPathCount(const byte* destId)
+{
+    int route = findRoute(destId);
+    return route != NOT_FOUND ? routes[route].pathCount : 0;
+}
+
+uint16_t RoutingTable::getRouteCost(const byte* destId)
+{
+    int route = findRoute(destId);
+    if (route == NOT_FOUND || routes[route].pathCount == 0) {
+        return 0;
     }
-    return false;
+    return getPathCost(routes[route].paths[0]);
 }
 
-int RoutingTable::findRoute(const byte* destId)
+int RoutingTable::findPath(const RouteEntry& route, const byte* nextHop) const
 {
-    for (int i = 0; i < MAX_ROUTES; i++) {
-        if (std::equal(routes[i].destId.begin(), routes[i].destId.end(), destId)) {
+    for (uint8_t i = 0; i < route.pathCount; i++) {
+        if (std::equal(route.paths[i].nextHopId.begin(), route.paths[i].nextHopId.end(),
+                       nextHop)) {
             return i;
         }
     }
     return NOT_FOUND;
 }
 
-int RoutingTable::findEmptySlot()
+void RoutingTable::removePath(RouteEntry& route, uint8_t path)
 {
-    // First try to find an inactive slot
-    for (int i = 0; i < MAX_ROUTES; i++) {
-        if (!routes[i].active) {
-            return i;
+    // The paths after it move up, the best alternative takes over if it was in use
+    for (uint8_t i = path + 1; i < route.pathCount; i++) {
+        route.paths[i - 1] = route.paths[i];
+    }
+    route.pathCount--;
+}
+
+void RoutingTable::removeExpiredPaths(RouteEntry& route, uint32_t now)
+{
+    for (uint8_t i = route.pathCount; i > 0; i--) {
+        if (now - route.paths[i - 1].lastSeen >= ROUTE_TIMEOUT) {
+            removePath(route, i - 1);
         }
     }
-    // If no inactive slots, find oldest route
-    uint32_t oldestTime = millis();
-    int oldestIndex = 0;
-    for (int i = 0; i < MAX_ROUTES; i++) {
-        if (routes[i].lastSeen < oldestTime) {
-            oldestTime = routes[i].lastSeen;
-            oldestIndex = i;
+}
+
+void RoutingTable::rankPaths(RouteEntry& route)
+{
+    // Alternatives by rising cost, a handful of them at most
+    for (uint8_t i = 2; i < route.pathCount; i++) {
+        RoutePath path = route.paths[i];
+        uint16_t cost = getPathCost(path);
+        uint8_t j = i;
+        for (; j > 1 && getPathCost(route.paths[j - 1]) > cost; j--) {
+            route.paths[j] = route.paths[j - 1];
         }
+        route.paths[j] = path;
+    }
+    if (route.pathCount > 1 && isBetterPath(route.paths[1], route.paths[0])) {
+        // Update existing route if an alternative is better
+        std::swap(route.paths[0], route.paths[1]);
+        loginfo_ln("Updated route via better relay: cost=%u, hops=%d",
+                   getPathCost(route.paths[0]), route.paths[0].hops);
+        rankPaths(route);
     }
-    return oldestIndex;
 }
 
-bool RoutingTable::isBetterRoute(const RouteEntry& newRoute, const RouteEntry& existingRoute)
+uint32_t RoutingTable::hashSlot(const byte* destId)
 {
-    // Switch to new route if it's RSSI_UPPER_THRESHOLD or better
-    if (newRoute.rssi > (existingRoute.rssi + RSSI_UPPER_THRESHOLD)) {
-        return true;
+    // Fibonacci hashing: the top bits of the product depend on every bit of the ID
+    return (RadioMeshUtils::toUint32(destId) * 2654435769U) >> INDEX_SHIFT;
+}
+
+int32_t RoutingTable::findSlot(const byte* destId) const
+{
+    for (uint32_t slot = hashSlot(destId);; slot = (slot + 1) & INDEX_MASK) {
+        uint16_t entry = index[slot];
+        if (entry == 0) {
+            return -1;
+        }
+        const RouteEntry& route = routes[entry - 1];
+        if (std::equal(route.destId.begin(), route.destId.end(), destId)) {
+            return slot;
+        }
     }
+}
 
-    // Keep existing route unless it degrades by RSSI_LOWER_THRESHOLD or more
-    if (newRoute.rssi < (existingRoute.rssi - RSSI_LOWER_THRESHOLD)) {
-        return false;
+int RoutingTable::findRoute(const byte* destId) const
+{
+    int32_t slot = findSlot(destId);
+    return slot >= 0 ? index[slot] - 1 : NOT_FOUND;
+}
+
+int RoutingTable::addRoute(const byte* destId)
+{
+    if (freeHead == NONE) {
+        loginfo_ln(
+            "Routing table full, forgetting route to %s",
+            RadioMeshUtils::convertToHex(routes[tail].destId.data(), DEV_ID_LENGTH).c_str());
+        removeRoute(tail);
     }
+    uint16_t route = freeHead;
+    freeHead = next[route];
+    std::copy_n(destId, DEV_ID_LENGTH, routes[route].destId.begin());
+    linkFront(route);
 
-    // Within acceptable band, use hop count
-    return newRoute.hops < existingRoute.hops;
+    uint32_t slot = hashSlot(destId);
+    while (index[slot] != 0) {
+        slot = (slot + 1) & INDEX_MASK;
+    }
+    index[slot] = route + 1;
+    count++;
+    return route;
+}
+
+void RoutingTable::removeRoute(int route)
+{
+    uint32_t slot = findSlot(routes[route].destId.data());
+    index[slot] = 0;
+
+    // Backward shift deletion: pull later entries of the probe run into the hole so that
+    // lookups can stop at the first empty slot without tombstones
+    uint32_t hole = slot;
+    for (uint32_t following = (slot + 1) & INDEX_MASK; index[following] != 0;
+         following = (following + 1) & INDEX_MASK) {
+        uint32_t home = hashSlot(routes[index[following] - 1].destId.data());
+        if (((following - home) & INDEX_MASK) >= ((following - hole) & INDEX_MASK)) {
+            index[hole] = index[following];
+            index[following] = 0;
+            hole = following;
+        }
+    }
+
+    unlink(route);
+    next[route] = freeHead;
+    freeHead = route;
+    count--;
+}
+
+void RoutingTable::touch(int route)
+{
+    if (head != route) {
+        unlink(route);
+        linkFront(route);
+    }
+}
+
+void RoutingTable::linkFront(int route)
+{
+    previous[route] = NONE;
+    next[route] = head;
+    if (head != NONE) {
+        previous[head] = route;
+    } else {
+        tail = route;
+    }
+    head = route;
+}
+
+void RoutingTable::unlink(int route)
+{
+    if (previous[route] != NONE) {
+        next[previous[route]] = next[route];
+    } else {
+        head = next[route];
+    }
+    if (next[route] != NONE) {
+        previous[next[route]] = previous[route];
+    } else {
+        tail = previous[route];
+    }
+}
+
+uint16_t RoutingTable::getPathCost(const RoutePath& path) const
+{
+    uint32_t cost = neighbors.getLinkCost(path.nextHopId.data()) + path.hops * ROUTE_HOP_COST;
+    return static_cast<uint16_t>(std::min<uint32_t>(cost, 0xFFFF));
+}
+
+bool RoutingTable::isBetterPath(const RoutePath& newPath, const RoutePath& existingPath) const
+{
+    // Switch only to a clearly cheaper path, a single packet over a similar one is not enough
+    return static_cast<uint32_t>(getPathCost(newPath)) * 100 <
+           static_cast<uint32_t>(getPathCost(existingPath)) * (100 - ROUTE_SWITCH_MARGIN_PCT);
 }
 
 void RoutingTable::printRoutes()
 {
-    loginfo_ln("Current Routes:");
-    for (int i = 0; i < MAX_ROUTES; i++) {
-        if (routes[i].active) {
-            std::string destId =
-                RadioMeshUtils::convertToHex(routes[i].destId.data(), DEV_ID_LENGTH);
+    loginfo_ln("Current Routes (%u of %u, most recently used first):", count, CAPACITY);
+    for (uint16_t i = head; i != NONE; i = next[i]) {
+        const RouteEntry& entry = routes[i];
+        std::string destId = RadioMeshUtils::convertToHex(entry.destId.data(), DEV_ID_LENGTH);
+        for (uint8_t p = 0; p < entry.pathCount; p++) {
+            const RoutePath& path = entry.paths[p];
             std::string nextHopId =
-                RadioMeshUtils::convertToHex(routes[i].nextHopId.data(), DEV_ID_LENGTH);
-            loginfo_ln("Route %d: Dest=%s NextHop=%s Hops=%d RSSI=%d Age=%lums", i, destId.c_str(),
-                       nextHopId.c_str(), routes[i].hops, routes[i].rssi,
-                       millis() - routes[i].lastSeen);
+                RadioMeshUtils::convertToHex(path.nextHopId.data(), DEV_ID_LENGTH);
+            loginfo_ln("Route %d%s: Dest=%s NextHop=%s Hops=%d RSSI=%d Cost=%u Age=%lums", i,
+                       p == 0 ? "" : " (alternative)", destId.c_str(), nextHopId.c_str(),
+                       path.hops, path.rssi, getPathCost(path), millis() - path.lastSeen);
         }
     }
 }
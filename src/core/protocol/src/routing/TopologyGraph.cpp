@@ -0,0 +1,518 @@
+#include <Arduino.h>
+#include <algorithm>
+
+#include <common/inc/Logger.h>
+#include <common/utils/Utils.h>
+#include <core/protocol/inc/routing/TopologyGraph.h>
+
+const uint16_t TopologyGraph::MAX_NODES;
+const uint16_t TopologyGraph::MAX_LINKS;
+const uint32_t TopologyGraph::UNREACHABLE;
+
+TopologyGraph::TopologyGraph(const byte* hubId)
+{
+    for (uint16_t i = 0; i < MAX_NODES; i++) {
+        nodes[i].used = false;
+    }
+    for (uint16_t i = 0; i < MAX_LINKS; i++) {
+        links[i].used = false;
+        links[i].next[0] = i + 1 < MAX_LINKS ? i + 1 : NONE;
+    }
+    freeLink = 0;
+    addNode(hubId, 0, NONE);
+    nodes[ROOT].cost = 0;
+}
+
+void TopologyGraph::onPacket(const byte* sourceId, const byte* lastHopId, uint8_t hopCount,
+                             uint16_t lastHopCost, uint32_t now)
+{
+    if (hopCount == 0) {
+        return;
+    }
+    updateLink(lastHopId, nodes[ROOT].id.data(), lastHopCost, 1, now);
+    // The last hop is hopCount - 1 hops away from the source, it heard it directly if 1
+    if (hopCount > 1 && !std::equal(sourceId, sourceId + DEV_ID_LENGTH, lastHopId)) {
+        uint8_t hops = hopCount - 1;
+        updateLink(sourceId, lastHopId, hops * ROUTE_HOP_COST, hops, now);
+    }
+}
+
+void TopologyGraph::onBeacon(const byte* senderId, const byte* listedId, uint32_t now)
+{
+    // The link of the hub to the sender is measured, not taken from its beacon
+    if (findNode(listedId) == ROOT) {
+        return;
+    }
+    updateLink(senderId, listedId, ROUTE_HOP_COST, 1, now);
+}
+
+void TopologyGraph::updateLink(const byte* a, const byte* b, uint16_t cost, uint8_t hops,
+                               uint32_t now)
+{
+    if (std::equal(a, a + DEV_ID_LENGTH, b)) {
+        return;
+    }
+    uint16_t first = findNode(a);
+    if (first == NONE) {
+        first = addNode(a, now, NONE);
+    }
+    nodes[first].lastSeen = now;
+    uint16_t second = findNode(b);
+    if (second == NONE) {
+        second = addNode(b, now, first);
+    }
+    nodes[second].lastSeen = now;
+
+    uint16_t link = findLink(first, second);
+    if (link == NONE) {
+        link = addLink(first, second, now);
+        links[link].cost = cost;
+        links[link].hops = hops;
+        stats.linkChanges++;
+        relax(first, second, links[link]);
+        relax(second, first, links[link]);
+        propagate();
+        return;
+    }
+
+    Link& existing = links[link];
+    existing.lastSeen = now;
+    uint16_t previous = existing.cost;
+    uint32_t change = cost > previous ? cost - previous : previous - cost;
+    if (hops == existing.hops && change * 100 < previous * TOPOLOGY_COST_CHANGE_PCT) {
+        return;
+    }
+    existing.cost = cost;
+    existing.hops = hops;
+    stats.linkChanges++;
+    if (cost < previous) {
+        // Only the devices the link brings closer move
+        relax(first, second, existing);
+        relax(second, first, existing);
+        propagate();
+        return;
+    }
+    // Only the devices below the link in the tree may find a better path elsewhere
+    if (nodes[second].parent == first) {
+        detachSubtree(second);
+    } else if (nodes[first].parent == second) {
+        detachSubtree(first);
+    }
+    repair();
+}
+
+bool TopologyGraph::removeLink(const byte* a, const byte* b)
+{
+    uint16_t first = findNode(a);
+    uint16_t second = findNode(b);
+    if (first == NONE || second == NONE) {
+        return false;
+    }
+    uint16_t link = findLink(first, second);
+    if (link == NONE) {
+        return false;
+    }
+    detachLink(link);
+    stats.linkChanges++;
+    repair();
+    return true;
+}
+
+void TopologyGraph::removeExpired(uint32_t now)
+{
+    if (now - lastExpiryScan < TOPOLOGY_EXPIRY_SCAN_MS) {
+        return;
+    }
+    lastExpiryScan = now;
+
+    // All the expired links go first, the devices that lost their path get a new one at once
+    for (uint16_t i = 0; i < MAX_LINKS; i++) {
+        if (links[i].used && now - links[i].lastSeen >= ROUTE_TIMEOUT) {
+            detachLink(i);
+            stats.linkChanges++;
+        }
+    }
+    for (uint16_t i = 0; i < MAX_NODES; i++) {
+        if (i != ROOT && nodes[i].used && nodes[i].firstLink == NONE &&
+            now - nodes[i].lastSeen >= ROUTE_TIMEOUT) {
+            removeNode(i);
+        }
+    }
+    repair();
+}
+
+bool TopologyGraph::getPath(const byte* destId,
+                            std::vector<std::array<byte, DEV_ID_LENGTH>>* path) const
+{
+    uint16_t node = findNode(destId);
+    if (node == NONE || nodes[node].cost == UNREACHABLE) {
+        return false;
+    }
+    path->clear();
+    for (; node != ROOT; node = nodes[node].parent) {
+        path->push_back(nodes[node].id);
+    }
+    std::reverse(path->begin(), path->end());
+    return true;
+}
+
+uint32_t TopologyGraph::getCost(const byte* destId) const
+{
+    uint16_t node = findNode(destId);
+    return node != NONE ? nodes[node].cost : UNREACHABLE;
+}
+
+uint8_t TopologyGraph::getHops(const byte* destId) const
+{
+    uint16_t node = findNode(destId);
+    return node != NONE && nodes[node].cost != UNREACHABLE ? nodes[node].hops : 0;
+}
+
+std::string TopologyGraph::toJson() const
+{
+    char item[96];
+    std::string json;
+    json.reserve(64 + nodeCount * 56 + linkCount * 48);
+    json += "{\"hub\":\"" + RadioMeshUtils::convertToHex(nodes[ROOT].id.data(), DEV_ID_LENGTH) +
+            "\",\"nodes\":[";
+    bool first = true;
+    for (uint16_t i = 0; i < MAX_NODES; i++) {
+        const Node& node = nodes[i];
+        if (!node.used || i == ROOT) {
+            continue;
+        }
+        json += first ? "" : ",";
+        first = false;
+        std::string id = RadioMeshUtils::convertToHex(node.id.data(), DEV_ID_LENGTH);
+        if (node.cost == UNREACHABLE) {
+            snprintf(item, sizeof(item), "{\"id\":\"%s\"}", id.c_str());
+        } else {
+            std::string via = RadioMeshUtils::convertToHex(nodes[node.parent].id.data(),
+                                                           DEV_ID_LENGTH);
+            snprintf(item, sizeof(item), "{\"id\":\"%s\",\"cost\":%u,\"hops\":%u,\"via\":\"%s\"}",
+                     id.c_str(), static_cast<unsigned>(node.cost), node.hops, via.c_str());
+        }
+        json += item;
+    }
+    json += "],\"links\":[";
+    first = true;
+    for (uint16_t i = 0; i < MAX_LINKS; i++) {
+        const Link& link = links[i];
+        if (!link.used) {
+            continue;
+        }
+        json += first ? "" : ",";
+        first = false;
+        std::string a = RadioMeshUtils::convertToHex(nodes[link.ends[0]].id.data(), DEV_ID_LENGTH);
+        std::string b = RadioMeshUtils::convertToHex(nodes[link.ends[1]].id.data(), DEV_ID_LENGTH);
+        snprintf(item, sizeof(item), "{\"a\":\"%s\",\"b\":\"%s\",\"cost\":%u,\"hops\":%u}",
+                 a.c_str(), b.c_str(), link.cost, link.hops);
+        json += item;
+    }
+    json += "]}";
+    return json;
+}
+
+uint32_t TopologyGraph::hashSlot(const byte* id)
+{
+    // Fibonacci hashing, as for the routing table
+    return (RadioMeshUtils::toUint32(id) * 2654435769U) >> INDEX_SHIFT;
+}
+
+int32_t TopologyGraph::findSlot(const byte* id) const
+{
+    for (uint32_t slot = hashSlot(id);; slot = (slot + 1) & INDEX_MASK) {
+        uint16_t entry = index[slot];
+        if (entry == 0) {
+            return -1;
+        }
+        const Node& node = nodes[entry - 1];
+        if (std::equal(node.id.begin(), node.id.end(), id)) {
+            return slot;
+        }
+    }
+}
+
+uint16_t TopologyGraph::findNode(const byte* id) const
+{
+    int32_t slot = findSlot(id);
+    return slot >= 0 ? index[slot] - 1 : NONE;
+}
+
+uint16_t TopologyGraph::addNode(const byte* id, uint32_t now, uint16_t keep)
+{
+    if (nodeCount == MAX_NODES) {
+        uint16_t oldest = NONE;
+        for (uint16_t i = 0; i < MAX_NODES; i++) {
+            if (i != ROOT && i != keep &&
+                (oldest == NONE ||
+                 static_cast<int32_t>(nodes[i].lastSeen - nodes[oldest].lastSeen) < 0)) {
+                oldest = i;
+            }
+        }
+        loginfo_ln("Topology full, forgetting %s",
+                   RadioMeshUtils::convertToHex(nodes[oldest].id.data(), DEV_ID_LENGTH).c_str());
+        removeNode(oldest);
+        repair();
+        stats.nodesEvicted++;
+    }
+    uint16_t free = 0;
+    while (nodes[free].used) {
+        free++;
+    }
+    Node& node = nodes[free];
+    std::copy_n(id, DEV_ID_LENGTH, node.id.begin());
+    node.lastSeen = now;
+    node.cost = UNREACHABLE;
+    node.parent = NONE;
+    node.firstLink = NONE;
+    node.heapPosition = NONE;
+    node.hops = 0;
+    node.used = true;
+
+    uint32_t slot = hashSlot(id);
+    while (index[slot] != 0) {
+        slot = (slot + 1) & INDEX_MASK;
+    }
+    index[slot] = free + 1;
+    nodeCount++;
+    return free;
+}
+
+void TopologyGraph::removeNode(uint16_t node)
+{
+    detachSubtree(node);
+    while (nodes[node].firstLink != NONE) {
+        uint16_t link = nodes[node].firstLink;
+        nodes[node].firstLink = nextOf(links[link], node);
+        unlinkFrom(other(links[link], node), link);
+        freeLinkEntry(link);
+    }
+
+    // Backward shift deletion, as for the routing table
+    uint32_t slot = findSlot(nodes[node].id.data());
+    index[slot] = 0;
+    uint32_t hole = slot;
+    for (uint32_t following = (slot + 1) & INDEX_MASK; index[following] != 0;
+         following = (following + 1) & INDEX_MASK) {
+        uint32_t home = hashSlot(nodes[index[following] - 1].id.data());
+        if (((following - home) & INDEX_MASK) >= ((following - hole) & INDEX_MASK)) {
+            index[hole] = index[following];
+            index[following] = 0;
+            hole = following;
+        }
+    }
+    nodes[node].used = false;
+    nodeCount--;
+}
+
+uint16_t TopologyGraph::findLink(uint16_t a, uint16_t b) const
+{
+    for (uint16_t link = nodes[a].firstLink; link != NONE; link = nextOf(links[link], a)) {
+        if (other(links[link], a) == b) {
+            return link;
+        }
+    }
+    return NONE;
+}
+
+uint16_t TopologyGraph::addLink(uint16_t a, uint16_t b, uint32_t now)
+{
+    if (freeLink == NONE) {
+        uint16_t oldest = 0;
+        for (uint16_t i = 1; i < MAX_LINKS; i++) {
+            if (static_cast<int32_t>(links[i].lastSeen - links[oldest].lastSeen) < 0) {
+                oldest = i;
+            }
+        }
+        detachLink(oldest);
+        repair();
+        stats.linksEvicted++;
+    }
+    uint16_t link = freeLink;
+    Link& entry = links[link];
+    freeLink = entry.next[0];
+    entry.ends[0] = a;
+    entry.ends[1] = b;
+    entry.next[0] = nodes[a].firstLink;
+    entry.next[1] = nodes[b].firstLink;
+    entry.lastSeen = now;
+    entry.used = true;
+    nodes[a].firstLink = link;
+    nodes[b].firstLink = link;
+    linkCount++;
+    return link;
+}
+
+void TopologyGraph::unlinkFrom(uint16_t node, uint16_t link)
+{
+    uint16_t* slot = &nodes[node].firstLink;
+    while (*slot != link) {
+        Link& current = links[*slot];
+        slot = &current.next[current.ends[0] == node ? 0 : 1];
+    }
+    *slot = nextOf(links[link], node);
+}
+
+void TopologyGraph::freeLinkEntry(uint16_t link)
+{
+    links[link].used = false;
+    links[link].next[0] = freeLink;
+    freeLink = link;
+    linkCount--;
+}
+
+void TopologyGraph::detachLink(uint16_t link)
+{
+    uint16_t a = links[link].ends[0];
+    uint16_t b = links[link].ends[1];
+    if (nodes[b].parent == a) {
+        detachSubtree(b);
+    } else if (nodes[a].parent == b) {
+        detachSubtree(a);
+    }
+    unlinkFrom(a, link);
+    unlinkFrom(b, link);
+    freeLinkEntry(link);
+}
+
+uint16_t TopologyGraph::other(const Link& link, uint16_t node) const
+{
+    return link.ends[0] == node ? link.ends[1] : link.ends[0];
+}
+
+uint16_t TopologyGraph::nextOf(const Link& link, uint16_t node) const
+{
+    return link.next[link.ends[0] == node ? 0 : 1];
+}
+
+void TopologyGraph::relax(uint16_t from, uint16_t to, const Link& link)
+{
+    if (nodes[from].cost == UNREACHABLE) {
+        return;
+    }
+    uint32_t cost = nodes[from].cost + link.cost;
+    Node& node = nodes[to];
+    if (cost >= node.cost) {
+        return;
+    }
+    node.cost = cost;
+    node.parent = from;
+    node.hops = static_cast<uint8_t>(std::min(nodes[from].hops + link.hops, 0xFF));
+    heapPush(to);
+}
+
+void TopologyGraph::detachSubtree(uint16_t top)
+{
+    if (nodes[top].cost == UNREACHABLE || top == ROOT) {
+        return;
+    }
+    // The devices whose path goes through the top one, found breadth first through the links
+    uint16_t first = detachedCount;
+    detached[detachedCount++] = top;
+    for (uint16_t i = first; i < detachedCount; i++) {
+        uint16_t node = detached[i];
+        for (uint16_t link = nodes[node].firstLink; link != NONE;
+             link = nextOf(links[link], node)) {
+            uint16_t child = other(links[link], node);
+            if (nodes[child].parent == node) {
+                detached[detachedCount++] = child;
+            }
+        }
+    }
+    for (uint16_t i = first; i < detachedCount; i++) {
+        Node& node = nodes[detached[i]];
+        node.cost = UNREACHABLE;
+        node.parent = NONE;
+        node.hops = 0;
+    }
+}
+
+void TopologyGraph::repair()
+{
+    // Each device that lost its path starts from its best neighbour still reached
+    for (uint16_t i = 0; i < detachedCount; i++) {
+        uint16_t node = detached[i];
+        if (!nodes[node].used) {
+            continue;
+        }
+        for (uint16_t link = nodes[node].firstLink; link != NONE;
+             link = nextOf(links[link], node)) {
+            relax(other(links[link], node), node, links[link]);
+        }
+    }
+    detachedCount = 0;
+    propagate();
+}
+
+void TopologyGraph::propagate()
+{
+    while (heapSize > 0) {
+        uint16_t node = heapPop();
+        stats.nodesSettled++;
+        for (uint16_t link = nodes[node].firstLink; link != NONE;
+             link = nextOf(links[link], node)) {
+            relax(node, other(links[link], node), links[link]);
+        }
+    }
+}
+
+void TopologyGraph::heapPush(uint16_t node)
+{
+    if (nodes[node].heapPosition == NONE) {
+        nodes[node].heapPosition = heapSize;
+        heap[heapSize++] = node;
+    }
+    siftUp(nodes[node].heapPosition);
+}
+
+uint16_t TopologyGraph::heapPop()
+{
+    uint16_t top = heap[0];
+    nodes[top].heapPosition = NONE;
+    heapSize--;
+    if (heapSize > 0) {
+        heap[0] = heap[heapSize];
+        nodes[heap[0]].heapPosition = 0;
+        siftDown(0);
+    }
+    return top;
+}
+
+void TopologyGraph::siftUp(uint16_t position)
+{
+    uint16_t node = heap[position];
+    while (position > 0) {
+        uint16_t up = (position - 1) / 2;
+        if (nodes[heap[up]].cost <= nodes[node].cost) {
+            break;
+        }
+        heap[position] = heap[up];
+        nodes[heap[position]].heapPosition = position;
+        position = up;
+    }
+    heap[position] = node;
+    nodes[node].heapPosition = position;
+}
+
+void TopologyGraph::siftDown(uint16_t position)
+{
+    uint16_t node = heap[position];
+    while (true) {
+        uint32_t down = 2 * position + 1;
+        if (down >= heapSize) {
+            break;
+        }
+        if (down + 1 < heapSize && nodes[heap[down + 1]].cost < nodes[heap[down]].cost) {
+            down++;
+        }
+        if (nodes[node].cost <= nodes[heap[down]].cost) {
+            break;
+        }
+        heap[position] = heap[down];
+        nodes[heap[position]].heapPosition = position;
+        position = down;
+    }
+    heap[position] = node;
+    nodes[node].heapPosition = position;
+}
@@ -0,0 +1,439 @@
+#include <Arduino.h>
+#include <algorithm>
+#include <cstring>
+
+#include <common/inc/Errors.h>
+#include <common/utils/Utils.h>
+#include <core/protocol/inc/transport/ReliableTransfer.h>
+
+const uint8_t ReliableTransfer::SLOTS;
+const uint8_t ReliableTransfer::WINDOW;
+const uint8_t ReliableTransfer::PEERS;
+const uint8_t ReliableTransfer::SACK_BITS;
+const size_t ReliableTransfer::DATA_HEADER_LENGTH;
+const size_t ReliableTransfer::ACK_LENGTH;
+const size_t ReliableTransfer::MAX_MESSAGE_LENGTH;
+
+namespace
+{
+uint16_t readUint16(const byte* data)
+{
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+void writeUint16(byte* data, uint16_t value)
+{
+    data[0] = (value >> 8) & 0xFF;
+    data[1] = value & 0xFF;
+}
+
+// Distance from one sequence number to another, negative if it comes before (serial arithmetic)
+int16_t distance(uint16_t from, uint16_t to)
+{
+    return static_cast<int16_t>(to - from);
+}
+
+// Whether the message an offset past the next expected one is marked received in a SACK bitmap
+bool isMarked(uint32_t received, int16_t offset)
+{
+    return offset > 0 && offset <= ReliableTransfer::SACK_BITS &&
+           (received & (1UL << (offset - 1))) != 0;
+}
+} // namespace
+
+std::vector<byte> ReliableTransfer::Message::getPayload() const
+{
+    std::vector<byte> payload(DATA_HEADER_LENGTH + length);
+    payload[0] = topic;
+    payload[1] = session;
+    writeUint16(payload.data() + 2, sequence);
+    memcpy(payload.data() + DATA_HEADER_LENGTH, data, length);
+    return payload;
+}
+
+std::vector<byte> ReliableTransfer::Ack::getPayload() const
+{
+    std::vector<byte> payload(ACK_LENGTH);
+    payload[0] = session;
+    writeUint16(payload.data() + 1, nextExpected);
+    RadioMeshPacket::writeUint32(payload.data() + 3, received);
+    return payload;
+}
+
+ReliableTransfer::ReliableTransfer()
+{
+    clear();
+}
+
+int ReliableTransfer::send(const std::array<byte, RM_ID_LENGTH>& target, uint8_t topic,
+                           const std::vector<byte>& data, ReliableSendCallback onComplete,
+                           void* context, uint16_t* sequence)
+{
+    if (data.size() > MAX_MESSAGE_LENGTH) {
+        return RM_E_PACKET_TOO_LONG;
+    }
+    Message* message = nullptr;
+    for (int i = 0; i < SLOTS; i++) {
+        if (messages[i].state == State::FREE) {
+            message = &messages[i];
+            break;
+        }
+    }
+    if (message == nullptr) {
+        return RM_E_QUEUE_FULL;
+    }
+    uint32_t now = millis();
+    Peer* peer = findPeer(target.data());
+    if (peer == nullptr) {
+        peer = addPeer(target.data(), now);
+        if (peer == nullptr) {
+            return RM_E_QUEUE_FULL;
+        }
+    }
+    if (!peer->sending) {
+        peer->sending = true;
+        peer->txSession = static_cast<uint8_t>(1 + random(255));
+        peer->nextSequence = 0;
+        peer->hasRtt = false;
+    }
+    peer->lastUsed = now;
+
+    message->target = target;
+    message->topic = topic;
+    message->session = peer->txSession;
+    message->sequence = peer->nextSequence++;
+    std::copy(data.begin(), data.end(), message->data);
+    message->length = data.size();
+    message->onComplete = onComplete;
+    message->context = context;
+    message->order = nextOrder++;
+    message->transmissions = 0;
+    message->fastRetransmitted = false;
+    message->state = State::QUEUED;
+    stats.sent++;
+    if (sequence != nullptr) {
+        *sequence = message->sequence;
+    }
+    return RM_E_NONE;
+}
+
+ReliableTransfer::Message* ReliableTransfer::getDue(uint32_t now)
+{
+    Message* next = nullptr;
+    for (int i = 0; i < SLOTS; i++) {
+        Message& message = messages[i];
+        if (message.state == State::SENT &&
+            static_cast<int32_t>(now - message.deadline) >= 0) {
+            if (message.transmissions > RM_RELIABLE_RETRIES) {
+                logwarn_ln("Reliable message %u to %s not acknowledged, giving up",
+                           message.sequence,
+                           RadioMeshUtils::convertToHex(message.target.data(), RM_ID_LENGTH)
+                               .c_str());
+                complete(&message, RM_E_DELIVERY_TIMEOUT);
+                continue;
+            }
+        } else if (message.state != State::QUEUED || !isInWindow(message)) {
+            continue;
+        }
+        if (next == nullptr || static_cast<int32_t>(message.order - next->order) < 0) {
+            next = &message;
+        }
+    }
+    return next;
+}
+
+void ReliableTransfer::onSent(Message* message, uint32_t now)
+{
+    Peer* peer = findPeer(message->target.data());
+    message->transmissions++;
+    if (message->transmissions > 1) {
+        stats.retransmissions++;
+    }
+    message->sentAt = now;
+    // Random extra wait, so that messages sent back to back are not sent again back to back, each
+    // one's ACK landing on the next exchange every time
+    uint32_t timeout = peer != nullptr ? getTimeout(*peer, message->transmissions)
+                                       : RM_RELIABLE_INITIAL_TIMEOUT_MS;
+    message->deadline = now + timeout + random(timeout / 2 + 1);
+    message->fastRetransmitted = false;
+    message->state = State::SENT;
+}
+
+bool ReliableTransfer::onAck(const byte* from, const std::vector<byte>& payload, uint32_t now)
+{
+    if (payload.size() != ACK_LENGTH) {
+        return false;
+    }
+    uint8_t session = payload[0];
+    uint16_t nextExpected = readUint16(payload.data() + 1);
+    uint32_t received = RadioMeshUtils::toUint32(payload.data() + 3);
+
+    Peer* peer = findPeer(from);
+    if (peer == nullptr || !peer->sending || peer->txSession != session) {
+        // Late ACK of a session given up since
+        return true;
+    }
+    peer->lastUsed = now;
+
+    // Messages up to the newest one acknowledged that are still missing were lost
+    int16_t newest = 0;
+    for (int16_t bit = SACK_BITS; bit > 0; bit--) {
+        if (received & (1UL << (bit - 1))) {
+            newest = bit;
+            break;
+        }
+    }
+    for (int i = 0; i < SLOTS; i++) {
+        Message& message = messages[i];
+        if (message.state != State::SENT || message.session != session ||
+            message.target != peer->id) {
+            continue;
+        }
+        int16_t offset = distance(nextExpected, message.sequence);
+        if (offset < 0 || isMarked(received, offset)) {
+            // Karn's rule: the ACK of a retransmitted message may answer any of its copies
+            if (message.transmissions == 1) {
+                sampleRtt(*peer, now - message.sentAt);
+            }
+            stats.acknowledged++;
+            complete(&message, RM_E_NONE);
+        } else if (offset < newest && !message.fastRetransmitted) {
+            message.fastRetransmitted = true;
+            message.deadline = now;
+        }
+    }
+    return true;
+}
+
+ReliableTransfer::Receipt ReliableTransfer::onData(const byte* from,
+                                                   const std::vector<byte>& payload, uint32_t now,
+                                                   uint8_t* topic, std::vector<byte>* data)
+{
+    // Only application topics travel reliably
+    if (payload.size() < DATA_HEADER_LENGTH || payload[0] <= MessageTopic::MAX_RESERVED) {
+        return Receipt::DROPPED;
+    }
+    uint8_t session = payload[1];
+    uint16_t sequence = readUint16(payload.data() + 2);
+
+    Peer* peer = findPeer(from);
+    if (peer == nullptr) {
+        peer = addPeer(from, now);
+        if (peer == nullptr) {
+            return Receipt::DROPPED;
+        }
+    }
+    if (!peer->receiving || peer->rxSession != session) {
+        // A new session, whatever came before it is not ours to wait for
+        peer->receiving = true;
+        peer->rxSession = session;
+        peer->nextExpected = 0;
+        peer->received = 0;
+    }
+    peer->lastUsed = now;
+    if (!peer->ackPending) {
+        peer->ackPending = true;
+        peer->ackDueAt = now + RM_RELIABLE_ACK_DELAY_MS;
+    }
+
+    int16_t offset = distance(peer->nextExpected, sequence);
+    if (offset < 0 || isMarked(peer->received, offset)) {
+        stats.duplicates++;
+        return Receipt::DUPLICATE;
+    }
+    // Past the bitmap, the sender gave up on the oldest messages
+    if (offset > 2 * SACK_BITS) {
+        // Far past it, after the source was forgotten mid-session
+        peer->nextExpected = sequence - SACK_BITS;
+        peer->received = 0;
+        offset = SACK_BITS;
+    }
+    while (offset > SACK_BITS) {
+        advance(*peer);
+        offset = distance(peer->nextExpected, sequence);
+    }
+    if (offset == 0) {
+        advance(*peer);
+    } else {
+        peer->received |= 1UL << (offset - 1);
+    }
+
+    *topic = payload[0];
+    data->assign(payload.begin() + DATA_HEADER_LENGTH, payload.end());
+    stats.received++;
+    return Receipt::NEW;
+}
+
+bool ReliableTransfer::getAckDue(uint32_t now, Ack* ack)
+{
+    for (int i = 0; i < PEERS; i++) {
+        Peer& peer = peers[i];
+        if (!peer.used || !peer.ackPending || static_cast<int32_t>(now - peer.ackDueAt) < 0) {
+            continue;
+        }
+        peer.ackPending = false;
+        ack->target = peer.id;
+        ack->session = peer.rxSession;
+        ack->nextExpected = peer.nextExpected;
+        ack->received = peer.received;
+        stats.acksSent++;
+        return true;
+    }
+    return false;
+}
+
+bool ReliableTransfer::getNextDue(uint32_t* dueAt) const
+{
+    bool found = false;
+    auto consider = [&](uint32_t deadline) {
+        if (!found || static_cast<int32_t>(deadline - *dueAt) < 0) {
+            *dueAt = deadline;
+            found = true;
+        }
+    };
+    for (int i = 0; i < SLOTS; i++) {
+        if (messages[i].state == State::SENT) {
+            consider(messages[i].deadline);
+        }
+    }
+    for (int i = 0; i < PEERS; i++) {
+        if (peers[i].used && peers[i].ackPending) {
+            consider(peers[i].ackDueAt);
+        }
+    }
+    return found;
+}
+
+void ReliableTransfer::clear()
+{
+    for (int i = 0; i < SLOTS; i++) {
+        messages[i].state = State::FREE;
+    }
+    for (int i = 0; i < PEERS; i++) {
+        peers[i].used = false;
+    }
+}
+
+size_t ReliableTransfer::size() const
+{
+    size_t count = 0;
+    for (int i = 0; i < SLOTS; i++) {
+        if (messages[i].state != State::FREE) {
+            count++;
+        }
+    }
+    return count;
+}
+
+ReliableTransfer::Peer* ReliableTransfer::findPeer(const byte* id)
+{
+    for (int i = 0; i < PEERS; i++) {
+        if (peers[i].used && std::equal(peers[i].id.begin(), peers[i].id.end(), id)) {
+            return &peers[i];
+        }
+    }
+    return nullptr;
+}
+
+ReliableTransfer::Peer* ReliableTransfer::addPeer(const byte* id, uint32_t now)
+{
+    // A free entry, or else the least recently used one that no message depends on
+    Peer* entry = nullptr;
+    for (int i = 0; i < PEERS; i++) {
+        Peer& peer = peers[i];
+        if (!peer.used) {
+            entry = &peer;
+            break;
+        }
+        if (!hasMessages(peer) &&
+            (entry == nullptr || static_cast<int32_t>(peer.lastUsed - entry->lastUsed) < 0)) {
+            entry = &peer;
+        }
+    }
+    if (entry == nullptr) {
+        return nullptr;
+    }
+    std::copy_n(id, RM_ID_LENGTH, entry->id.begin());
+    entry->lastUsed = now;
+    entry->used = true;
+    entry->sending = false;
+    entry->receiving = false;
+    entry->ackPending = false;
+    return entry;
+}
+
+bool ReliableTransfer::hasMessages(const Peer& peer) const
+{
+    for (int i = 0; i < SLOTS; i++) {
+        if (messages[i].state != State::FREE && messages[i].target == peer.id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ReliableTransfer::isInWindow(const Message& message) const
+{
+    // The window starts at the oldest message to the destination not completed yet
+    for (int i = 0; i < SLOTS; i++) {
+        const Message& other = messages[i];
+        if (other.state != State::FREE && other.target == message.target &&
+            distance(other.sequence, message.sequence) >= WINDOW) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t ReliableTransfer::getTimeout(const Peer& peer, uint8_t transmissions) const
+{
+    uint32_t timeout = RM_RELIABLE_INITIAL_TIMEOUT_MS;
+    if (peer.hasRtt) {
+        timeout = std::max<uint32_t>(RM_RELIABLE_MIN_TIMEOUT_MS,
+                                     peer.srttMs + 4 * peer.rttvarMs);
+    }
+    for (uint8_t i = 1; i < transmissions && timeout < RM_RELIABLE_MAX_TIMEOUT_MS; i++) {
+        timeout *= 2;
+    }
+    return std::min<uint32_t>(timeout, RM_RELIABLE_MAX_TIMEOUT_MS);
+}
+
+void ReliableTransfer::sampleRtt(Peer& peer, uint32_t rttMs)
+{
+    if (!peer.hasRtt) {
+        peer.srttMs = rttMs;
+        peer.rttvarMs = rttMs / 2;
+        peer.hasRtt = true;
+        return;
+    }
+    uint32_t deviation = peer.srttMs > rttMs ? peer.srttMs - rttMs : rttMs - peer.srttMs;
+    peer.rttvarMs = (3 * peer.rttvarMs + deviation) / 4;
+    peer.srttMs = (7 * peer.srttMs + rttMs) / 8;
+}
+
+void ReliableTransfer::complete(Message* message, int err)
+{
+    if (err != RM_E_NONE) {
+        stats.failed++;
+    }
+    // The slot is free before the callback, which may send the next message
+    std::array<byte, RM_ID_LENGTH> target = message->target;
+    uint16_t sequence = message->sequence;
+    ReliableSendCallback onComplete = message->onComplete;
+    void* context = message->context;
+    message->state = State::FREE;
+    if (onComplete != nullptr) {
+        onComplete(target, sequence, err, context);
+    }
+}
+
+void ReliableTransfer::advance(Peer& peer)
+{
+    // Move past the next expected message, and past the ones after it already received
+    bool received;
+    do {
+        received = (peer.received & 1) != 0;
+        peer.received >>= 1;
+        peer.nextExpected++;
+    } while (received);
+}
@@ -41,6 +41,13 @@ public:
      */
     DeviceBuilder& withRelayEnabled(bool enabled);
 
+    /**
+     * @brief Enable or disable neighbour discovery beacons
+     * @param enabled True to send beacons, false not to
+     * @return A reference to the updated builder
+     */
+    DeviceBuilder& withBeacons(bool enabled);
+
     /**
      * @brief Add a callback for received packets
      * @param callback The callback function to call when a packet is received
@@ -129,6 +136,7 @@ private:
     DevicePortalParams devicePortalParams;
 
     bool relayEnabled = false;
+    bool beaconsEnabled = false;
     PacketReceivedCallback rxCallback = nullptr;
     PacketSentCallback txCallback = nullptr;
     IDisplay* customDisplay = nullptr;
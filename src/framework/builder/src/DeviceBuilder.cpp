@@ -14,6 +14,7 @@ DeviceBuilder& DeviceBuilder::start()
                  .hasWifiAccessPoint = false,
                  .hasDevicePortal = false};
     relayEnabled = false;
+    beaconsEnabled = false;
     isBuilderStarted = true;
 
     // Initialize the serial port here since we need it for builder lo
@@ -59,6 +60,13 @@ DeviceBuilder& DeviceBuilder::withRelayEnabled(bool enabled)
     return *this;
 }
 
+DeviceBuilder& DeviceBuilder::withBeacons(bool enabled)
+{
+    loginfo_ln("Setting beacons enabled: %d", enabled);
+    beaconsEnabled = enabled;
+    return *this;
+}
+
 DeviceBuilder& DeviceBuilder::withSecureMessaging(const SecurityParams& params)
 {
     loginfo_ln("Setting secure messaging params");
@@ -180,6 +188,11 @@ IDevice* DeviceBuilder::build(const std::string name, std::array<byte, RM_ID_LEN
         logdbg_ln("Relay enabled.");
     }
 
+    if (beaconsEnabled) {
+        device->enableBeacons(true);
+        logdbg_ln("Beacons enabled.");
+    }
+
     if (blueprint.usesCrypto) {
         build_error = device->initializeAesCrypto(securityParams);
         if (build_error != RM_E_NONE) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,13 +11,18 @@
 #include <core/protocol/inc/crypto/EncryptionService.h>
 #include <core/protocol/inc/crypto/MicService.h>
 #include <core/protocol/inc/packet/Callbacks.h>
+#include <core/protocol/inc/routing/BeaconService.h>
 #include <core/protocol/inc/routing/PacketRouter.h>
+#include <core/protocol/inc/routing/RelayScheduler.h>
+#include <core/protocol/inc/routing/TopologyGraph.h>
+#include <core/protocol/inc/transport/ReliableTransfer.h>
 #include <framework/interfaces/IDevice.h>
 #include <hardware/inc/radio/LoraRadio.h>
 #include <hardware/inc/storage/eeprom/EEPROMStorage.h>
 
 #ifndef RM_NO_WIFI
 #include <framework/device_portal/inc/AsyncDevicePortal.h>
+#include <framework/device_portal/inc/TopologyMessage.h>
 #include <hardware/inc/wifi/WifiAccessPoint.h>
 #include <hardware/inc/wifi/WifiConnector.h>
 #endif
@@ -27,6 +33,12 @@
 
 #include "InclusionController.h"
 
+// Frame counters are reserved in storage this many at a time. A rebooted device counts on from the
+// end of its last reservation, so its packets are never taken for ones its neighbours saw.
+#ifndef RM_FCOUNTER_RESERVE
+#define RM_FCOUNTER_RESERVE 256
+#endif
+
 class RadioMeshDevice : public IDevice
 {
 public:
@@ -58,8 +70,14 @@ public:
 
     int sendData(const uint8_t topic, const std::vector<byte> data,
                  std::array<byte, RM_ID_LENGTH> target = BROADCAST_ADDR) override;
+    int sendReliableData(const uint8_t topic, const std::vector<byte>& data,
+                         std::array<byte, RM_ID_LENGTH> target,
+                         ReliableSendCallback onComplete = nullptr, void* context = nullptr,
+                         uint16_t* sequence = nullptr) override;
     void enableRelay(bool enabled) override;
     bool isRelayEnabled() override;
+    void enableBeacons(bool enabled) override;
+    bool isBeaconEnabled() override;
     int run() override;
     std::string getDeviceName() override;
     std::array<byte, RM_ID_LENGTH> getDeviceId() override;
@@ -76,6 +94,12 @@ public:
     bool isIncluded() const override;
     int factoryReset() override;
     int updateSecurityParams(const SecurityParams& params) override;
+    uint32_t getRxDropCount(RxDropReason reason) const override;
+    TxQueueStats getTxQueueStats() override;
+    ChannelAccessStats getChannelAccessStats() override;
+    AirtimeBudget getAirtimeBudget() override;
+    HopAckStats getHopAckStats() const override;
+    const TopologyGraph* getTopology() const override;
 
     // Device specific methods
 
@@ -127,7 +151,12 @@ public:
     }
 
     /**
-     * @brief Register a Tx callback function for when a packet is received
+     * @brief Register a Tx callback function for when a packet is sent
+     *
+     * The callback is called from run() once the radio is done with the packet, with the
+     * outcome of the transmission. Relayed packets are reported too, with their payload as
+     * relayed. Packets sent to a unicast next hop are reported once the hop acknowledged them,
+     * or with RM_E_HOP_ACK_TIMEOUT if it never did and they could not be flooded instead.
      *
      * @param callback  Callback function to register
      */
@@ -136,6 +165,36 @@ public:
         this->onPacketSent = callback;
     }
 
+    /**
+     * @brief Get the scheduler of the rebroadcasts this device makes as a relay
+     *
+     * @return RelayScheduler
+     */
+    const RelayScheduler& getRelayScheduler() const
+    {
+        return relayScheduler;
+    }
+
+    /**
+     * @brief Get the reliable message service, with the messages waiting for their acknowledgement
+     *
+     * @return ReliableTransfer
+     */
+    const ReliableTransfer& getReliableTransfer() const
+    {
+        return reliableTransfer;
+    }
+
+    /**
+     * @brief Get the neighbour discovery beacon service, with its interval and metrics
+     *
+     * @return BeaconService
+     */
+    const BeaconService& getBeaconService() const
+    {
+        return beaconService;
+    }
+
     /**
      * @brief Initialize the radio with the given parameters
      *
@@ -196,7 +255,7 @@ public:
     int initializeDevicePortal(DevicePortalParams devicePortalParams);
 
     /**
-     * @brief Handle received data
+     * @brief Handle the oldest frame queued by the radio, if any
      *
      * @return int RM_E_NONE if the data was successfully handled, an error code otherwise.
      */
@@ -207,6 +266,8 @@ private:
     std::array<byte, RM_ID_LENGTH> id;
     DeviceBlueprint blueprint;
     uint32_t packetCounter = 0;
+    // Highest frame counter reserved in storage
+    uint32_t packetCounterLimit = 0;
 
     std::unique_ptr<InclusionController> inclusionController; // Ownership
 
@@ -226,6 +287,10 @@ private:
     WifiConnector* wifiConnector = nullptr;
     WifiAccessPoint* wifiAccessPoint = nullptr;
     AsyncDevicePortal* devicePortal = nullptr;
+    // Portal clients that asked for the topology graph, answered from run() since the graph is
+    // only used from the device loop. A slot holds the client ID, 0 when free.
+    static const uint8_t TOPOLOGY_REQUEST_SLOTS = 4;
+    std::array<std::atomic<uint32_t>, TOPOLOGY_REQUEST_SLOTS> topologyRequests = {};
 #endif
 
     LoraRadioParams radioParams = LoraRadioParams();
@@ -239,11 +304,58 @@ private:
     PacketSentCallback onPacketSent = nullptr;
     PacketRouter* router = PacketRouter::getInstance();
 
-    RadioMeshPacket txPacket = RadioMeshPacket();
-
-    bool isReceivedDataCrcValid(RadioMeshPacket& receivedPacket);
-    bool verifyAndStripReceivedPacketMIC(RadioMeshPacket& receivedPacket);
+    // Packets handed to the radio, kept until onPacketSent is called with them. Those waiting for a
+    // hop ACK are kept until it arrives or times out, so there is one per transmit queue slot and
+    // one per hop ACK slot.
+    struct SentPacket
+    {
+        RadioMeshDevice* device = nullptr;
+        RadioMeshPacket packet;
+        bool relayed = false;
+        bool used = false;
+    };
+    std::array<SentPacket, RM_TX_QUEUE_SLOTS + RM_HOP_ACK_SLOTS> sentPackets;
+    RelayScheduler relayScheduler;
+    ReliableTransfer reliableTransfer;
+    BeaconService beaconService;
+    // Hubs only, created when the device becomes one
+    std::unique_ptr<TopologyGraph> topology;
+    // ID and frame counter of the next packet, reserved ahead so its key stream can be generated
+    // while the radio sends. Protocol packets sent meanwhile take the following counters.
+    std::array<byte, MSG_ID_LENGTH> nextPacketId;
+    uint32_t nextPacketFcounter = 0;
+    bool hasNextPacketId = false;
+    std::array<uint32_t, static_cast<size_t>(RxDropReason::COUNT)> rxDropCounts = {};
+
+    uint32_t nextFrameCounter();
+    void reserveFrameCounters();
+    void prepareNextPacket(uint8_t topic, size_t length, DeviceInclusionState inclusionState);
+    int handleReceivedFrame(const RxFrame& received);
+    bool isForThisDevice(const RadioMeshPacketView& receivedPacket) const;
+    int dropReceivedFrame(RxDropReason reason, int rc);
+    int relayFrame(const RadioMeshPacketView& frame);
+    bool isHopAddressedToUs(const RadioMeshPacketView& frame) const;
+    int sendProtocolPacket(uint8_t topic, const std::array<byte, RM_ID_LENGTH>& target,
+                           std::vector<byte> data, TxPriority priority);
+    int sendHopAck(const RadioMeshPacketView& frame);
+    void handleHopAck(const RadioMeshPacket& ack, const byte* nonce);
+    void handleReliableFrame(RadioMeshPacket& packet, const byte* nonce);
+    void serviceReliableTransfer();
+    void handleBeacon(const RadioMeshPacket& beacon, const byte* nonce, int8_t rssi);
+    void serviceBeacons();
+    void updateTopology(const byte* sourceId, const byte* lastHopId, uint8_t hopCount);
+#ifndef RM_NO_WIFI
+    void requestTopology(uint32_t clientId);
+    void serviceTopologyRequests();
+#endif
+    void serviceRelays();
+    bool isReceivedDataCrcValid(const RadioMeshPacketView& receivedPacket);
+    bool verifyReceivedPacketMIC(const RadioMeshPacketView& receivedPacket);
     bool canSendMessage(uint8_t topic) const;
     bool isInclusionMessage(uint8_t topic) const;
     bool isApplicationMessage(uint8_t topic) const;
+    TxPriority getTxPriority(uint8_t topic) const;
+    SentPacket* claimSentPacket(bool relayed);
+    static void onFrameSent(const TxFrame& frame, int err, void* context);
+    static bool isFloodRelayOf(const TxFrame& frame, void* context);
 };
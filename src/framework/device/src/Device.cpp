@@ -1,7 +1,11 @@
+#include <Arduino.h>
+#include <new>
 #include <string>
 #include <vector>
 
 #include <common/utils/RadioMeshCrc32.h>
+#include <core/protocol/inc/crypto/EcdhKeyCache.h>
+#include <core/protocol/inc/routing/DuplicateFilter.h>
 #include <core/protocol/inc/routing/RoutingTable.h>
 #include <framework/device/inc/Device.h>
 
@@ -10,6 +14,7 @@ RadioMeshDevice::RadioMeshDevice(const std::string& name, const std::array<byte,
     : name(name), id(id), deviceType(type), encryptionService(), micService(&encryptionService)
 {
     // InclusionController will be created in initialize() after storage is set up
+    setDeviceType(type);
 }
 
 bool RadioMeshDevice::isIncluded() const
@@ -44,6 +49,16 @@ std::string RadioMeshDevice::getDeviceName()
 void RadioMeshDevice::setDeviceType(MeshDeviceType type)
 {
     deviceType = type;
+    // Only a hub sees the whole network, the graph is too large for the other devices
+    if (type != MeshDeviceType::HUB) {
+        topology.reset();
+    } else if (!topology) {
+        // The hub works without it, it only loses the topology view
+        topology.reset(new (std::nothrow) TopologyGraph(id.data()));
+        if (!topology) {
+            logerr_ln("No memory for the topology graph, %d bytes", sizeof(TopologyGraph));
+        }
+    }
 }
 
 int RadioMeshDevice::initializeRadio(LoraRadioParams radioParams)
@@ -60,7 +75,10 @@ int RadioMeshDevice::initializeRadio(LoraRadioParams radioParams)
     if (rc != RM_E_NONE) {
         logerr_ln("Failed to set radio params");
         radio = nullptr;
+        return rc;
     }
+    // Link quality is judged against the SNR frames need at this spreading factor
+    RoutingTable::getInstance()->getNeighbors().setSpreadingFactor(radioParams.sf);
     return rc;
 }
 
@@ -227,6 +245,15 @@ int RadioMeshDevice::initializeDevicePortal(DevicePortalParams devicePortalParam
         return RM_E_UNKNOWN;
     }
 
+    // A hub answers the clients asking for its topology graph. Handlers run on the web server
+    // task, the request is answered from run().
+    if (deviceType == MeshDeviceType::HUB) {
+        devicePortalParams.eventHandlers.push_back(
+            {"get_topology", [this](void* client, const std::vector<byte>& data) {
+                 requestTopology(static_cast<AsyncWebSocketClient*>(client)->id());
+             }});
+    }
+
     rc = devicePortal->setParams(devicePortalParams);
     if (rc != RM_E_NONE) {
         logerr_ln("Failed to set device portal params");
@@ -240,6 +267,34 @@ IDevicePortal* RadioMeshDevice::getDevicePortal()
     return devicePortal;
 }
 
+void RadioMeshDevice::requestTopology(uint32_t clientId)
+{
+    for (auto& request : topologyRequests) {
+        uint32_t expected = 0;
+        if (request.load(std::memory_order_relaxed) == clientId ||
+            request.compare_exchange_strong(expected, clientId, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+    logwarn_ln("Too many topology requests, client #%u is not answered", clientId);
+}
+
+void RadioMeshDevice::serviceTopologyRequests()
+{
+    std::unique_ptr<TopologyMessage> message;
+    for (auto& request : topologyRequests) {
+        uint32_t clientId = request.exchange(0, std::memory_order_relaxed);
+        if (clientId == 0 || !topology || devicePortal == nullptr) {
+            continue;
+        }
+        // Built once for all the clients waiting
+        if (!message) {
+            message = std::make_unique<TopologyMessage>(*topology);
+        }
+        devicePortal->sendToClient(clientId, *message);
+    }
+}
+
 #endif // RM_NO_WIFI
 
 IRadio* RadioMeshDevice::getRadio()
@@ -280,14 +335,22 @@ int RadioMeshDevice::sendData(const uint8_t topic, const std::vector<byte> data,
         return RM_E_PACKET_TOO_LONG;
     }
 
-    txPacket.reset();
+    RadioMeshPacket txPacket;
     txPacket.topic = topic;
     txPacket.sourceDevId = this->id;
     txPacket.destDevId = target;
     txPacket.deviceType = this->deviceType;
-    txPacket.packetId = RadioMeshUtils::getRandomBytesArray<MSG_ID_LENGTH>();
+    // A reserved counter is given up once the receivers' duplicate windows may have moved past it
+    if (hasNextPacketId &&
+        packetCounter - nextPacketFcounter < DuplicateFilter::WINDOW_SIZE / 2) {
+        txPacket.packetId = nextPacketId;
+        txPacket.fcounter = nextPacketFcounter;
+    } else {
+        txPacket.packetId = RadioMeshUtils::getRandomBytesArray<MSG_ID_LENGTH>();
+        txPacket.fcounter = nextFrameCounter();
+    }
+    hasNextPacketId = false;
     txPacket.hopCount = 0;
-    txPacket.fcounter = ++packetCounter;
     txPacket.lastHopId = this->id;
     txPacket.nextHopId = BROADCAST_ADDR;
     txPacket.packetData = data;
@@ -296,26 +359,159 @@ int RadioMeshDevice::sendData(const uint8_t topic, const std::vector<byte> data,
     DeviceInclusionState currentState =
         inclusionController ? inclusionController->getState() : DeviceInclusionState::NOT_INCLUDED;
 
-    return router->routePacket(txPacket, this->id.data(), deviceType, currentState);
+    // Without a Tx callback there is nothing to report, the packet is not kept
+    SentPacket* sent = onPacketSent != nullptr ? claimSentPacket(false) : nullptr;
+    int rc = router->routePacket(txPacket, this->id.data(), deviceType, currentState,
+                                 getTxPriority(topic),
+                                 sent != nullptr ? &RadioMeshDevice::onFrameSent : nullptr, sent);
+    if (sent != nullptr) {
+        // Completions are only reported from run(), so the packet can be stored after queuing
+        if (rc == RM_E_NONE) {
+            sent->packet = std::move(txPacket);
+        } else {
+            sent->used = false;
+        }
+    }
+
+    // The radio is busy sending, get the next packet ready meanwhile
+    if (rc == RM_E_NONE) {
+        prepareNextPacket(topic, data.size(), currentState);
+    }
+    return rc;
+}
+
+int RadioMeshDevice::sendReliableData(const uint8_t topic, const std::vector<byte>& data,
+                                      std::array<byte, RM_ID_LENGTH> target,
+                                      ReliableSendCallback onComplete, void* context,
+                                      uint16_t* sequence)
+{
+    if (!canSendMessage(topic)) {
+        logerr_ln("Device not authorized to send messages");
+        return RM_E_DEVICE_NOT_INCLUDED;
+    }
+    if (!isApplicationMessage(topic)) {
+        logerr_ln("Reliable messages need an application topic, got 0x%02X", topic);
+        return RM_E_INVALID_PARAM;
+    }
+    if (RadioMeshUtils::isBroadcastAddress(target) || target == this->id) {
+        logerr_ln("Reliable messages need a single target device");
+        return RM_E_INVALID_PARAM;
+    }
+    if (data.size() > ReliableTransfer::MAX_MESSAGE_LENGTH) {
+        logerr_ln("Data too large: %d bytes, maximum: %d", data.size(),
+                  ReliableTransfer::MAX_MESSAGE_LENGTH);
+        return RM_E_PACKET_TOO_LONG;
+    }
+
+    // Sent from run(), with the messages already waiting
+    int rc = reliableTransfer.send(target, topic, data, onComplete, context, sequence);
+    if (rc != RM_E_NONE) {
+        logwarn_ln("No room for a reliable message to %s. rc = %d",
+                   RadioMeshUtils::convertToHex(target.data(), DEV_ID_LENGTH).c_str(), rc);
+    }
+    return rc;
+}
+
+TxPriority RadioMeshDevice::getTxPriority(uint8_t topic) const
+{
+    if (isInclusionMessage(topic)) {
+        return TxPriority::INCLUSION;
+    }
+    if (TopicUtils::isAck(topic)) {
+        return TxPriority::ACK;
+    }
+    return TxPriority::APPLICATION;
 }
 
-bool RadioMeshDevice::isReceivedDataCrcValid(RadioMeshPacket& receivedPacket)
+RadioMeshDevice::SentPacket* RadioMeshDevice::claimSentPacket(bool relayed)
+{
+    for (auto& sent : sentPackets) {
+        if (!sent.used) {
+            sent.device = this;
+            sent.relayed = relayed;
+            sent.used = true;
+            return &sent;
+        }
+    }
+    // One entry per transmit queue slot and per hop ACK slot, this only happens if both are full
+    logwarn_ln("No room to keep the sent packet, it will not be reported");
+    return nullptr;
+}
+
+bool RadioMeshDevice::isFloodRelayOf(const TxFrame& frame, void* context)
+{
+    RadioMeshPacketView view(frame.data, frame.length);
+    return frame.priority == TxPriority::RELAY && !view.hasUnicastNextHop() &&
+           view.getPacketIdKey() == *static_cast<uint32_t*>(context);
+}
+
+void RadioMeshDevice::onFrameSent(const TxFrame& frame, int err, void* context)
+{
+    SentPacket* sent = static_cast<SentPacket*>(context);
+    if (sent->relayed) {
+        // Relayed packets are reported as they went out, the payload is still encrypted
+        sent->packet = RadioMeshPacketView(frame.data, frame.length).toPacket();
+    }
+    if (sent->device->onPacketSent != nullptr) {
+        logdbg_ln("Calling onPacketSent callback");
+        sent->device->onPacketSent(&sent->packet, err);
+    }
+    sent->packet.reset();
+    sent->used = false;
+}
+
+uint32_t RadioMeshDevice::nextFrameCounter()
+{
+    if (++packetCounter > packetCounterLimit) {
+        reserveFrameCounters();
+    }
+    return packetCounter;
+}
+
+void RadioMeshDevice::reserveFrameCounters()
+{
+    packetCounterLimit = packetCounter + RM_FCOUNTER_RESERVE;
+    if (eepromStorage == nullptr) {
+        return;
+    }
+    int rc = DeviceStorage(eepromStorage).persistMessageCounter(packetCounterLimit);
+    if (rc != RM_E_NONE) {
+        logwarn_ln("Failed to persist the frame counter: %d", rc);
+    }
+}
+
+void RadioMeshDevice::prepareNextPacket(uint8_t topic, size_t length,
+                                        DeviceInclusionState inclusionState)
+{
+    nextPacketId = RadioMeshUtils::getRandomBytesArray<MSG_ID_LENGTH>();
+    nextPacketFcounter = nextFrameCounter();
+    hasNextPacketId = true;
+
+    // Assume the next packet looks like this one, the key stream is dropped otherwise
+    byte fcounter[FCOUNTER_LENGTH];
+    RadioMeshPacket::writeUint32(fcounter, nextPacketFcounter);
+    byte nonce[PacketNonce::SIZE];
+    PacketNonce::build(RM_PROTOCOL_VERSION, this->id.data(), nextPacketId.data(), fcounter, nonce);
+    encryptionService.precomputeKeystream(topic, deviceType, inclusionState, nonce, length);
+}
+
+bool RadioMeshDevice::isReceivedDataCrcValid(const RadioMeshPacketView& receivedPacket)
 {
     RadioMeshUtils::CRC32 crc32;
-    crc32.update(receivedPacket.fcounter);
+    crc32.update(receivedPacket.getFcounter());
 
     // CRC covers payload without MIC, mirroring the sender (PacketRouter computes CRC before
-    // appending the MIC). For topics without a MIC, getDataWithoutMIC returns the full payload.
-    std::vector<byte> dataForCrc = receivedPacket.getDataWithoutMIC();
+    // appending the MIC). For topics without a MIC, getPayload returns the full data section.
+    ByteSpan dataForCrc = receivedPacket.getPayload();
     if (!dataForCrc.empty()) {
-        crc32.update(dataForCrc.data(), dataForCrc.size());
+        crc32.update(dataForCrc.data, dataForCrc.size);
     }
     uint32_t computed_data_crc = crc32.finalize();
     crc32.reset();
 
-    if (computed_data_crc != receivedPacket.packetCrc) {
+    if (computed_data_crc != receivedPacket.getPacketCrc()) {
         logerr_ln("ERROR data crc mismatch: received: 0x%X, calculated: 0x%X",
-                  receivedPacket.packetCrc, computed_data_crc);
+                  receivedPacket.getPacketCrc(), computed_data_crc);
         return false;
     }
     return true;
@@ -323,48 +519,148 @@ bool RadioMeshDevice::isReceivedDataCrcValid(RadioMeshPacket& receivedPacket)
 
 int RadioMeshDevice::handleReceivedData()
 {
-    std::vector<byte> dataBytes;
+    // The oldest frame queued by the radio is processed where it sits in the RX ring, and released
+    // when done with
+    const RxFrame* received = radio->peekReceivedFrame();
+    if (received == nullptr) {
+        return RM_E_NONE;
+    }
+    int rc = handleReceivedFrame(*received);
+    radio->releaseReceivedFrame();
+    return rc;
+}
+
+int RadioMeshDevice::handleReceivedFrame(const RxFrame& received)
+{
+    int rc = RM_E_NONE;
+    size_t frameLength = received.length;
 
     logtrace_ln("handleReceivedPacket() START...");
 
-    // Read the received data from the radio and create a RadioMeshPacket object
-    int rc = radio->readReceivedData(&dataBytes);
+    // Duplicate, CRC and MIC checks work on a view over the frame, so rejected and duplicate
+    // frames cost no allocation.
+    RadioMeshPacketView frame(received.data, frameLength);
 
-    if (rc != RM_E_NONE) {
-        logerr_ln("ERROR handleReceivedPacket. Failed to get data. rc = %d", rc);
-        return rc;
+    // Header checks, cheapest first. They read fixed header offsets and reject the frames that
+    // would be thrown away anyway before any CRC, MIC or decryption work.
+    if (!frame.isValid()) {
+        logerr_ln("ERROR handleReceivedPacket. Invalid packet length: %d", frameLength);
+        return dropReceivedFrame(RxDropReason::INVALID_LENGTH, RM_E_INVALID_LENGTH);
     }
 
-    RadioMeshPacket receivedPacket = RadioMeshPacket(dataBytes);
-    receivedPacket.log();
+    if (!frame.hasSupportedVersion()) {
+        logerr_ln("ERROR handleReceivedPacket. Unsupported protocol version: %d",
+                  frame.getProtocolVersion());
+        return dropReceivedFrame(RxDropReason::UNSUPPORTED_VERSION, RM_E_NOT_SUPPORTED);
+    }
+
+    // Relays echo every packet we send
+    if (frame.getSourceDevId() == this->id) {
+        logdbg_ln("Own packet echoed by a relay. Ignoring...");
+        return dropReceivedFrame(RxDropReason::OWN_ECHO, RM_E_NONE);
+    }
+
+    // Packets for someone else are only useful to relay them
+    bool forUs = isForThisDevice(frame);
+    if (frame.getHopCount() > MAX_HOPS || (!forUs && frame.getHopCount() >= MAX_HOPS)) {
+        logdbg_ln("Hop limit reached. Ignoring...");
+        return dropReceivedFrame(RxDropReason::HOP_LIMIT, RM_E_NONE);
+    }
+
+    if (!forUs && frame.hasUnicastNextHop() && frame.getNextHopId() != this->id) {
+        logdbg_ln("Relay hop addressed to another device. Ignoring...");
+        return dropReceivedFrame(RxDropReason::NOT_NEXT_HOP, RM_E_NONE);
+    }
 
     // skip already seen packets
-    if (router->isPacketFoundInTracker(receivedPacket)) {
+    if (router->isPacketFoundInTracker(frame)) {
         logwarn_ln("Packet already seen. Ignoring...");
-        return RM_E_NONE;
+        // A neighbour relayed it, our own rebroadcast may no longer be needed
+        uint32_t packetKey = frame.getPacketIdKey();
+        relayScheduler.onCopyHeard(packetKey);
+        // Among many neighbours, the copy also ends a rebroadcast already handed to the radio and
+        // waiting for the channel, which was busy with this very packet
+        if (RoutingTable::getInstance()->getNeighbors().countHeard(millis()) >=
+                RM_RELAY_DENSE_NEIGHBORS &&
+            radio->cancelWaitingTxFrame(&RadioMeshDevice::isFloodRelayOf, &packetKey)) {
+            loginfo_ln("Relay of packet 0x%X given up, a neighbour relayed it", packetKey);
+        }
+        // A copy relayed by another neighbour may show another path back to the source, and the
+        // previous hop sends again until an ACK gets through, ours may have been lost. Other
+        // copies are dropped from the header, without verifying their MIC.
+        bool learnPath = RoutingTable::getInstance()->canLearnFrom(frame, millis());
+        if ((learnPath || isHopAddressedToUs(frame)) && verifyReceivedPacketMIC(frame)) {
+            if (learnPath) {
+                RoutingTable::getInstance()->updateRoute(frame, static_cast<int>(received.rssi),
+                                                         received.snr);
+                updateTopology(frame.getSourceDevId().data(), frame.getLastHopId().data(),
+                               frame.getHopCount());
+            }
+            if (isHopAddressedToUs(frame)) {
+                sendHopAck(frame);
+            }
+        }
+        return dropReceivedFrame(RxDropReason::DUPLICATE, RM_E_NONE);
     }
 
-    if (!isReceivedDataCrcValid(receivedPacket)) {
+    if (!isReceivedDataCrcValid(frame)) {
         logerr_ln("ERROR handleReceivedPacket. Data CRC mismatch");
-        return RM_E_PACKET_CORRUPTED;
+        return dropReceivedFrame(RxDropReason::CRC_MISMATCH, RM_E_PACKET_CORRUPTED);
     }
 
     // Verify MIC before any further processing
-    if (!verifyAndStripReceivedPacketMIC(receivedPacket)) {
+    if (!verifyReceivedPacketMIC(frame)) {
         logerr_ln("ERROR handleReceivedPacket. MIC verification failed");
-        return RM_E_AUTH_FAILED;
+        return dropReceivedFrame(RxDropReason::MIC_FAILURE, RM_E_AUTH_FAILED);
+    }
+
+    // Only an authenticated frame may move the source's frame counter window
+    router->markPacketSeen(frame);
+
+    // Acknowledge the hop first, so the ACK is queued while the frame is processed
+    if (isHopAddressedToUs(frame)) {
+        sendHopAck(frame);
     }
 
+    // The frame is accepted, build the packet without the MIC for further processing
+    RadioMeshPacket receivedPacket = frame.toPacket();
+    receivedPacket.log();
+
+    // Initial AES-CTR counter block of the payload, all zeros for version 4 frames
+    byte nonce[PacketNonce::SIZE];
+    PacketNonce::fromHeader(received.data, nonce);
+
     // Update routing table with information from received packet
     // We do this for all valid packets, even if they're for us
-    int lastRssi = radio->getRSSI();
-    RoutingTable::getInstance()->updateRoute(receivedPacket, lastRssi);
+    int lastRssi = static_cast<int>(received.rssi);
+    RoutingTable::getInstance()->updateRoute(receivedPacket, lastRssi, received.snr);
+    updateTopology(receivedPacket.sourceDevId.data(), receivedPacket.lastHopId.data(),
+                   receivedPacket.hopCount);
     logdbg_ln(
         "Updated route table for source: %s, last hop: %s, RSSI: %d",
         RadioMeshUtils::convertToHex(receivedPacket.sourceDevId.data(), DEV_ID_LENGTH).c_str(),
         RadioMeshUtils::convertToHex(receivedPacket.lastHopId.data(), DEV_ID_LENGTH).c_str(),
         lastRssi);
 
+    // Hop ACKs end here, they are neither relayed nor handed to the application
+    if (TopicUtils::isAck(receivedPacket.topic)) {
+        handleHopAck(receivedPacket, nonce);
+        return RM_E_NONE;
+    }
+
+    // Beacons are for the neighbours only, neither relayed nor handed to the application
+    if (TopicUtils::isPing(receivedPacket.topic) || TopicUtils::isPong(receivedPacket.topic)) {
+        handleBeacon(receivedPacket, nonce, static_cast<int8_t>(lastRssi));
+        return RM_E_NONE;
+    }
+
+    // Reliable messages and their ACKs belong to the reliable message service of their destination
+    bool reliable = TopicUtils::isReliableTransfer(receivedPacket.topic);
+    if (reliable && receivedPacket.destDevId == this->id) {
+        handleReliableFrame(receivedPacket, nonce);
+        return RM_E_NONE;
+    }
+
     // Check if this is an inclusion message and handle it automatically
     if (isInclusionMessage(receivedPacket.topic)) {
         logdbg_ln("Received inclusion message with topic: 0x%02X", receivedPacket.topic);
@@ -372,7 +668,7 @@ int RadioMeshDevice::handleReceivedData()
         // Decrypt packet data if this device is the destination
         receivedPacket.packetData =
             encryptionService.decrypt(receivedPacket.packetData, receivedPacket.topic,
-                                     deviceType, inclusionController->getState());
+                                      deviceType, inclusionController->getState(), nonce);
 
         // Let the InclusionController handle it automatically
         int result = inclusionController->handleInclusionMessage(receivedPacket);
@@ -394,11 +690,11 @@ int RadioMeshDevice::handleReceivedData()
     if (isApplicationMessage(receivedPacket.topic)) {
         receivedPacket.packetData =
             encryptionService.decrypt(receivedPacket.packetData, receivedPacket.topic,
-                                     deviceType, inclusionController->getState());
+                                      deviceType, inclusionController->getState(), nonce);
     }
 
     // Packet has reached its destination or the device is a HUB, let the application handle it
-    if (onPacketReceived != nullptr) {
+    if (onPacketReceived != nullptr && !reliable) {
         logdbg_ln("Calling onPacketReceived callback");
         onPacketReceived(&receivedPacket, RM_E_NONE);
     }
@@ -410,11 +706,18 @@ int RadioMeshDevice::handleReceivedData()
     }
     // Only a standard device with relay enabled should route the packet
     if (this->deviceType == MeshDeviceType::STANDARD && relayEnabled) {
+        // A hop addressed to us is ours alone to relay. A flooded packet is rebroadcast after a
+        // backoff, unless enough neighbours relay it first.
+        if (!frame.hasUnicastNextHop() &&
+            relayScheduler.schedule(
+                frame, received.rssi, received.snr, radio->getTimeOnAirMs(received.length),
+                RoutingTable::getInstance()->getNeighbors().countHeard(millis()), millis())) {
+            loginfo_ln("Router device. Relay of packet 0x%X scheduled", frame.getPacketIdKey());
+            router->trackPendingRelay(frame);
+            return RM_E_NONE;
+        }
         loginfo_ln("Router device. Routing received packet...");
-        DeviceInclusionState currentState = inclusionController
-                                                ? inclusionController->getState()
-                                                : DeviceInclusionState::NOT_INCLUDED;
-        rc = router->routePacket(receivedPacket, this->id.data(), deviceType, currentState);
+        rc = relayFrame(frame);
         if (rc != RM_E_NONE) {
             logerr_ln("ERROR handleReceivedPacket. Failed to route packet. rc = %d", rc);
             return rc;
@@ -425,9 +728,273 @@ int RadioMeshDevice::handleReceivedData()
     return RM_E_NONE;
 }
 
+int RadioMeshDevice::relayFrame(const RadioMeshPacketView& frame)
+{
+    DeviceInclusionState currentState =
+        inclusionController ? inclusionController->getState() : DeviceInclusionState::NOT_INCLUDED;
+    SentPacket* sent = onPacketSent != nullptr ? claimSentPacket(true) : nullptr;
+    int rc = router->relayFrame(frame, this->id.data(), deviceType, currentState,
+                                sent != nullptr ? &RadioMeshDevice::onFrameSent : nullptr, sent);
+    if (rc != RM_E_NONE && sent != nullptr) {
+        sent->used = false;
+    }
+    return rc;
+}
+
+void RadioMeshDevice::serviceRelays()
+{
+    const RelayScheduler::PendingRelay* relay;
+    while ((relay = relayScheduler.getDue(millis())) != nullptr) {
+        int rc = relayFrame(relay->getFrame());
+        if (rc == RM_E_QUEUE_FULL) {
+            // Retried on the next run, once queued frames went out
+            return;
+        }
+        if (rc != RM_E_NONE) {
+            logerr_ln("ERROR failed to relay packet 0x%X. rc = %d", relay->packetKey, rc);
+        }
+        relayScheduler.release(relay);
+    }
+}
+
+bool RadioMeshDevice::isHopAddressedToUs(const RadioMeshPacketView& frame) const
+{
+    return PacketRouter::requiresHopAck(frame) && frame.getNextHopId() == this->id;
+}
+
+int RadioMeshDevice::sendProtocolPacket(uint8_t topic,
+                                        const std::array<byte, RM_ID_LENGTH>& target,
+                                        std::vector<byte> data, TxPriority priority)
+{
+    RadioMeshPacket packet;
+    packet.topic = topic;
+    packet.sourceDevId = this->id;
+    packet.destDevId = target;
+    packet.deviceType = this->deviceType;
+    packet.packetId = RadioMeshUtils::getRandomBytesArray<MSG_ID_LENGTH>();
+    packet.hopCount = 0;
+    packet.fcounter = nextFrameCounter();
+    packet.lastHopId = this->id;
+    packet.nextHopId = BROADCAST_ADDR;
+    packet.packetData = std::move(data);
+
+    DeviceInclusionState currentState =
+        inclusionController ? inclusionController->getState() : DeviceInclusionState::NOT_INCLUDED;
+    return router->routePacket(packet, this->id.data(), deviceType, currentState, priority);
+}
+
+int RadioMeshDevice::sendHopAck(const RadioMeshPacketView& frame)
+{
+    std::array<byte, MSG_ID_LENGTH> ackedId = frame.getPacketId();
+    int rc = sendProtocolPacket(MessageTopic::ACK, frame.getLastHopId(),
+                                std::vector<byte>(ackedId.begin(), ackedId.end()), TxPriority::ACK);
+    if (rc != RM_E_NONE) {
+        logwarn_ln("Failed to acknowledge packet 0x%X. rc = %d", frame.getPacketIdKey(), rc);
+    }
+    return rc;
+}
+
+void RadioMeshDevice::handleHopAck(const RadioMeshPacket& ack, const byte* nonce)
+{
+    // The hub sees every ACK, only ours complete a frame
+    if (ack.destDevId != this->id) {
+        return;
+    }
+    std::vector<byte> ackedId = encryptionService.decrypt(ack.packetData, ack.topic, deviceType,
+                                                          inclusionController->getState(), nonce);
+    if (ackedId.size() != MSG_ID_LENGTH) {
+        logwarn_ln("Invalid hop ACK, %d data bytes", ackedId.size());
+        return;
+    }
+    router->onHopAck(RadioMeshUtils::toUint32(ackedId.data()), ack.sourceDevId.data());
+}
+
+void RadioMeshDevice::handleReliableFrame(RadioMeshPacket& packet, const byte* nonce)
+{
+    std::vector<byte> payload = encryptionService.decrypt(packet.packetData, packet.topic,
+                                                          deviceType,
+                                                          inclusionController->getState(), nonce);
+    if (packet.topic == MessageTopic::RELIABLE_ACK) {
+        if (!reliableTransfer.onAck(packet.sourceDevId.data(), payload, millis())) {
+            logwarn_ln("Invalid reliable ACK, %d data bytes", payload.size());
+        }
+        return;
+    }
+
+    uint8_t topic;
+    std::vector<byte> data;
+    switch (reliableTransfer.onData(packet.sourceDevId.data(), payload, millis(), &topic, &data)) {
+    case ReliableTransfer::Receipt::NEW:
+        // The application sees the message under its own topic
+        if (onPacketReceived != nullptr) {
+            packet.topic = topic;
+            packet.packetData = std::move(data);
+            logdbg_ln("Calling onPacketReceived callback");
+            onPacketReceived(&packet, RM_E_NONE);
+        }
+        break;
+    case ReliableTransfer::Receipt::DUPLICATE:
+        logdbg_ln("Reliable message received again. Acknowledging...");
+        break;
+    case ReliableTransfer::Receipt::DROPPED:
+        logwarn_ln("Reliable message from %s dropped",
+                   RadioMeshUtils::convertToHex(packet.sourceDevId.data(), DEV_ID_LENGTH).c_str());
+        break;
+    }
+}
+
+void RadioMeshDevice::serviceReliableTransfer()
+{
+    uint32_t now = millis();
+    ReliableTransfer::Ack ack;
+    while (reliableTransfer.getAckDue(now, &ack)) {
+        int rc = sendProtocolPacket(MessageTopic::RELIABLE_ACK, ack.target, ack.getPayload(),
+                                    TxPriority::ACK);
+        if (rc != RM_E_NONE) {
+            // The source sends the messages again, they are acknowledged then
+            logwarn_ln("Failed to acknowledge reliable messages from %s. rc = %d",
+                       RadioMeshUtils::convertToHex(ack.target.data(), DEV_ID_LENGTH).c_str(), rc);
+        }
+    }
+
+    ReliableTransfer::Message* message;
+    while ((message = reliableTransfer.getDue(now)) != nullptr) {
+        int rc = sendProtocolPacket(MessageTopic::RELIABLE_DATA, message->target,
+                                    message->getPayload(), TxPriority::APPLICATION);
+        if (rc == RM_E_QUEUE_FULL) {
+            // Retried on the next run, once queued frames went out
+            return;
+        }
+        if (rc != RM_E_NONE) {
+            logerr_ln("ERROR failed to send reliable message %u. rc = %d", message->sequence, rc);
+        }
+        // A message that did not go out times out and is sent again like a lost one
+        reliableTransfer.onSent(message, now);
+    }
+}
+
+void RadioMeshDevice::handleBeacon(const RadioMeshPacket& beacon, const byte* nonce, int8_t rssi)
+{
+    // Only the beacons heard directly, after their first transmission, describe a neighbour
+    if (beacon.hopCount != 1) {
+        return;
+    }
+    std::vector<byte> listed = encryptionService.decrypt(beacon.packetData, beacon.topic,
+                                                         deviceType,
+                                                         inclusionController->getState(), nonce);
+    if (listed.size() % DEV_ID_LENGTH != 0) {
+        logwarn_ln("Invalid beacon, %d data bytes", listed.size());
+        return;
+    }
+    // The sender hears every device it lists, they are two hops away through it if our own link
+    // to the sender is as good as the ones it lists
+    RoutingTable* routingTable = RoutingTable::getInstance();
+    bool goodLink = routingTable->getNeighbors().getLinkCost(beacon.sourceDevId.data()) <=
+                    BeaconService::MAX_LISTED_LINK_COST;
+    bool listsUs = false;
+    for (size_t i = 0; i < listed.size(); i += DEV_ID_LENGTH) {
+        if (std::equal(this->id.begin(), this->id.end(), listed.begin() + i)) {
+            listsUs = true;
+        } else if (goodLink && !std::equal(beacon.sourceDevId.begin(),
+                                           beacon.sourceDevId.end(), listed.begin() + i)) {
+            routingTable->updateTwoHopRoute(&listed[i], beacon.sourceDevId.data(), rssi);
+        }
+        if (topology) {
+            topology->onBeacon(beacon.sourceDevId.data(), &listed[i], millis());
+        }
+    }
+    beaconService.onBeacon(beacon.topic, listed.size() / DEV_ID_LENGTH, listsUs, millis());
+}
+
+void RadioMeshDevice::serviceBeacons()
+{
+    if (!beaconService.isEnabled() || !canSendMessage(MessageTopic::PING)) {
+        return;
+    }
+    uint32_t now = millis();
+    const NeighborTable& neighbors = RoutingTable::getInstance()->getNeighbors();
+    beaconService.checkNeighbors(neighbors, now);
+    uint8_t topic;
+    if (!beaconService.isDue(now, &topic)) {
+        return;
+    }
+    int rc = sendProtocolPacket(topic, BROADCAST_ADDR, beaconService.buildPayload(neighbors, now),
+                                TxPriority::APPLICATION);
+    if (rc == RM_E_QUEUE_FULL) {
+        // Retried on the next run, once queued frames went out
+        return;
+    }
+    if (rc != RM_E_NONE) {
+        logerr_ln("ERROR failed to send beacon. rc = %d", rc);
+    }
+    beaconService.onSent();
+}
+
+bool RadioMeshDevice::isForThisDevice(const RadioMeshPacketView& receivedPacket) const
+{
+    // The hub is a final destination for all packets
+    if (this->deviceType == MeshDeviceType::HUB) {
+        return true;
+    }
+    std::array<byte, RM_ID_LENGTH> destination = receivedPacket.getDestDevId();
+    return destination == this->id || destination == BROADCAST_ADDR;
+}
+
+int RadioMeshDevice::dropReceivedFrame(RxDropReason reason, int rc)
+{
+    rxDropCounts[static_cast<size_t>(reason)]++;
+    return rc;
+}
+
+uint32_t RadioMeshDevice::getRxDropCount(RxDropReason reason) const
+{
+    if (reason >= RxDropReason::COUNT) {
+        return 0;
+    }
+    return rxDropCounts[static_cast<size_t>(reason)];
+}
+
+TxQueueStats RadioMeshDevice::getTxQueueStats()
+{
+    return radio != nullptr ? radio->getTxQueueStats() : TxQueueStats();
+}
+
+ChannelAccessStats RadioMeshDevice::getChannelAccessStats()
+{
+    return radio != nullptr ? radio->getChannelAccessStats() : ChannelAccessStats();
+}
+
+AirtimeBudget RadioMeshDevice::getAirtimeBudget()
+{
+    return radio != nullptr ? radio->getAirtimeBudget() : AirtimeBudget();
+}
+
+HopAckStats RadioMeshDevice::getHopAckStats() const
+{
+    return router->getHopAckStats();
+}
+
+const TopologyGraph* RadioMeshDevice::getTopology() const
+{
+    return topology.get();
+}
+
+void RadioMeshDevice::updateTopology(const byte* sourceId, const byte* lastHopId,
+                                     uint8_t hopCount)
+{
+    if (!topology) {
+        return;
+    }
+    uint16_t lastHopCost = RoutingTable::getInstance()->getNeighbors().getLinkCost(lastHopId);
+    topology->onPacket(sourceId, lastHopId, hopCount, lastHopCost, millis());
+}
+
 void RadioMeshDevice::enableRelay(bool enabled)
 {
     relayEnabled = enabled;
+    if (!enabled) {
+        relayScheduler.clear();
+    }
 }
 
 bool RadioMeshDevice::isRelayEnabled()
@@ -435,11 +1002,26 @@ bool RadioMeshDevice::isRelayEnabled()
     return relayEnabled;
 }
 
+void RadioMeshDevice::enableBeacons(bool enabled)
+{
+    if (enabled && !beaconService.isEnabled()) {
+        beaconService.start(millis());
+    } else if (!enabled) {
+        beaconService.stop();
+    }
+}
+
+bool RadioMeshDevice::isBeaconEnabled()
+{
+    return beaconService.isEnabled();
+}
+
 int RadioMeshDevice::run()
 {
     inclusionController->checkProtocolTimeouts();
 
-    // handle radio Rx/Tx events
+    // handle radio Rx/Tx events. Without an interrupt task the radio is drained here.
+    radio->serviceInterrupts();
     if (radio->checkAndClearRxFlag()) {
         logtrace_ln("Packet RX done");
         int radioErr = radio->getRadioStateError();
@@ -451,26 +1033,48 @@ int RadioMeshDevice::run()
             return radioErr;
         }
 
-        // Handle received data and invoke the callback with the received packet
-        int rc = handleReceivedData();
-        // Report error if any
-        if (rc != RM_E_NONE) {
-            logerr_ln("ERROR handleReceivedData failed with rc = %d", rc);
-            if (onPacketReceived != nullptr) {
-                onPacketReceived(nullptr, rc);
+        // Handle every frame queued since the last call and invoke the callback with each
+        // received packet. Report errors as they occur, return the first one.
+        int rc = RM_E_NONE;
+        while (radio->peekReceivedFrame() != nullptr) {
+            int frameRc = handleReceivedData();
+            if (frameRc != RM_E_NONE) {
+                logerr_ln("ERROR handleReceivedData failed with rc = %d", frameRc);
+                if (onPacketReceived != nullptr) {
+                    onPacketReceived(nullptr, frameRc);
+                }
+                if (rc == RM_E_NONE) {
+                    rc = frameRc;
+                }
             }
+        }
+        if (rc != RM_E_NONE) {
             return rc;
         }
     }
+    // Rebroadcast the relayed packets whose backoff expired
+    serviceRelays();
+    // Send again the unicast hops whose ACK timed out
+    router->serviceHopAcks();
+    // Send the reliable messages and acknowledgements that are due
+    serviceReliableTransfer();
+    // Send the neighbour discovery beacon when its interval calls for it
+    serviceBeacons();
+    // Forget the links of the network no longer observed
+    if (topology) {
+        topology->removeExpired(millis());
+    }
+#ifndef RM_NO_WIFI
+    // Answer the portal clients that asked for the topology graph
+    serviceTopologyRequests();
+#endif
+
+    // The radio already moved on to the next queued frame, or back to receive. Report the frames
+    // sent since the last call.
     if (radio->checkAndClearTxFlag()) {
         logtrace_ln("Packet TX done");
-        int radioErr = radio->getRadioStateError();
-        if (onPacketSent != nullptr) {
-            logdbg_ln("Calling onPacketSent callback");
-            onPacketSent(&txPacket, radioErr);
-        }
-        radio->startReceive();
     }
+    radio->dispatchTxCompletions();
 
     return RM_E_NONE;
 }
@@ -534,6 +1138,13 @@ int RadioMeshDevice::initialize()
         return rc;
     }
 
+    // Count on past every frame counter the device may have used before it rebooted
+    uint32_t storedCounter = 0;
+    if (DeviceStorage(eepromStorage).loadMessageCounter(storedCounter) == RM_E_NONE) {
+        packetCounter = storedCounter;
+    }
+    reserveFrameCounters();
+
     inclusionController = std::make_unique<InclusionController>(*this);
 
     // Configure what we need for performing inclusion
@@ -578,8 +1189,16 @@ int RadioMeshDevice::factoryReset()
         return rc;
     }
 
-    // Reset frame counter
-    packetCounter = 0;
+    // The frame counter carries on, neighbours still remember the counters used before the reset
+    reserveFrameCounters();
+    relayScheduler.clear();
+    reliableTransfer.clear();
+    if (beaconService.isEnabled()) {
+        beaconService.start(millis());
+    }
+
+    // Wipe the keys derived for inclusion peers
+    EcdhKeyCache::getInstance()->clear();
 
     // Recreate inclusion controller to reset its state
     if (inclusionController != nullptr) {
@@ -618,48 +1237,20 @@ int RadioMeshDevice::updateSecurityParams(const SecurityParams& params)
     return RM_E_NONE;
 }
 
-bool RadioMeshDevice::verifyAndStripReceivedPacketMIC(RadioMeshPacket& receivedPacket)
+bool RadioMeshDevice::verifyReceivedPacketMIC(const RadioMeshPacketView& receivedPacket)
 {
-    // Public key exchange messages don't have MIC
-    if (receivedPacket.topic == MessageTopic::INCLUDE_OPEN ||
-        receivedPacket.topic == MessageTopic::INCLUDE_REQUEST) {
-        logdbg_ln("Public key exchange message (0x%02X) - no MIC verification needed", 
-                  receivedPacket.topic);
-        return true;
-    }
-
-    // Check if packet has MIC
-    if (!receivedPacket.hasMIC()) {
-        logerr_ln("Packet missing MIC for topic 0x%02X", receivedPacket.topic);
-        return false;
-    }
-
-    // Use Device's own MicService instance
-
-    // Extract MIC and payload without MIC
-    std::vector<byte> receivedMic = receivedPacket.extractMIC();
-    std::vector<byte> payloadWithoutMic = receivedPacket.getDataWithoutMIC();
-
-    // Get header bytes for MIC computation
-    std::vector<byte> header = receivedPacket.getHeaderBytes();
-
     DeviceInclusionState currentState = inclusionController
-                                           ? inclusionController->getState()
-                                           : DeviceInclusionState::NOT_INCLUDED;
+                                            ? inclusionController->getState()
+                                            : DeviceInclusionState::NOT_INCLUDED;
 
-    bool isValid = micService.verifyPacketMIC(header, payloadWithoutMic, receivedMic,
-                                             receivedPacket.topic, deviceType, currentState);
-
-    if (!isValid) {
+    // Public key exchange messages have no MIC, MicService accepts them as is
+    if (!micService.verifyPacketMIC(receivedPacket, deviceType, currentState)) {
         logerr_ln("MIC verification FAILED for packet from device %s, topic 0x%02X",
-                 RadioMeshUtils::convertToHex(receivedPacket.sourceDevId.data(), DEV_ID_LENGTH).c_str(),
-                 receivedPacket.topic);
+                  RadioMeshUtils::convertToHex(receivedPacket.getFrame().data + SDEV_ID_POS,
+                                               DEV_ID_LENGTH)
+                      .c_str(),
+                  receivedPacket.getTopic());
         return false;
     }
-
-    logdbg_ln("MIC verification passed for topic 0x%02X", receivedPacket.topic);
-
-    // Update the packet data to remove MIC for further processing
-    receivedPacket.packetData = payloadWithoutMic;
     return true;
 }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <common/inc/Definitions.h>
+#include <core/protocol/inc/routing/TopologyGraph.h>
+#include <string>
+
+/**
+ * @class TopologyMessage
+ * @brief Portal message carrying the topology graph of a hub, in the JSON of
+ * TopologyGraph::toJson().
+ *
+ * The portal sends the data as a JSON string, so its quotes are escaped. Clients parse the
+ * message, then its data.
+ */
+class TopologyMessage : public PortalMessage
+{
+public:
+    explicit TopologyMessage(const TopologyGraph& graph) : json(graph.toJson())
+    {
+    }
+
+    std::string getType() const override
+    {
+        return "topology";
+    }
+
+    std::string serialize() const override
+    {
+        // The IDs are hexadecimal and the values numbers, quotes are the only characters to escape
+        std::string escaped;
+        escaped.reserve(json.size() * 5 / 4);
+        for (char c : json) {
+            if (c == '"') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+private:
+    std::string json;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <array>
+#include <common/inc/Metrics.h>
 #include <common/inc/Options.h>
+#include <core/protocol/inc/packet/Callbacks.h>
 #include <framework/interfaces/IAesCrypto.h>
 #include <framework/interfaces/IByteStorage.h>
 #include <framework/interfaces/IDevicePortal.h>
@@ -12,6 +14,8 @@
 #include <string>
 #include <vector>
 
+class TopologyGraph;
+
 /**
  * @class IDevice
  * @brief This class is an interface for a device.
@@ -87,6 +91,35 @@ public:
     virtual int sendData(const uint8_t topic, const std::vector<byte> data,
                          std::array<byte, RM_ID_LENGTH> target = BROADCAST_ADDR) = 0;
 
+    /**
+     * @brief Send data to a single device and have it acknowledged end to end.
+     *
+     * The message is numbered, kept and sent again until the target acknowledges it, and the
+     * target hands it to its application once, through the received packet callback, under the
+     * given topic. Several messages to a target are in flight at once, up to RM_RELIABLE_WINDOW,
+     * and are acknowledged together. The outcome of each message is reported to onComplete from
+     * run(): RM_E_NONE once acknowledged, RM_E_DELIVERY_TIMEOUT once the retries are used up.
+     *
+     * At most RM_RELIABLE_SLOTS messages wait for their acknowledgement, all targets together,
+     * to at most RM_RELIABLE_PEERS targets. Past that the message is refused, and can be sent again
+     * once onComplete reported an earlier one. A hub pushing to dozens of devices at once is
+     * refused most of them: it sends the rest as earlier ones complete. Raising the limit does not
+     * help, the hub then sends more than the channel around it carries and most messages fail.
+     *
+     * @param topic Application topic to send the data to
+     * @param data Data to send
+     * @param target Target device, not the broadcast address
+     * @param onComplete Called with the outcome of the message, may be nullptr
+     * @param context Passed to onComplete
+     * @param sequence set to the sequence number of the message, may be nullptr
+     * @return RM_E_NONE if the message was accepted, an error code otherwise. RM_E_QUEUE_FULL if
+     * every slot or every target entry is held by a message waiting for its acknowledgement.
+     */
+    virtual int sendReliableData(const uint8_t topic, const std::vector<byte>& data,
+                                 std::array<byte, RM_ID_LENGTH> target,
+                                 ReliableSendCallback onComplete = nullptr,
+                                 void* context = nullptr, uint16_t* sequence = nullptr) = 0;
+
     /**
      * @brief Allow the device to relay packets.
      * @param enabled true to enable the relay, false to disable it.
@@ -99,6 +132,20 @@ public:
      */
     virtual bool isRelayEnabled() = 0;
 
+    /**
+     * @brief Send neighbour discovery beacons, so that routes to the devices around are known
+     * before they send anything. Beacons start fast and slow down while the neighbourhood stays
+     * the same.
+     * @param enabled true to send beacons, false to stop.
+     */
+    virtual void enableBeacons(bool enabled) = 0;
+
+    /**
+     * @brief Check if the device sends neighbour discovery beacons.
+     * @return true if the device sends beacons, false otherwise.
+     */
+    virtual bool isBeaconEnabled() = 0;
+
     /**
      * @brief Get the device name.
      * @return std::string containing the device name.
@@ -204,4 +251,44 @@ public:
      * @return RM_E_NONE on success, error code otherwise
      */
     virtual int updateSecurityParams(const SecurityParams& params) = 0;
+
+    /**
+     * @brief Get the number of received frames dropped for a reason since the device started.
+     * @param reason The drop reason
+     * @return The number of frames dropped for this reason
+     */
+    virtual uint32_t getRxDropCount(RxDropReason reason) const = 0;
+
+    /**
+     * @brief Get the metrics of the radio's transmit queue.
+     * @return TxQueueStats, all zeros if the radio is not initialized
+     */
+    virtual TxQueueStats getTxQueueStats() = 0;
+
+    /**
+     * @brief Get the listen before talk metrics of the radio.
+     * @return ChannelAccessStats, all zeros if the radio is not initialized
+     */
+    virtual ChannelAccessStats getChannelAccessStats() = 0;
+
+    /**
+     * @brief Get the airtime budget left in the radio's sub-band.
+     * @return AirtimeBudget, unrestricted if the radio is not initialized
+     */
+    virtual AirtimeBudget getAirtimeBudget() = 0;
+
+    /**
+     * @brief Get the hop-by-hop acknowledgement metrics of the unicast frames this device sent.
+     * @return HopAckStats
+     */
+    virtual HopAckStats getHopAckStats() const = 0;
+
+    /**
+     * @brief Get the graph of the links a hub observed, with the shortest path to every device.
+     * With a device portal, clients get it as a "topology" message by sending a "get_topology"
+     * one.
+     * @return The topology graph on a hub, nullptr on other devices or if the hub had no memory
+     * for it.
+     */
+    virtual const TopologyGraph* getTopology() const = 0;
 };
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <common/inc/Metrics.h>
+#include <common/inc/RadioConfigs.h>
+
+// Window the duty cycle is measured over, in seconds. The budget of a sub-band holds up to the
+// duty cycle share of it, 36 s of airtime for a 1% sub-band over an hour.
+#ifndef RM_AIRTIME_WINDOW_S
+#define RM_AIRTIME_WINDOW_S 3600
+#endif
+
+// Part of the budget relays spend freely, in percent. Below it relays are thinned out at random,
+// more as the budget drains, so the node's own frames keep the rest.
+#ifndef RM_AIRTIME_RELAY_RESERVE_PCT
+#define RM_AIRTIME_RELAY_RESERVE_PCT 50
+#endif
+
+/**
+ * @class AirtimeGovernor
+ * @brief Token bucket keeping transmissions within regulatory airtime limits.
+ *
+ * Each sub-band of the region has its own bucket, filled at the sub-band's duty cycle: a 1%
+ * sub-band earns 10 us of airtime per millisecond. A frame is sent when its bucket covers its
+ * time on air. Otherwise a relay is dropped, since it is stale by the time the budget refills,
+ * and any other frame is deferred. Relays are also thinned out once the budget falls below
+ * RM_AIRTIME_RELAY_RESERVE_PCT, so a relay storm slows down before it exhausts the budget instead
+ * of silencing the node.
+ */
+class AirtimeGovernor
+{
+public:
+    enum class Decision : uint8_t
+    {
+        SEND,
+        DEFER,
+        DROP
+    };
+
+    /**
+     * @brief Select the rules of a region and the sub-band of a frequency
+     *
+     * Budgets already spent are kept, switching back to a sub-band does not refill it.
+     *
+     * @param region The regulatory region
+     * @param frequencyMHz The carrier frequency
+     */
+    void setRegion(AirtimeRegion region, float frequencyMHz);
+
+    /**
+     * @brief Decide what to do with a frame about to be sent
+     * @param airtimeUs Time on air of the frame, in microseconds
+     * @param priority Priority class of the frame
+     * @param now Current time in milliseconds
+     * @param retryAt set to the time the budget covers the frame when it is deferred
+     * @return SEND if the frame fits, DEFER to try again at retryAt, DROP to give it up
+     */
+    Decision check(uint32_t airtimeUs, TxPriority priority, uint32_t now, uint32_t* retryAt);
+
+    /**
+     * @brief Charge the budget for a frame put on air
+     * @param airtimeUs Time on air of the frame, in microseconds
+     * @param now Current time in milliseconds
+     */
+    void consume(uint32_t airtimeUs, uint32_t now);
+
+    /**
+     * @brief Get the budget of the current sub-band
+     * @param now Current time in milliseconds
+     * @return The budget
+     */
+    AirtimeBudget getBudget(uint32_t now);
+
+private:
+    struct SubBand
+    {
+        float minMHz;
+        float maxMHz;
+        uint16_t dutyCyclePermille;
+        uint32_t maxDwellMs;
+    };
+
+    struct Bucket
+    {
+        uint32_t tokensUs;
+        uint32_t updatedAt;
+        bool started;
+    };
+
+    static const size_t MAX_SUB_BANDS = 6;
+    static const SubBand EU868_SUB_BANDS[];
+    static const SubBand US915_SUB_BANDS[];
+    static const SubBand UNRESTRICTED_BAND;
+    static const SubBand EU868_OUTSIDE_BAND;
+
+    const SubBand* subBands = nullptr;
+    size_t subBandCount = 0;
+    AirtimeRegion region = AirtimeRegion::UNRESTRICTED;
+    // Sub-band in use, subBandCount when the frequency falls outside of the region's sub-bands
+    size_t current = 0;
+    // One more bucket for frequencies outside of the region's sub-bands
+    Bucket buckets[MAX_SUB_BANDS + 1] = {};
+    uint32_t deferred = 0;
+    uint32_t dropped = 0;
+
+    const SubBand& getSubBand() const;
+    uint32_t getCapacityUs() const;
+    Bucket& refill(uint32_t now);
+};
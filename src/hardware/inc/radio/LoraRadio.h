@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <string>
 #include <vector>
@@ -7,6 +8,9 @@
 #include <common/inc/Definitions.h>
 #include <common/inc/Errors.h>
 #include <framework/interfaces/IRadio.h>
+#include <hardware/inc/radio/AirtimeGovernor.h>
+#include <hardware/inc/radio/RxFrameRing.h>
+#include <hardware/inc/radio/TxQueue.h>
 
 #include <RadioLib.h>
 
@@ -14,6 +18,46 @@
 #define RX_STATE 1
 #define TX_STATE 2
 
+// Number of received frames queued until the device processes them, a power of two. Each slot
+// costs about 270 bytes of RAM.
+#ifndef RM_RX_RING_SLOTS
+#define RM_RX_RING_SLOTS 4
+#endif
+
+// Number of frames waiting to be sent, relays and application frames alike. Each slot costs about
+// 280 bytes of RAM.
+#ifndef RM_TX_QUEUE_SLOTS
+#define RM_TX_QUEUE_SLOTS 4
+#endif
+
+// Largest listen before talk contention window, as a power of two of the frame's time on air.
+// The window doubles with every busy channel detection up to this size.
+#ifndef RM_LBT_MAX_WINDOW_EXP
+#define RM_LBT_MAX_WINDOW_EXP 5
+#endif
+
+// Time allowed past a frame's time on air for its TX done interrupt. Without it by then the
+// frame is given up with RM_E_RADIO_TX_TIMEOUT, so a lost interrupt cannot stall the queue.
+#ifndef RM_TX_WATCHDOG_MARGIN_MS
+#define RM_TX_WATCHDOG_MARGIN_MS 1000
+#endif
+
+// Run the deferred interrupt handler in a FreeRTOS task, so received frames are drained from the
+// radio while the application is busy. Without it the handler runs from RadioMeshDevice::run().
+#ifndef RM_RADIO_IRQ_TASK
+#if defined(ESP32)
+#define RM_RADIO_IRQ_TASK 1
+#else
+#define RM_RADIO_IRQ_TASK 0
+#endif
+#endif
+
+#if RM_RADIO_IRQ_TASK
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#endif
+
 /**
  * @class LoraRadio
  *
@@ -22,6 +66,8 @@
 class LoraRadio : public IRadio
 {
 public:
+    static const size_t TX_FRAME_SIZE = TxFrame::MAX_LENGTH;
+
     /**
      * @brief Get the instance of the LoraRadio.
      * @returns A pointer to the instance of the LoraRadio.
@@ -34,6 +80,24 @@ public:
         return instance;
     }
 
+#ifdef RM_NATIVE
+    /**
+     * @brief Replace the instance returned by getInstance(). Native build only.
+     *
+     * The mesh simulator owns one LoraRadio per simulated node and installs it before running
+     * that node, so the interrupt handler and the device reach the right radio.
+     *
+     * @param newInstance The instance to install, nullptr to create a new one on next use.
+     * @returns The previously installed instance.
+     */
+    static LoraRadio* setInstance(LoraRadio* newInstance)
+    {
+        LoraRadio* previous = instance;
+        instance = newInstance;
+        return previous;
+    }
+#endif
+
     // IRadio interface
     virtual ~LoraRadio()
     {
@@ -51,9 +115,20 @@ public:
     /**
      * @brief interrupt callabarck for the radio.
      *
+     * It only records that the radio needs attention and wakes the deferred handler, which reads
+     * the IRQ flags and drains received frames into the RX ring.
      */
     static void onInterrupt();
 
+    /**
+     * @brief Run the deferred interrupt handler if an interrupt is pending, retry a frame whose
+     * listen before talk backoff expired and give up a frame whose TX done never came.
+     *
+     * Does nothing when the handler runs in its own task (RM_RADIO_IRQ_TASK). Otherwise it must be
+     * called regularly, RadioMeshDevice::run() does.
+     */
+    void serviceInterrupts();
+
     /**
      * @brief Indicates if the radio has been setup.
      *
@@ -90,6 +165,104 @@ public:
      */
     int sendPacket(std::vector<byte>& data);
 
+    /**
+     * @brief Take a free slot of the transmit queue.
+     *
+     * The router serializes outgoing frames straight into the slot and queues it with
+     * queueTxFrame(), so a frame is never copied on its way to the radio. A slot that ends up not
+     * being queued must be handed back with releaseTxFrame().
+     *
+     * @return The slot, nullptr if the transmit queue is full.
+     */
+    TxFrame* acquireTxFrame();
+
+    /**
+     * @brief Hand back a slot taken with acquireTxFrame() without sending it.
+     *
+     * @param frame The slot
+     */
+    void releaseTxFrame(TxFrame* frame);
+
+    /**
+     * @brief Queue a frame for transmission.
+     *
+     * The frame is sent right away if the radio is idle. Otherwise it is sent from the TX done
+     * interrupt, after the frames queued with a higher priority or before it.
+     *
+     * @param frame slot taken with acquireTxFrame(), holding the frame
+     * @param length number of bytes of the frame
+     * @param priority priority class of the frame
+     * @param onComplete called from dispatchTxCompletions() once the frame is sent or failed, may
+     * be nullptr
+     * @param context passed to onComplete
+     * @return RM_E_NONE if the frame was queued, an error code otherwise. The slot is handed back
+     * if the frame is not queued.
+     */
+    int queueTxFrame(TxFrame* frame, size_t length, TxPriority priority,
+                     TxCompleteCallback onComplete = nullptr, void* context = nullptr);
+
+    /**
+     * @brief Report the completed frames to their callbacks and free their slots.
+     *
+     * Completions are recorded by the interrupt handler and reported here, in the order the frames
+     * completed. RadioMeshDevice::run() calls it.
+     */
+    void dispatchTxCompletions();
+
+    /**
+     * @brief Get the transmit queue metrics.
+     * @return The metrics
+     */
+    TxQueueStats getTxQueueStats();
+
+    /**
+     * @brief Get the listen before talk metrics.
+     * @return The metrics
+     */
+    ChannelAccessStats getChannelAccessStats();
+
+    /**
+     * @brief Get the airtime budget left in the sub-band the radio transmits in.
+     * @return The budget
+     */
+    AirtimeBudget getAirtimeBudget();
+
+    /**
+     * @brief Get when the frame waiting for a free channel or for airtime budget is tried again,
+     * when the wait for a reply ends, or when the frame on air times out.
+     *
+     * @param dueAt set to the time of the next attempt, in milliseconds
+     * @return true if a frame is waiting, false otherwise
+     */
+    bool getTxRetryDue(uint32_t* dueAt);
+
+    /**
+     * @brief Give up the frame waiting for a free channel or for airtime budget, if it matches.
+     *
+     * The frame completes with RM_E_RADIO_CHANNEL_BUSY and the next queued frame is started.
+     *
+     * @param match tells whether the waiting frame is the one to give up
+     * @param context passed to match
+     * @return true if the frame was given up, false if none is waiting or it does not match
+     */
+    bool cancelWaitingTxFrame(TxFrameMatch match, void* context);
+
+    /**
+     * @brief End the wait for a reply to the last frame sent, the reply came in.
+     *
+     * A frame with a reply window keeps the radio listening for that long once sent, so that
+     * the next queued frame does not go out over the reply.
+     */
+    void endReplyWindow();
+
+    /**
+     * @brief Get the time a frame spends on air with the current radio parameters.
+     *
+     * @param length frame length in bytes
+     * @return time on air in milliseconds, 0 if the radio is not setup
+     */
+    uint32_t getTimeOnAirMs(size_t length);
+
     /**
      * @brief switch the radio to receive mode.
      *
@@ -108,7 +281,7 @@ public:
     int startTransmitPacket(byte* data, int length);
 
     /**
-     * @brief Read the received data from the radio.
+     * @brief Read and dequeue the oldest received frame.
      *
      * @param packetData vector of bytes to store the received data
      * @return WAR_ERR_NONE if the data was successfully read, an error code otherwise.
@@ -116,14 +289,55 @@ public:
     int readReceivedData(std::vector<byte>* packetData);
 
     /**
-     * @brief Check if the radio is in receive mode.
-     * @return true if the radio is in receive mode, false otherwise.
+     * @brief Read and dequeue the oldest received frame into a caller owned buffer, without
+     * allocating.
+     *
+     * @param buffer buffer to store the received data
+     * @param capacity size of the buffer in bytes
+     * @param length set to the number of bytes received
+     * @return RM_E_NONE if the data was successfully read, RM_E_PACKET_TOO_LONG if the packet does
+     * not fit in the buffer, RM_E_RADIO_RX if no frame is queued, an error code otherwise.
+     */
+    int readReceivedData(byte* buffer, size_t capacity, size_t* length);
+
+    /**
+     * @brief Get the oldest received frame without copying it.
+     *
+     * The frame stays valid and queued until releaseReceivedFrame() is called.
+     *
+     * @return The oldest received frame, nullptr if none is queued.
+     */
+    const RxFrame* peekReceivedFrame() const
+    {
+        return rxRing.front();
+    }
+
+    /**
+     * @brief Dequeue the frame returned by peekReceivedFrame().
+     */
+    void releaseReceivedFrame()
+    {
+        rxRing.pop();
+    }
+
+    /**
+     * @brief Get the number of received frames dropped because the RX ring was full.
+     * @return Number of frames
+     */
+    uint32_t getRxOverflows() const
+    {
+        return rxRing.getOverflows();
+    }
+
+    /**
+     * @brief Check if received frames are queued or a receive error occurred.
+     * @return true if there is something to process, false otherwise.
      */
     bool checkAndClearRxFlag();
 
     /**
-     * @brief Check if the radio is in transmit mode.
-     * @return true if the radio is in transmit mode, false otherwise.
+     * @brief Check if a transmission completed since the last call.
+     * @return true if a transmission completed, false otherwise.
      */
     bool checkAndClearTxFlag();
 
@@ -142,11 +356,23 @@ private:
 
     static LoraRadio* instance;
 
+    volatile bool irqPending = false;
     volatile bool rxDone = false;
     volatile bool txDone = false;
     volatile bool isSetup = false;
     volatile int16_t radioStateError = RM_E_NONE;
 
+    // Listen before talk and airtime budget state of the frame being sent
+    bool txBackingOff = false;
+    // Listening for the reply to the last frame sent, until txRetryAt
+    bool txAwaitingReply = false;
+    // Transmitting, the frame fails if TX done did not come by txRetryAt
+    bool txOnAir = false;
+    uint32_t txRetryAt = 0;
+    uint8_t txAttempts = 0;
+    ChannelAccessStats channelStats;
+    AirtimeGovernor airtime;
+
     void resetRadioState(int flag = RX_TX_STATE)
     {
 
@@ -158,12 +384,34 @@ private:
         } else if (flag == TX_STATE) {
             txDone = false;
         }
-        radioStateError = RM_E_NONE;
+        // Starting a transmission keeps an RX error for the device loop to report
+        if (flag != TX_STATE) {
+            radioStateError = RM_E_NONE;
+        }
     }
 
     LoraRadioParams radioParams;
     std::unique_ptr<SX1262> radio;
+    RxFrameRing<RM_RX_RING_SLOTS> rxRing;
+    TxQueue<RM_TX_QUEUE_SLOTS> txQueue;
+
+#if RM_RADIO_IRQ_TASK
+    // The interrupt task and the application both talk to the radio over SPI
+    TaskHandle_t irqTask = nullptr;
+    SemaphoreHandle_t radioMutex = nullptr;
+    static void irqTaskLoop(void* param);
+    int startIrqTask();
+#endif
+
+    class RadioLock;
 
+    void handleInterrupt();
+    void queueReceivedFrame();
+    void startNextTxFrame();
+    int transmitTxFrame(TxFrame* frame);
+    bool isChannelBusy();
+    void waitForTxRetry(uint32_t retryAt);
+    void serviceTxRetry();
     int checkLoraParameters(LoraRadioParams params);
     int switchToReceiveMode();
     int createModule(const LoraRadioParams& params);
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <common/inc/Definitions.h>
+
+/**
+ * @struct RxFrame
+ * @brief A frame received by the radio, with the signal quality it was received at.
+ */
+struct RxFrame
+{
+    static const size_t MAX_LENGTH = 256;
+
+    byte data[MAX_LENGTH];
+    size_t length;
+    float rssi;
+    float snr;
+};
+
+/**
+ * @class RxFrameRing
+ * @brief Single producer, single consumer ring of received frames.
+ *
+ * The radio's interrupt handler is the producer and the device loop the consumer. Frames are
+ * written in place into fixed slots and read in place, so nothing is copied or allocated on the
+ * way. The indices are atomics, so producer and consumer need no lock, whether the producer is
+ * an interrupt task or runs in the loop itself.
+ *
+ * When the ring is full, a new frame is dropped and counted as an overflow. Frames already queued
+ * are never overwritten, the consumer may still be working on the oldest one.
+ *
+ * @tparam Slots number of frames, a power of two up to 128
+ */
+template <uint8_t Slots>
+class RxFrameRing
+{
+    static_assert(Slots > 0 && Slots <= 128 && (Slots & (Slots - 1)) == 0,
+                  "RX ring slots must be a power of two up to 128");
+
+public:
+    /**
+     * @brief Producer: get the slot to receive the next frame into
+     * @return The free slot, or nullptr if the ring is full. A full ring counts an overflow
+     */
+    RxFrame* acquire()
+    {
+        uint8_t head = this->head.load(std::memory_order_relaxed);
+        if (static_cast<uint8_t>(head - tail.load(std::memory_order_acquire)) == Slots) {
+            overflows.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &slots[head & (Slots - 1)];
+    }
+
+    /**
+     * @brief Producer: queue the frame written into the slot returned by acquire()
+     */
+    void publish()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer: get the oldest queued frame, it stays valid until pop()
+     * @return The oldest frame, or nullptr if the ring is empty
+     */
+    const RxFrame* front() const
+    {
+        uint8_t tail = this->tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == tail) {
+            return nullptr;
+        }
+        return &slots[tail & (Slots - 1)];
+    }
+
+    /**
+     * @brief Consumer: release the oldest queued frame
+     */
+    void pop()
+    {
+        uint8_t tail = this->tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) != tail) {
+            this->tail.store(tail + 1, std::memory_order_release);
+        }
+    }
+
+    /**
+     * @brief Get the number of queued frames
+     * @return Number of frames
+     */
+    size_t size() const
+    {
+        return static_cast<uint8_t>(head.load(std::memory_order_acquire) -
+                                    tail.load(std::memory_order_acquire));
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * @brief Get the number of frames dropped because the ring was full
+     * @return Number of frames
+     */
+    uint32_t getOverflows() const
+    {
+        return overflows.load(std::memory_order_relaxed);
+    }
+
+private:
+    RxFrame slots[Slots];
+    // Free running indices, the difference is the number of queued frames
+    std::atomic<uint8_t> head{0};
+    std::atomic<uint8_t> tail{0};
+    std::atomic<uint32_t> overflows{0};
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <common/inc/Definitions.h>
+#include <common/inc/Errors.h>
+#include <common/inc/Metrics.h>
+
+struct TxFrame;
+
+/**
+ * @typedef TxCompleteCallback
+ * @brief Called once a queued frame has been sent or has failed.
+ * @param frame The frame, valid only for the duration of the call.
+ * @param err RM_E_NONE if the frame was sent, an error code otherwise.
+ * @param context The context given when the frame was queued.
+ */
+typedef void (*TxCompleteCallback)(const TxFrame& frame, int err, void* context);
+
+/**
+ * @typedef TxFrameMatch
+ * @brief Tells whether a queued frame is the one looked for.
+ * @param frame The frame
+ * @param context The context given along with the callback.
+ * @return true if the frame matches, false otherwise.
+ */
+typedef bool (*TxFrameMatch)(const TxFrame& frame, void* context);
+
+/**
+ * @struct TxFrame
+ * @brief A frame waiting in the transmit queue, with what to do once it is sent.
+ */
+struct TxFrame
+{
+    static const size_t MAX_LENGTH = 256;
+
+    byte data[MAX_LENGTH];
+    size_t length;
+    TxPriority priority;
+    TxCompleteCallback onComplete;
+    void* context;
+    // Time the radio keeps listening for a reply once the frame is sent, before the next frame
+    uint16_t replyWindowMs;
+};
+
+/**
+ * @class TxQueue
+ * @brief Bounded transmit queue of fixed frame slots.
+ *
+ * A frame is written in place into a slot taken with acquire() and queued with push(). The radio
+ * sends one frame at a time: startNext() picks the most urgent queued frame, oldest first within a
+ * priority class, and complete() records its outcome. Completed frames stay in their slot until
+ * the completion is reported with takeCompleted() and the slot is handed back with release(), so
+ * callbacks run outside of the interrupt handler.
+ *
+ * The queue itself is not synchronized, the radio serializes access to it.
+ *
+ * @tparam Slots number of frames, up to 32
+ */
+template <uint8_t Slots>
+class TxQueue
+{
+    static_assert(Slots > 0 && Slots <= 32, "TX queue slots must be between 1 and 32");
+
+public:
+    /**
+     * @brief Take a free slot to write a frame into
+     * @return The slot, or nullptr if the queue is full. A full queue counts a rejected frame
+     */
+    TxFrame* acquire()
+    {
+        for (uint8_t i = 0; i < Slots; i++) {
+            if (states[i] == State::FREE) {
+                states[i] = State::RESERVED;
+                frames[i].replyWindowMs = 0;
+                return &frames[i];
+            }
+        }
+        stats.rejected++;
+        return nullptr;
+    }
+
+    /**
+     * @brief Queue the frame written into a slot returned by acquire()
+     * @param frame The slot
+     * @param priority Priority class of the frame
+     * @param onComplete Called with the outcome of the transmission, may be nullptr
+     * @param context Passed to onComplete
+     */
+    void push(TxFrame* frame, TxPriority priority, TxCompleteCallback onComplete, void* context)
+    {
+        uint8_t slot = indexOf(frame);
+        frame->priority = priority;
+        frame->onComplete = onComplete;
+        frame->context = context;
+        order[slot] = nextOrder++;
+        states[slot] = State::QUEUED;
+
+        stats.depth++;
+        stats.depthByPriority[static_cast<size_t>(priority)]++;
+        if (stats.depth > stats.highWater) {
+            stats.highWater = stats.depth;
+        }
+    }
+
+    /**
+     * @brief Make the most urgent queued frame the one being sent
+     * @return The frame, or nullptr if a frame is already being sent or none is queued
+     */
+    TxFrame* startNext()
+    {
+        if (inFlight >= 0) {
+            return nullptr;
+        }
+        int next = -1;
+        for (uint8_t i = 0; i < Slots; i++) {
+            if (states[i] != State::QUEUED) {
+                continue;
+            }
+            if (next < 0 || frames[i].priority < frames[next].priority ||
+                (frames[i].priority == frames[next].priority &&
+                 static_cast<int32_t>(order[i] - order[next]) < 0)) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            return nullptr;
+        }
+        states[next] = State::IN_FLIGHT;
+        inFlight = next;
+        return &frames[next];
+    }
+
+    /**
+     * @brief Check if a frame is being sent
+     * @return true if a frame is being sent, false otherwise
+     */
+    bool isBusy() const
+    {
+        return inFlight >= 0;
+    }
+
+    /**
+     * @brief Get the frame being sent
+     * @return The frame, or nullptr if none is being sent
+     */
+    TxFrame* getInFlight()
+    {
+        return inFlight >= 0 ? &frames[inFlight] : nullptr;
+    }
+
+    /**
+     * @brief Record the outcome of the frame being sent
+     * @param err RM_E_NONE if the frame was sent, an error code otherwise
+     */
+    void complete(int err)
+    {
+        if (inFlight < 0) {
+            return;
+        }
+        TxFrame& frame = frames[inFlight];
+        results[inFlight] = err;
+        order[inFlight] = nextOrder++;
+        states[inFlight] = State::DONE;
+        inFlight = -1;
+
+        stats.depth--;
+        stats.depthByPriority[static_cast<size_t>(frame.priority)]--;
+        if (err == RM_E_NONE) {
+            stats.sent++;
+        } else {
+            stats.failed++;
+        }
+    }
+
+    /**
+     * @brief Get the frame completed first whose completion was not reported yet
+     * @param err set to the outcome of the frame
+     * @return The frame, to be handed back with release(), or nullptr if there is none
+     */
+    TxFrame* takeCompleted(int* err)
+    {
+        int oldest = -1;
+        for (uint8_t i = 0; i < Slots; i++) {
+            if (states[i] == State::DONE &&
+                (oldest < 0 || static_cast<int32_t>(order[i] - order[oldest]) < 0)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return nullptr;
+        }
+        states[oldest] = State::REPORTING;
+        *err = results[oldest];
+        return &frames[oldest];
+    }
+
+    /**
+     * @brief Hand back a slot, either unused after acquire() or reported after takeCompleted()
+     * @param frame The slot
+     */
+    void release(TxFrame* frame)
+    {
+        states[indexOf(frame)] = State::FREE;
+    }
+
+    /**
+     * @brief Get the queue metrics
+     * @return The metrics
+     */
+    const TxQueueStats& getStats() const
+    {
+        return stats;
+    }
+
+private:
+    enum class State : uint8_t
+    {
+        FREE,
+        RESERVED,
+        QUEUED,
+        IN_FLIGHT,
+        DONE,
+        REPORTING
+    };
+
+    TxFrame frames[Slots];
+    State states[Slots] = {};
+    // Queue order while queued, completion order once done
+    uint32_t order[Slots] = {};
+    int results[Slots] = {};
+    uint32_t nextOrder = 0;
+    int inFlight = -1;
+    TxQueueStats stats;
+
+    uint8_t indexOf(const TxFrame* frame) const
+    {
+        return static_cast<uint8_t>(frame - frames);
+    }
+};
@@ -60,6 +60,20 @@ public:
         return instance;
     }
 
+#ifdef RM_NATIVE
+    /**
+     * @brief Replace the instance returned by getInstance(). Native build only.
+     * @param newInstance The instance to install, nullptr to create a new one on next use.
+     * @returns The previously installed instance.
+     **/
+    static EEPROMStorage* setInstance(EEPROMStorage* newInstance)
+    {
+        EEPROMStorage* previous = instance;
+        instance = newInstance;
+        return previous;
+    }
+#endif
+
     virtual ~EEPROMStorage() = default;
 
     // IByteStorage interface
@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <algorithm>
+
+#include <hardware/inc/radio/AirtimeGovernor.h>
+
+// ETSI EN 300 220 sub-bands usable by LoRa, without listen before talk and adaptive frequency
+// agility
+const AirtimeGovernor::SubBand AirtimeGovernor::EU868_SUB_BANDS[] = {
+    {863.0f, 865.0f, 1, 0},
+    {865.0f, 868.0f, 10, 0},
+    {868.0f, 868.6f, 10, 0},
+    {868.7f, 869.2f, 1, 0},
+    {869.4f, 869.65f, 100, 0},
+    {869.7f, 870.0f, 10, 0},
+};
+
+// FCC part 15.247 frequency hopping systems: no duty cycle, 400 ms per channel
+const AirtimeGovernor::SubBand AirtimeGovernor::US915_SUB_BANDS[] = {
+    {902.0f, 928.0f, 1000, 400},
+};
+
+const AirtimeGovernor::SubBand AirtimeGovernor::UNRESTRICTED_BAND = {0.0f, 0.0f, 1000, 0};
+
+// Between EU sub-bands the strictest duty cycle applies
+const AirtimeGovernor::SubBand AirtimeGovernor::EU868_OUTSIDE_BAND = {0.0f, 0.0f, 1, 0};
+
+void AirtimeGovernor::setRegion(AirtimeRegion newRegion, float frequencyMHz)
+{
+    if (newRegion != region) {
+        // Budgets belong to the sub-bands of a region
+        for (Bucket& bucket : buckets) {
+            bucket.started = false;
+        }
+    }
+    region = newRegion;
+    switch (region) {
+    case AirtimeRegion::EU868:
+        subBands = EU868_SUB_BANDS;
+        subBandCount = sizeof(EU868_SUB_BANDS) / sizeof(EU868_SUB_BANDS[0]);
+        break;
+    case AirtimeRegion::US915:
+        subBands = US915_SUB_BANDS;
+        subBandCount = sizeof(US915_SUB_BANDS) / sizeof(US915_SUB_BANDS[0]);
+        break;
+    default:
+        subBands = nullptr;
+        subBandCount = 0;
+        break;
+    }
+
+    current = subBandCount;
+    for (size_t i = 0; i < subBandCount; i++) {
+        if (frequencyMHz >= subBands[i].minMHz && frequencyMHz <= subBands[i].maxMHz) {
+            current = i;
+            break;
+        }
+    }
+}
+
+const AirtimeGovernor::SubBand& AirtimeGovernor::getSubBand() const
+{
+    if (current < subBandCount) {
+        return subBands[current];
+    }
+    if (region == AirtimeRegion::EU868) {
+        return EU868_OUTSIDE_BAND;
+    }
+    if (region == AirtimeRegion::US915) {
+        return US915_SUB_BANDS[0];
+    }
+    return UNRESTRICTED_BAND;
+}
+
+uint32_t AirtimeGovernor::getCapacityUs() const
+{
+    // A duty cycle in permille earns that many microseconds of airtime per millisecond
+    return RM_AIRTIME_WINDOW_S * 1000UL * getSubBand().dutyCyclePermille;
+}
+
+AirtimeGovernor::Bucket& AirtimeGovernor::refill(uint32_t now)
+{
+    Bucket& bucket = buckets[current];
+    uint32_t capacity = getCapacityUs();
+    if (!bucket.started) {
+        bucket.tokensUs = capacity;
+        bucket.updatedAt = now;
+        bucket.started = true;
+        return bucket;
+    }
+    uint64_t earned = static_cast<uint64_t>(now - bucket.updatedAt) *
+                      getSubBand().dutyCyclePermille;
+    bucket.tokensUs = static_cast<uint32_t>(
+        std::min<uint64_t>(static_cast<uint64_t>(bucket.tokensUs) + earned, capacity));
+    bucket.updatedAt = now;
+    return bucket;
+}
+
+AirtimeGovernor::Decision AirtimeGovernor::check(uint32_t airtimeUs, TxPriority priority,
+                                                 uint32_t now, uint32_t* retryAt)
+{
+    const SubBand& subBand = getSubBand();
+    if (subBand.maxDwellMs > 0 && airtimeUs > subBand.maxDwellMs * 1000) {
+        dropped++;
+        return Decision::DROP;
+    }
+    if (subBand.dutyCyclePermille >= 1000) {
+        return Decision::SEND;
+    }
+    if (airtimeUs > getCapacityUs()) {
+        dropped++;
+        return Decision::DROP;
+    }
+
+    Bucket& bucket = refill(now);
+    if (priority == TxPriority::RELAY) {
+        uint32_t reserve = getCapacityUs() / 100 * RM_AIRTIME_RELAY_RESERVE_PCT;
+        if (bucket.tokensUs < airtimeUs ||
+            (bucket.tokensUs < reserve &&
+             static_cast<uint32_t>(random(static_cast<long>(reserve))) >= bucket.tokensUs)) {
+            dropped++;
+            return Decision::DROP;
+        }
+        return Decision::SEND;
+    }
+    if (bucket.tokensUs >= airtimeUs) {
+        return Decision::SEND;
+    }
+    uint32_t missing = airtimeUs - bucket.tokensUs;
+    *retryAt = now + (missing + subBand.dutyCyclePermille - 1) / subBand.dutyCyclePermille;
+    deferred++;
+    return Decision::DEFER;
+}
+
+void AirtimeGovernor::consume(uint32_t airtimeUs, uint32_t now)
+{
+    if (getSubBand().dutyCyclePermille >= 1000) {
+        return;
+    }
+    Bucket& bucket = refill(now);
+    bucket.tokensUs -= std::min(bucket.tokensUs, airtimeUs);
+}
+
+AirtimeBudget AirtimeGovernor::getBudget(uint32_t now)
+{
+    const SubBand& subBand = getSubBand();
+    AirtimeBudget budget;
+    budget.dutyCyclePermille = subBand.dutyCyclePermille;
+    budget.maxDwellMs = subBand.maxDwellMs;
+    budget.deferred = deferred;
+    budget.dropped = dropped;
+    if (subBand.dutyCyclePermille < 1000) {
+        budget.capacityMs = getCapacityUs() / 1000;
+        budget.remainingMs = refill(now).tokensUs / 1000;
+    }
+    return budget;
+}
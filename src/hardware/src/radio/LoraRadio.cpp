@@ -1,5 +1,7 @@
 static_assert(__cplusplus >= 201703L, "C++17 required");
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
@@ -13,6 +15,39 @@ static_assert(__cplusplus >= 201703L, "C++17 required");
 
 LoraRadio* LoraRadio::instance = nullptr;
 
+/**
+ * @brief Serializes radio access between the interrupt task and the application.
+ *
+ * The mutex is recursive since some radio operations call others. Without an interrupt task there
+ * is a single thread of radio access and the lock does nothing.
+ */
+class LoraRadio::RadioLock
+{
+public:
+#if RM_RADIO_IRQ_TASK
+    explicit RadioLock(LoraRadio* owner) : mutex(owner->radioMutex)
+    {
+        if (mutex != nullptr) {
+            xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+        }
+    }
+
+    ~RadioLock()
+    {
+        if (mutex != nullptr) {
+            xSemaphoreGiveRecursive(mutex);
+        }
+    }
+
+private:
+    SemaphoreHandle_t mutex;
+#else
+    explicit RadioLock(LoraRadio* owner)
+    {
+    }
+#endif
+};
+
 int LoraRadio::setParams(LoraRadioParams params)
 {
     if (checkLoraParameters(params) != RM_E_NONE) {
@@ -133,9 +168,18 @@ int LoraRadio::setup(const LoraRadioParams& params)
         return RM_E_RADIO_SETUP;
     }
 
+    airtime.setRegion(params.airtimeRegion, params.band);
+
     // set the interrupt handler to execute when packet tx or rx is done.
     radio->setDio1Action(LoraRadio::onInterrupt);
 
+#if RM_RADIO_IRQ_TASK
+    rc = startIrqTask();
+    if (rc != RM_E_NONE) {
+        return rc;
+    }
+#endif
+
     isSetup = true;
 
     rc = startReceive();
@@ -156,7 +200,266 @@ int LoraRadio::setup()
 
 int LoraRadio::sendPacket(std::vector<byte>& data)
 {
-    return startTransmitPacket(data.data(), data.size());
+    if (data.size() > TX_FRAME_SIZE) {
+        logerr_ln("ERROR  TX frame too long: %d bytes", data.size());
+        return RM_E_PACKET_TOO_LONG;
+    }
+    TxFrame* frame = acquireTxFrame();
+    if (frame == nullptr) {
+        return RM_E_QUEUE_FULL;
+    }
+    memcpy(frame->data, data.data(), data.size());
+    return queueTxFrame(frame, data.size(), TxPriority::APPLICATION);
+}
+
+TxFrame* LoraRadio::acquireTxFrame()
+{
+    RadioLock lock(this);
+    TxFrame* frame = txQueue.acquire();
+    if (frame == nullptr) {
+        logwarn_ln("WARNING  TX queue full, %d frames queued", txQueue.getStats().depth);
+    }
+    return frame;
+}
+
+void LoraRadio::releaseTxFrame(TxFrame* frame)
+{
+    RadioLock lock(this);
+    txQueue.release(frame);
+}
+
+int LoraRadio::queueTxFrame(TxFrame* frame, size_t length, TxPriority priority,
+                            TxCompleteCallback onComplete, void* context)
+{
+    if (length > TX_FRAME_SIZE) {
+        logerr_ln("ERROR  TX frame too long: %d bytes", length);
+        releaseTxFrame(frame);
+        return RM_E_PACKET_TOO_LONG;
+    }
+    if (!isSetup) {
+        logerr_ln("ERROR  LoRa radio not setup");
+        releaseTxFrame(frame);
+        return RM_E_RADIO_NOT_INITIALIZED;
+    }
+
+    RadioLock lock(this);
+    frame->length = length;
+    txQueue.push(frame, priority, onComplete, context);
+    if (!txQueue.isBusy() && !txAwaitingReply) {
+        startNextTxFrame();
+    }
+    return RM_E_NONE;
+}
+
+void LoraRadio::startNextTxFrame()
+{
+    // Called with the radio locked. A frame that fails to start completes right away and the next
+    // one is tried.
+    TxFrame* frame;
+    while ((frame = txQueue.startNext()) != nullptr) {
+        txAttempts = 0;
+        int rc = transmitTxFrame(frame);
+        if (rc == RM_E_NONE) {
+            return;
+        }
+        txQueue.complete(rc);
+    }
+}
+
+int LoraRadio::transmitTxFrame(TxFrame* frame)
+{
+    // Called with the radio locked
+    uint32_t airtimeUs = radio->getTimeOnAir(frame->length);
+    uint32_t retryAt = 0;
+    switch (airtime.check(airtimeUs, frame->priority, millis(), &retryAt)) {
+    case AirtimeGovernor::Decision::DROP:
+        logwarn_ln("WARNING  airtime limit, frame of %d us dropped", airtimeUs);
+        return RM_E_RADIO_AIRTIME_LIMIT;
+    case AirtimeGovernor::Decision::DEFER:
+        logdbg_ln("Airtime budget exhausted, TX deferred by %d ms", retryAt - millis());
+        waitForTxRetry(retryAt);
+        return RM_E_NONE;
+    default:
+        break;
+    }
+
+    bool listen = radioParams.listenBeforeTalk ||
+                  (radioParams.relayListenBeforeTalk && frame->priority == TxPriority::RELAY);
+    if (listen && isChannelBusy()) {
+        txAttempts++;
+        if (txAttempts >= std::max<uint8_t>(radioParams.lbtMaxAttempts, 1)) {
+            logwarn_ln("WARNING  channel busy, frame dropped after %d attempts", txAttempts);
+            channelStats.dropped++;
+            return RM_E_RADIO_CHANNEL_BUSY;
+        }
+        // Binary exponential backoff in frame times on air
+        uint32_t slot = std::max<uint32_t>((airtimeUs + 999) / 1000, 1);
+        uint32_t window = slot << std::min<uint8_t>(txAttempts, RM_LBT_MAX_WINDOW_EXP);
+        retryAt = millis() + 1 + random(window);
+        logdbg_ln("Channel busy, TX retry %d in %d ms", txAttempts, retryAt - millis());
+        waitForTxRetry(retryAt);
+        return RM_E_NONE;
+    }
+
+    // Set first, TX done may be handled before the call returns
+    txRetryAt = millis() + (airtimeUs + 999) / 1000 + RM_TX_WATCHDOG_MARGIN_MS;
+    txOnAir = true;
+    int rc = startTransmitPacket(frame->data, frame->length);
+    if (rc == RM_E_NONE) {
+        airtime.consume(airtimeUs, millis());
+    } else {
+        txOnAir = false;
+    }
+    return rc;
+}
+
+void LoraRadio::waitForTxRetry(uint32_t retryAt)
+{
+    // The frame stays in flight, ahead of anything queued meanwhile, and the radio listens while
+    // it waits
+    txRetryAt = retryAt;
+    txBackingOff = true;
+    radio->startReceive();
+#if RM_RADIO_IRQ_TASK
+    // The interrupt task retries the frame, it must learn how long to wait
+    xTaskNotifyGive(irqTask);
+#endif
+}
+
+bool LoraRadio::isChannelBusy()
+{
+    channelStats.scans++;
+    int rc = radio->scanChannel();
+    if (rc == RADIOLIB_LORA_DETECTED || rc == RADIOLIB_PREAMBLE_DETECTED) {
+        channelStats.busy++;
+        return true;
+    }
+    if (rc != RADIOLIB_CHANNEL_FREE) {
+        // Better to risk a collision than to hold the frame on a failing detection
+        logwarn_ln("WARNING  channel activity detection failed, code %d", rc);
+    }
+    return false;
+}
+
+void LoraRadio::serviceTxRetry()
+{
+    RadioLock lock(this);
+    if ((!txBackingOff && !txAwaitingReply && !txOnAir) ||
+        static_cast<int32_t>(millis() - txRetryAt) < 0) {
+        return;
+    }
+    if (txOnAir) {
+        // TX done never came, the frame fails and the radio moves on
+        logwarn_ln("WARNING  no TX done, frame given up");
+        txOnAir = false;
+        txQueue.complete(RM_E_RADIO_TX_TIMEOUT);
+        startNextTxFrame();
+        if (!txQueue.isBusy()) {
+            startReceive();
+        }
+        return;
+    }
+    if (txAwaitingReply) {
+        // Still receiving, the reply did not come
+        txAwaitingReply = false;
+        startNextTxFrame();
+        return;
+    }
+    txBackingOff = false;
+    TxFrame* frame = txQueue.getInFlight();
+    if (frame == nullptr) {
+        return;
+    }
+    int rc = transmitTxFrame(frame);
+    if (rc != RM_E_NONE) {
+        txQueue.complete(rc);
+        startNextTxFrame();
+        if (!txQueue.isBusy()) {
+            startReceive();
+        }
+    }
+}
+
+void LoraRadio::dispatchTxCompletions()
+{
+    for (;;) {
+        TxFrame* frame;
+        int err = RM_E_NONE;
+        {
+            RadioLock lock(this);
+            frame = txQueue.takeCompleted(&err);
+        }
+        if (frame == nullptr) {
+            return;
+        }
+        // The callback may queue another frame, so the radio is not locked meanwhile
+        if (frame->onComplete != nullptr) {
+            frame->onComplete(*frame, err, frame->context);
+        }
+        releaseTxFrame(frame);
+    }
+}
+
+TxQueueStats LoraRadio::getTxQueueStats()
+{
+    RadioLock lock(this);
+    return txQueue.getStats();
+}
+
+ChannelAccessStats LoraRadio::getChannelAccessStats()
+{
+    RadioLock lock(this);
+    return channelStats;
+}
+
+AirtimeBudget LoraRadio::getAirtimeBudget()
+{
+    RadioLock lock(this);
+    return airtime.getBudget(millis());
+}
+
+bool LoraRadio::getTxRetryDue(uint32_t* dueAt)
+{
+    RadioLock lock(this);
+    if (!txBackingOff && !txAwaitingReply && !txOnAir) {
+        return false;
+    }
+    *dueAt = txRetryAt;
+    return true;
+}
+
+bool LoraRadio::cancelWaitingTxFrame(TxFrameMatch match, void* context)
+{
+    RadioLock lock(this);
+    TxFrame* frame = txQueue.getInFlight();
+    if (!txBackingOff || frame == nullptr || !match(*frame, context)) {
+        return false;
+    }
+    txBackingOff = false;
+    txQueue.complete(RM_E_RADIO_CHANNEL_BUSY);
+    startNextTxFrame();
+    if (!txQueue.isBusy()) {
+        startReceive();
+    }
+    return true;
+}
+
+void LoraRadio::endReplyWindow()
+{
+    RadioLock lock(this);
+    if (txAwaitingReply) {
+        txAwaitingReply = false;
+        startNextTxFrame();
+    }
+}
+
+uint32_t LoraRadio::getTimeOnAirMs(size_t length)
+{
+    if (!isSetup) {
+        return 0;
+    }
+    RadioLock lock(this);
+    return (radio->getTimeOnAir(length) + 999) / 1000;
 }
 
 int LoraRadio::startReceive()
@@ -167,6 +470,7 @@ int LoraRadio::startReceive()
     }
 
     loginfo_ln("Start receiving data...");
+    RadioLock lock(this);
     int state = radio->startReceive();
 
     if (state != RADIOLIB_ERR_NONE) {
@@ -186,6 +490,7 @@ int LoraRadio::startTransmitPacket(byte* data, int length)
     resetRadioState(TX_STATE);
 
     [[maybe_unused]] long t1 = millis();
+    RadioLock lock(this);
     tx_err = radio->startTransmit(data, length);
     logdbg_ln("Radio sent packet...");
     switch (tx_err) {
@@ -215,6 +520,7 @@ int LoraRadio::startTransmitPacket(byte* data, int length)
 
 int LoraRadio::standBy()
 {
+    RadioLock lock(this);
     int rc = radio->standby();
     if (rc != RADIOLIB_ERR_NONE) {
         logerr_ln("ERROR  standby failed, code %d", rc);
@@ -225,16 +531,19 @@ int LoraRadio::standBy()
 
 float LoraRadio::getSNR()
 {
+    RadioLock lock(this);
     return radio->getSNR();
 }
 
 int LoraRadio::getRSSI()
 {
+    RadioLock lock(this);
     return radio->getRSSI();
 }
 
 int LoraRadio::sleep()
 {
+    RadioLock lock(this);
     int rc = radio->sleep();
     if (rc != RADIOLIB_ERR_NONE) {
         logerr_ln("ERROR  sleep failed, code %d", rc);
@@ -245,36 +554,38 @@ int LoraRadio::sleep()
 
 int LoraRadio::readReceivedData(std::vector<byte>* packetBytes)
 {
-    int packet_length = 0;
-    int err = RM_E_NONE;
+    size_t length = 0;
 
+    packetBytes->resize(RADIOLIB_SX126X_MAX_PACKET_LENGTH);
+    int err = readReceivedData(packetBytes->data(), packetBytes->size(), &length);
+    packetBytes->resize(err == RM_E_NONE ? length : 0);
+    return err;
+}
+
+int LoraRadio::readReceivedData(byte* buffer, size_t capacity, size_t* length)
+{
     if (!isSetup) {
         logerr_ln("ERROR  LoRa radio not setup");
         return RM_E_RADIO_NOT_INITIALIZED;
     }
 
-    packet_length = radio->getPacketLength();
-    if (packet_length < 0) {
-        logerr_ln("ERROR  getPacketLength failed. err = %d", packet_length);
-        return RM_E_RADIO_FAILURE;
+    const RxFrame* frame = rxRing.front();
+    if (frame == nullptr) {
+        logerr_ln("ERROR  no received frame to read");
+        return RM_E_RADIO_RX;
     }
-    logtrace_ln("readReceivedData() - packet length returns: %d", packet_length);
 
-    packetBytes->resize(packet_length);
-    err = radio->readData(packetBytes->data(), packet_length);
-    if (err != RADIOLIB_ERR_NONE) {
-        logerr_ln("ERROR  readReceivedData failed. err = %d", err);
-        return RM_E_RADIO_FAILURE;
+    if (frame->length > capacity) {
+        logerr_ln("ERROR  received packet too long: %d bytes, buffer: %d", frame->length,
+                  capacity);
+        rxRing.pop();
+        return RM_E_PACKET_TOO_LONG;
     }
 
-    logdbg_ln("Rx packet: %s",
-              RadioMeshUtils::convertToHex(packetBytes->data(), packetBytes->size()).c_str());
-    logdbg_ln("RX: rssi: %f snr: %f size: %d", radio->getRSSI(), radio->getSNR(), packet_length);
-
-    resetRadioState(RX_TX_STATE);
-
-    logtrace_ln("readReceivedData() - DONE");
-    return err;
+    memcpy(buffer, frame->data, frame->length);
+    *length = frame->length;
+    rxRing.pop();
+    return RM_E_NONE;
 }
 
 // IMPORTANT: this function MUST be 'void' type and MUST NOT have any arguments!
@@ -284,41 +595,159 @@ void ICACHE_RAM_ATTR LoraRadio::onInterrupt()
 void LoraRadio::onInterrupt()
 #endif
 {
-    // This function will be called immediately when an interrupt occurs
-    uint16_t irqStatus = instance->radio->getIrqFlags();
+    // Reading the IRQ flags and the frame takes SPI transfers, which are left to the deferred
+    // handler. A second frame can arrive before the first is processed, so the handler must run
+    // promptly: the radio's buffer holds a single frame.
+    instance->irqPending = true;
+#if RM_RADIO_IRQ_TASK
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(instance->irqTask, &woken);
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+#elif defined(RM_NATIVE)
+    // There is no interrupt context on the host, handle it right away like the task would
+    instance->handleInterrupt();
+#endif
+}
+
+void LoraRadio::serviceInterrupts()
+{
+#if !RM_RADIO_IRQ_TASK
+    if (irqPending) {
+        handleInterrupt();
+    }
+    serviceTxRetry();
+#endif
+}
+
+void LoraRadio::handleInterrupt()
+{
+    RadioLock lock(this);
+    irqPending = false;
+    if (!isSetup || radio == nullptr) {
+        return;
+    }
+
+    uint16_t irqStatus = radio->getIrqFlags();
 
     // check for rx/tx done first and then check for errors
     if (irqStatus & RADIOLIB_SX126X_IRQ_RX_DONE) {
-        instance->rxDone = true;
+        if (!(irqStatus & (RADIOLIB_SX126X_IRQ_CRC_ERR | RADIOLIB_SX126X_IRQ_HEADER_ERR))) {
+            queueReceivedFrame();
+        }
+        rxDone = true;
     }
     if (irqStatus & RADIOLIB_SX126X_IRQ_TX_DONE) {
-        instance->txDone = true;
+        txDone = true;
     }
 
     if (irqStatus & RADIOLIB_SX126X_IRQ_TIMEOUT) {
-        if (instance->rxDone) {
-            instance->radioStateError = RM_E_RADIO_RX_TIMEOUT;
+        if (rxDone) {
+            radioStateError = RM_E_RADIO_RX_TIMEOUT;
+        }
+    }
+
+    if (irqStatus & (RADIOLIB_SX126X_IRQ_TX_DONE | RADIOLIB_SX126X_IRQ_TIMEOUT) &&
+        txQueue.isBusy() && !txBackingOff) {
+        // A TX timeout belongs to the frame being sent, it is reported to its callback. The next
+        // frame goes out straight away, unless the one sent expects a reply, and the radio only
+        // returns to receive once the queue is empty.
+        uint16_t replyWindowMs = txQueue.getInFlight()->replyWindowMs;
+        bool sent = irqStatus & RADIOLIB_SX126X_IRQ_TX_DONE;
+        txOnAir = false;
+        txQueue.complete(sent ? RM_E_NONE : RM_E_RADIO_TX_TIMEOUT);
+        if (sent && replyWindowMs > 0) {
+            txRetryAt = millis() + replyWindowMs;
+            txAwaitingReply = true;
+        } else {
+            startNextTxFrame();
         }
-        if (instance->txDone) {
-            instance->radioStateError = RM_E_RADIO_TX_TIMEOUT;
+        if (!txQueue.isBusy()) {
+            startReceive();
         }
+    } else if ((irqStatus & RADIOLIB_SX126X_IRQ_TIMEOUT) && txDone) {
+        radioStateError = RM_E_RADIO_TX_TIMEOUT;
     }
 
     if (irqStatus & RADIOLIB_SX126X_IRQ_CRC_ERR) {
-        instance->radioStateError = RM_E_RADIO_CRC_MISMATCH;
+        radioStateError = RM_E_RADIO_CRC_MISMATCH;
     }
     if (irqStatus & RADIOLIB_SX126X_IRQ_HEADER_ERR) {
-        instance->radioStateError = RM_E_RADIO_HEADER_CRC_MISMATCH;
+        radioStateError = RM_E_RADIO_HEADER_CRC_MISMATCH;
     }
 }
 
-bool LoraRadio::checkAndClearRxFlag()
+void LoraRadio::queueReceivedFrame()
 {
-    if (rxDone) {
-        rxDone = false;
-        return true;
+    size_t length = radio->getPacketLength();
+    RxFrame* frame = rxRing.acquire();
+    if (frame == nullptr || length > RxFrame::MAX_LENGTH) {
+        // Still read the frame, reading clears the radio's RX interrupt
+        byte discarded[RxFrame::MAX_LENGTH];
+        radio->readData(discarded, std::min(length, sizeof(discarded)));
+        logwarn_ln("WARNING  RX frame dropped, %d bytes, %d frames queued", length,
+                   rxRing.size());
+        return;
+    }
+
+    int err = radio->readData(frame->data, length);
+    if (err != RADIOLIB_ERR_NONE) {
+        logerr_ln("ERROR  readData failed. err = %d", err);
+        radioStateError = RM_E_RADIO_RX;
+        return;
+    }
+    frame->length = length;
+    frame->rssi = radio->getRSSI();
+    frame->snr = radio->getSNR();
+    logdbg_ln("RX: rssi: %f snr: %f size: %d", frame->rssi, frame->snr, length);
+    rxRing.publish();
+}
+
+#if RM_RADIO_IRQ_TASK
+int LoraRadio::startIrqTask()
+{
+    if (irqTask != nullptr) {
+        return RM_E_NONE;
     }
-    return false;
+    radioMutex = xSemaphoreCreateRecursiveMutex();
+    if (radioMutex == nullptr) {
+        logerr_ln("ERROR  creating radio mutex");
+        return RM_E_RADIO_SETUP;
+    }
+    if (xTaskCreate(LoraRadio::irqTaskLoop, "rm_radio_irq", 4096, this, configMAX_PRIORITIES - 1,
+                    &irqTask) != pdPASS) {
+        logerr_ln("ERROR  creating radio interrupt task");
+        irqTask = nullptr;
+        return RM_E_RADIO_SETUP;
+    }
+    return RM_E_NONE;
+}
+
+void LoraRadio::irqTaskLoop(void* param)
+{
+    LoraRadio* owner = static_cast<LoraRadio*>(param);
+    for (;;) {
+        // Wake up on interrupts, and when a frame backing off from a busy channel or a reply
+        // window is due
+        TickType_t wait = portMAX_DELAY;
+        uint32_t dueAt;
+        if (owner->getTxRetryDue(&dueAt)) {
+            int32_t remaining = static_cast<int32_t>(dueAt - millis());
+            wait = remaining > 0 ? pdMS_TO_TICKS(remaining) + 1 : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        owner->handleInterrupt();
+        owner->serviceTxRetry();
+    }
+}
+#endif
+
+bool LoraRadio::checkAndClearRxFlag()
+{
+    bool pending = rxDone || !rxRing.empty();
+    rxDone = false;
+    return pending;
 }
 
 bool LoraRadio::checkAndClearTxFlag()
@@ -332,11 +761,15 @@ bool LoraRadio::checkAndClearTxFlag()
 
 int LoraRadio::getRadioStateError()
 {
-    // TODO: review this function. There's probably a better place to switch to receive mode when an
-    // error occurs.
+    // A CRC or header error can be reported while a frame waits to be sent or for its reply, or
+    // after the next one went on air. Restarting receive then would abort that transmission, and
+    // the radio is already listening otherwise.
+    RadioLock lock(this);
     if (radioStateError != RM_E_NONE) {
         resetRadioState();
-        switchToReceiveMode();
+        if (!txQueue.isBusy() && !txAwaitingReply) {
+            switchToReceiveMode();
+        }
     }
     return radioStateError;
 }
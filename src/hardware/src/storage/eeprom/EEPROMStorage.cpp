@@ -97,7 +97,7 @@ int EEPROMStorage::begin()
     if (!isStorageValid()) {
         logdbg_ln("Initializing storage header");
         initializeStorageHeader();
-        if (!commit()) {
+        if (commit() != RM_E_NONE) {
             logerr_ln("Failed to commit storage header");
             return RM_E_STORAGE_SETUP;
         }
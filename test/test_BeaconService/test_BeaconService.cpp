@@ -0,0 +1,97 @@
+#include <RadioMesh.h>
+#include <core/protocol/inc/routing/BeaconService.h>
+#include <unity.h>
+
+void test_BeaconService_trickle(void)
+{
+    BeaconService beacons;
+    uint8_t topic = 0;
+    uint32_t dueAt = 0;
+    beacons.start(0);
+    TEST_ASSERT_EQUAL(BeaconService::MIN_INTERVAL_MS, beacons.getInterval());
+
+    // One beacon in the second half of the interval
+    TEST_ASSERT_TRUE(beacons.getNextDue(&dueAt));
+    TEST_ASSERT_TRUE(dueAt >= BeaconService::MIN_INTERVAL_MS / 2);
+    TEST_ASSERT_TRUE(dueAt < BeaconService::MIN_INTERVAL_MS);
+    TEST_ASSERT_FALSE(beacons.isDue(dueAt - 1, &topic));
+    TEST_ASSERT_TRUE(beacons.isDue(dueAt, &topic));
+    TEST_ASSERT_EQUAL(MessageTopic::PING, topic);
+    beacons.onSent();
+    TEST_ASSERT_FALSE(beacons.isDue(dueAt, &topic));
+
+    // The next interval is twice as long, and its beacon is skipped once enough neighbours
+    // listing us beaconed
+    uint32_t now = BeaconService::MIN_INTERVAL_MS;
+    TEST_ASSERT_FALSE(beacons.isDue(now, &topic));
+    TEST_ASSERT_EQUAL(2 * BeaconService::MIN_INTERVAL_MS, beacons.getInterval());
+    for (int i = 0; i < RM_BEACON_REDUNDANCY; i++) {
+        beacons.onBeacon(MessageTopic::PING, 2, true, now);
+    }
+    beacons.onBeacon(MessageTopic::PING, 2, false, now);
+    beacons.getNextDue(&dueAt);
+    TEST_ASSERT_FALSE(beacons.isDue(dueAt, &topic));
+    TEST_ASSERT_EQUAL(1, beacons.getStats().sent);
+    TEST_ASSERT_EQUAL(1, beacons.getStats().suppressed);
+
+    // A stable neighbourhood grows the interval up to the longest one
+    now += 60 * BeaconService::MAX_INTERVAL_MS;
+    beacons.isDue(now, &topic);
+    TEST_ASSERT_EQUAL(BeaconService::MAX_INTERVAL_MS, beacons.getInterval());
+
+    // A device listing nobody is answered within the jitter
+    beacons.onBeacon(MessageTopic::PING, 0, false, now);
+    beacons.getNextDue(&dueAt);
+    TEST_ASSERT_TRUE(dueAt - now <= RM_BEACON_ANSWER_JITTER_MS);
+    TEST_ASSERT_TRUE(beacons.isDue(now + RM_BEACON_ANSWER_JITTER_MS, &topic));
+    TEST_ASSERT_EQUAL(MessageTopic::PONG, topic);
+    beacons.onSent();
+    TEST_ASSERT_FALSE(beacons.isDue(now + RM_BEACON_ANSWER_JITTER_MS, &topic));
+
+    // Only neighbours heard over a good link are listed, and a new one starts over from the
+    // shortest interval
+    NeighborTable neighbors;
+    neighbors.setSpreadingFactor(8);
+    const byte good[DEV_ID_LENGTH] = {1, 0, 0, 0};
+    const byte poor[DEV_ID_LENGTH] = {2, 0, 0, 0};
+    neighbors.onReceived(good, -80, 10.0, now);
+    neighbors.onReceived(poor, -118, -10.0, now);
+    std::vector<byte> payload = beacons.buildPayload(neighbors, now);
+    TEST_ASSERT_EQUAL(DEV_ID_LENGTH, payload.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(good, payload.data(), DEV_ID_LENGTH);
+    beacons.checkNeighbors(neighbors, now);
+    TEST_ASSERT_EQUAL(BeaconService::MIN_INTERVAL_MS, beacons.getInterval());
+    TEST_ASSERT_EQUAL(1, beacons.getStats().resets);
+
+    // Links changing quality without changing the list do not
+    beacons.isDue(now + BeaconService::MIN_INTERVAL_MS, &topic);
+    neighbors.onAckResult(good, true);
+    const byte other[DEV_ID_LENGTH] = {3, 0, 0, 0};
+    neighbors.onReceived(other, -119, -12.0, now);
+    beacons.checkNeighbors(neighbors, now + BeaconService::MIN_INTERVAL_MS);
+    TEST_ASSERT_EQUAL(2 * BeaconService::MIN_INTERVAL_MS, beacons.getInterval());
+    TEST_ASSERT_EQUAL(1, beacons.getStats().resets);
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_BeaconService_trickle);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
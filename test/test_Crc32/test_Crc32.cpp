@@ -0,0 +1,135 @@
+#include <RadioMesh.h>
+#include <common/utils/RadioMeshCrc32.h>
+#include <unity.h>
+
+// The original bit-reflecting implementation, kept as the reference for the wire CRC
+static uint8_t reflectByte(uint8_t b)
+{
+    uint8_t reflection = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        if (b & (1U << i)) {
+            reflection |= (1 << (7 - i));
+        }
+    }
+    return reflection;
+}
+
+static uint32_t reflect(uint32_t data)
+{
+    uint32_t reflection = 0;
+    for (uint32_t i = 0; i < 32; i++) {
+        if (data & (1U << i)) {
+            reflection |= (1U << (31 - i));
+        }
+    }
+    return reflection;
+}
+
+static uint32_t referenceCrc(uint32_t fcounter, const uint8_t* data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFFU;
+    uint8_t counter[4] = {static_cast<uint8_t>(fcounter), static_cast<uint8_t>(fcounter >> 8),
+                          static_cast<uint8_t>(fcounter >> 16),
+                          static_cast<uint8_t>(fcounter >> 24)};
+    for (size_t i = 0; i < 4 + length; i++) {
+        crc ^= reflectByte(i < 4 ? counter[i] : data[i - 4]);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+    }
+    return reflect(crc) ^ 0xFFFFFFFFU;
+}
+
+template <typename Crc>
+static uint32_t packetCrc(uint32_t fcounter, const uint8_t* data, size_t length)
+{
+    Crc crc;
+    crc.update(fcounter);
+    crc.update(data, length);
+    return crc.finalize();
+}
+
+template <typename Crc>
+static void checkBackend()
+{
+    static const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX32(0xFC891918, Crc::compute(check, sizeof(check)));
+
+    // Every length up to a full frame, so the sliced engines hit all their tails
+    uint8_t data[PACKET_LENGTH];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i * 37 + 11);
+    }
+    for (size_t length = 0; length <= sizeof(data); length++) {
+        uint32_t fcounter = 0xA5000000U | length;
+        TEST_ASSERT_EQUAL_HEX32(referenceCrc(fcounter, data, length),
+                                packetCrc<Crc>(fcounter, data, length));
+    }
+}
+
+void test_Crc32_bitwise(void)
+{
+    checkBackend<RadioMeshUtils::Crc32Bitwise>();
+}
+
+void test_Crc32_nibble(void)
+{
+    checkBackend<RadioMeshUtils::Crc32Nibble>();
+}
+
+void test_Crc32_table(void)
+{
+    checkBackend<RadioMeshUtils::Crc32Table>();
+}
+
+void test_Crc32_slice4(void)
+{
+    checkBackend<RadioMeshUtils::Crc32Slice4>();
+}
+
+void test_Crc32_slice8(void)
+{
+    checkBackend<RadioMeshUtils::Crc32Slice8>();
+}
+
+void test_Crc32_incremental(void)
+{
+    // Splitting the input must not change the CRC
+    uint8_t data[100];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i ^ 0x5A);
+    }
+    RadioMeshUtils::CRC32 crc;
+    crc.update(data, 3);
+    crc.update(data[3]);
+    crc.update(data + 4, sizeof(data) - 4);
+    TEST_ASSERT_EQUAL_HEX32(RadioMeshUtils::CRC32::compute(data, sizeof(data)), crc.finalize());
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_Crc32_bitwise);
+    RUN_TEST(test_Crc32_nibble);
+    RUN_TEST(test_Crc32_table);
+    RUN_TEST(test_Crc32_slice4);
+    RUN_TEST(test_Crc32_slice8);
+    RUN_TEST(test_Crc32_incremental);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
@@ -1,4 +1,12 @@
+#include <Curve25519.h>
+#include <common/inc/Errors.h>
 #include <core/protocol/inc/crypto/aes/AesCrypto.h>
+#include <core/protocol/inc/crypto/aes/AesCtrCipherCache.h>
+#include <core/protocol/inc/crypto/cmac/AesCmac.h>
+#include <core/protocol/inc/crypto/EcdhKeyCache.h>
+#include <core/protocol/inc/crypto/EncryptionService.h>
+#include <core/protocol/inc/crypto/MicService.h>
+#include <core/protocol/inc/crypto/cmac/AesCmacContext.h>
 #include <framework/interfaces/ICrypto.h>
 #include <unity.h>
 
@@ -13,8 +21,11 @@ void test_encrypt_decrypt(void)
 {
     AesCrypto* crypto = AesCrypto::getInstance();
 
-    crypto->setKey(key);
-    crypto->setIV(iv);
+    SecurityParams params;
+    params.method = SecurityMethod::AES;
+    params.key = key;
+    params.iv = iv;
+    TEST_ASSERT_EQUAL(RM_E_NONE, crypto->setParams(params));
     std::vector<byte> clearData = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
                                    0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10};
     std::vector<byte> encryptedData = crypto->encrypt(clearData);
@@ -25,13 +36,260 @@ void test_encrypt_decrypt(void)
         TEST_ASSERT_EQUAL(clearData[i], decryptedData[i]);
     }
 }
-void setup()
+
+// RFC 4493 section 4 test vectors
+std::vector<byte> cmacKey = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                             0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+std::vector<byte> cmacMessage = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73,
+    0x93, 0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7,
+    0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51, 0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4,
+    0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef, 0xf6, 0x9f, 0x24, 0x45,
+    0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+
+void test_cmac_rfc4493(void)
+{
+    const byte expected[4][16] = {
+        {0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75,
+         0x67, 0x46},
+        {0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a,
+         0x28, 0x7c},
+        {0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97,
+         0xc8, 0x27},
+        {0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36,
+         0x3c, 0xfe}};
+    const size_t lengths[4] = {0, 16, 40, 64};
+
+    for (int i = 0; i < 4; i++) {
+        std::vector<byte> message(cmacMessage.begin(), cmacMessage.begin() + lengths[i]);
+        std::vector<byte> cmac = AesCmac::computeCMAC(cmacKey, message);
+        TEST_ASSERT_EQUAL(16, cmac.size());
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected[i], cmac.data(), 16);
+
+        std::vector<byte> mic(expected[i], expected[i] + 4);
+        TEST_ASSERT_TRUE(AesCmac::verifyMIC(cmacKey, message.data(), message.size(), mic.data()));
+        mic[3] ^= 0x01;
+        TEST_ASSERT_FALSE(AesCmac::verifyMIC(cmacKey, message, mic));
+    }
+}
+
+void test_cmac_context_streaming(void)
+{
+    // RFC 4493 example 4, fed in every possible pair of pieces through one keyed context
+    const byte expected[16] = {0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92,
+                               0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe};
+    AesCmacContext context;
+    byte cmac[16];
+
+    for (size_t split = 0; split <= cmacMessage.size(); split++) {
+        TEST_ASSERT_TRUE(context.setKey(cmacKey.data(), cmacKey.size()));
+        context.update(cmacMessage.data(), split);
+        context.update(cmacMessage.data() + split, cmacMessage.size() - split);
+        TEST_ASSERT_TRUE(context.finalize(cmac));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, cmac, 16);
+    }
+
+    // Truncated output and verification reuse the same key schedule
+    context.begin();
+    context.update(cmacMessage.data(), cmacMessage.size());
+    TEST_ASSERT_TRUE(context.verify(expected, 4));
+    context.update(cmacMessage.data(), cmacMessage.size() - 1);
+    TEST_ASSERT_FALSE(context.verify(expected, 4));
+
+    // A 32-byte network key rekeys the context, a cleared context refuses to finalize
+    std::vector<byte> networkKey(32, 0x42);
+    TEST_ASSERT_TRUE(context.setKey(networkKey.data(), networkKey.size()));
+    context.update(cmacMessage.data(), 40);
+    TEST_ASSERT_TRUE(context.finalize(cmac, 4));
+    std::vector<byte> message(cmacMessage.begin(), cmacMessage.begin() + 40);
+    std::vector<byte> mic = AesCmac::computeMIC(networkKey, message);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(mic.data(), cmac, 4);
+
+    context.clear();
+    TEST_ASSERT_FALSE(context.hasKey());
+    TEST_ASSERT_FALSE(context.finalize(cmac));
+    TEST_ASSERT_FALSE(context.setKey(networkKey.data(), 24));
+}
+
+void test_mic_service_streaming(void)
+{
+    EncryptionService encryptionService;
+    std::vector<byte> networkKey(32, 0x5A);
+    encryptionService.setNetworkKey(networkKey);
+    MicService micService(&encryptionService);
+
+    std::vector<byte> header(cmacMessage.begin(), cmacMessage.begin() + HEADER_LENGTH);
+    std::vector<byte> payload(cmacMessage.begin() + HEADER_LENGTH, cmacMessage.end());
+    const uint8_t topic = 0x10;
+    const auto type = MeshDeviceType::STANDARD;
+    const auto state = DeviceInclusionState::INCLUDED;
+
+    // Header and payload in separate buffers give the MIC of their concatenation
+    std::vector<byte> expected = AesCmac::computeMIC(networkKey, cmacMessage);
+    std::vector<byte> mic = micService.computePacketMIC(header, payload, topic, type, state);
+    TEST_ASSERT_EQUAL(MIC_SIZE, mic.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), mic.data(), MIC_SIZE);
+
+    byte streamed[MIC_SIZE];
+    TEST_ASSERT_TRUE(micService.beginMIC(topic, type, state));
+    micService.updateMIC(header.data(), 7);
+    micService.updateMIC(header.data() + 7, header.size() - 7);
+    micService.updateMIC(payload.data(), payload.size());
+    TEST_ASSERT_TRUE(micService.finalizeMIC(streamed));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), streamed, MIC_SIZE);
+
+    TEST_ASSERT_TRUE(micService.verifyPacketMIC(header, payload, mic, topic, type, state));
+    payload[0] ^= 0x01;
+    TEST_ASSERT_FALSE(micService.verifyPacketMIC(header, payload, mic, topic, type, state));
+
+    // Without the network key there is nothing to authenticate with
+    TEST_ASSERT_FALSE(micService.beginMIC(topic, type, DeviceInclusionState::NOT_INCLUDED));
+}
+
+void test_ctr_cipher_cache(void)
+{
+    // Same key stream as the AesCrypto component
+    AesCrypto* crypto = AesCrypto::getInstance();
+    SecurityParams params;
+    params.method = SecurityMethod::AES;
+    params.key = key;
+    params.iv = iv;
+    TEST_ASSERT_EQUAL(RM_E_NONE, crypto->setParams(params));
+    std::vector<byte> clearData(50);
+    for (size_t i = 0; i < clearData.size(); i++) {
+        clearData[i] = static_cast<byte>(i);
+    }
+    std::vector<byte> expected = crypto->encrypt(clearData);
+
+    AesCtrCipherCache cache;
+    std::vector<byte> data = clearData;
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(cache.crypt(key.data(), key.size(), iv.data(), clearData.data(),
+                                     data.data(), data.size()));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), data.data(), data.size());
+    }
+    // Decrypting in place restores the clear text
+    TEST_ASSERT_TRUE(cache.crypt(key.data(), key.size(), iv.data(), data.data(), data.data(),
+                                 data.size()));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(clearData.data(), data.data(), data.size());
+    TEST_ASSERT_EQUAL_UINT32(1, cache.getKeyExpansions());
+
+    // Cycling through one key more than there are slots evicts the least recently used one
+    std::vector<std::vector<byte>> keys(AesCtrCipherCache::SLOTS + 1, key);
+    for (size_t i = 0; i < keys.size(); i++) {
+        keys[i][0] = static_cast<byte>(i);
+    }
+    for (size_t i = 0; i < AesCtrCipherCache::SLOTS; i++) {
+        cache.crypt(keys[i].data(), key.size(), iv.data(), data.data(), data.data(), 16);
+    }
+    uint32_t expansions = cache.getKeyExpansions();
+    cache.crypt(keys[1].data(), key.size(), iv.data(), data.data(), data.data(), 16);
+    TEST_ASSERT_EQUAL_UINT32(expansions, cache.getKeyExpansions());
+    cache.crypt(keys.back().data(), key.size(), iv.data(), data.data(), data.data(), 16);
+    cache.crypt(keys[1].data(), key.size(), iv.data(), data.data(), data.data(), 16);
+    TEST_ASSERT_EQUAL_UINT32(expansions + 1, cache.getKeyExpansions());
+
+    TEST_ASSERT_FALSE(cache.crypt(key.data(), 16, iv.data(), data.data(), data.data(), 16));
+}
+
+void test_precomputed_keystream(void)
+{
+    EncryptionService encryptionService;
+    encryptionService.setNetworkKey(key);
+    const uint8_t topic = 0x10;
+    const auto type = MeshDeviceType::STANDARD;
+    const auto state = DeviceInclusionState::INCLUDED;
+
+    std::vector<byte> clearData(40, 0xA5);
+    std::vector<byte> expected =
+        encryptionService.encrypt(clearData, topic, type, state, iv.data());
+    // A different nonce gives a different key stream
+    TEST_ASSERT_FALSE(expected == encryptionService.encrypt(clearData, topic, type, state));
+
+    TEST_ASSERT_TRUE(encryptionService.precomputeKeystream(topic, type, state, iv.data(), 40));
+    std::vector<byte> data = clearData;
+    encryptionService.encryptInPlace(data.data(), data.size(), topic, type, state, iv.data());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), data.data(), data.size());
+
+    // Direct ECC keys are not known ahead of time
+    TEST_ASSERT_FALSE(encryptionService.precomputeKeystream(MessageTopic::INCLUDE_RESPONSE, type,
+                                                            state, iv.data(), 40));
+}
+
+void test_ecdh_key_cache(void)
+{
+    EcdhKeyCache* cache = EcdhKeyCache::getInstance();
+    cache->clear();
+    std::vector<byte> hubPrivate(32, 0x21), hubPublic(32);
+    std::vector<byte> devicePrivate(32, 0x43), devicePublic(32);
+    Curve25519::eval(hubPublic.data(), hubPrivate.data(), nullptr);
+    Curve25519::eval(devicePublic.data(), devicePrivate.data(), nullptr);
+
+    // Hub side of INCLUDE_RESPONSE: encryption and MIC share one scalar multiplication
+    EncryptionService hub;
+    hub.setDeviceKeys(hubPrivate, hubPublic);
+    hub.setTempDevicePublicKey(devicePublic);
+    MicService hubMic(&hub);
+    uint32_t derivations = cache->getDerivations();
+
+    std::vector<byte> clearData(32, 0x5A);
+    std::vector<byte> encrypted = hub.encrypt(clearData, MessageTopic::INCLUDE_RESPONSE,
+                                              MeshDeviceType::HUB, DeviceInclusionState::INCLUDED);
+    std::vector<byte> header(HEADER_LENGTH, 0x01);
+    std::vector<byte> mic =
+        hubMic.computePacketMIC(header, encrypted, MessageTopic::INCLUDE_RESPONSE,
+                                MeshDeviceType::HUB, DeviceInclusionState::INCLUDED);
+    TEST_ASSERT_EQUAL(MIC_SIZE, mic.size());
+    TEST_ASSERT_EQUAL_UINT32(derivations + 1, cache->getDerivations());
+
+    // Device side: another private key starts over, then one derivation serves MIC and decryption
+    EncryptionService device;
+    device.setDeviceKeys(devicePrivate, devicePublic);
+    device.setHubPublicKey(hubPublic);
+    MicService deviceMic(&device);
+    TEST_ASSERT_TRUE(deviceMic.verifyPacketMIC(header, encrypted, mic,
+                                               MessageTopic::INCLUDE_RESPONSE,
+                                               MeshDeviceType::STANDARD,
+                                               DeviceInclusionState::INCLUSION_PENDING));
+    std::vector<byte> decrypted = device.decrypt(encrypted, MessageTopic::INCLUDE_RESPONSE,
+                                                 MeshDeviceType::STANDARD,
+                                                 DeviceInclusionState::INCLUSION_PENDING);
+    TEST_ASSERT_TRUE(clearData == decrypted);
+    TEST_ASSERT_EQUAL_UINT32(derivations + 2, cache->getDerivations());
+
+    // Wiped keys are derived again
+    cache->clear();
+    device.decrypt(encrypted, MessageTopic::INCLUDE_RESPONSE, MeshDeviceType::STANDARD,
+                   DeviceInclusionState::INCLUSION_PENDING);
+    TEST_ASSERT_EQUAL_UINT32(derivations + 3, cache->getDerivations());
+}
+
+int runUnityTests()
 {
     UNITY_BEGIN();
     RUN_TEST(test_encrypt_decrypt);
-    UNITY_END();
+    RUN_TEST(test_cmac_rfc4493);
+    RUN_TEST(test_cmac_context_streaming);
+    RUN_TEST(test_mic_service_streaming);
+    RUN_TEST(test_ctr_cipher_cache);
+    RUN_TEST(test_precomputed_keystream);
+    RUN_TEST(test_ecdh_key_cache);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
 }
 
 void loop()
 {
 }
+#endif
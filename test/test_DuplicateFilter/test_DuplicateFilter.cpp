@@ -0,0 +1,115 @@
+#include <RadioMesh.h>
+#include <core/protocol/inc/routing/DuplicateFilter.h>
+#include <unity.h>
+
+void test_DuplicateFilter_window(void)
+{
+    DuplicateFilter filter;
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 100, 0));
+    filter.markSeen(0xA1, 100, 0);
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 100, 0));
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xB2, 100, 0));
+
+    // Out of order arrivals inside the window are accepted once
+    filter.markSeen(0xA1, 105, 0);
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 103, 0));
+    filter.markSeen(0xA1, 103, 0);
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 103, 0));
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 104, 0));
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 100, 0));
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 106, 0));
+
+    // Counters that fell out of the window are rejected
+    filter.markSeen(0xA1, 105 + DuplicateFilter::WINDOW_SIZE, 0);
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 104, 0));
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 105 + DuplicateFilter::WINDOW_SIZE, 0));
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 106, 0));
+    TEST_ASSERT_EQUAL(1, filter.size());
+}
+
+void test_DuplicateFilter_expiry(void)
+{
+    DuplicateFilter filter;
+    filter.markSeen(0xA1, 1, 1000);
+
+    // A silent source is forgotten
+    uint32_t later = 1000 + DuplicateFilter::SOURCE_TIMEOUT_MS;
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 1, later - 1));
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 1, later));
+    filter.markSeen(0xA1, 1, later);
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 1, later));
+    TEST_ASSERT_EQUAL(1, filter.size());
+
+    // When full, the source heard from least recently makes room
+    for (uint32_t source = 1; source <= DuplicateFilter::MAX_SOURCES; source++) {
+        filter.markSeen(source, 10, later + source);
+    }
+    TEST_ASSERT_EQUAL(DuplicateFilter::MAX_SOURCES, filter.size());
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 1, later + 100));
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(2, 10, later + 100));
+
+    filter.clear();
+    TEST_ASSERT_EQUAL(0, filter.size());
+}
+
+void test_DuplicateFilter_replay_below_window(void)
+{
+    // Well past two windows, a captured frame with a counter from the start is still old
+    DuplicateFilter filter;
+    for (uint32_t fcounter = 1; fcounter <= 3 * DuplicateFilter::WINDOW_SIZE; fcounter++) {
+        filter.markSeen(0xA1, fcounter, 1000);
+    }
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 1, 1000));
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, DuplicateFilter::WINDOW_SIZE, 1000));
+
+    // Recording it anyway does not reopen the window to older frames
+    filter.markSeen(0xA1, 1, 1000);
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 2, 1000));
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 2 * DuplicateFilter::WINDOW_SIZE, 1000));
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, 3 * DuplicateFilter::WINDOW_SIZE + 1, 1000));
+}
+
+void test_DuplicateFilter_resume_after_reboot(void)
+{
+    // A source that sent few packets cannot count from 1 again, devices count on from their
+    // reserved frame counters instead
+    DuplicateFilter filter;
+    for (uint32_t fcounter = 1; fcounter <= 40; fcounter++) {
+        filter.markSeen(0xA1, fcounter, 1000);
+    }
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 1, 2000));
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, 40, 2000));
+
+    // After the reboot the source resumes past its reservation and is heard at once
+    uint32_t resumed = RM_FCOUNTER_RESERVE + 1;
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, resumed, 2000));
+    filter.markSeen(0xA1, resumed, 2000);
+    TEST_ASSERT_EQUAL(true, filter.isDuplicate(0xA1, resumed, 2000));
+    TEST_ASSERT_EQUAL(false, filter.isDuplicate(0xA1, resumed + 1, 2000));
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_DuplicateFilter_window);
+    RUN_TEST(test_DuplicateFilter_expiry);
+    RUN_TEST(test_DuplicateFilter_replay_below_window);
+    RUN_TEST(test_DuplicateFilter_resume_after_reboot);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
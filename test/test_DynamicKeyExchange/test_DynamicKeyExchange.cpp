@@ -68,15 +68,27 @@ void test_updateSecurityParams_without_crypto_creates_crypto(void)
     TEST_ASSERT_EQUAL(RM_E_NONE, rc);
 }
 
-void setup()
+int runUnityTests()
 {
     UNITY_BEGIN();
     RUN_TEST(test_updateSecurityParams_with_crypto);
     RUN_TEST(test_updateSecurityParams_without_crypto_creates_crypto);
-    UNITY_END();
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
 }
 
 void loop()
 {
     // Empty loop
-}
\ No newline at end of file
+}
+#endif
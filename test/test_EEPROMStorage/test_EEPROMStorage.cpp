@@ -211,12 +211,8 @@ void test_EEPROMStorage_write_and_commit_same_key(void)
     TEST_ASSERT_EQUAL(8, readData[3]);
 }
 
-void setup()
+int runUnityTests()
 {
-    Serial.begin(115200);
-    while (!Serial)
-        ; // Wait for serial connection (optional)
-
     initStorage();
     UNITY_BEGIN();
     Serial.println("EEPROMStorage test_EEPROMStorage_write_exist_and_read");
@@ -239,9 +235,25 @@ void setup()
     RUN_TEST(test_EEPROMStorage_write_and_commit_same_key);
 
     resetEEPROMStorage();
-    UNITY_END();
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+        ; // Wait for serial connection (optional)
+
+    runUnityTests();
 }
 
 void loop()
 {
 }
+#endif
@@ -6,13 +6,25 @@ void test_Loger_loginfo_ln(void)
     loginfo_ln("Hello, World!");
 }
 
-void setup()
+int runUnityTests()
 {
     UNITY_BEGIN();
     RUN_TEST(test_Loger_loginfo_ln);
-    UNITY_END();
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
 }
 
 void loop()
 {
 }
+#endif
@@ -0,0 +1,107 @@
+#include <RadioMesh.h>
+#include <core/protocol/inc/routing/HopAckTracker.h>
+#include <unity.h>
+
+static void makeHopFrame(TxFrame& frame, byte nextHop)
+{
+    memset(frame.data, 0, sizeof(frame.data));
+    frame.data[NEXT_HOP_POS] = nextHop;
+    frame.length = HEADER_LENGTH + MIC_SIZE;
+    frame.priority = TxPriority::APPLICATION;
+    frame.onComplete = nullptr;
+    frame.context = nullptr;
+}
+
+void test_HopAckTracker_timeouts_and_retries(void)
+{
+    HopAckTracker tracker;
+    TxFrame frame;
+    makeHopFrame(frame, 7);
+    const byte hop[DEV_ID_LENGTH] = {7, 0, 0, 0};
+    const byte otherHop[DEV_ID_LENGTH] = {8, 0, 0, 0};
+
+    // Frame of 100 ms, ACK of 20 ms: the first timeout covers both ways and the guard
+    HopAckTracker::PendingAck* pending = tracker.add(frame, 0x1234, MeshDeviceType::STANDARD,
+                                                     DeviceInclusionState::INCLUDED, 100, 20);
+    TEST_ASSERT_NOT_NULL(pending);
+    uint32_t timeout = 100 + 2 * 20 + RM_HOP_ACK_GUARD_MS;
+    TEST_ASSERT_EQUAL(timeout, tracker.getTimeout(*pending));
+    TEST_ASSERT_FALSE(tracker.onSent(pending, 1000));
+
+    uint32_t dueAt;
+    TEST_ASSERT_TRUE(tracker.getNextDue(&dueAt));
+    TEST_ASSERT_TRUE(dueAt >= 1000 + timeout && dueAt <= 1000 + timeout * 3 / 2);
+    TEST_ASSERT_NULL(tracker.getExpired(dueAt - 1));
+    TEST_ASSERT_TRUE(pending == tracker.getExpired(dueAt));
+
+    // Every retransmission doubles the timeout, until the retries are used up
+    for (int i = 0; i < RM_HOP_ACK_RETRIES; i++) {
+        TEST_ASSERT_TRUE(tracker.canRetry(*pending));
+        tracker.onRetransmit(pending);
+        TEST_ASSERT_EQUAL(std::min<uint32_t>(timeout << (i + 1), RM_HOP_ACK_MAX_TIMEOUT_MS),
+                          tracker.getTimeout(*pending));
+        tracker.onSent(pending, 2000);
+    }
+    TEST_ASSERT_FALSE(tracker.canRetry(*pending));
+    tracker.release(pending);
+    TEST_ASSERT_EQUAL(0, tracker.size());
+    TEST_ASSERT_EQUAL(RM_HOP_ACK_RETRIES, tracker.getStats().retransmissions);
+    TEST_ASSERT_EQUAL(1, tracker.getStats().failures);
+
+    // Only the next hop acknowledges, the first delay measured sets the timeout
+    pending = tracker.add(frame, 0x5678, MeshDeviceType::STANDARD, DeviceInclusionState::INCLUDED,
+                          100, 20);
+    tracker.onSent(pending, 3000);
+    TEST_ASSERT_NULL(tracker.onAck(0x5678, otherHop, 3060));
+    TEST_ASSERT_NULL(tracker.onAck(0x9999, hop, 3060));
+    TEST_ASSERT_TRUE(pending == tracker.onAck(0x5678, hop, 3060));
+    TEST_ASSERT_EQUAL(HopAckTracker::State::WAITING, pending->state);
+    tracker.release(pending);
+    TEST_ASSERT_EQUAL(1, tracker.getStats().acked);
+    TEST_ASSERT_EQUAL(1, tracker.getStats().failures);
+    TEST_ASSERT_EQUAL(60, tracker.getStats().smoothedRttMs);
+
+    pending = tracker.add(frame, 0x4321, MeshDeviceType::STANDARD, DeviceInclusionState::INCLUDED,
+                          100, 20);
+    TEST_ASSERT_EQUAL(60 + 4 * 30, tracker.getTimeout(*pending));
+
+    // An ACK for an earlier copy completes a retransmission once it is sent
+    tracker.onSent(pending, 4000);
+    tracker.onRetransmit(pending);
+    TEST_ASSERT_TRUE(pending == tracker.onAck(0x4321, hop, 4500));
+    TEST_ASSERT_EQUAL(HopAckTracker::State::SENDING, pending->state);
+    TEST_ASSERT_TRUE(tracker.onSent(pending, 4600));
+    tracker.release(pending);
+    TEST_ASSERT_EQUAL(60, tracker.getStats().smoothedRttMs);
+
+    // Frames are sent unacknowledged once every slot is taken
+    for (int i = 0; i < HopAckTracker::SLOTS; i++) {
+        TEST_ASSERT_NOT_NULL(tracker.add(frame, i, MeshDeviceType::STANDARD,
+                                         DeviceInclusionState::INCLUDED, 100, 20));
+    }
+    TEST_ASSERT_NULL(tracker.add(frame, 100, MeshDeviceType::STANDARD,
+                                 DeviceInclusionState::INCLUDED, 100, 20));
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_HopAckTracker_timeouts_and_retries);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
@@ -1,3 +1,6 @@
+#include <vector>
+
+#include <NativeHost.h>
 #include <RadioMesh.h>
 #include <unity.h>
 
@@ -75,7 +78,425 @@ void test_LoraRadio_setup_with_given_radio_params(void)
     TEST_ASSERT_EQUAL(radioParams.sf, params.sf);
 }
 
-void setup()
+// Keeps the emulated chip behind a LoraRadio, to deliver frames to it
+class CapturingBackend : public NativeRadioBackend
+{
+public:
+    SX1262* chip = nullptr;
+    // When set, a frame stays on air until the test calls transmitDone()
+    bool holdTx = false;
+    // First byte of every frame put on air
+    std::vector<byte> sentIds;
+    // Number of channel activity detections still to report a busy channel
+    int busyScans = 0;
+
+    int16_t transmit(SX1262& radio, const uint8_t* data, size_t length) override
+    {
+        sentIds.push_back(data[0]);
+        if (!holdTx) {
+            radio.transmitDone();
+        }
+        return RADIOLIB_ERR_NONE;
+    }
+
+    bool isChannelActive(SX1262& radio) override
+    {
+        if (busyScans > 0) {
+            busyScans--;
+            return true;
+        }
+        return false;
+    }
+
+    void onAttach(SX1262& radio, bool attached) override
+    {
+        chip = attached ? &radio : nullptr;
+    }
+};
+
+void test_LoraRadio_rx_ring(void)
+{
+    CapturingBackend backend;
+    NativeHost::setRadioBackend(&backend);
+    LoraRadio* previous = LoraRadio::setInstance(nullptr);
+    LoraRadio* ringRadio = LoraRadio::getInstance();
+    TEST_ASSERT_EQUAL(RM_E_NONE, ringRadio->setup(radioParams));
+    TEST_ASSERT_NOT_NULL(backend.chip);
+
+    // A burst of frames, more than the ring holds, before the device gets to run
+    for (int i = 0; i < RM_RX_RING_SLOTS + 2; i++) {
+        byte frame[3] = {static_cast<byte>(i), 0xAA, 0x55};
+        TEST_ASSERT_TRUE(backend.chip->receive(frame, sizeof(frame), -80.0f - i, 7.5f));
+    }
+    ringRadio->serviceInterrupts();
+    TEST_ASSERT_TRUE(ringRadio->checkAndClearRxFlag());
+    TEST_ASSERT_EQUAL(2, ringRadio->getRxOverflows());
+
+    // Queued frames come out in order, each with its own signal quality
+    for (int i = 0; i < RM_RX_RING_SLOTS; i++) {
+        const RxFrame* frame = ringRadio->peekReceivedFrame();
+        TEST_ASSERT_NOT_NULL(frame);
+        TEST_ASSERT_EQUAL(3, frame->length);
+        TEST_ASSERT_EQUAL(i, frame->data[0]);
+        TEST_ASSERT_FLOAT_WITHIN(0.01, -80.0f - i, frame->rssi);
+        TEST_ASSERT_FLOAT_WITHIN(0.01, 7.5f, frame->snr);
+        ringRadio->releaseReceivedFrame();
+    }
+    TEST_ASSERT_NULL(ringRadio->peekReceivedFrame());
+    TEST_ASSERT_FALSE(ringRadio->checkAndClearRxFlag());
+
+    // The copying read dequeues too
+    byte frame[2] = {0x12, 0x34};
+    TEST_ASSERT_TRUE(backend.chip->receive(frame, sizeof(frame), -90.0f, 5.0f));
+    byte buffer[8];
+    size_t length = 0;
+    TEST_ASSERT_EQUAL(RM_E_NONE, ringRadio->readReceivedData(buffer, sizeof(buffer), &length));
+    TEST_ASSERT_EQUAL(2, length);
+    TEST_ASSERT_EQUAL_HEX8(0x34, buffer[1]);
+    TEST_ASSERT_EQUAL(RM_E_RADIO_RX, ringRadio->readReceivedData(buffer, sizeof(buffer), &length));
+
+    LoraRadio::setInstance(previous);
+    delete ringRadio;
+    NativeHost::setRadioBackend(nullptr);
+}
+
+static std::vector<int> completions;
+
+static void recordCompletion(const TxFrame& frame, int err, void* context)
+{
+    completions.push_back(err == RM_E_NONE ? frame.data[0] : err);
+}
+
+static bool isFrameId(const TxFrame& frame, void* context)
+{
+    return frame.data[0] == *static_cast<byte*>(context);
+}
+
+static int queueFrame(LoraRadio* radio, byte id, TxPriority priority, uint16_t replyWindowMs = 0)
+{
+    TxFrame* frame = radio->acquireTxFrame();
+    if (frame == nullptr) {
+        return RM_E_QUEUE_FULL;
+    }
+    frame->data[0] = id;
+    frame->data[1] = 0x55;
+    frame->replyWindowMs = replyWindowMs;
+    return radio->queueTxFrame(frame, 2, priority, recordCompletion, nullptr);
+}
+
+void test_LoraRadio_tx_queue(void)
+{
+    CapturingBackend backend;
+    backend.holdTx = true;
+    NativeHost::setRadioBackend(&backend);
+    LoraRadio* previous = LoraRadio::setInstance(nullptr);
+    LoraRadio* txRadio = LoraRadio::getInstance();
+    TEST_ASSERT_EQUAL(RM_E_NONE, txRadio->setup(radioParams));
+    completions.clear();
+
+    // The radio is idle so the first frame goes out at once, the others wait their turn
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 1, TxPriority::RELAY));
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 2, TxPriority::APPLICATION));
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 3, TxPriority::RELAY));
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 4, TxPriority::INCLUSION));
+    for (int id = 5; id <= RM_TX_QUEUE_SLOTS; id++) {
+        TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, id, TxPriority::RELAY));
+    }
+    TEST_ASSERT_EQUAL(1, backend.sentIds.size());
+    TEST_ASSERT_EQUAL(RM_E_QUEUE_FULL, queueFrame(txRadio, 99, TxPriority::INCLUSION));
+
+    TxQueueStats stats = txRadio->getTxQueueStats();
+    TEST_ASSERT_EQUAL(RM_TX_QUEUE_SLOTS, stats.depth);
+    TEST_ASSERT_EQUAL(RM_TX_QUEUE_SLOTS, stats.highWater);
+    TEST_ASSERT_EQUAL(1, stats.depthByPriority[static_cast<size_t>(TxPriority::INCLUSION)]);
+    TEST_ASSERT_EQUAL(1, stats.rejected);
+
+    // Each TX done feeds the radio the next frame, most urgent first and oldest first within a
+    // priority, then the radio goes back to receive
+    for (int i = 0; i < RM_TX_QUEUE_SLOTS; i++) {
+        backend.chip->transmitDone();
+    }
+    std::vector<byte> expected = {1, 4, 2, 3};
+    for (int id = 5; id <= RM_TX_QUEUE_SLOTS; id++) {
+        expected.push_back(id);
+    }
+    TEST_ASSERT_EQUAL(expected.size(), backend.sentIds.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), backend.sentIds.data(), expected.size());
+    TEST_ASSERT_TRUE(backend.chip->getMode() == SX1262::Mode::RX);
+
+    // Completions are reported from the device loop, in the order the frames went out
+    TEST_ASSERT_EQUAL(0, completions.size());
+    txRadio->dispatchTxCompletions();
+    TEST_ASSERT_EQUAL(expected.size(), completions.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL(expected[i], completions[i]);
+    }
+    stats = txRadio->getTxQueueStats();
+    TEST_ASSERT_EQUAL(0, stats.depth);
+    TEST_ASSERT_EQUAL(RM_TX_QUEUE_SLOTS, stats.sent);
+    TEST_ASSERT_NOT_NULL(txRadio->acquireTxFrame());
+
+    LoraRadio::setInstance(previous);
+    delete txRadio;
+    NativeHost::setRadioBackend(nullptr);
+}
+
+void test_LoraRadio_listen_before_talk(void)
+{
+    CapturingBackend backend;
+    NativeHost::setRadioBackend(&backend);
+    NativeHost::useVirtualClock(1000000);
+    LoraRadio* previous = LoraRadio::setInstance(nullptr);
+    LoraRadio* lbtRadio = LoraRadio::getInstance();
+    LoraRadioParams params = radioParams;
+    params.setListenBeforeTalk(true, 3);
+    TEST_ASSERT_EQUAL(RM_E_NONE, lbtRadio->setup(params));
+    completions.clear();
+
+    // A busy channel delays the frame, the radio listens meanwhile
+    backend.busyScans = 1;
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(lbtRadio, 1, TxPriority::APPLICATION));
+    TEST_ASSERT_EQUAL(0, backend.sentIds.size());
+    TEST_ASSERT_TRUE(backend.chip->getMode() == SX1262::Mode::RX);
+    uint32_t dueAt = 0;
+    TEST_ASSERT_TRUE(lbtRadio->getTxRetryDue(&dueAt));
+    TEST_ASSERT_TRUE(dueAt > millis());
+    NativeHost::setMicros((dueAt - 1) * 1000ULL);
+    lbtRadio->serviceInterrupts();
+    TEST_ASSERT_EQUAL(0, backend.sentIds.size());
+    NativeHost::setMicros(dueAt * 1000ULL);
+    lbtRadio->serviceInterrupts();
+    TEST_ASSERT_EQUAL(1, backend.sentIds.size());
+    TEST_ASSERT_FALSE(lbtRadio->getTxRetryDue(&dueAt));
+
+    // A channel that stays busy makes the frame fail after the last attempt
+    backend.busyScans = 10;
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(lbtRadio, 2, TxPriority::APPLICATION));
+    uint32_t previousDue = 0;
+    int retries = 0;
+    while (lbtRadio->getTxRetryDue(&dueAt)) {
+        TEST_ASSERT_TRUE(dueAt > previousDue);
+        previousDue = dueAt;
+        NativeHost::setMicros(dueAt * 1000ULL);
+        lbtRadio->serviceInterrupts();
+        retries++;
+    }
+    TEST_ASSERT_EQUAL(2, retries);
+    TEST_ASSERT_EQUAL(1, backend.sentIds.size());
+    TEST_ASSERT_TRUE(backend.chip->getMode() == SX1262::Mode::RX);
+    lbtRadio->dispatchTxCompletions();
+    TEST_ASSERT_EQUAL(2, completions.size());
+    TEST_ASSERT_EQUAL(1, completions[0]);
+    TEST_ASSERT_EQUAL(RM_E_RADIO_CHANNEL_BUSY, completions[1]);
+
+    ChannelAccessStats stats = lbtRadio->getChannelAccessStats();
+    TEST_ASSERT_EQUAL(5, stats.scans);
+    TEST_ASSERT_EQUAL(4, stats.busy);
+    TEST_ASSERT_EQUAL(1, stats.dropped);
+
+    LoraRadio::setInstance(previous);
+    delete lbtRadio;
+    NativeHost::useRealClock();
+    NativeHost::setRadioBackend(nullptr);
+}
+
+void test_LoraRadio_relay_listen_before_talk(void)
+{
+    CapturingBackend backend;
+    NativeHost::setRadioBackend(&backend);
+    NativeHost::useVirtualClock(1000000);
+    LoraRadio* previous = LoraRadio::setInstance(nullptr);
+    LoraRadio* lbtRadio = LoraRadio::getInstance();
+
+    // Off by default, even a relay goes out on a busy channel
+    TEST_ASSERT_EQUAL(RM_E_NONE, lbtRadio->setup(radioParams));
+    backend.busyScans = 1;
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(lbtRadio, 1, TxPriority::RELAY));
+    TEST_ASSERT_EQUAL(1, backend.sentIds.size());
+    TEST_ASSERT_EQUAL(0, lbtRadio->getChannelAccessStats().scans);
+    LoraRadio::setInstance(previous);
+    delete lbtRadio;
+
+    // Turned on, for relays only: frames sent first hand still go out on a busy channel
+    backend.busyScans = 1;
+    backend.sentIds.clear();
+    previous = LoraRadio::setInstance(nullptr);
+    lbtRadio = LoraRadio::getInstance();
+    LoraRadioParams params = radioParams;
+    params.setRelayListenBeforeTalk(true);
+    TEST_ASSERT_EQUAL(RM_E_NONE, lbtRadio->setup(params));
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(lbtRadio, 2, TxPriority::APPLICATION));
+    TEST_ASSERT_EQUAL(1, backend.sentIds.size());
+    TEST_ASSERT_EQUAL(0, lbtRadio->getChannelAccessStats().scans);
+
+    // A relay waits for the channel to clear
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(lbtRadio, 3, TxPriority::RELAY));
+    TEST_ASSERT_EQUAL(1, backend.sentIds.size());
+    uint32_t dueAt = 0;
+    TEST_ASSERT_TRUE(lbtRadio->getTxRetryDue(&dueAt));
+    NativeHost::setMicros(dueAt * 1000ULL);
+    lbtRadio->serviceInterrupts();
+    TEST_ASSERT_EQUAL(2, backend.sentIds.size());
+    TEST_ASSERT_EQUAL(3, backend.sentIds[1]);
+    ChannelAccessStats stats = lbtRadio->getChannelAccessStats();
+    TEST_ASSERT_EQUAL(2, stats.scans);
+    TEST_ASSERT_EQUAL(1, stats.busy);
+
+    // A relay waiting for the channel is given up when it matches, and the next frame goes out
+    lbtRadio->dispatchTxCompletions();
+    completions.clear();
+    backend.busyScans = 1;
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(lbtRadio, 4, TxPriority::RELAY));
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(lbtRadio, 5, TxPriority::APPLICATION));
+    TEST_ASSERT_EQUAL(2, backend.sentIds.size());
+    byte id = 6;
+    TEST_ASSERT_FALSE(lbtRadio->cancelWaitingTxFrame(&isFrameId, &id));
+    id = 4;
+    TEST_ASSERT_TRUE(lbtRadio->cancelWaitingTxFrame(&isFrameId, &id));
+    TEST_ASSERT_EQUAL(3, backend.sentIds.size());
+    TEST_ASSERT_EQUAL(5, backend.sentIds[2]);
+    TEST_ASSERT_FALSE(lbtRadio->cancelWaitingTxFrame(&isFrameId, &id));
+    lbtRadio->dispatchTxCompletions();
+    TEST_ASSERT_EQUAL(2, completions.size());
+    TEST_ASSERT_EQUAL(RM_E_RADIO_CHANNEL_BUSY, completions[0]);
+    TEST_ASSERT_EQUAL(5, completions[1]);
+
+    LoraRadio::setInstance(previous);
+    delete lbtRadio;
+    NativeHost::useRealClock();
+    NativeHost::setRadioBackend(nullptr);
+}
+
+void test_LoraRadio_rx_error_during_reply_window(void)
+{
+    CapturingBackend backend;
+    backend.holdTx = true;
+    NativeHost::setRadioBackend(&backend);
+    NativeHost::useVirtualClock(1000000);
+    LoraRadio* previous = LoraRadio::setInstance(nullptr);
+    LoraRadio* txRadio = LoraRadio::getInstance();
+    TEST_ASSERT_EQUAL(RM_E_NONE, txRadio->setup(radioParams));
+    completions.clear();
+
+    // The first frame waits for a reply, the second one is queued behind it
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 1, TxPriority::APPLICATION, 200));
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 2, TxPriority::APPLICATION));
+    backend.chip->transmitDone();
+    TEST_ASSERT_TRUE(backend.chip->getMode() == SX1262::Mode::RX);
+
+    // A corrupted frame is heard in the reply window, then the window ends and the second frame
+    // goes on air before the device loop looks at the error
+    backend.chip->raiseIrq(RADIOLIB_SX126X_IRQ_RX_DONE | RADIOLIB_SX126X_IRQ_CRC_ERR);
+    NativeHost::advanceMicros(200000);
+    txRadio->serviceInterrupts();
+    TEST_ASSERT_EQUAL(2, backend.sentIds.size());
+    TEST_ASSERT_TRUE(txRadio->checkAndClearRxFlag());
+    txRadio->getRadioStateError();
+    TEST_ASSERT_TRUE(backend.chip->getMode() == SX1262::Mode::TX);
+
+    // The transmission was not aborted, its TX done drains the queue
+    backend.chip->transmitDone();
+    txRadio->dispatchTxCompletions();
+    TEST_ASSERT_EQUAL(2, completions.size());
+    TEST_ASSERT_EQUAL(1, completions[0]);
+    TEST_ASSERT_EQUAL(2, completions[1]);
+    TEST_ASSERT_EQUAL(0, txRadio->getTxQueueStats().depth);
+    TEST_ASSERT_TRUE(backend.chip->getMode() == SX1262::Mode::RX);
+
+    LoraRadio::setInstance(previous);
+    delete txRadio;
+    NativeHost::useRealClock();
+    NativeHost::setRadioBackend(nullptr);
+}
+
+void test_LoraRadio_tx_watchdog(void)
+{
+    CapturingBackend backend;
+    backend.holdTx = true;
+    NativeHost::setRadioBackend(&backend);
+    NativeHost::useVirtualClock(1000000);
+    LoraRadio* previous = LoraRadio::setInstance(nullptr);
+    LoraRadio* txRadio = LoraRadio::getInstance();
+    TEST_ASSERT_EQUAL(RM_E_NONE, txRadio->setup(radioParams));
+    completions.clear();
+
+    // TX done never comes for the first frame
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 1, TxPriority::APPLICATION));
+    TEST_ASSERT_EQUAL(RM_E_NONE, queueFrame(txRadio, 2, TxPriority::APPLICATION));
+    uint32_t dueAt = 0;
+    TEST_ASSERT_TRUE(txRadio->getTxRetryDue(&dueAt));
+    TEST_ASSERT_TRUE(dueAt >= millis() + RM_TX_WATCHDOG_MARGIN_MS);
+    NativeHost::setMicros((dueAt - 1) * 1000ULL);
+    txRadio->serviceInterrupts();
+    TEST_ASSERT_EQUAL(1, backend.sentIds.size());
+
+    // Once overdue it fails and the next frame goes out
+    NativeHost::setMicros(dueAt * 1000ULL);
+    txRadio->serviceInterrupts();
+    TEST_ASSERT_EQUAL(2, backend.sentIds.size());
+    backend.chip->transmitDone();
+    TEST_ASSERT_FALSE(txRadio->getTxRetryDue(&dueAt));
+    txRadio->dispatchTxCompletions();
+    TEST_ASSERT_EQUAL(2, completions.size());
+    TEST_ASSERT_EQUAL(RM_E_RADIO_TX_TIMEOUT, completions[0]);
+    TEST_ASSERT_EQUAL(2, completions[1]);
+    TEST_ASSERT_EQUAL(0, txRadio->getTxQueueStats().depth);
+    TEST_ASSERT_TRUE(backend.chip->getMode() == SX1262::Mode::RX);
+
+    LoraRadio::setInstance(previous);
+    delete txRadio;
+    NativeHost::useRealClock();
+    NativeHost::setRadioBackend(nullptr);
+}
+
+void test_AirtimeGovernor_budget(void)
+{
+    typedef AirtimeGovernor::Decision Decision;
+    uint32_t retryAt = 0;
+
+    AirtimeGovernor unrestricted;
+    unrestricted.setRegion(AirtimeRegion::UNRESTRICTED, 915.0);
+    TEST_ASSERT_TRUE(unrestricted.check(2000000, TxPriority::RELAY, 0, &retryAt) ==
+                     Decision::SEND);
+    TEST_ASSERT_EQUAL(1000, unrestricted.getBudget(0).dutyCyclePermille);
+
+    // 1% sub-band: 36 s of airtime per hour, refilled at 10 us per ms
+    AirtimeGovernor eu;
+    eu.setRegion(AirtimeRegion::EU868, 868.3);
+    AirtimeBudget budget = eu.getBudget(0);
+    TEST_ASSERT_EQUAL(10, budget.dutyCyclePermille);
+    TEST_ASSERT_EQUAL(RM_AIRTIME_WINDOW_S * 10, budget.capacityMs);
+    TEST_ASSERT_EQUAL(budget.capacityMs, budget.remainingMs);
+    TEST_ASSERT_TRUE(eu.check(100000, TxPriority::RELAY, 0, &retryAt) == Decision::SEND);
+
+    // An exhausted budget defers the node's own frames until it refilled, and drops relays
+    eu.consume(budget.capacityMs * 1000 - 50000, 0);
+    TEST_ASSERT_EQUAL(50, eu.getBudget(0).remainingMs);
+    TEST_ASSERT_TRUE(eu.check(100000, TxPriority::APPLICATION, 0, &retryAt) == Decision::DEFER);
+    TEST_ASSERT_EQUAL(5000, retryAt);
+    TEST_ASSERT_TRUE(eu.check(100000, TxPriority::RELAY, 0, &retryAt) == Decision::DROP);
+    TEST_ASSERT_TRUE(eu.check(100000, TxPriority::ACK, retryAt, &retryAt) == Decision::SEND);
+    budget = eu.getBudget(5000);
+    TEST_ASSERT_EQUAL(1, budget.deferred);
+    TEST_ASSERT_EQUAL(1, budget.dropped);
+
+    // Every sub-band has its own budget
+    eu.setRegion(AirtimeRegion::EU868, 869.5);
+    budget = eu.getBudget(5000);
+    TEST_ASSERT_EQUAL(100, budget.dutyCyclePermille);
+    TEST_ASSERT_EQUAL(budget.capacityMs, budget.remainingMs);
+    eu.setRegion(AirtimeRegion::EU868, 868.3);
+    TEST_ASSERT_EQUAL(100, eu.getBudget(5000).remainingMs);
+
+    // US915 has no duty cycle, only a dwell time per frame
+    AirtimeGovernor us;
+    us.setRegion(AirtimeRegion::US915, 915.0);
+    TEST_ASSERT_TRUE(us.check(399000, TxPriority::APPLICATION, 0, &retryAt) == Decision::SEND);
+    TEST_ASSERT_TRUE(us.check(450000, TxPriority::APPLICATION, 0, &retryAt) == Decision::DROP);
+    TEST_ASSERT_EQUAL(400, us.getBudget(0).maxDwellMs);
+}
+
+int runUnityTests()
 {
     UNITY_BEGIN();
     RUN_TEST(test_LoraRadio_getInstance);
@@ -84,9 +505,28 @@ void setup()
 
     RUN_TEST(test_LoraRadio_setup_without_set_params);
     RUN_TEST(test_LoraRadio_setup_with_given_radio_params);
-    UNITY_END();
+    RUN_TEST(test_LoraRadio_rx_ring);
+    RUN_TEST(test_LoraRadio_tx_queue);
+    RUN_TEST(test_LoraRadio_listen_before_talk);
+    RUN_TEST(test_LoraRadio_relay_listen_before_talk);
+    RUN_TEST(test_LoraRadio_rx_error_during_reply_window);
+    RUN_TEST(test_LoraRadio_tx_watchdog);
+    RUN_TEST(test_AirtimeGovernor_budget);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
 }
 
 void loop()
 {
 }
+#endif
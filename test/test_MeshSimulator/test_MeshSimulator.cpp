@@ -0,0 +1,474 @@
+#include <MeshSimulator.h>
+#include <RadioMesh.h>
+#include <unity.h>
+
+static const uint8_t APP_TOPIC = 0x10;
+static const std::vector<byte> PAYLOAD = {1, 2, 3, 4, 5, 6, 7, 8};
+
+static SimNodeConfig makeNode(uint32_t id, double x,
+                              MeshDeviceType type = MeshDeviceType::STANDARD)
+{
+    SimNodeConfig node;
+    node.name = "node" + std::to_string(id);
+    node.id = RadioMeshUtils::uint32ToDeviceId(id);
+    node.type = type;
+    node.x = x;
+    return node;
+}
+
+void test_MeshSimulator_timeOnAir(void)
+{
+    LoraModulation modulation;
+    modulation.sf = 7;
+    modulation.bw = 125.0;
+    modulation.cr = 5;
+    modulation.preambleLength = 8;
+
+    // Reference values from the Semtech LoRa calculator
+    TEST_ASSERT_EQUAL_UINT32(56576, ChannelModel::timeOnAirMicros(modulation, 20));
+    modulation.cr = 7;
+    TEST_ASSERT_EQUAL_UINT32(70912, ChannelModel::timeOnAirMicros(modulation, 20));
+
+    // SF12 at 125 kHz enables low data rate optimization
+    modulation.sf = 12;
+    modulation.cr = 5;
+    TEST_ASSERT_EQUAL_UINT32(1318912, ChannelModel::timeOnAirMicros(modulation, 20));
+}
+
+void test_MeshSimulator_unicast_two_nodes(void)
+{
+    MeshSimulator sim;
+    TEST_ASSERT_EQUAL(0, sim.addNode(makeNode(1, 0)));
+    TEST_ASSERT_EQUAL(1, sim.addNode(makeNode(2, 1000)));
+
+    sim.scheduleSend(0, 1000, APP_TOPIC, PAYLOAD, RadioMeshUtils::uint32ToDeviceId(2));
+    sim.runFor(5000);
+
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(1, report.messagesSent);
+    TEST_ASSERT_EQUAL(1, report.deliveries);
+    TEST_ASSERT_EQUAL(1, report.framesSent);
+    TEST_ASSERT_EQUAL(0, report.relays);
+    // A single hop is delivered exactly one time on air after the send
+    TEST_ASSERT_FLOAT_WITHIN(0.001, report.airtimeMicros / 1000.0, report.latencyMaxMs);
+}
+
+void test_MeshSimulator_relay_out_of_range(void)
+{
+    // 16 km apart the end nodes cannot hear each other at SF8, the middle node relays
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 8000));
+    sim.addNode(makeNode(3, 16000));
+
+    sim.scheduleSend(0, 1000, APP_TOPIC, PAYLOAD, RadioMeshUtils::uint32ToDeviceId(3));
+    sim.runFor(5000);
+
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(1, report.deliveries);
+    TEST_ASSERT_EQUAL(1, report.relays);
+    TEST_ASSERT_EQUAL(1, report.nodes[1].relays);
+    TEST_ASSERT_EQUAL(0, report.duplicateRebroadcasts);
+}
+
+void test_MeshSimulator_rx_drop_counts(void)
+{
+    // The relayed copy reaches the sender again and is rejected from its header
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 8000));
+    sim.addNode(makeNode(3, 16000));
+
+    sim.scheduleSend(0, 1000, APP_TOPIC, PAYLOAD, RadioMeshUtils::uint32ToDeviceId(3));
+    sim.runFor(5000);
+
+    TEST_ASSERT_EQUAL(1, sim.getReport().deliveries);
+    RadioMeshDevice* sender = sim.getDevice(0);
+    TEST_ASSERT_EQUAL(1, sender->getRxDropCount(RxDropReason::OWN_ECHO));
+    TEST_ASSERT_EQUAL(0, sender->getRxDropCount(RxDropReason::DUPLICATE));
+    TEST_ASSERT_EQUAL(0, sender->getRxDropCount(RxDropReason::CRC_MISMATCH));
+    TEST_ASSERT_EQUAL(0, sender->getRxDropCount(RxDropReason::MIC_FAILURE));
+    for (size_t i = 1; i < 3; i++) {
+        TEST_ASSERT_EQUAL(0, sim.getDevice(i)->getRxDropCount(RxDropReason::OWN_ECHO));
+    }
+}
+
+void test_MeshSimulator_collision(void)
+{
+    // Equal power frames overlapping at the middle node are both lost
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, -1000));
+    sim.addNode(makeNode(2, 0));
+    sim.addNode(makeNode(3, 1000));
+
+    auto target = RadioMeshUtils::uint32ToDeviceId(2);
+    sim.scheduleSend(0, 1000, APP_TOPIC, PAYLOAD, target);
+    sim.scheduleSend(2, 1500, APP_TOPIC, PAYLOAD, target);
+    sim.runFor(5000);
+
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(2, report.messagesSent);
+    TEST_ASSERT_EQUAL(0, report.deliveries);
+    TEST_ASSERT_EQUAL(2, report.nodes[1].collisions);
+}
+
+void test_MeshSimulator_hop_ack(void)
+{
+    // Once the end node was heard, the packet back to it is routed and acknowledged hop by hop
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 8000));
+    sim.addNode(makeNode(3, 16000));
+
+    sim.scheduleSend(2, 1000000, APP_TOPIC, PAYLOAD, BROADCAST_ADDR);
+    sim.scheduleSend(0, 5000000, APP_TOPIC, PAYLOAD, RadioMeshUtils::uint32ToDeviceId(3));
+    sim.runFor(10000);
+
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(3, report.deliveries);
+    TEST_ASSERT_EQUAL(1, report.nodes[0].hopAcked);
+    TEST_ASSERT_EQUAL(1, report.nodes[1].hopAcked);
+    TEST_ASSERT_EQUAL(0, report.hopRetransmissions);
+    TEST_ASSERT_EQUAL(0, report.hopAckFailures);
+}
+
+void test_MeshSimulator_keystream_across_protocol_packets(void)
+{
+    // The hop ACK sent between two messages takes a frame counter of its own, the second message
+    // still goes out with the counter its key stream was generated for
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 1000));
+
+    sim.scheduleSend(1, 1000000, APP_TOPIC, PAYLOAD, BROADCAST_ADDR);
+    sim.scheduleSend(0, 3000000, APP_TOPIC, PAYLOAD, RadioMeshUtils::uint32ToDeviceId(2));
+    sim.runFor(5000);
+    TEST_ASSERT_EQUAL(1, sim.getReport().nodes[0].hopAcked);
+    TEST_ASSERT_EQUAL(0, sim.getDevice(1)->getEncryptionService()->getPrecomputedKeystreamUses());
+
+    sim.scheduleSend(1, 6000000, APP_TOPIC, PAYLOAD, BROADCAST_ADDR);
+    sim.runFor(5000);
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(report.deliveriesExpected, report.deliveries);
+    TEST_ASSERT_EQUAL(1, sim.getDevice(1)->getEncryptionService()->getPrecomputedKeystreamUses());
+}
+
+void test_MeshSimulator_hop_ack_flood_relay(void)
+{
+    // The sender knows no route and floods. The relay knows one but keeps the copy a flood, so
+    // no hop is left unacknowledged and the end node sends no ACK nobody waits for.
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 8000));
+    sim.addNode(makeNode(3, 16000));
+
+    // Only the relay hears the end node
+    sim.scheduleSend(2, 1000000, APP_TOPIC, PAYLOAD, RadioMeshUtils::uint32ToDeviceId(2));
+    sim.scheduleSend(0, 5000000, APP_TOPIC, PAYLOAD, RadioMeshUtils::uint32ToDeviceId(3));
+    sim.runFor(10000);
+
+    bool found = false;
+    byte nextHop[DEV_ID_LENGTH] = {};
+    sim.withNode(1, [&]() {
+        found = RoutingTable::getInstance()->findNextHop(
+            RadioMeshUtils::uint32ToDeviceId(3).data(), nextHop);
+    });
+    TEST_ASSERT_TRUE(found);
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(2, report.deliveries);
+    TEST_ASSERT_EQUAL(3, report.framesSent);
+    TEST_ASSERT_EQUAL(1, report.relays);
+    TEST_ASSERT_EQUAL(0, report.nodes[1].hopAcked);
+    TEST_ASSERT_EQUAL(0, report.hopRetransmissions);
+    TEST_ASSERT_EQUAL(0, report.hopAckFailures);
+}
+
+void test_MeshSimulator_hop_ack_retransmission(void)
+{
+    // On a lossy link, unacknowledged hops are sent again until they get through
+    SimConfig config;
+    config.seed = 3;
+    config.channel.packetLossRate = 0.3;
+    MeshSimulator sim(config);
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 1000));
+
+    sim.scheduleSend(1, 1000000, APP_TOPIC, PAYLOAD, BROADCAST_ADDR);
+    for (uint32_t i = 0; i < 10; i++) {
+        sim.scheduleSend(0, (5000 + i * 5000) * 1000ULL, APP_TOPIC, PAYLOAD,
+                         RadioMeshUtils::uint32ToDeviceId(2));
+    }
+    sim.runFor(70000);
+
+    SimReport report = sim.getReport();
+    TEST_ASSERT_TRUE(report.hopRetransmissions > 0);
+    TEST_ASSERT_EQUAL(report.nodes[0].hopAcked + report.nodes[0].hopAckFailures, 10);
+    TEST_ASSERT_TRUE(report.deliveries >= report.nodes[0].hopAcked);
+}
+
+void test_MeshSimulator_reliable_delivery(void)
+{
+    // Over a lossy link, every reliable message reaches the application once and is acknowledged
+    SimConfig config;
+    config.seed = 3;
+    config.reliable = true;
+    config.channel.packetLossRate = 0.3;
+    MeshSimulator sim(config);
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 1000));
+
+    sim.scheduleSend(1, 1000000, APP_TOPIC, PAYLOAD, BROADCAST_ADDR);
+    // Far enough apart that a message sent twice or more does not hold every slot
+    for (uint32_t i = 0; i < 10; i++) {
+        sim.scheduleSend(0, (5000 + i * 3000) * 1000ULL, APP_TOPIC, PAYLOAD,
+                         RadioMeshUtils::uint32ToDeviceId(2));
+    }
+    sim.runFor(180000);
+
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(11, report.messagesSent);
+    TEST_ASSERT_EQUAL(report.deliveriesExpected, report.deliveries);
+    TEST_ASSERT_EQUAL(10, report.reliableAcknowledged);
+    TEST_ASSERT_EQUAL(0, report.reliableFailed);
+}
+
+void test_MeshSimulator_reliable_push_full(void)
+{
+    // The hub pushes to more nodes at once than it has slots: the messages past the last slot
+    // are refused, and go through once sent again after the first ones were acknowledged.
+    // The nodes report to the hub first, so it knows a route to each of them. Lost ACKs back the
+    // retransmissions off up to a minute, so each step is given a few minutes. The nodes all hear
+    // each other, so they listen before relaying.
+    const size_t targets = ReliableTransfer::SLOTS + 2;
+    SimConfig config;
+    config.reliable = true;
+    config.radio.setRelayListenBeforeTalk(true);
+    MeshSimulator sim(config);
+    sim.addNode(makeNode(1, 0, MeshDeviceType::HUB));
+    for (size_t i = 0; i < targets; i++) {
+        double angle = 2 * M_PI * i / targets;
+        SimNodeConfig node = makeNode(2 + i, 1000 * cos(angle));
+        node.y = 1000 * sin(angle);
+        sim.addNode(node);
+    }
+    for (size_t i = 0; i < targets; i++) {
+        sim.scheduleSend(1 + i, (1000 + i * 2000) * 1000ULL, APP_TOPIC, PAYLOAD,
+                         RadioMeshUtils::uint32ToDeviceId(1));
+    }
+    sim.runFor(180000);
+    SimReport reported = sim.getReport();
+    TEST_ASSERT_EQUAL(targets, reported.reliableAcknowledged);
+
+    for (size_t i = 0; i < targets; i++) {
+        sim.scheduleSend(0, sim.getNowMicros() + (1 + i) * 1000ULL, APP_TOPIC, PAYLOAD,
+                         RadioMeshUtils::uint32ToDeviceId(2 + i));
+    }
+    sim.runFor(180000);
+
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(2, report.reliableRefused);
+    TEST_ASSERT_EQUAL(reported.messagesSent + ReliableTransfer::SLOTS, report.messagesSent);
+    TEST_ASSERT_EQUAL(targets + ReliableTransfer::SLOTS, report.reliableAcknowledged);
+    TEST_ASSERT_EQUAL(report.deliveriesExpected, report.deliveries);
+
+    for (size_t i = ReliableTransfer::SLOTS; i < targets; i++) {
+        sim.scheduleSend(0, sim.getNowMicros() + (1 + i) * 1000ULL, APP_TOPIC, PAYLOAD,
+                         RadioMeshUtils::uint32ToDeviceId(2 + i));
+    }
+    sim.runFor(180000);
+
+    report = sim.getReport();
+    TEST_ASSERT_EQUAL(2, report.reliableRefused);
+    TEST_ASSERT_EQUAL(2 * targets, report.reliableAcknowledged);
+    TEST_ASSERT_EQUAL(0, report.reliableFailed);
+    TEST_ASSERT_EQUAL(report.deliveriesExpected, report.deliveries);
+}
+
+void test_MeshSimulator_relay_failover(void)
+{
+    // Two relays between the ends. Once the one in use dies, the other one carries the traffic.
+    // They are as far from either end and hear each other, so they listen before relaying.
+    SimConfig config;
+    config.radio.setRelayListenBeforeTalk(true);
+    MeshSimulator sim(config);
+    sim.addNode(makeNode(1, 0));
+    SimNodeConfig upper = makeNode(2, 8000);
+    upper.y = 1000;
+    sim.addNode(upper);
+    SimNodeConfig lower = makeNode(3, 8000);
+    lower.y = -1000;
+    sim.addNode(lower);
+    sim.addNode(makeNode(4, 16000));
+
+    std::array<byte, RM_ID_LENGTH> target = RadioMeshUtils::uint32ToDeviceId(4);
+    // Either relay may win the rebroadcast of each message, which teaches both paths
+    for (uint32_t i = 0; i < 4; i++) {
+        sim.scheduleSend(3, (1000 + i * 3000) * 1000ULL, APP_TOPIC, PAYLOAD, BROADCAST_ADDR);
+    }
+    sim.scheduleSend(0, 14000000, APP_TOPIC, PAYLOAD, target);
+    sim.runFor(18000);
+
+    uint8_t paths = 0;
+    byte relay[DEV_ID_LENGTH] = {};
+    sim.withNode(0, [&]() {
+        paths = RoutingTable::getInstance()->getPathCount(target.data());
+        RoutingTable::getInstance()->findNextHop(target.data(), relay);
+    });
+    TEST_ASSERT_EQUAL(2, paths);
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(13, report.deliveries);
+
+    sim.scheduleNodeFailure(RadioMeshUtils::toUint32(relay) - 1, 19000000);
+    for (uint32_t i = 0; i < 5; i++) {
+        sim.scheduleSend(0, (20000 + i * 5000) * 1000ULL, APP_TOPIC, PAYLOAD, target);
+    }
+    sim.runFor(30000);
+
+    report = sim.getReport();
+    TEST_ASSERT_EQUAL(18, report.deliveries);
+    TEST_ASSERT_EQUAL(1, report.nodes[0].routeFailovers);
+    TEST_ASSERT_EQUAL(0, report.hopAckFailures);
+}
+
+void test_MeshSimulator_beacons_two_hop_route(void)
+{
+    // The end nodes never send anything, beacons teach each a route to the other through the
+    // middle node
+    SimConfig config;
+    config.beacons = true;
+    MeshSimulator sim(config);
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 6500));
+    sim.addNode(makeNode(3, 13000));
+    sim.runFor(60000);
+
+    std::array<byte, RM_ID_LENGTH> target = RadioMeshUtils::uint32ToDeviceId(3);
+    bool found = false;
+    byte nextHop[DEV_ID_LENGTH] = {};
+    sim.withNode(0, [&]() {
+        found = RoutingTable::getInstance()->findNextHop(target.data(), nextHop);
+    });
+    TEST_ASSERT_TRUE(found);
+    TEST_ASSERT_EQUAL(2, RadioMeshUtils::toUint32(nextHop));
+    SimReport report = sim.getReport();
+    TEST_ASSERT_TRUE(report.beaconsSent >= 3);
+    TEST_ASSERT_EQUAL(0, report.messagesSent);
+
+    sim.scheduleSend(0, 61000000, APP_TOPIC, PAYLOAD, target);
+    sim.runFor(5000);
+    report = sim.getReport();
+    TEST_ASSERT_EQUAL(1, report.deliveries);
+    TEST_ASSERT_EQUAL(0, report.hopAckFailures);
+}
+
+void test_MeshSimulator_hub_topology(void)
+{
+    // A line of devices 6.5 km apart, the hub at one end hears only the first one
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, 0, MeshDeviceType::HUB));
+    for (uint32_t i = 2; i <= 5; i++) {
+        sim.addNode(makeNode(i, (i - 1) * 6500.0));
+    }
+    std::array<byte, RM_ID_LENGTH> hub = RadioMeshUtils::uint32ToDeviceId(1);
+    // Spaced so that two floods seldom cross on the line, where relays two hops apart collide
+    for (uint32_t i = 1; i <= 4; i++) {
+        sim.scheduleSend(i, i * 6000000ULL, APP_TOPIC, PAYLOAD, hub);
+    }
+    sim.runFor(40000);
+    TEST_ASSERT_EQUAL(4, sim.getReport().deliveries);
+
+    // Each device is as many hops away as its place in the line, through the first one
+    const TopologyGraph* topology = sim.getDevice(0)->getTopology();
+    TEST_ASSERT_NOT_NULL(topology);
+    TEST_ASSERT_TRUE(sim.getDevice(1)->getTopology() == nullptr);
+    TEST_ASSERT_EQUAL(5, topology->getNodeCount());
+    std::array<byte, RM_ID_LENGTH> first = RadioMeshUtils::uint32ToDeviceId(2);
+    for (uint32_t i = 2; i <= 5; i++) {
+        std::array<byte, RM_ID_LENGTH> device = RadioMeshUtils::uint32ToDeviceId(i);
+        TEST_ASSERT_EQUAL(i - 1, topology->getHops(device.data()));
+        std::vector<std::array<byte, DEV_ID_LENGTH>> path;
+        TEST_ASSERT_TRUE(topology->getPath(device.data(), &path));
+        TEST_ASSERT_TRUE(path.front() == first);
+        TEST_ASSERT_TRUE(path.back() == device);
+    }
+}
+
+void test_MeshSimulator_restart_keeps_counting(void)
+{
+    // A node that reboots after a few packets is still heard, its frame counter does not start
+    // over below the ones its neighbour remembers
+    MeshSimulator sim;
+    sim.addNode(makeNode(1, 0));
+    sim.addNode(makeNode(2, 1000));
+    std::array<byte, RM_ID_LENGTH> target = RadioMeshUtils::uint32ToDeviceId(2);
+    for (uint32_t i = 0; i < 3; i++) {
+        sim.scheduleSend(0, (1000 + i * 1000) * 1000ULL, APP_TOPIC, PAYLOAD, target);
+    }
+    sim.scheduleNodeRestart(0, 5000000);
+    for (uint32_t i = 0; i < 3; i++) {
+        sim.scheduleSend(0, (6000 + i * 1000) * 1000ULL, APP_TOPIC, PAYLOAD, target);
+    }
+    sim.runFor(10000);
+
+    TEST_ASSERT_EQUAL(0, sim.getDevice(1)->getRxDropCount(RxDropReason::DUPLICATE));
+    SimReport report = sim.getReport();
+    TEST_ASSERT_EQUAL(6, report.messagesSent);
+    TEST_ASSERT_EQUAL(6, report.deliveries);
+}
+
+static SimReport runRandomNetwork(uint32_t seed)
+{
+    SimConfig config;
+    config.seed = seed;
+    config.channel.shadowingSigmaDb = 4.0;
+    config.channel.packetLossRate = 0.05;
+    MeshSimulator sim(config);
+
+    std::mt19937 placement(seed);
+    std::uniform_real_distribution<double> coordinate(0.0, 12000.0);
+    for (uint32_t i = 1; i <= 8; i++) {
+        SimNodeConfig node = makeNode(i, coordinate(placement),
+                                      i == 1 ? MeshDeviceType::HUB : MeshDeviceType::STANDARD);
+        node.y = coordinate(placement);
+        sim.addNode(node);
+    }
+    sim.schedulePeriodicTraffic(10000, 60000, 16, RadioMeshUtils::uint32ToDeviceId(1));
+    sim.runFor(70000);
+    return sim.getReport();
+}
+
+void test_MeshSimulator_deterministic(void)
+{
+    SimReport first = runRandomNetwork(7);
+    SimReport second = runRandomNetwork(7);
+
+    TEST_ASSERT_TRUE(first.messagesSent > 0);
+    TEST_ASSERT_EQUAL_STRING(first.toString(true).c_str(), second.toString(true).c_str());
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_MeshSimulator_timeOnAir);
+    RUN_TEST(test_MeshSimulator_unicast_two_nodes);
+    RUN_TEST(test_MeshSimulator_relay_out_of_range);
+    RUN_TEST(test_MeshSimulator_rx_drop_counts);
+    RUN_TEST(test_MeshSimulator_collision);
+    RUN_TEST(test_MeshSimulator_hop_ack);
+    RUN_TEST(test_MeshSimulator_keystream_across_protocol_packets);
+    RUN_TEST(test_MeshSimulator_hop_ack_flood_relay);
+    RUN_TEST(test_MeshSimulator_hop_ack_retransmission);
+    RUN_TEST(test_MeshSimulator_reliable_delivery);
+    RUN_TEST(test_MeshSimulator_reliable_push_full);
+    RUN_TEST(test_MeshSimulator_relay_failover);
+    RUN_TEST(test_MeshSimulator_beacons_two_hop_route);
+    RUN_TEST(test_MeshSimulator_hub_topology);
+    RUN_TEST(test_MeshSimulator_restart_keeps_counting);
+    RUN_TEST(test_MeshSimulator_deterministic);
+    return UNITY_END();
+}
+
+int main()
+{
+    return runUnityTests();
+}
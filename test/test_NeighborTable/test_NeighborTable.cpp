@@ -0,0 +1,80 @@
+#include <RadioMesh.h>
+#include <unity.h>
+
+void test_NeighborTable_link_cost(void)
+{
+    NeighborTable neighbors;
+    neighbors.setSpreadingFactor(8);
+    const byte strong[DEV_ID_LENGTH] = {1, 0, 0, 0};
+    const byte weak[DEV_ID_LENGTH] = {2, 0, 0, 0};
+    TEST_ASSERT_EQUAL(NeighborTable::UNKNOWN_LINK_COST, neighbors.getLinkCost(strong));
+
+    // Before any ACK, the cost follows the SNR margin over the -10 dB floor of SF8
+    neighbors.onReceived(strong, -80, 10.0, 1000);
+    neighbors.onReceived(weak, -118, -10.0, 1000);
+    TEST_ASSERT_EQUAL(2, neighbors.size());
+    uint16_t strongCost = neighbors.getLinkCost(strong);
+    uint16_t weakCost = neighbors.getLinkCost(weak);
+    TEST_ASSERT_TRUE(strongCost >= NeighborTable::MIN_LINK_COST && strongCost < 110);
+    TEST_ASSERT_TRUE(weakCost > 1000 && weakCost <= NeighborTable::MAX_LINK_COST);
+
+    // A single good frame over the weak link hardly changes its smoothed SNR
+    neighbors.onReceived(weak, -90, 10.0, 2000);
+    TEST_ASSERT_TRUE(neighbors.getLinkCost(weak) > 2 * strongCost);
+    TEST_ASSERT_EQUAL(-30, neighbors.find(weak)->snr);
+
+    // Missed ACKs raise the cost of the strong link, acknowledged transmissions bring it back
+    for (int i = 0; i < 8; i++) {
+        neighbors.onAckResult(strong, false);
+    }
+    TEST_ASSERT_TRUE(neighbors.getLinkCost(strong) > 2 * strongCost);
+    for (int i = 0; i < 40; i++) {
+        neighbors.onAckResult(strong, true);
+    }
+    TEST_ASSERT_TRUE(neighbors.getLinkCost(strong) < 110);
+    TEST_ASSERT_EQUAL(48, neighbors.find(strong)->ackSamples);
+
+    // Once full, a new neighbour only takes the place of a worse link
+    for (byte i = 3; i < 3 + NeighborTable::CAPACITY - 2; i++) {
+        const byte id[DEV_ID_LENGTH] = {i, 0, 0, 0};
+        neighbors.onReceived(id, -100, 0.0, 3000 + i);
+    }
+    TEST_ASSERT_EQUAL(NeighborTable::CAPACITY, neighbors.size());
+    const byte poor[DEV_ID_LENGTH] = {100, 0, 0, 0};
+    neighbors.onReceived(poor, -119, -12.0, 4000);
+    TEST_ASSERT_NULL(neighbors.find(poor));
+    TEST_ASSERT_NOT_NULL(neighbors.find(weak));
+    const byte fair[DEV_ID_LENGTH] = {101, 0, 0, 0};
+    neighbors.onReceived(fair, -100, 0.0, 4000);
+    TEST_ASSERT_NOT_NULL(neighbors.find(fair));
+    TEST_ASSERT_NULL(neighbors.find(weak));
+
+    // A neighbour gone quiet makes room whatever its link
+    neighbors.onReceived(poor, -119, -12.0, 1000 + ROUTE_TIMEOUT);
+    TEST_ASSERT_NOT_NULL(neighbors.find(poor));
+    TEST_ASSERT_NULL(neighbors.find(strong));
+    TEST_ASSERT_EQUAL(NeighborTable::CAPACITY, neighbors.size());
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_NeighborTable_link_cost);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
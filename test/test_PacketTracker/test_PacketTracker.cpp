@@ -1,4 +1,5 @@
 #include <RadioMesh.h>
+#include <map>
 #include <unity.h>
 
 void test_PacketTracker_addEntry(void)
@@ -104,7 +105,66 @@ void test_PacketTracker_findOrDefault(void)
     TEST_ASSERT_EQUAL(0, tracker.findOrDefault(4, 0));
 }
 
-void setup()
+void test_PacketTracker_keeps_recently_found(void)
+{
+    PacketTracker tracker(3);
+    tracker.addEntry(1, 2);
+    tracker.addEntry(2, 3);
+    tracker.addEntry(3, 4);
+    TEST_ASSERT_EQUAL(2, tracker.findOrDefault(1, 0));
+    tracker.addEntry(4, 5); // Key 1 was looked up, so key 2 is evicted instead
+    TEST_ASSERT_EQUAL(3, tracker.size());
+    TEST_ASSERT_EQUAL(true, tracker.keyExists(1));
+    TEST_ASSERT_EQUAL(false, tracker.keyExists(2));
+    TEST_ASSERT_EQUAL(true, tracker.keyExists(3));
+    TEST_ASSERT_EQUAL(true, tracker.keyExists(4));
+}
+
+void test_PacketTracker_remove_and_reuse(void)
+{
+    // Random adds and removes over fewer keys than the capacity, so nothing is evicted and the
+    // tracker must agree with a plain map, whatever the hash collisions and probe runs
+    FixedPacketTracker<64> tracker;
+    std::map<uint32_t, uint32_t> reference;
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < 5000; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t key = ((seed >> 8) % 48) * 0x10001;
+        if (seed & 0x80000000) {
+            tracker.removeEntry(key);
+            reference.erase(key);
+        } else {
+            tracker.addEntry(key, i);
+            reference[key] = i;
+        }
+        TEST_ASSERT_EQUAL(reference.size(), tracker.size());
+    }
+    for (uint32_t k = 0; k < 48; k++) {
+        uint32_t key = k * 0x10001;
+        auto it = reference.find(key);
+        TEST_ASSERT_EQUAL(it != reference.end(), tracker.keyExists(key));
+        TEST_ASSERT_EQUAL(it != reference.end() ? it->second : 0xFFFFFFFF,
+                          tracker.findOrDefault(key, 0xFFFFFFFFU));
+    }
+
+    // Freed entries are reused before anything is evicted
+    FixedPacketTracker<4> small;
+    small.addEntry(1, 1);
+    small.addEntry(2, 2);
+    small.addEntry(3, 3);
+    small.addEntry(4, 4);
+    small.removeEntry(2);
+    small.addEntry(5, 5);
+    TEST_ASSERT_EQUAL(4, small.size());
+    TEST_ASSERT_EQUAL(true, small.keyExists(1));
+    TEST_ASSERT_EQUAL(true, small.keyExists(5));
+    small.addEntry(6, 6); // Full again, the oldest entry goes
+    TEST_ASSERT_EQUAL(4, small.size());
+    TEST_ASSERT_EQUAL(false, small.keyExists(1));
+    TEST_ASSERT_EQUAL(true, small.keyExists(6));
+}
+
+int runUnityTests()
 {
     UNITY_BEGIN();
     RUN_TEST(test_PacketTracker_addEntry);
@@ -113,9 +173,23 @@ void setup()
     RUN_TEST(test_PacketTracker_findOrDefault);
     RUN_TEST(test_PacketTracker_removeEntry);
     RUN_TEST(test_PacketTracker_addEntry_evicts_lru);
-    UNITY_END();
+    RUN_TEST(test_PacketTracker_keeps_recently_found);
+    RUN_TEST(test_PacketTracker_remove_and_reuse);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
 }
 
 void loop()
 {
 }
+#endif
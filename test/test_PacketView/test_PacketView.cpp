@@ -0,0 +1,161 @@
+#include <RadioMesh.h>
+#include <core/protocol/inc/crypto/aes/PacketNonce.h>
+#include <unity.h>
+
+static RadioMeshPacket makePacket(uint8_t topic)
+{
+    RadioMeshPacket packet;
+    packet.sourceDevId = {0x11, 0x22, 0x33, 0x44};
+    packet.destDevId = {0x55, 0x66, 0x77, 0x88};
+    packet.packetId = {0xDE, 0xAD, 0xBE, 0xEF};
+    packet.topic = topic;
+    packet.deviceType = MeshDeviceType::STANDARD;
+    packet.hopCount = 3;
+    packet.packetCrc = 0x01020304;
+    packet.fcounter = 0xA0B0C0D0;
+    packet.lastHopId = {0x01, 0x02, 0x03, 0x04};
+    packet.nextHopId = {0xFF, 0xFF, 0xFF, 0xFF};
+    packet.reserved = {0x07, 0x08, 0x09};
+    packet.packetData = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80};
+    return packet;
+}
+
+void test_PacketView_header_fields(void)
+{
+    RadioMeshPacket packet = makePacket(0x10);
+    std::vector<byte> frame = packet.toByteBuffer();
+    RadioMeshPacketView view(frame.data(), frame.size());
+
+    TEST_ASSERT_TRUE(view.isValid());
+    TEST_ASSERT_EQUAL(RM_PROTOCOL_VERSION, view.getProtocolVersion());
+    TEST_ASSERT_TRUE(packet.sourceDevId == view.getSourceDevId());
+    TEST_ASSERT_TRUE(packet.destDevId == view.getDestDevId());
+    TEST_ASSERT_TRUE(packet.packetId == view.getPacketId());
+    TEST_ASSERT_EQUAL_HEX32(0xDEADBEEF, view.getPacketIdKey());
+    TEST_ASSERT_EQUAL(0x10, view.getTopic());
+    TEST_ASSERT_EQUAL(MeshDeviceType::STANDARD, view.getDeviceType());
+    TEST_ASSERT_EQUAL(3, view.getHopCount());
+    TEST_ASSERT_EQUAL_HEX32(0x01020304, view.getPacketCrc());
+    TEST_ASSERT_EQUAL_HEX32(0xA0B0C0D0, view.getFcounter());
+    TEST_ASSERT_TRUE(packet.lastHopId == view.getLastHopId());
+    TEST_ASSERT_TRUE(packet.nextHopId == view.getNextHopId());
+
+    std::vector<byte> header = packet.getHeaderBytes();
+    TEST_ASSERT_EQUAL(HEADER_LENGTH, view.getHeader().size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(header.data(), view.getHeader().data, HEADER_LENGTH);
+}
+
+void test_PacketView_spans_with_MIC(void)
+{
+    // The last MIC_SIZE bytes of the data section are the MIC
+    RadioMeshPacket packet = makePacket(0x10);
+    std::vector<byte> frame = packet.toByteBuffer();
+    RadioMeshPacketView view(frame.data(), frame.size());
+
+    TEST_ASSERT_TRUE(view.hasMIC());
+    TEST_ASSERT_EQUAL(packet.packetData.size(), view.getData().size);
+    TEST_ASSERT_EQUAL(packet.getDataWithoutMIC().size(), view.getPayload().size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(packet.extractMIC().data(), view.getMIC().data, MIC_SIZE);
+    TEST_ASSERT_EQUAL(frame.size() - MIC_SIZE, view.getAuthenticatedData().size);
+    TEST_ASSERT_TRUE(frame.data() == view.getAuthenticatedData().data);
+
+    RadioMeshPacket copy = view.toPacket();
+    TEST_ASSERT_TRUE(packet.sourceDevId == copy.sourceDevId);
+    TEST_ASSERT_TRUE(packet.reserved == copy.reserved);
+    TEST_ASSERT_EQUAL(packet.fcounter, copy.fcounter);
+    TEST_ASSERT_TRUE(packet.getDataWithoutMIC() == copy.packetData);
+    TEST_ASSERT_TRUE(packet.packetData == view.toPacket(false).packetData);
+}
+
+void test_PacketView_spans_without_MIC(void)
+{
+    // Public key exchange messages carry no MIC
+    RadioMeshPacket packet = makePacket(MessageTopic::INCLUDE_OPEN);
+    std::vector<byte> frame = packet.toByteBuffer();
+    RadioMeshPacketView view(frame.data(), frame.size());
+
+    TEST_ASSERT_FALSE(view.hasMIC());
+    TEST_ASSERT_TRUE(view.getMIC().empty());
+    TEST_ASSERT_EQUAL(packet.packetData.size(), view.getPayload().size);
+    TEST_ASSERT_TRUE(packet.packetData == view.toPacket().packetData);
+}
+
+void test_PacketView_invalid_length(void)
+{
+    std::vector<byte> frame(HEADER_LENGTH, 0);
+    TEST_ASSERT_FALSE(RadioMeshPacketView(frame.data(), frame.size()).isValid());
+    TEST_ASSERT_FALSE(RadioMeshPacketView(nullptr, 0).isValid());
+    TEST_ASSERT_FALSE(RadioMeshPacketView().isValid());
+
+    frame.resize(PACKET_LENGTH + 1);
+    TEST_ASSERT_FALSE(RadioMeshPacketView(frame.data(), frame.size()).isValid());
+    TEST_ASSERT_TRUE(RadioMeshPacketView(frame.data(), PACKET_LENGTH).isValid());
+}
+
+void test_PacketView_serialize(void)
+{
+    RadioMeshPacket packet = makePacket(0x10);
+    std::vector<byte> expected = packet.toByteBuffer();
+
+    std::array<byte, PACKET_LENGTH> frame;
+    TEST_ASSERT_EQUAL(expected.size(), packet.serialize(frame.data(), frame.size()));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), frame.data(), expected.size());
+
+    // Nothing is written past the capacity
+    TEST_ASSERT_EQUAL(0, packet.serialize(frame.data(), expected.size() - 1));
+}
+
+void test_PacketView_nonce(void)
+{
+    RadioMeshPacket packet = makePacket(0x10);
+    std::vector<byte> frame = packet.toByteBuffer();
+
+    const byte expected[PacketNonce::SIZE] = {0x11, 0x22, 0x33, 0x44, 0xDE, 0xAD, 0xBE, 0xEF,
+                                              0xA0, 0xB0, 0xC0, 0xD0, 0x00, 0x00, 0x00, 0x00};
+    byte fromHeader[PacketNonce::SIZE];
+    byte fromPacket[PacketNonce::SIZE];
+    PacketNonce::fromHeader(frame.data(), fromHeader);
+    PacketNonce::fromPacket(packet, fromPacket);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fromHeader, PacketNonce::SIZE);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fromPacket, PacketNonce::SIZE);
+
+    // Relays patch hop fields only, the nonce does not change
+    frame[HOP_COUNT_POS]++;
+    frame[LAST_HOP_ID_POS] ^= 0xFF;
+    PacketNonce::fromHeader(frame.data(), fromHeader);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fromHeader, PacketNonce::SIZE);
+
+    // Version 4 frames keep the all-zero counter block
+    const byte zeros[PacketNonce::SIZE] = {0};
+    frame[VERSION_POS] = RM_PROTOCOL_VERSION_ZERO_IV;
+    PacketNonce::fromHeader(frame.data(), fromHeader);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(zeros, fromHeader, PacketNonce::SIZE);
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_PacketView_header_fields);
+    RUN_TEST(test_PacketView_spans_with_MIC);
+    RUN_TEST(test_PacketView_spans_without_MIC);
+    RUN_TEST(test_PacketView_invalid_length);
+    RUN_TEST(test_PacketView_serialize);
+    RUN_TEST(test_PacketView_nonce);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
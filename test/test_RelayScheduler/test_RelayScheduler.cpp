@@ -0,0 +1,173 @@
+#include <RadioMesh.h>
+#include <core/protocol/inc/routing/RelayScheduler.h>
+#include <unity.h>
+
+static void makeRelayFrame(byte* frame, byte id)
+{
+    memset(frame, 0, HEADER_LENGTH + MIC_SIZE);
+    frame[PKT_ID_POS] = id;
+}
+
+void test_RelayScheduler_signal_backoff(void)
+{
+    const uint32_t airtime = 100;
+    uint32_t weakest = RelayScheduler::getSignalBackoff(-130, -25, airtime);
+    uint32_t weak = RelayScheduler::getSignalBackoff(-115, -10, airtime);
+    uint32_t strong = RelayScheduler::getSignalBackoff(-60, 8, airtime);
+    uint32_t strongest = RelayScheduler::getSignalBackoff(-40, 15, airtime);
+
+    // Far receivers, heard weakly, rebroadcast first
+    TEST_ASSERT_EQUAL(0, weakest);
+    TEST_ASSERT_LESS_THAN(strong, weak);
+    TEST_ASSERT_LESS_THAN(strongest, strong);
+    TEST_ASSERT_EQUAL(RM_RELAY_BACKOFF_SLOTS * airtime, strongest);
+}
+
+void test_RelayScheduler_due_and_suppress(void)
+{
+    const uint32_t airtime = 100;
+    const uint32_t maxBackoff = (RM_RELAY_BACKOFF_SLOTS + RM_RELAY_JITTER_SLOTS) * airtime;
+    byte data[HEADER_LENGTH + MIC_SIZE];
+    byte other[HEADER_LENGTH + MIC_SIZE];
+    RelayScheduler scheduler;
+
+    makeRelayFrame(other, 1);
+    RadioMeshPacketView first(other, sizeof(other));
+    TEST_ASSERT_TRUE(scheduler.schedule(first, -60, 8, airtime, 0, 1000));
+    // A later copy of a pending packet is not scheduled again
+    TEST_ASSERT_TRUE(scheduler.schedule(first, -60, 8, airtime, 0, 1000));
+    TEST_ASSERT_EQUAL(1, scheduler.size());
+
+    uint32_t dueAt;
+    TEST_ASSERT_TRUE(scheduler.getNextDue(&dueAt));
+    TEST_ASSERT_TRUE(dueAt >= 1000 && dueAt <= 1000 + maxBackoff);
+    TEST_ASSERT_NULL(scheduler.getDue(dueAt - 1));
+    const RelayScheduler::PendingRelay* relay = scheduler.getDue(dueAt);
+    TEST_ASSERT_NOT_NULL(relay);
+    TEST_ASSERT_EQUAL(first.getPacketIdKey(), relay->getFrame().getPacketIdKey());
+    TEST_ASSERT_EQUAL(sizeof(data), relay->getFrame().getFrame().size);
+    scheduler.release(relay);
+    TEST_ASSERT_EQUAL(0, scheduler.size());
+    TEST_ASSERT_FALSE(scheduler.getNextDue(&dueAt));
+
+    // Neighbours relaying the packet first cancel the rebroadcast
+    makeRelayFrame(data, 2);
+    RadioMeshPacketView second(data, sizeof(data));
+    TEST_ASSERT_TRUE(scheduler.schedule(second, -60, 8, airtime, 2, 2000));
+    scheduler.onCopyHeard(first.getPacketIdKey());
+    TEST_ASSERT_EQUAL(1, scheduler.size());
+    for (int i = 0; i < RM_RELAY_SUPPRESS_COPIES - 1; i++) {
+        scheduler.onCopyHeard(second.getPacketIdKey());
+    }
+    TEST_ASSERT_EQUAL(1, scheduler.size());
+    scheduler.onCopyHeard(second.getPacketIdKey());
+    TEST_ASSERT_EQUAL(0, scheduler.size());
+    TEST_ASSERT_EQUAL(1, scheduler.getSuppressedCount());
+    TEST_ASSERT_NULL(scheduler.getDue(2000 + maxBackoff));
+
+    // Among many neighbours, a single one relaying the packet is enough
+    TEST_ASSERT_TRUE(scheduler.schedule(second, -60, 8, airtime, RM_RELAY_DENSE_NEIGHBORS, 2000));
+    scheduler.onCopyHeard(second.getPacketIdKey());
+    TEST_ASSERT_EQUAL(0, scheduler.size());
+    TEST_ASSERT_EQUAL(2, scheduler.getSuppressedCount());
+
+    scheduler.clear();
+    TEST_ASSERT_EQUAL(0, scheduler.size());
+}
+
+void test_RelayScheduler_full(void)
+{
+    const uint32_t airtime = 100;
+    byte data[HEADER_LENGTH + MIC_SIZE];
+    byte oldest[HEADER_LENGTH + MIC_SIZE];
+    RelayScheduler scheduler;
+
+    // Every slot taken in a burst, the first frame heard strongly so it waits the longest
+    makeRelayFrame(oldest, 10);
+    TEST_ASSERT_TRUE(
+        scheduler.schedule(RadioMeshPacketView(oldest, sizeof(oldest)), -50, 10, airtime, 0, 1000));
+    for (byte id = 1; id < RelayScheduler::SLOTS; id++) {
+        makeRelayFrame(data, 10 + id);
+        TEST_ASSERT_TRUE(scheduler.schedule(RadioMeshPacketView(data, sizeof(data)), -130, -25,
+                                            airtime, 0, 1000 + id));
+    }
+    TEST_ASSERT_EQUAL(RelayScheduler::SLOTS, scheduler.size());
+    TEST_ASSERT_EQUAL(0, scheduler.getDroppedCount());
+
+    // A new frame takes the place of the one waiting the longest, and still waits its backoff
+    makeRelayFrame(data, 100);
+    RadioMeshPacketView newest(data, sizeof(data));
+    uint32_t now = 1000 + RelayScheduler::SLOTS;
+    TEST_ASSERT_TRUE(scheduler.schedule(newest, -50, 10, airtime, 0, now));
+    TEST_ASSERT_EQUAL(RelayScheduler::SLOTS, scheduler.size());
+    TEST_ASSERT_EQUAL(1, scheduler.getDroppedCount());
+
+    // The rebroadcasts due before the new one's backoff ends are the others
+    const RelayScheduler::PendingRelay* relay;
+    size_t sent = 0;
+    while ((relay = scheduler.getDue(now + RM_RELAY_BACKOFF_SLOTS * airtime - 1)) != nullptr) {
+        TEST_ASSERT_NOT_EQUAL(newest.getPacketIdKey(), relay->packetKey);
+        TEST_ASSERT_NOT_EQUAL(RadioMeshPacketView(oldest, sizeof(oldest)).getPacketIdKey(),
+                              relay->packetKey);
+        scheduler.release(relay);
+        sent++;
+    }
+    TEST_ASSERT_EQUAL(RelayScheduler::SLOTS - 1, sent);
+    relay = scheduler.getDue(now + (RM_RELAY_BACKOFF_SLOTS + RM_RELAY_JITTER_SLOTS) * airtime);
+    TEST_ASSERT_NOT_NULL(relay);
+    TEST_ASSERT_EQUAL(newest.getPacketIdKey(), relay->packetKey);
+    scheduler.release(relay);
+    TEST_ASSERT_EQUAL(0, scheduler.size());
+}
+
+void test_RelayScheduler_weak_signal_first(void)
+{
+    // Two relays hearing the same packet, one far away and one close by: whatever the draw,
+    // the far one rebroadcasts first nearly every time
+    const uint32_t airtime = 100;
+    byte data[HEADER_LENGTH + MIC_SIZE];
+    makeRelayFrame(data, 1);
+    RadioMeshPacketView frame(data, sizeof(data));
+    int weakFirst = 0;
+    for (uint32_t seed = 1; seed <= 100; seed++) {
+        randomSeed(seed);
+        RelayScheduler weak;
+        RelayScheduler strong;
+        TEST_ASSERT_TRUE(weak.schedule(frame, -115, -10, airtime, 2, 1000));
+        TEST_ASSERT_TRUE(strong.schedule(frame, -75, 3, airtime, 2, 1000));
+        uint32_t weakDue = 0;
+        uint32_t strongDue = 0;
+        TEST_ASSERT_TRUE(weak.getNextDue(&weakDue));
+        TEST_ASSERT_TRUE(strong.getNextDue(&strongDue));
+        if (weakDue < strongDue) {
+            weakFirst++;
+        }
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(90, weakFirst);
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_RelayScheduler_signal_backoff);
+    RUN_TEST(test_RelayScheduler_due_and_suppress);
+    RUN_TEST(test_RelayScheduler_full);
+    RUN_TEST(test_RelayScheduler_weak_signal_first);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
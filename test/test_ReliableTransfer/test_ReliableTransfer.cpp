@@ -0,0 +1,190 @@
+#include <RadioMesh.h>
+#include <core/protocol/inc/transport/ReliableTransfer.h>
+#include <unity.h>
+
+struct ReliableOutcome
+{
+    int calls = 0;
+    uint16_t sequence = 0;
+    int err = RM_E_NONE;
+};
+
+static void onReliableComplete(const std::array<byte, RM_ID_LENGTH>& target, uint16_t sequence,
+                               int err, void* context)
+{
+    ReliableOutcome* outcome = static_cast<ReliableOutcome*>(context);
+    outcome->calls++;
+    outcome->sequence = sequence;
+    outcome->err = err;
+}
+
+void test_ReliableTransfer_window_and_sack(void)
+{
+    ReliableTransfer sender;
+    ReliableTransfer receiver;
+    const std::array<byte, RM_ID_LENGTH> source = {1, 0, 0, 0};
+    const std::array<byte, RM_ID_LENGTH> target = {2, 0, 0, 0};
+    ReliableOutcome outcomes[ReliableTransfer::WINDOW + 1];
+
+    for (int i = 0; i <= ReliableTransfer::WINDOW; i++) {
+        uint16_t sequence;
+        TEST_ASSERT_EQUAL(RM_E_NONE, sender.send(target, 0x10, {byte(i)}, onReliableComplete,
+                                                 &outcomes[i], &sequence));
+        TEST_ASSERT_EQUAL(i, sequence);
+    }
+
+    // Only a window of messages goes out, oldest first
+    std::vector<byte> payloads[ReliableTransfer::WINDOW];
+    for (int i = 0; i < ReliableTransfer::WINDOW; i++) {
+        ReliableTransfer::Message* message = sender.getDue(1000);
+        TEST_ASSERT_NOT_NULL(message);
+        TEST_ASSERT_EQUAL(i, message->sequence);
+        payloads[i] = message->getPayload();
+        sender.onSent(message, 1000);
+    }
+    TEST_ASSERT_NULL(sender.getDue(1000));
+
+    // The second message is lost, the others are delivered once each
+    uint8_t topic;
+    std::vector<byte> data;
+    for (int i = 0; i < ReliableTransfer::WINDOW; i++) {
+        if (i == 1) {
+            continue;
+        }
+        TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::NEW,
+                          receiver.onData(source.data(), payloads[i], 1100, &topic, &data));
+        TEST_ASSERT_EQUAL(0x10, topic);
+        TEST_ASSERT_EQUAL(1, data.size());
+        TEST_ASSERT_EQUAL(i, data[0]);
+    }
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::DUPLICATE,
+                      receiver.onData(source.data(), payloads[2], 1100, &topic, &data));
+
+    // A single ACK covers the window, after its delay
+    ReliableTransfer::Ack ack;
+    TEST_ASSERT_FALSE(receiver.getAckDue(1100 + RM_RELIABLE_ACK_DELAY_MS - 1, &ack));
+    TEST_ASSERT_TRUE(receiver.getAckDue(1100 + RM_RELIABLE_ACK_DELAY_MS, &ack));
+    TEST_ASSERT_FALSE(receiver.getAckDue(1100 + RM_RELIABLE_ACK_DELAY_MS, &ack));
+    TEST_ASSERT_TRUE(ack.target == source);
+    TEST_ASSERT_EQUAL(1, ack.nextExpected);
+    TEST_ASSERT_EQUAL_HEX32(0x3, ack.received);
+
+    // Acknowledged messages complete, the hole is sent again at once and the window moves on
+    TEST_ASSERT_TRUE(sender.onAck(target.data(), ack.getPayload(), 2000));
+    TEST_ASSERT_EQUAL(1, outcomes[0].calls);
+    TEST_ASSERT_EQUAL(RM_E_NONE, outcomes[0].err);
+    TEST_ASSERT_EQUAL(0, outcomes[1].calls);
+    TEST_ASSERT_EQUAL(1, outcomes[3].calls);
+    TEST_ASSERT_EQUAL(2, sender.size());
+    ReliableTransfer::Message* message = sender.getDue(2000);
+    TEST_ASSERT_NOT_NULL(message);
+    TEST_ASSERT_EQUAL(1, message->sequence);
+    std::vector<byte> retransmitted = message->getPayload();
+    sender.onSent(message, 2000);
+    message = sender.getDue(2000);
+    TEST_ASSERT_NOT_NULL(message);
+    TEST_ASSERT_EQUAL(ReliableTransfer::WINDOW, message->sequence);
+    std::vector<byte> last = message->getPayload();
+    sender.onSent(message, 2000);
+
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::NEW,
+                      receiver.onData(source.data(), retransmitted, 2100, &topic, &data));
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::NEW,
+                      receiver.onData(source.data(), last, 2100, &topic, &data));
+    TEST_ASSERT_TRUE(receiver.getAckDue(2100 + RM_RELIABLE_ACK_DELAY_MS, &ack));
+    TEST_ASSERT_EQUAL(ReliableTransfer::WINDOW + 1, ack.nextExpected);
+    TEST_ASSERT_EQUAL_HEX32(0, ack.received);
+    TEST_ASSERT_TRUE(sender.onAck(target.data(), ack.getPayload(), 3000));
+    TEST_ASSERT_EQUAL(0, sender.size());
+    for (int i = 0; i <= ReliableTransfer::WINDOW; i++) {
+        TEST_ASSERT_EQUAL(1, outcomes[i].calls);
+    }
+    TEST_ASSERT_EQUAL(1, sender.getStats().retransmissions);
+    TEST_ASSERT_EQUAL(ReliableTransfer::WINDOW + 1, sender.getStats().acknowledged);
+    TEST_ASSERT_EQUAL(ReliableTransfer::WINDOW + 1, receiver.getStats().received);
+    TEST_ASSERT_EQUAL(1, receiver.getStats().duplicates);
+}
+
+void test_ReliableTransfer_timeout_and_session(void)
+{
+    ReliableTransfer sender;
+    ReliableTransfer receiver;
+    const std::array<byte, RM_ID_LENGTH> source = {1, 0, 0, 0};
+    const std::array<byte, RM_ID_LENGTH> target = {2, 0, 0, 0};
+    ReliableOutcome outcome;
+
+    TEST_ASSERT_EQUAL(RM_E_PACKET_TOO_LONG,
+                      sender.send(target, 0x10,
+                                  std::vector<byte>(ReliableTransfer::MAX_MESSAGE_LENGTH + 1),
+                                  nullptr, nullptr, nullptr));
+
+    // Unacknowledged, the message is sent again with a doubling timeout and some random wait, then
+    // reported
+    TEST_ASSERT_EQUAL(RM_E_NONE,
+                      sender.send(target, 0x10, {1}, onReliableComplete, &outcome, nullptr));
+    uint32_t now = 0;
+    uint32_t timeout = RM_RELIABLE_INITIAL_TIMEOUT_MS;
+    ReliableTransfer::Message* message = nullptr;
+    std::vector<byte> payload;
+    for (int i = 0; i <= RM_RELIABLE_RETRIES; i++) {
+        message = sender.getDue(now);
+        TEST_ASSERT_NOT_NULL(message);
+        payload = message->getPayload();
+        sender.onSent(message, now);
+        uint32_t dueAt;
+        TEST_ASSERT_TRUE(sender.getNextDue(&dueAt));
+        TEST_ASSERT_TRUE(dueAt >= now + timeout && dueAt <= now + timeout * 3 / 2);
+        TEST_ASSERT_NULL(sender.getDue(dueAt - 1));
+        now = dueAt;
+        timeout = std::min<uint32_t>(timeout * 2, RM_RELIABLE_MAX_TIMEOUT_MS);
+    }
+    TEST_ASSERT_NULL(sender.getDue(now));
+    TEST_ASSERT_EQUAL(1, outcome.calls);
+    TEST_ASSERT_EQUAL(RM_E_DELIVERY_TIMEOUT, outcome.err);
+    TEST_ASSERT_EQUAL(0, sender.size());
+    TEST_ASSERT_EQUAL(1, sender.getStats().failed);
+    TEST_ASSERT_EQUAL(RM_RELIABLE_RETRIES, sender.getStats().retransmissions);
+
+    // A rebooted source starts a new session from sequence number 0, it is not a duplicate
+    uint8_t topic;
+    std::vector<byte> data;
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::NEW,
+                      receiver.onData(source.data(), payload, now, &topic, &data));
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::DUPLICATE,
+                      receiver.onData(source.data(), payload, now, &topic, &data));
+    payload[1]++;
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::NEW,
+                      receiver.onData(source.data(), payload, now, &topic, &data));
+
+    // Reserved topics and short payloads are not reliable messages
+    payload[0] = MessageTopic::MAX_RESERVED;
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::DROPPED,
+                      receiver.onData(source.data(), payload, now, &topic, &data));
+    TEST_ASSERT_EQUAL(ReliableTransfer::Receipt::DROPPED,
+                      receiver.onData(source.data(), {0x10, 1, 0}, now, &topic, &data));
+    TEST_ASSERT_FALSE(sender.onAck(target.data(), {1, 0}, now));
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ReliableTransfer_window_and_sack);
+    RUN_TEST(test_ReliableTransfer_timeout_and_session);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
@@ -0,0 +1,271 @@
+#include <NativeHost.h>
+#include <RadioMesh.h>
+#include <unity.h>
+
+void test_RoutingTable_ack_failures(void)
+{
+    RoutingTable* previous = RoutingTable::setInstance(nullptr);
+    RoutingTable* table = RoutingTable::getInstance();
+
+    RadioMeshPacket packet;
+    packet.sourceDevId = {1, 0, 0, 0};
+    packet.lastHopId = {2, 0, 0, 0};
+    packet.hopCount = 2;
+    table->updateRoute(packet, -80, 5.0);
+
+    byte nextHop[DEV_ID_LENGTH];
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(packet.lastHopId.data(), nextHop, DEV_ID_LENGTH);
+
+    // An ACK in between clears the failures
+    for (int i = 0; i < ROUTE_MAX_ACK_FAILURES - 1; i++) {
+        table->reportAckFailure(packet.lastHopId.data());
+    }
+    table->reportAckSuccess(packet.lastHopId.data());
+    table->reportAckFailure(packet.lastHopId.data());
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+
+    for (int i = 0; i < ROUTE_MAX_ACK_FAILURES - 1; i++) {
+        table->reportAckFailure(packet.lastHopId.data());
+    }
+    TEST_ASSERT_FALSE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+
+    // The next packet from the destination brings a route back, even a worse one
+    packet.lastHopId = {3, 0, 0, 0};
+    packet.hopCount = 3;
+    table->updateRoute(packet, -110, -5.0);
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(packet.lastHopId.data(), nextHop, DEV_ID_LENGTH);
+
+    delete table;
+    RoutingTable::setInstance(previous);
+}
+
+void test_RoutingTable_capacity_and_lru(void)
+{
+    RoutingTable* previous = RoutingTable::setInstance(nullptr);
+    RoutingTable* table = RoutingTable::getInstance();
+    NativeHost::useVirtualClock(1000000);
+
+    // Fill the table, one destination a millisecond, each through its own next hop
+    RadioMeshPacket packet;
+    packet.hopCount = 1;
+    for (uint32_t i = 1; i <= RoutingTable::CAPACITY; i++) {
+        packet.sourceDevId = RadioMeshUtils::uint32ToDeviceId(i);
+        packet.lastHopId = RadioMeshUtils::uint32ToDeviceId(0x10000 + i);
+        table->updateRoute(packet, -80, 5.0);
+        NativeHost::advanceMicros(1000);
+    }
+    TEST_ASSERT_EQUAL(RoutingTable::CAPACITY, table->size());
+
+    byte nextHop[DEV_ID_LENGTH];
+    for (uint32_t i = 1; i <= RoutingTable::CAPACITY; i++) {
+        std::array<byte, DEV_ID_LENGTH> destId = RadioMeshUtils::uint32ToDeviceId(i);
+        TEST_ASSERT_TRUE(table->findNextHop(destId.data(), nextHop));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(RadioMeshUtils::uint32ToDeviceId(0x10000 + i).data(),
+                                      nextHop, DEV_ID_LENGTH);
+    }
+
+    // Looking the first routes up keeps them, the least recently used one makes room
+    std::array<byte, DEV_ID_LENGTH> first = RadioMeshUtils::uint32ToDeviceId(1);
+    TEST_ASSERT_TRUE(table->findNextHop(first.data(), nextHop));
+    packet.sourceDevId = RadioMeshUtils::uint32ToDeviceId(RoutingTable::CAPACITY + 1);
+    table->updateRoute(packet, -80, 5.0);
+    TEST_ASSERT_EQUAL(RoutingTable::CAPACITY, table->size());
+    TEST_ASSERT_TRUE(table->findNextHop(first.data(), nextHop));
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    std::array<byte, DEV_ID_LENGTH> evicted = RadioMeshUtils::uint32ToDeviceId(2);
+    if (RoutingTable::CAPACITY > 1) {
+        TEST_ASSERT_FALSE(table->findNextHop(evicted.data(), nextHop));
+    }
+
+    // Expired routes are removed when looked up, and replaced by any new one when heard from
+    NativeHost::advanceMicros(ROUTE_TIMEOUT * 1000ULL);
+    TEST_ASSERT_FALSE(table->findNextHop(first.data(), nextHop));
+    TEST_ASSERT_EQUAL(RoutingTable::CAPACITY - 1, table->size());
+    packet.lastHopId = RadioMeshUtils::uint32ToDeviceId(0x20000);
+    packet.hopCount = 3;
+    table->updateRoute(packet, -110, -5.0);
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(packet.lastHopId.data(), nextHop, DEV_ID_LENGTH);
+
+    NativeHost::useRealClock();
+    delete table;
+    RoutingTable::setInstance(previous);
+}
+
+void test_RoutingTable_link_cost_routes(void)
+{
+    RoutingTable* previous = RoutingTable::setInstance(nullptr);
+    RoutingTable* table = RoutingTable::getInstance();
+    table->getNeighbors().setSpreadingFactor(8);
+
+    // The source is heard directly over a poor link, then through a relay over a good one
+    RadioMeshPacket packet;
+    packet.sourceDevId = {1, 0, 0, 0};
+    packet.lastHopId = {1, 0, 0, 0};
+    packet.hopCount = 0;
+    table->updateRoute(packet, -118, -9.0);
+    uint16_t directCost = table->getRouteCost(packet.sourceDevId.data());
+
+    packet.lastHopId = {2, 0, 0, 0};
+    packet.hopCount = 1;
+    table->updateRoute(packet, -80, 10.0);
+    byte nextHop[DEV_ID_LENGTH];
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL(2, nextHop[0]);
+    uint16_t relayCost = table->getRouteCost(packet.sourceDevId.data());
+    TEST_ASSERT_TRUE(relayCost < directCost);
+
+    // One good frame over the direct link is not enough to switch back
+    packet.lastHopId = {1, 0, 0, 0};
+    packet.hopCount = 0;
+    table->updateRoute(packet, -90, 10.0);
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL(2, nextHop[0]);
+
+    // Once the relay misses ACKs, the direct link is the cheaper path
+    const byte relay[DEV_ID_LENGTH] = {2, 0, 0, 0};
+    for (int i = 0; i < 8; i++) {
+        table->reportAckMissed(relay);
+    }
+    TEST_ASSERT_TRUE(table->getRouteCost(packet.sourceDevId.data()) > relayCost);
+    table->updateRoute(packet, -90, 10.0);
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL(1, nextHop[0]);
+
+    delete table;
+    RoutingTable::setInstance(previous);
+}
+
+void test_RoutingTable_multipath_failover(void)
+{
+    RoutingTable* previous = RoutingTable::setInstance(nullptr);
+    RoutingTable* table = RoutingTable::getInstance();
+    table->getNeighbors().setSpreadingFactor(8);
+
+    // The source is heard through two relays, the second copy is kept as an alternative
+    RadioMeshPacket packet;
+    packet.sourceDevId = {1, 0, 0, 0};
+    packet.lastHopId = {2, 0, 0, 0};
+    packet.hopCount = 1;
+    table->updateRoute(packet, -80, 10.0);
+    packet.lastHopId = {3, 0, 0, 0};
+    table->updateRoute(packet, -110, -8.0);
+    TEST_ASSERT_EQUAL(2, table->getPathCount(packet.sourceDevId.data()));
+    byte nextHop[DEV_ID_LENGTH];
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL(2, nextHop[0]);
+
+    // A duplicate from a neighbour no closer to the source than we are is not a path
+    byte frame[HEADER_LENGTH] = {};
+    std::copy(packet.sourceDevId.begin(), packet.sourceDevId.end(), frame + SDEV_ID_POS);
+    frame[LAST_HOP_ID_POS] = 4;
+    frame[HOP_COUNT_POS] = 2;
+    table->updateRoute(RadioMeshPacketView(frame, sizeof(frame)), -90, 5.0);
+    TEST_ASSERT_EQUAL(2, table->getPathCount(packet.sourceDevId.data()));
+    frame[HOP_COUNT_POS] = 1;
+    table->updateRoute(RadioMeshPacketView(frame, sizeof(frame)), -90, 5.0);
+    TEST_ASSERT_EQUAL(RM_ROUTE_PATHS < 3 ? RM_ROUTE_PATHS : 3,
+                      table->getPathCount(packet.sourceDevId.data()));
+
+    // The next hop in use missed its ACKs, the best alternative takes over
+    const byte relay[DEV_ID_LENGTH] = {2, 0, 0, 0};
+    TEST_ASSERT_TRUE(table->failover(packet.sourceDevId.data(), relay, nextHop));
+    TEST_ASSERT_EQUAL(4, nextHop[0]);
+    TEST_ASSERT_EQUAL(1, table->getFailovers());
+    TEST_ASSERT_TRUE(table->findNextHop(packet.sourceDevId.data(), nextHop));
+    TEST_ASSERT_EQUAL(4, nextHop[0]);
+
+    // A hop no longer in use failing changes nothing
+    TEST_ASSERT_TRUE(table->failover(packet.sourceDevId.data(), relay, nextHop));
+    TEST_ASSERT_EQUAL(4, nextHop[0]);
+    TEST_ASSERT_EQUAL(1, table->getFailovers());
+
+    // A destination with a single path has nothing to fail over to
+    packet.sourceDevId = {5, 0, 0, 0};
+    packet.lastHopId = {2, 0, 0, 0};
+    table->updateRoute(packet, -80, 10.0);
+    TEST_ASSERT_FALSE(table->failover(packet.sourceDevId.data(), relay, nextHop));
+    TEST_ASSERT_EQUAL(1, table->getFailovers());
+
+    delete table;
+    RoutingTable::setInstance(previous);
+}
+
+void test_RoutingTable_learns_from_new_copies(void)
+{
+    RoutingTable* previous = RoutingTable::setInstance(nullptr);
+    RoutingTable* table = RoutingTable::getInstance();
+    table->getNeighbors().setSpreadingFactor(8);
+    NativeHost::useVirtualClock(1000000);
+
+    // The source is heard through a relay, which is now a stored path
+    RadioMeshPacket packet;
+    packet.sourceDevId = {1, 0, 0, 0};
+    packet.lastHopId = {2, 0, 0, 0};
+    packet.hopCount = 1;
+    table->updateRoute(packet, -80, 10.0);
+
+    byte frame[HEADER_LENGTH] = {};
+    std::copy(packet.sourceDevId.begin(), packet.sourceDevId.end(), frame + SDEV_ID_POS);
+    frame[LAST_HOP_ID_POS] = 2;
+    frame[HOP_COUNT_POS] = 1;
+    RadioMeshPacketView copy(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(table->canLearnFrom(copy, millis()));
+
+    // A copy through another relay is another path, until it is stored
+    frame[LAST_HOP_ID_POS] = 3;
+    TEST_ASSERT_TRUE(table->canLearnFrom(copy, millis()));
+    table->updateRoute(copy, -90, 5.0);
+    TEST_ASSERT_FALSE(table->canLearnFrom(copy, millis()));
+
+    // A longer copy is no path, it only tells of a neighbour until that one is known
+    frame[LAST_HOP_ID_POS] = 4;
+    frame[HOP_COUNT_POS] = 2;
+    TEST_ASSERT_TRUE(table->canLearnFrom(copy, millis()));
+    table->updateRoute(copy, -90, 5.0);
+    TEST_ASSERT_FALSE(table->canLearnFrom(copy, millis()));
+
+    // Nor is a copy at the hop limit
+    frame[LAST_HOP_ID_POS] = 5;
+    frame[HOP_COUNT_POS] = MAX_HOPS - 1;
+    TEST_ASSERT_FALSE(table->canLearnFrom(copy, millis()));
+
+    // Stored paths are refreshed from their copies once in a while
+    frame[LAST_HOP_ID_POS] = 3;
+    frame[HOP_COUNT_POS] = 1;
+    NativeHost::advanceMicros(ROUTE_PATH_REFRESH_MS * 1000ULL);
+    TEST_ASSERT_TRUE(table->canLearnFrom(copy, millis()));
+
+    NativeHost::useRealClock();
+    delete table;
+    RoutingTable::setInstance(previous);
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_RoutingTable_ack_failures);
+    RUN_TEST(test_RoutingTable_capacity_and_lru);
+    RUN_TEST(test_RoutingTable_link_cost_routes);
+    RUN_TEST(test_RoutingTable_multipath_failover);
+    RUN_TEST(test_RoutingTable_learns_from_new_copies);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif
@@ -0,0 +1,167 @@
+#include <RadioMesh.h>
+#include <core/protocol/inc/routing/TopologyGraph.h>
+#include <map>
+#include <random>
+#include <unity.h>
+
+// Shortest path costs from device 1 over the links, computed from scratch
+static std::map<uint32_t, uint32_t> shortestCosts(
+    const std::map<std::pair<uint32_t, uint32_t>, uint16_t>& links)
+{
+    std::map<uint32_t, uint32_t> costs = {{1, 0}};
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& link : links) {
+            uint32_t ends[2] = {link.first.first, link.first.second};
+            for (int i = 0; i < 2; i++) {
+                auto from = costs.find(ends[i]);
+                if (from == costs.end()) {
+                    continue;
+                }
+                uint32_t cost = from->second + link.second;
+                auto to = costs.find(ends[1 - i]);
+                if (to == costs.end() || cost < to->second) {
+                    costs[ends[1 - i]] = cost;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return costs;
+}
+
+void test_TopologyGraph_incremental_paths(void)
+{
+    const uint32_t DEVICES = 40;
+    std::mt19937 random(11);
+    TopologyGraph graph(RadioMeshUtils::uint32ToDeviceId(1).data());
+    std::map<std::pair<uint32_t, uint32_t>, uint16_t> links;
+
+    // Links come, change and go, the paths always match the ones computed from scratch
+    for (int step = 0; step < 600; step++) {
+        uint32_t a = 1 + random() % DEVICES;
+        uint32_t b = 1 + random() % DEVICES;
+        if (a == b) {
+            continue;
+        }
+        std::pair<uint32_t, uint32_t> key(std::min(a, b), std::max(a, b));
+        auto idA = RadioMeshUtils::uint32ToDeviceId(a);
+        auto idB = RadioMeshUtils::uint32ToDeviceId(b);
+        if (random() % 4 == 0) {
+            TEST_ASSERT_EQUAL(links.erase(key) == 1, graph.removeLink(idA.data(), idB.data()));
+        } else {
+            uint16_t cost = 100 + random() % 400;
+            auto existing = links.find(key);
+            // Changes under TOPOLOGY_COST_CHANGE_PCT are ignored
+            if (existing == links.end() || std::abs(cost - existing->second) * 100 >=
+                                               existing->second * TOPOLOGY_COST_CHANGE_PCT) {
+                links[key] = cost;
+            }
+            graph.updateLink(idA.data(), idB.data(), cost, 1, step);
+        }
+
+        std::map<uint32_t, uint32_t> expected = shortestCosts(links);
+        for (uint32_t device = 2; device <= DEVICES; device++) {
+            auto id = RadioMeshUtils::uint32ToDeviceId(device);
+            auto cost = expected.find(device);
+            TEST_ASSERT_EQUAL_UINT32(cost != expected.end() ? cost->second
+                                                            : TopologyGraph::UNREACHABLE,
+                                     graph.getCost(id.data()));
+        }
+    }
+    TEST_ASSERT_EQUAL(links.size(), graph.getLinkCount());
+
+    // A path adds up to its cost over the links it takes
+    for (uint32_t device = 2; device <= DEVICES; device++) {
+        auto id = RadioMeshUtils::uint32ToDeviceId(device);
+        std::vector<std::array<byte, DEV_ID_LENGTH>> path;
+        if (!graph.getPath(id.data(), &path)) {
+            continue;
+        }
+        TEST_ASSERT_EQUAL(path.size(), graph.getHops(id.data()));
+        TEST_ASSERT_TRUE(path.back() == id);
+        uint32_t cost = 0;
+        uint32_t previous = 1;
+        for (const auto& hop : path) {
+            uint32_t next = RadioMeshUtils::toUint32(hop.data());
+            cost += links.at({std::min(previous, next), std::max(previous, next)});
+            previous = next;
+        }
+        TEST_ASSERT_EQUAL_UINT32(graph.getCost(id.data()), cost);
+    }
+
+    // Only the devices a change moves are settled again, far fewer than all of them each time
+    const TopologyStats& stats = graph.getStats();
+    TEST_ASSERT_TRUE(stats.linkChanges > 300);
+    TEST_ASSERT_TRUE(stats.nodesSettled < stats.linkChanges * DEVICES / 4);
+}
+
+void test_TopologyGraph_packets(void)
+{
+    auto hub = RadioMeshUtils::uint32ToDeviceId(1);
+    auto relay = RadioMeshUtils::uint32ToDeviceId(2);
+    auto near = RadioMeshUtils::uint32ToDeviceId(3);
+    auto far = RadioMeshUtils::uint32ToDeviceId(4);
+    TopologyGraph graph(hub.data());
+
+    // Heard directly, then relayed once, then from 4 hops away
+    graph.onPacket(relay.data(), relay.data(), 1, 120, 1000);
+    graph.onPacket(near.data(), relay.data(), 2, 120, 1000);
+    graph.onPacket(far.data(), relay.data(), 4, 120, 1000);
+    TEST_ASSERT_EQUAL(4, graph.getNodeCount());
+    TEST_ASSERT_EQUAL(3, graph.getLinkCount());
+    TEST_ASSERT_EQUAL_UINT32(120, graph.getCost(relay.data()));
+    TEST_ASSERT_EQUAL_UINT32(120 + ROUTE_HOP_COST, graph.getCost(near.data()));
+    TEST_ASSERT_EQUAL(2, graph.getHops(near.data()));
+    TEST_ASSERT_EQUAL_UINT32(120 + 3 * ROUTE_HOP_COST, graph.getCost(far.data()));
+    TEST_ASSERT_EQUAL(4, graph.getHops(far.data()));
+
+    // A beacon of the nearer device listing the far one gives it a shorter path
+    graph.onBeacon(near.data(), far.data(), 2000);
+    graph.onBeacon(near.data(), hub.data(), 2000);
+    std::vector<std::array<byte, DEV_ID_LENGTH>> path;
+    TEST_ASSERT_TRUE(graph.getPath(far.data(), &path));
+    TEST_ASSERT_EQUAL(3, path.size());
+    TEST_ASSERT_TRUE(path[0] == relay && path[1] == near && path[2] == far);
+    TEST_ASSERT_EQUAL_UINT32(120 + 2 * ROUTE_HOP_COST, graph.getCost(far.data()));
+    TEST_ASSERT_EQUAL(4, graph.getLinkCount());
+
+    std::string json = graph.toJson();
+    TEST_ASSERT_TRUE(json.find("\"hub\":\"00000001\"") != std::string::npos);
+    TEST_ASSERT_TRUE(json.find("{\"id\":\"00000004\",\"cost\":420,\"hops\":3,"
+                               "\"via\":\"00000003\"}") != std::string::npos);
+
+    // Links expire once not observed for ROUTE_TIMEOUT, and the devices left without one
+    graph.onPacket(relay.data(), relay.data(), 1, 120, 1000 + ROUTE_TIMEOUT / 2);
+    graph.removeExpired(2000 + ROUTE_TIMEOUT);
+    TEST_ASSERT_EQUAL(1, graph.getLinkCount());
+    TEST_ASSERT_EQUAL(2, graph.getNodeCount());
+    TEST_ASSERT_EQUAL_UINT32(TopologyGraph::UNREACHABLE, graph.getCost(far.data()));
+    TEST_ASSERT_FALSE(graph.getPath(near.data(), &path));
+    TEST_ASSERT_EQUAL_UINT32(120, graph.getCost(relay.data()));
+}
+
+int runUnityTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_TopologyGraph_incremental_paths);
+    RUN_TEST(test_TopologyGraph_packets);
+    return UNITY_END();
+}
+
+#ifdef RM_NATIVE
+int main()
+{
+    return runUnityTests();
+}
+#else
+void setup()
+{
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#endif